@@ -0,0 +1,356 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// #define LOG_NDEBUG 0
+#define LOG_TAG "audio_utils_LoudnessMeter"
+#include <log/log.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <math.h>
+#include <sstream>
+
+#include <audio_utils/format.h>
+#include <audio_utils/LoudnessMeter.h>
+#include <audio_utils/power.h>
+
+namespace android {
+
+namespace {
+
+// BS.1770-4 loudness of a weighted mean square, the offset compensates the
+// K-weighting gain of +0.691 dB at 1 kHz.
+inline float loudnessFromEnergy(double energy)
+{
+    return -0.691f + 10.f * log10f((float)energy);
+}
+
+// K-weighting filter sections at any sample rate, from the analog prototypes
+// of the BS.1770-4 48 kHz coefficients: a high shelf modeling the head,
+// then the RLB high pass.
+std::array<float, audio_utils::kBiquadNumCoefs> highShelfCoefficients(uint32_t sampleRate)
+{
+    constexpr double f0 = 1681.974450955533;
+    constexpr double gainDb = 3.999843853973347;
+    constexpr double q = 0.7071752369554196;
+    const double k = tan(M_PI * f0 / sampleRate);
+    const double vh = pow(10., gainDb / 20.);
+    const double vb = pow(vh, 0.4996667741545416);
+    const double a0 = 1. + k / q + k * k;
+    return {(float)((vh + vb * k / q + k * k) / a0),
+            (float)(2. * (k * k - vh) / a0),
+            (float)((vh - vb * k / q + k * k) / a0),
+            (float)(2. * (k * k - 1.) / a0),
+            (float)((1. - k / q + k * k) / a0)};
+}
+
+std::array<float, audio_utils::kBiquadNumCoefs> highPassCoefficients(uint32_t sampleRate)
+{
+    constexpr double f0 = 38.13547087602444;
+    constexpr double q = 0.5003270373238773;
+    const double k = tan(M_PI * f0 / sampleRate);
+    const double a0 = 1. + k / q + k * k;
+    return {1.f, -2.f, 1.f,
+            (float)(2. * (k * k - 1.) / a0),
+            (float)((1. - k / q + k * k) / a0)};
+}
+
+// BS.1770-4 channel weights, in the order of the interleaved channels.
+std::vector<float> channelWeights(audio_channel_mask_t channelMask)
+{
+    std::vector<float> weights(audio_channel_count_from_out_mask(channelMask), 1.f);
+    if (audio_channel_mask_get_representation(channelMask)
+            != AUDIO_CHANNEL_REPRESENTATION_POSITION) {
+        return weights;
+    }
+    const uint32_t bits = audio_channel_mask_get_bits(channelMask);
+    constexpr uint32_t kSide = AUDIO_CHANNEL_OUT_SIDE_LEFT | AUDIO_CHANNEL_OUT_SIDE_RIGHT;
+    // The back channels of 5.1 are the surrounds at +/-110 degrees,
+    // but with side channels they are further back and are weighted as the front.
+    const uint32_t surround = (bits & kSide) != 0 ? kSide
+            : AUDIO_CHANNEL_OUT_BACK_LEFT | AUDIO_CHANNEL_OUT_BACK_RIGHT;
+    constexpr uint32_t kLfe = AUDIO_CHANNEL_OUT_LOW_FREQUENCY
+            | AUDIO_CHANNEL_OUT_LOW_FREQUENCY_2;
+    size_t i = 0;
+    for (uint32_t remaining = bits; remaining != 0; remaining &= remaining - 1) {
+        const uint32_t bit = remaining & -remaining;
+        weights[i++] = (bit & kLfe) != 0 ? 0.f : (bit & surround) != 0 ? 1.41f : 1.f;
+    }
+    return weights;
+}
+
+} // namespace
+
+LoudnessMeter::LoudnessMeter(
+        uint32_t sampleRate, audio_channel_mask_t channelMask, audio_format_t format)
+    : mChannelCount(audio_channel_count_from_out_mask(channelMask))
+    , mFormat(format)
+    , mStepFrames(std::max((sampleRate + 5) / 10, 1u))
+    , mOversampling(sampleRate < 96000 ? 4 : sampleRate < 192000 ? 2 : 1)
+    , mWeights(channelWeights(channelMask))
+    , mBuffer(kBlockFrames * mChannelCount)
+    , mFilter(mChannelCount, 2 /* sectionCount */)
+    , mTruePeakCoefs(mOversampling * kTruePeakTaps)
+    , mTruePeakHistory(mChannelCount * kTruePeakTaps * 2)
+{
+    mFilter.setCoefficients(0 /* section */, highShelfCoefficients(sampleRate));
+    mFilter.setCoefficients(1 /* section */, highPassCoefficients(sampleRate));
+    mFilter.commitCoefficients();
+
+    // The true peak interpolator is a Blackman windowed sinc, cutting off at the
+    // Nyquist frequency of the audio data, with the unity DC gain for each phase.
+    // Phase p interpolates at p / mOversampling after the sample kTruePeakTaps / 2 ago,
+    // so phase 0 is the samples themselves.
+    const size_t length = mOversampling * kTruePeakTaps;
+    for (size_t phase = 1; phase < mOversampling; ++phase) {
+        float *coefs = &mTruePeakCoefs[phase * kTruePeakTaps];
+        double sum = 0.;
+        for (size_t i = 0; i < kTruePeakTaps; ++i) {
+            const double m = i * mOversampling + phase;  // for x[n - i]
+            const double t = (m - length * 0.5) / mOversampling;
+            const double sinc = t == 0. ? 1. : sin(M_PI * t) / (M_PI * t);
+            const double window = 0.42 - 0.5 * cos(2. * M_PI * m / length)
+                    + 0.08 * cos(4. * M_PI * m / length);
+            coefs[i] = sinc * window;
+            sum += coefs[i];
+        }
+        for (size_t i = 0; i < kTruePeakTaps; ++i) {
+            coefs[i] /= sum;
+        }
+    }
+    reset();
+}
+
+void LoudnessMeter::process(const void *buffer, size_t frames)
+{
+    const size_t frameSize = mChannelCount * audio_bytes_per_sample(mFormat);
+    const uint8_t *data = static_cast<const uint8_t *>(buffer);
+    while (frames > 0) {
+        const size_t count = std::min(frames, kBlockFrames);
+        memcpy_by_audio_format(mBuffer.data(), AUDIO_FORMAT_PCM_FLOAT,
+                data, mFormat, count * mChannelCount);
+        processBlock(count);
+        data += count * frameSize;
+        frames -= count;
+    }
+}
+
+void LoudnessMeter::processBlock(size_t frames)
+{
+    float *buffer = mBuffer.data();
+
+    // The true peak is the maximum of the samples and the samples interpolated
+    // between them.  The history of the last kTruePeakTaps samples of each channel
+    // is stored twice, so the newest is at index + kTruePeakTaps, and it is preceded
+    // by the others.
+    float peak = mPeak;
+    for (size_t i = 0; i < frames; ++i) {
+        for (size_t ch = 0; ch < mChannelCount; ++ch) {
+            const float x = buffer[i * mChannelCount + ch];
+            peak = std::max(peak, fabsf(x));
+            if (mOversampling == 1) continue;
+            float *history = &mTruePeakHistory[ch * kTruePeakTaps * 2];
+            history[mTruePeakIndex] = x;
+            history[mTruePeakIndex + kTruePeakTaps] = x;
+            const float *newest = history + mTruePeakIndex + kTruePeakTaps;
+            for (size_t phase = 1; phase < mOversampling; ++phase) {
+                const float *coefs = &mTruePeakCoefs[phase * kTruePeakTaps];
+                float y = 0.f;
+                for (size_t k = 0; k < kTruePeakTaps; ++k) {
+                    y += coefs[k] * newest[-(ptrdiff_t)k];
+                }
+                peak = std::max(peak, fabsf(y));
+            }
+        }
+        if (++mTruePeakIndex == kTruePeakTaps) {
+            mTruePeakIndex = 0;
+        }
+    }
+    if (peak > mPeak) {
+        mPeak = peak;
+        mTruePeak.store(20.f * log10f(peak), std::memory_order_relaxed);
+    }
+
+    mFilter.process(buffer, buffer, frames);
+
+    for (size_t i = 0; i < frames; ) {
+        const size_t count = std::min(frames - i, mStepFrames - mStepFramesDone);
+        float energy = 0.f;
+        for (size_t j = i; j < i + count; ++j) {
+            for (size_t ch = 0; ch < mChannelCount; ++ch) {
+                const float x = buffer[j * mChannelCount + ch];
+                energy += mWeights[ch] * x * x;
+            }
+        }
+        mStepEnergy += energy;
+        mStepFramesDone += count;
+        i += count;
+        if (mStepFramesDone == mStepFrames) {
+            completeStep();
+        }
+    }
+}
+
+void LoudnessMeter::completeStep()
+{
+    mSteps[mStepCount % kShortTermSteps] = mStepEnergy / mStepFrames;
+    ++mStepCount;
+    mStepEnergy = 0.;
+    mStepFramesDone = 0;
+
+    // Before the windows are full, the missing steps count as silence.
+    double momentary = 0.;
+    double shortTerm = 0.;
+    for (size_t i = 0; i < kShortTermSteps; ++i) {
+        const double energy = mSteps[(mStepCount + kShortTermSteps - 1 - i) % kShortTermSteps];
+        if (i < kMomentarySteps) {
+            momentary += energy;
+        }
+        shortTerm += energy;
+    }
+    momentary /= kMomentarySteps;
+    shortTerm /= kShortTermSteps;
+    mMomentaryLoudness.store(loudnessFromEnergy(momentary), std::memory_order_relaxed);
+    mShortTermLoudness.store(loudnessFromEnergy(shortTerm), std::memory_order_relaxed);
+
+    // The momentary window is the 400 ms gating block.
+    const float loudness = loudnessFromEnergy(momentary);
+    if (mStepCount < kMomentarySteps || !(loudness > kAbsoluteGateLufs)) {
+        return;
+    }
+    const size_t bin = std::min(
+            (size_t)((loudness - kAbsoluteGateLufs) * 10.f), kHistogramBins - 1);
+    ++mHistogramCounts[bin];
+    mHistogramEnergies[bin] += momentary;
+    ++mGatedCount;
+    mGatedEnergy += momentary;
+
+    // The blocks in the bin of the relative gate are included by the mean of the bin.
+    const float threshold = loudnessFromEnergy(mGatedEnergy / mGatedCount) + kRelativeGateLu;
+    const size_t thresholdBin = threshold > kAbsoluteGateLufs ? std::min(
+            (size_t)((threshold - kAbsoluteGateLufs) * 10.f), kHistogramBins - 1) : 0;
+    uint64_t count = 0;
+    double energy = 0.;
+    for (size_t i = thresholdBin; i < kHistogramBins; ++i) {
+        if (i == thresholdBin && mHistogramCounts[i] != 0
+                && loudnessFromEnergy(mHistogramEnergies[i] / mHistogramCounts[i]) < threshold) {
+            continue;
+        }
+        count += mHistogramCounts[i];
+        energy += mHistogramEnergies[i];
+    }
+    mIntegratedLoudness.store(count == 0 ? -INFINITY : loudnessFromEnergy(energy / count),
+            std::memory_order_relaxed);
+}
+
+void LoudnessMeter::reset()
+{
+    mFilter.clear();
+    std::fill(mTruePeakHistory.begin(), mTruePeakHistory.end(), 0.f);
+    mTruePeakIndex = 0;
+    mPeak = 0.f;
+    mStepEnergy = 0.;
+    mStepFramesDone = 0;
+    mSteps.fill(0.);
+    mStepCount = 0;
+    mGatedCount = 0;
+    mGatedEnergy = 0.;
+    mHistogramCounts.fill(0);
+    mHistogramEnergies.fill(0.);
+    mMomentaryLoudness.store(-INFINITY, std::memory_order_relaxed);
+    mShortTermLoudness.store(-INFINITY, std::memory_order_relaxed);
+    mIntegratedLoudness.store(-INFINITY, std::memory_order_relaxed);
+    mTruePeak.store(-INFINITY, std::memory_order_relaxed);
+}
+
+std::string LoudnessMeter::toString(const char *prefix) const
+{
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(1) << prefix
+            << "Loudness momentary: " << getMomentaryLoudness()
+            << " LUFS short-term: " << getShortTermLoudness()
+            << " LUFS integrated: " << getIntegratedLoudness()
+            << " LUFS true peak: " << getTruePeak() << " dBTP\n";
+    return ss.str();
+}
+
+} // namespace android
+
+using namespace android;
+
+loudness_meter_t *loudness_meter_create(uint32_t sample_rate,
+        audio_channel_mask_t channel_mask, audio_format_t format)
+{
+    if (!audio_utils_is_compute_power_format_supported(format)
+            || audio_channel_count_from_out_mask(channel_mask) == 0 || sample_rate == 0) {
+        return nullptr;
+    }
+    return reinterpret_cast<loudness_meter_t *>
+            (new(std::nothrow) LoudnessMeter(sample_rate, channel_mask, format));
+}
+
+void loudness_meter_process(loudness_meter_t *loudness_meter, const void *buffer, size_t frames)
+{
+    if (loudness_meter == nullptr) {
+        return;
+    }
+    reinterpret_cast<LoudnessMeter *>(loudness_meter)->process(buffer, frames);
+}
+
+void loudness_meter_reset(loudness_meter_t *loudness_meter)
+{
+    if (loudness_meter == nullptr) {
+        return;
+    }
+    reinterpret_cast<LoudnessMeter *>(loudness_meter)->reset();
+}
+
+float loudness_meter_get_momentary(const loudness_meter_t *loudness_meter)
+{
+    if (loudness_meter == nullptr) {
+        return NAN;
+    }
+    return reinterpret_cast<const LoudnessMeter *>(loudness_meter)->getMomentaryLoudness();
+}
+
+float loudness_meter_get_short_term(const loudness_meter_t *loudness_meter)
+{
+    if (loudness_meter == nullptr) {
+        return NAN;
+    }
+    return reinterpret_cast<const LoudnessMeter *>(loudness_meter)->getShortTermLoudness();
+}
+
+float loudness_meter_get_integrated(const loudness_meter_t *loudness_meter)
+{
+    if (loudness_meter == nullptr) {
+        return NAN;
+    }
+    return reinterpret_cast<const LoudnessMeter *>(loudness_meter)->getIntegratedLoudness();
+}
+
+float loudness_meter_get_true_peak(const loudness_meter_t *loudness_meter)
+{
+    if (loudness_meter == nullptr) {
+        return NAN;
+    }
+    return reinterpret_cast<const LoudnessMeter *>(loudness_meter)->getTruePeak();
+}
+
+void loudness_meter_destroy(loudness_meter_t *loudness_meter)
+{
+    delete reinterpret_cast<LoudnessMeter *>(loudness_meter);
+}
@@ -33,6 +33,9 @@
 
 namespace android {
 
+static_assert(std::atomic<int64_t>::is_always_lock_free && std::atomic<float>::is_always_lock_free
+        && std::atomic<uint64_t>::is_always_lock_free, "PowerLog requires lock-free atomics");
+
 // TODO move to separate file
 template <typename T, size_t N>
 constexpr size_t array_size(const T(&)[N])
@@ -44,26 +47,62 @@ PowerLog::PowerLog(uint32_t sampleRate,
         uint32_t channelCount,
         audio_format_t format,
         size_t entries,
-        size_t framesPerEntry)
-    : mCurrentTime(0)
+        size_t framesPerEntry,
+        bool lockFree)
+    : mLockFree(lockFree)
+    , mCurrentTime(0)
     , mCurrentEnergy(0)
     , mCurrentFrames(0)
-    , mIdx(0)
     , mConsecutiveZeroes(0)
     , mSampleRate(sampleRate)
     , mChannelCount(channelCount)
     , mFormat(format)
     , mFramesPerEntry(framesPerEntry)
-    , mEntries(entries)
+    , mEntryCount(entries)
+    , mEntries(new Entry[entries])
 {
     (void)mSampleRate; // currently unused, for future use
     LOG_ALWAYS_FATAL_IF(!audio_utils_is_compute_power_format_supported(format),
             "unsupported format: %#x", format);
 }
 
+void PowerLog::writeEntry(int64_t timeNs, float energy)
+{
+    const uint64_t count = mEndCount.load(std::memory_order_relaxed);
+    mBeginCount.store(count + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    Entry &entry = mEntries[count % mEntryCount];
+    entry.mTime.store(timeNs, std::memory_order_relaxed);
+    entry.mEnergy.store(energy, std::memory_order_relaxed);
+    mEndCount.store(count + 1, std::memory_order_release);
+}
+
+void PowerLog::readEntries(std::vector<std::pair<int64_t, float>>& entries, size_t& idx) const
+{
+    const uint64_t end = mEndCount.load(std::memory_order_acquire);
+    for (size_t i = 0; i < mEntryCount; ++i) {
+        entries[i] = std::make_pair(mEntries[i].mTime.load(std::memory_order_relaxed),
+                mEntries[i].mEnergy.load(std::memory_order_relaxed));
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint64_t begin = mBeginCount.load(std::memory_order_relaxed);
+
+    // The entries from end were begun during the copy, and each overwrites the oldest entry,
+    // so clear the oldest begin - end entries.  A zero entry terminates the signal,
+    // as if the entry had been overwritten before the dump.
+    const uint64_t overwritten = std::min(begin - end, (uint64_t)mEntryCount);
+    for (uint64_t i = 0; i < overwritten; ++i) {
+        entries[(end + i) % mEntryCount] = std::make_pair(0, 0.f);
+    }
+    idx = end % mEntryCount;
+}
+
 void PowerLog::log(const void *buffer, size_t frames, int64_t nowNs)
 {
-    std::lock_guard<std::mutex> guard(mLock);
+    std::unique_lock<std::mutex> guard(mLock, std::defer_lock);
+    if (!mLockFree) {
+        guard.lock();
+    }
 
     const size_t bytes_per_sample = audio_bytes_per_sample(mFormat);
     while (frames > 0) {
@@ -88,17 +127,14 @@ void PowerLog::log(const void *buffer, size_t frames, int64_t nowNs)
         // zero terminated. Consecutive zeroes are ignored.
         if (mCurrentEnergy == 0.f) {
             if (mConsecutiveZeroes++ == 0) {
-                mEntries[mIdx++] = std::make_pair(nowNs, 0.f);
+                writeEntry(nowNs, 0.f);
                 // zero terminate the signal sequence.
             }
         } else {
             mConsecutiveZeroes = 0;
-            mEntries[mIdx++] = std::make_pair(mCurrentTime, mCurrentEnergy);
+            writeEntry(mCurrentTime, mCurrentEnergy);
             ALOGV("writing %lld %f", (long long)mCurrentTime, mCurrentEnergy);
         }
-        if (mIdx >= mEntries.size()) {
-            mIdx -= mEntries.size();
-        }
         mCurrentTime = 0;
         mCurrentEnergy = 0;
         mCurrentFrames = 0;
@@ -110,10 +146,21 @@ void PowerLog::log(const void *buffer, size_t frames, int64_t nowNs)
 std::string PowerLog::dumpToString(
         const char *prefix, size_t lines, int64_t limitNs, bool logPlot) const
 {
-    std::lock_guard<std::mutex> guard(mLock);
+    // Format a snapshot of the entries, so log() is blocked at most for the copy,
+    // or not at all in lock-free mode.
+    const size_t numberOfEntries = mEntryCount;
+    std::vector<std::pair<int64_t /* real time ns */, float /* energy */>> entries(
+            numberOfEntries);
+    size_t idx;
+    {
+        std::unique_lock<std::mutex> guard(mLock, std::defer_lock);
+        if (!mLockFree) {
+            guard.lock();
+        }
+        readEntries(entries, idx);
+    }
 
     const size_t maxColumns = 10;
-    const size_t numberOfEntries = mEntries.size();
     if (lines == 0) lines = SIZE_MAX;
 
     // compute where to start logging
@@ -126,10 +173,10 @@ std::string PowerLog::dumpToString(
     size_t nonzeros = 0;
     ssize_t offset; // TODO doesn't dump if # entries exceeds SSIZE_MAX
     for (offset = 0; offset < (ssize_t)numberOfEntries && count < lines; ++offset) {
-        const size_t idx = (mIdx + numberOfEntries - offset - 1) % numberOfEntries;
+        const size_t index = (idx + numberOfEntries - offset - 1) % numberOfEntries;
                                                                                 // reverse direction
-        const int64_t time = mEntries[idx].first;
-        const float energy = mEntries[idx].second;
+        const int64_t time = entries[index].first;
+        const float energy = entries[index].second;
 
         if (state == AT_END) {
             if (energy == 0.f) {
@@ -179,9 +226,9 @@ std::string PowerLog::dumpToString(
         bool start = false;
         float cumulative = 0.f;
         for (; offset >= 0; --offset) {
-            const size_t idx = (mIdx + numberOfEntries - offset - 1) % numberOfEntries;
-            const int64_t time = mEntries[idx].first;
-            const float energy = mEntries[idx].second;
+            const size_t index = (idx + numberOfEntries - offset - 1) % numberOfEntries;
+            const int64_t time = entries[index].first;
+            const float energy = entries[index].second;
 
             if (energy == 0.f) {
                 if (!first) {
@@ -17,11 +17,13 @@
 #include <array>
 #include <climits>
 #include <cstdlib>
+#include <memory>
 #include <random>
 #include <vector>
 
 #include <benchmark/benchmark.h>
 
+#include <audio_utils/BiquadCascade.h>
 #include <audio_utils/BiquadFilter.h>
 #include <audio_utils/format.h>
 
@@ -305,4 +307,143 @@ BENCHMARK(BM_BiquadFilterFloatOptimized)->Apply(BiquadFilterQuickArgs);
 BENCHMARK(BM_BiquadFilterFloatNonOptimized)->Apply(BiquadFilterQuickArgs);
 BENCHMARK(BM_BiquadFilterFloatOptimized)->Apply(BiquadFilterFullArgs);
 
+// Cascaded sections, as for a parametric EQ, on a buffer which is larger than L1 cache.
+// The first parameter indicates the channel count.
+// The second parameter indicates the number of sections.
+// The third parameter is 1 for BiquadCascade, which applies all the sections to each block
+// (or to each sample, for few channels),
+// or 0 for separate BiquadFilters which each process the whole buffer.
+static constexpr size_t CASCADE_DATA_SIZE = 8192;
+
+template <typename F>
+static void BM_BiquadCascade(benchmark::State& state) {
+    using android::audio_utils::BiquadCascade;
+    using android::audio_utils::BiquadFilter;
+
+    const size_t channelCount = state.range(0);
+    const size_t sections = state.range(1);
+    const bool useCascade = state.range(2) == 1;
+
+    std::vector<F> input(CASCADE_DATA_SIZE * channelCount);
+    std::vector<F> output(CASCADE_DATA_SIZE * channelCount);
+    std::minstd_rand gen(sections);
+    std::uniform_real_distribution<> dis(-1., 1.);
+    for (auto& sample : input) {
+        sample = dis(gen);
+    }
+    std::array<F, android::audio_utils::kBiquadNumCoefs> coefs;
+    std::copy(std::begin(REF_COEFS), std::end(REF_COEFS), coefs.begin());
+
+    BiquadCascade<F> cascade(channelCount, sections);
+    std::vector<std::unique_ptr<BiquadFilter<F>>> biquads(sections);
+    for (size_t i = 0; i < sections; ++i) {
+        cascade.setCoefficients(i, coefs);
+        biquads[i].reset(new BiquadFilter<F>(channelCount, coefs));
+    }
+    cascade.commitCoefficients();
+
+    // Run the test
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(input.data());
+        benchmark::DoNotOptimize(output.data());
+        if (useCascade) {
+            cascade.process(output.data(), input.data(), CASCADE_DATA_SIZE);
+        } else {
+            const F *in = input.data();
+            for (auto& biquad : biquads) {
+                biquad->process(output.data(), in, CASCADE_DATA_SIZE);
+                in = output.data();
+            }
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetComplexityN(sections);
+}
+
+static void BM_BiquadCascadeFloat(benchmark::State& state) {
+    BM_BiquadCascade<float>(state);
+}
+
+static void BiquadCascadeArgs(benchmark::internal::Benchmark* b) {
+    for (int channelCount : {1, 2, 8}) {
+        for (int sections : {4, 8, 16}) {
+            for (int useCascade = 0; useCascade < 2; ++useCascade) {
+                b->Args({channelCount, sections, useCascade});
+            }
+        }
+    }
+}
+
+BENCHMARK(BM_BiquadCascadeFloat)->Apply(BiquadCascadeArgs);
+
+// Coefficient automation, where the coefficients change in every buffer.
+// The first parameter indicates the channel count.
+// The second parameter is 1 to ramp the coefficients in the kernel over the buffer,
+// or 0 to set interpolated coefficients for every block of RAMP_BLOCK_FRAMES frames.
+static constexpr size_t RAMP_DATA_SIZE = 1024;
+static constexpr size_t RAMP_BLOCK_FRAMES = 16;
+
+template <typename F>
+static void BM_BiquadFilterRamp(benchmark::State& state) {
+    using android::audio_utils::BiquadFilter;
+    using android::audio_utils::kBiquadNumCoefs;
+
+    const size_t channelCount = state.range(0);
+    const bool ramp = state.range(1) == 1;
+
+    std::vector<F> input(RAMP_DATA_SIZE * channelCount);
+    std::vector<F> output(RAMP_DATA_SIZE * channelCount);
+    std::minstd_rand gen(channelCount);
+    std::uniform_real_distribution<> dis(-1., 1.);
+    for (auto& sample : input) {
+        sample = dis(gen);
+    }
+    std::array<F, kBiquadNumCoefs> coefs[2];
+    std::copy(std::begin(REF_COEFS), std::end(REF_COEFS), coefs[0].begin());
+    coefs[1] = coefs[0];
+    coefs[1][0] *= 0.5f;  // gain change
+
+    BiquadFilter<F> biquad(channelCount, coefs[0]);
+    biquad.setRampFrames(ramp ? RAMP_DATA_SIZE : 0);
+
+    // Run the test
+    size_t toggle = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(input.data());
+        benchmark::DoNotOptimize(output.data());
+        toggle ^= 1;
+        if (ramp) {
+            biquad.setCoefficients(coefs[toggle]);
+            biquad.process(output.data(), input.data(), RAMP_DATA_SIZE);
+        } else {
+            for (size_t i = 0; i < RAMP_DATA_SIZE; i += RAMP_BLOCK_FRAMES) {
+                const F fraction = F(i) / RAMP_DATA_SIZE;
+                std::array<F, kBiquadNumCoefs> blockCoefs;
+                for (size_t j = 0; j < kBiquadNumCoefs; ++j) {
+                    blockCoefs[j] = coefs[toggle ^ 1][j]
+                            + fraction * (coefs[toggle][j] - coefs[toggle ^ 1][j]);
+                }
+                biquad.setCoefficients(blockCoefs);
+                biquad.process(output.data() + i * channelCount,
+                        input.data() + i * channelCount, RAMP_BLOCK_FRAMES);
+            }
+        }
+        benchmark::ClobberMemory();
+    }
+}
+
+static void BM_BiquadFilterRampFloat(benchmark::State& state) {
+    BM_BiquadFilterRamp<float>(state);
+}
+
+static void BiquadFilterRampArgs(benchmark::internal::Benchmark* b) {
+    for (int channelCount : {1, 2, 4, 8, 16}) {
+        for (int ramp = 0; ramp < 2; ++ramp) {
+            b->Args({channelCount, ramp});
+        }
+    }
+}
+
+BENCHMARK(BM_BiquadFilterRampFloat)->Apply(BiquadFilterRampArgs);
+
 BENCHMARK_MAIN();
@@ -45,6 +45,9 @@ static constexpr audio_channel_mask_t kChannelPositionMasks[] = {
     AUDIO_CHANNEL_OUT_7POINT1POINT4,
     AUDIO_CHANNEL_OUT_13POINT_360RA,
     AUDIO_CHANNEL_OUT_22POINT2,
+    AUDIO_CHANNEL_OUT_9POINT1POINT6,
+    audio_channel_mask_t(AUDIO_CHANNEL_OUT_22POINT2
+            | AUDIO_CHANNEL_OUT_FRONT_WIDE_LEFT | AUDIO_CHANNEL_OUT_FRONT_WIDE_RIGHT),
 };
 
 /*
@@ -78,14 +81,15 @@ BM_ChannelMix/20      11293 ns        11262 ns        62135 AUDIO_CHANNEL_OUT_13
 BM_ChannelMix/21      19886 ns        19829 ns        35265 AUDIO_CHANNEL_OUT_22POINT2
 */
 
-static void BM_ChannelMix(benchmark::State& state) {
+template <typename ChannelMixType>
+static void BenchmarkChannelMix(benchmark::State& state) {
     const audio_channel_mask_t channelMask = kChannelPositionMasks[state.range(0)];
-    using namespace ::android::audio_utils::channels;
-    ChannelMix channelMix(channelMask);
+    ChannelMixType channelMix(channelMask);
     constexpr size_t frameCount = 1024;
     size_t inChannels = audio_channel_count_from_out_mask(channelMask);
     std::vector<float> input(inChannels * frameCount);
-    std::vector<float> output(FCC_2 * frameCount);
+    std::vector<float> output(
+            audio_channel_count_from_out_mask(channelMix.getOutputChannelMask()) * frameCount);
     constexpr float amplitude = 0.01f;
 
     std::minstd_rand gen(channelMask);
@@ -107,6 +111,20 @@ static void BM_ChannelMix(benchmark::State& state) {
     state.SetLabel(audio_channel_out_mask_to_string(channelMask));
 }
 
+using namespace ::android::audio_utils::channels;
+
+static void BM_ChannelMix(benchmark::State& state) {
+    BenchmarkChannelMix<ChannelMix>(state);
+}
+
+static void BM_ChannelMix5Point1(benchmark::State& state) {
+    BenchmarkChannelMix<SurroundChannelMix<AUDIO_CHANNEL_OUT_5POINT1>>(state);
+}
+
+static void BM_ChannelMix7Point1(benchmark::State& state) {
+    BenchmarkChannelMix<SurroundChannelMix<AUDIO_CHANNEL_OUT_7POINT1>>(state);
+}
+
 static void ChannelMixArgs(benchmark::internal::Benchmark* b) {
     for (int i = 0; i < (int)std::size(kChannelPositionMasks); i++) {
         b->Args({i});
@@ -115,4 +133,8 @@ static void ChannelMixArgs(benchmark::internal::Benchmark* b) {
 
 BENCHMARK(BM_ChannelMix)->Apply(ChannelMixArgs);
 
+BENCHMARK(BM_ChannelMix5Point1)->Apply(ChannelMixArgs);
+
+BENCHMARK(BM_ChannelMix7Point1)->Apply(ChannelMixArgs);
+
 BENCHMARK_MAIN();
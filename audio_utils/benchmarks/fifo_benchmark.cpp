@@ -0,0 +1,84 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <limits.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <audio_utils/fifo.h>
+
+/*
+ * Transfer of stereo 16-bit frames between a writer and a reader thread, in releases of
+ * state.range(0) frames.  The writer commits every state.range(1) releases,
+ * where 0 means batching mode is disabled and every release stores the rear index and wakes the
+ * reader.  The reader uses caching mode whenever the writer uses batching mode.
+ *
+ * At 48 kHz, a release of 48 frames is 1 ms.
+ */
+static void BM_fifo_transfer(benchmark::State& state) {
+    const size_t framesPerRelease = state.range(0);
+    const int64_t releasesPerCommit = state.range(1);
+    constexpr uint32_t kFrameCount = 1024;
+    std::vector<int32_t> buffer(kFrameCount);
+    audio_utils_fifo fifo(kFrameCount, sizeof(int32_t), buffer.data());
+    audio_utils_fifo_writer writer(fifo);
+    audio_utils_fifo_reader reader(fifo);
+    const bool batching = releasesPerCommit > 0;
+    writer.setBatching(batching);
+    reader.setCaching(batching);
+
+    std::atomic_bool done{false};
+    std::thread thread([&reader, &done] {
+        const struct timespec timeout = {0 /*tv_sec*/, 1000000 /*tv_nsec*/};
+        std::vector<int32_t> frames(kFrameCount);
+        while (!done.load() || reader.available() > 0) {
+            (void) reader.read(frames.data(), frames.size(), &timeout);
+        }
+    });
+
+    const struct timespec forever = {LONG_MAX /*tv_sec*/, 0 /*tv_nsec*/};
+    std::vector<int32_t> frames(framesPerRelease);
+    int64_t releases = 0;
+    for (auto _ : state) {
+        ssize_t written = writer.write(frames.data(), frames.size(), &forever);
+        benchmark::DoNotOptimize(written);
+        if (batching && ++releases % releasesPerCommit == 0) {
+            writer.commit();
+        }
+    }
+    writer.commit();
+    done = true;
+    thread.join();
+
+    state.SetItemsProcessed(writer.totalReleased());
+    state.SetLabel(batching ? "commit every " + std::to_string(releasesPerCommit) : "unbatched");
+}
+
+static void FifoArgs(benchmark::internal::Benchmark* b) {
+    for (int framesPerRelease : {1, 16, 48}) {
+        for (int releasesPerCommit : {0, 4, 16}) {
+            b->Args({framesPerRelease, releasesPerCommit});
+        }
+    }
+}
+
+BENCHMARK(BM_fifo_transfer)->Apply(FifoArgs)->UseRealTime();
+
+BENCHMARK_MAIN();
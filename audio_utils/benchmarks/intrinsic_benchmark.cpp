@@ -25,15 +25,10 @@
 #include <audio_utils/intrinsic_utils.h>
 #include <audio_utils/format.h>
 
+template <typename vec>
 static void BM_Intrinsic(benchmark::State& state) {
     using D = float;
     using namespace android::audio_utils::intrinsics;
-    constexpr size_t SIMD_LENGTH = 4;
-
-    // Possible testing types:
-    using vec = android::audio_utils::intrinsics::internal_array_t<D, SIMD_LENGTH>;
-    //using vec = float32x4_t;
-    //using vec = float32x4x4_t;
 
     constexpr size_t DATA_SIZE = 1024;
     D a[DATA_SIZE];
@@ -74,6 +69,25 @@ static void BM_IntrinsicArgs(benchmark::internal::Benchmark* b) {
          b->Args({k});
 }
 
-BENCHMARK(BM_Intrinsic)->Apply(BM_IntrinsicArgs);
+// Possible testing types:
+// NEON: float32x4_t, float32x4x4_t
+// x86: __m128, __m256 (with -mavx), __m512 (with -mavx512f)
+BENCHMARK_TEMPLATE(BM_Intrinsic, android::audio_utils::intrinsics::internal_array_t<float, 4>)
+        ->Apply(BM_IntrinsicArgs);
+
+#if defined(__ARM_NEON__) || defined(__aarch64__)
+BENCHMARK_TEMPLATE(BM_Intrinsic, float32x4_t)->Apply(BM_IntrinsicArgs);
+BENCHMARK_TEMPLATE(BM_Intrinsic, float32x4x4_t)->Apply(BM_IntrinsicArgs);
+#elif defined(__SSE2__)
+BENCHMARK_TEMPLATE(BM_Intrinsic, __m128)->Apply(BM_IntrinsicArgs);
+BENCHMARK_TEMPLATE(BM_Intrinsic,
+        android::audio_utils::intrinsics::internal_array_t<__m128, 4>)->Apply(BM_IntrinsicArgs);
+#if defined(__AVX__)
+BENCHMARK_TEMPLATE(BM_Intrinsic, __m256)->Apply(BM_IntrinsicArgs);
+#endif
+#if defined(__AVX512F__)
+BENCHMARK_TEMPLATE(BM_Intrinsic, __m512)->Apply(BM_IntrinsicArgs);
+#endif
+#endif
 
 BENCHMARK_MAIN();
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstddef>
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <audio_utils/power.h>
+
+static constexpr size_t kFrames = 1024;
+
+template <typename T>
+static std::vector<T> randomSamples(size_t count) {
+    std::vector<T> samples(count);
+    std::minstd_rand gen(count);
+    std::uniform_real_distribution<> dis(-0.5, 0.5);
+    for (auto& sample : samples) {
+        if constexpr (std::is_same_v<T, float>) {
+            sample = dis(gen);
+        } else {
+            sample = dis(gen) * (1 << (sizeof(T) * 8 - 1));
+        }
+    }
+    return samples;
+}
+
+// Energy of each channel, with the channels deinterleaved and then passed to
+// audio_utils_compute_energy_mono() one at a time.
+template <typename T, audio_format_t FORMAT>
+static void BM_EnergyDeinterleaved(benchmark::State& state) {
+    const size_t channelCount = state.range(0);
+    const std::vector<T> input = randomSamples<T>(kFrames * channelCount);
+    std::vector<T> channel(kFrames);
+    std::vector<float> energy(channelCount);
+
+    // Run the test
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(input.data());
+        for (size_t j = 0; j < channelCount; ++j) {
+            for (size_t i = 0; i < kFrames; ++i) {
+                channel[i] = input[i * channelCount + j];
+            }
+            energy[j] = audio_utils_compute_energy_mono(channel.data(), FORMAT, kFrames);
+        }
+        benchmark::DoNotOptimize(energy.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetComplexityN(channelCount);
+}
+
+// Energy, peak, DC offset and zero crossings of each channel in one pass.
+template <typename T, audio_format_t FORMAT>
+static void BM_ChannelStats(benchmark::State& state) {
+    const size_t channelCount = state.range(0);
+    const std::vector<T> input = randomSamples<T>(kFrames * channelCount);
+    std::vector<audio_utils_channel_stats> stats(channelCount);
+
+    // Run the test
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(input.data());
+        audio_utils_compute_channel_stats(
+                input.data(), FORMAT, kFrames, channelCount, stats.data());
+        benchmark::DoNotOptimize(stats.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetComplexityN(channelCount);
+}
+
+static void ChannelArgs(benchmark::internal::Benchmark* b) {
+    for (int channelCount : {1, 2, 6, 8, 12}) {
+        b->Arg(channelCount);
+    }
+}
+
+BENCHMARK_TEMPLATE(BM_EnergyDeinterleaved, float, AUDIO_FORMAT_PCM_FLOAT)->Apply(ChannelArgs);
+BENCHMARK_TEMPLATE(BM_ChannelStats, float, AUDIO_FORMAT_PCM_FLOAT)->Apply(ChannelArgs);
+BENCHMARK_TEMPLATE(BM_EnergyDeinterleaved, int16_t, AUDIO_FORMAT_PCM_16_BIT)->Apply(ChannelArgs);
+BENCHMARK_TEMPLATE(BM_ChannelStats, int16_t, AUDIO_FORMAT_PCM_16_BIT)->Apply(ChannelArgs);
+
+BENCHMARK_MAIN();
@@ -137,4 +137,160 @@ static void BM_MemcpyToI16FromFloat(benchmark::State& state) {
 
 BENCHMARK(BM_MemcpyToI16FromFloat)->RangeMultiplier(2)->Ranges({{10, 8<<12}});
 
+static void BM_MemcpyToFloatFromQ8_23(benchmark::State& state) {
+    const size_t count = state.range(0);
+
+    std::vector<int32_t> src(count);
+    std::vector<float> dst(count);
+
+    // Initialize src buffer with deterministic pseudo-random values
+    std::minstd_rand gen(count);
+    std::uniform_int_distribution<> dis(-0x800000, 0x7fffff);
+    for (size_t i = 0; i < count; i++) {
+        src[i] = dis(gen);
+    }
+
+    // Run the test
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(src.data());
+        benchmark::DoNotOptimize(dst.data());
+        memcpy_to_float_from_q8_23(dst.data(), src.data(), count);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetComplexityN(state.range(0));
+}
+
+BENCHMARK(BM_MemcpyToFloatFromQ8_23)->RangeMultiplier(2)->Ranges({{10, 8<<12}});
+
+static void BM_MemcpyToQ8_23FromFloat(benchmark::State& state) {
+    const size_t count = state.range(0);
+
+    std::vector<float> src(count);
+    std::vector<int32_t> dst(count);
+
+    // Initialize src buffer with deterministic pseudo-random values
+    std::minstd_rand gen(count);
+    std::uniform_real_distribution<> dis;
+    for (size_t i = 0; i < count; i++) {
+        src[i] = dis(gen);
+    }
+
+    // Run the test
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(src.data());
+        benchmark::DoNotOptimize(dst.data());
+        memcpy_to_q8_23_from_float_with_clamp(dst.data(), src.data(), count);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetComplexityN(state.range(0));
+}
+
+BENCHMARK(BM_MemcpyToQ8_23FromFloat)->RangeMultiplier(2)->Ranges({{10, 8<<12}});
+
+static void BM_MemcpyToI32FromFloat(benchmark::State& state) {
+    const size_t count = state.range(0);
+
+    std::vector<float> src(count);
+    std::vector<int32_t> dst(count);
+
+    // Initialize src buffer with deterministic pseudo-random values
+    std::minstd_rand gen(count);
+    std::uniform_real_distribution<> dis;
+    for (size_t i = 0; i < count; i++) {
+        src[i] = dis(gen);
+    }
+
+    // Run the test
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(src.data());
+        benchmark::DoNotOptimize(dst.data());
+        memcpy_to_i32_from_float(dst.data(), src.data(), count);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetComplexityN(state.range(0));
+}
+
+BENCHMARK(BM_MemcpyToI32FromFloat)->RangeMultiplier(2)->Ranges({{10, 8<<12}});
+
+static void BM_MemcpyToFloatFromP24(benchmark::State& state) {
+    const size_t count = state.range(0);
+
+    std::vector<uint8_t> src(count * 3);
+    std::vector<float> dst(count);
+
+    // Initialize src buffer with deterministic pseudo-random values
+    std::minstd_rand gen(count);
+    std::uniform_int_distribution<> dis(0, 0xff);
+    for (size_t i = 0; i < src.size(); i++) {
+        src[i] = dis(gen);
+    }
+
+    // Run the test
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(src.data());
+        benchmark::DoNotOptimize(dst.data());
+        memcpy_to_float_from_p24(dst.data(), src.data(), count);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetComplexityN(state.range(0));
+}
+
+BENCHMARK(BM_MemcpyToFloatFromP24)->RangeMultiplier(2)->Ranges({{10, 8<<12}});
+
+static void BM_MemcpyToP24FromFloat(benchmark::State& state) {
+    const size_t count = state.range(0);
+
+    std::vector<float> src(count);
+    std::vector<uint8_t> dst(count * 3);
+
+    // Initialize src buffer with deterministic pseudo-random values
+    std::minstd_rand gen(count);
+    std::uniform_real_distribution<> dis;
+    for (size_t i = 0; i < count; i++) {
+        src[i] = dis(gen);
+    }
+
+    // Run the test
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(src.data());
+        benchmark::DoNotOptimize(dst.data());
+        memcpy_to_p24_from_float(dst.data(), src.data(), count);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetComplexityN(state.range(0));
+}
+
+BENCHMARK(BM_MemcpyToP24FromFloat)->RangeMultiplier(2)->Ranges({{10, 8<<12}});
+
+static void BM_AccumulateP24(benchmark::State& state) {
+    const size_t count = state.range(0);
+
+    std::vector<uint8_t> src(count * 3);
+    std::vector<uint8_t> dst(count * 3);
+
+    // Initialize src buffer with deterministic pseudo-random values
+    std::minstd_rand gen(count);
+    std::uniform_int_distribution<> dis(0, 0xff);
+    for (size_t i = 0; i < src.size(); i++) {
+        src[i] = dis(gen);
+    }
+
+    // Run the test
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(src.data());
+        benchmark::DoNotOptimize(dst.data());
+        accumulate_p24(dst.data(), src.data(), count);
+        benchmark::ClobberMemory();
+    }
+
+    state.SetComplexityN(state.range(0));
+}
+
+BENCHMARK(BM_AccumulateP24)->RangeMultiplier(2)->Ranges({{10, 8<<12}});
+
 BENCHMARK_MAIN();
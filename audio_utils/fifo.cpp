@@ -19,6 +19,7 @@
 
 #include <errno.h>
 #include <limits.h>
+#include <sched.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -165,8 +166,136 @@ audio_utils_fifo_provider::~audio_utils_fifo_provider()
 
 ////////////////////////////////////////////////////////////////////////////////
 
+audio_utils_fifo_reader_registry::audio_utils_fifo_reader_registry()
+{
+    for (Slot& slot : mSlots) {
+        for (std::atomic_uint_least32_t& counter : slot.mLagHistogram) {
+            counter.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+audio_utils_fifo_reader_registry::~audio_utils_fifo_reader_registry()
+{
+}
+
+uint32_t audio_utils_fifo_reader_registry::attachedReaders() const
+{
+    uint32_t count = 0;
+    for (const Slot& slot : mSlots) {
+        if (slot.mState.loadAcquire() == SLOT_ATTACHED) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+int audio_utils_fifo_reader_registry::getLagHistogram(uint32_t slot,
+        uint32_t histogram[kLagBuckets]) const
+{
+    if (slot >= kMaxReaders || mSlots[slot].mState.loadAcquire() != SLOT_ATTACHED) {
+        return -EINVAL;
+    }
+    for (uint32_t i = 0; i < kLagBuckets; ++i) {
+        histogram[i] = mSlots[slot].mLagHistogram[i].load(std::memory_order_relaxed);
+    }
+    return 0;
+}
+
+int32_t audio_utils_fifo_reader_registry::attach(uint32_t front)
+{
+    for (uint32_t i = 0; i < kMaxReaders; ++i) {
+        Slot& slot = mSlots[i];
+        uint32_t expected = SLOT_FREE;
+        if (slot.mState.compareExchange(expected, SLOT_CLAIMED)) {
+            for (std::atomic_uint_least32_t& counter : slot.mLagHistogram) {
+                counter.store(0, std::memory_order_relaxed);
+            }
+            slot.mFront.storeRelease(front);
+            // the writer only looks at the slot from now on
+            slot.mState.storeRelease(SLOT_ATTACHED);
+            return i;
+        }
+    }
+    return -ENOSPC;
+}
+
+void audio_utils_fifo_reader_registry::detach(uint32_t slot)
+        __attribute__((no_sanitize("integer")))
+{
+    mSlots[slot].mState.storeRelease(SLOT_FREE);
+    uint32_t released = mReleased.loadAcquire();
+    while (!mReleased.compareExchange(released, released + 1)) {
+    }
+}
+
+void audio_utils_fifo_reader_registry::publish(uint32_t slot, uint32_t front)
+        __attribute__((no_sanitize("integer")))
+{
+    mSlots[slot].mFront.storeRelease(front);
+    uint32_t released = mReleased.loadAcquire();
+    while (!mReleased.compareExchange(released, released + 1)) {
+    }
+}
+
+int32_t audio_utils_fifo_reader_registry::filled(const audio_utils_fifo& fifo, uint32_t rear,
+        uint32_t throttleReaders) const
+{
+    // fill levels of the readers not overrun, in decreasing order
+    uint32_t lags[kMaxReaders];
+    uint32_t count = 0;
+    for (const Slot& slot : mSlots) {
+        if (slot.mState.loadAcquire() != SLOT_ATTACHED) {
+            continue;
+        }
+        // returns -EIO if mIsShutdown
+        int32_t lag = fifo.diff(rear, slot.mFront.loadAcquire());
+        if (lag == -EIO) {
+            return lag;
+        }
+        if (lag < 0) {
+            continue;
+        }
+        uint32_t i = count++;
+        for (; i > 0 && lags[i - 1] < (uint32_t) lag; --i) {
+            lags[i] = lags[i - 1];
+        }
+        lags[i] = lag;
+    }
+    if (count == 0) {
+        return 0;
+    }
+    return lags[(throttleReaders < count ? throttleReaders : count) - 1];
+}
+
+void audio_utils_fifo_reader_registry::recordLags(const audio_utils_fifo& fifo, uint32_t rear)
+{
+    for (Slot& slot : mSlots) {
+        if (slot.mState.loadAcquire() != SLOT_ATTACHED) {
+            continue;
+        }
+        int32_t lag = fifo.diff(rear, slot.mFront.loadAcquire());
+        uint32_t bucket = kLagBuckets - 1;
+        if (lag >= 0) {
+            bucket = (uint64_t) lag * (kLagBuckets - 1) / fifo.mFrameCount;
+            if (bucket > kLagBuckets - 2) {
+                bucket = kLagBuckets - 2;
+            }
+        } else if (lag != -EOVERFLOW) {
+            continue;
+        }
+        // there is only one writer, so this needs no read-modify-write
+        std::atomic_uint_least32_t& counter = slot.mLagHistogram[bucket];
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 audio_utils_fifo_writer::audio_utils_fifo_writer(audio_utils_fifo& fifo) :
     audio_utils_fifo_provider(fifo), mLocalRear(0),
+    mDeferredRear(fifo.mWriterRear), mBatching(false),
+    mRegistry(NULL), mThrottleReaders(0),
     mArmLevel(fifo.mFrameCount), mTriggerLevel(0),
     mIsArmed(true), // because initial fill level of zero is < mArmLevel
     mEffectiveFrames(fifo.mFrameCount)
@@ -203,14 +332,18 @@ ssize_t audio_utils_fifo_writer::obtain(audio_utils_iovec iovec[2], size_t count
 {
     int err = 0;
     size_t availToWrite;
-    if (mFifo.mThrottleFront != NULL) {
+    if (mFifo.mThrottleFront != NULL || mThrottleReaders > 0) {
+        // When throttled by the registry, wait for any attached reader to release.
+        audio_utils_fifo_index& throttleIndex = mThrottleReaders > 0 ?
+                mRegistry->mReleased : *mFifo.mThrottleFront;
         int retries = kRetries;
         for (;;) {
             uint32_t front = mFifo.mThrottleFrontSync == AUDIO_UTILS_FIFO_SYNC_SINGLE_THREADED ?
-                    mFifo.mThrottleFront->loadSingleThreaded() :
-                    mFifo.mThrottleFront->loadAcquire();
+                    throttleIndex.loadSingleThreaded() : throttleIndex.loadAcquire();
             // returns -EIO if mIsShutdown
-            int32_t filled = mFifo.diff(mLocalRear, front);
+            int32_t filled = mThrottleReaders > 0 ?
+                    mRegistry->filled(mFifo, mLocalRear, mThrottleReaders) :
+                    mFifo.diff(mLocalRear, front);
             if (filled < 0) {
                 // on error, return an empty slice
                 err = filled;
@@ -224,6 +357,8 @@ ssize_t audio_utils_fifo_writer::obtain(audio_utils_iovec iovec[2], size_t count
                     (timeout->tv_sec == 0 && timeout->tv_nsec == 0)) {
                 break;
             }
+            // the readers may be waiting for frames that were released but not yet committed
+            commit();
             // TODO add comments
             // TODO abstract out switch and replace by general sync object
             //      the high level code (synchronization, sleep, futex, iovec) should be completely
@@ -250,11 +385,11 @@ ssize_t audio_utils_fifo_writer::obtain(audio_utils_iovec iovec[2], size_t count
                 if (timeout->tv_sec == LONG_MAX) {
                     timeout = NULL;
                 }
-                err = mFifo.mThrottleFront->wait(op, front, timeout);
+                err = throttleIndex.wait(op, front, timeout);
                 if (err < 0) {
                     switch (errno) {
                     case EWOULDBLOCK:
-                        // Benign race condition with partner: mFifo.mThrottleFront->mIndex
+                        // Benign race condition with partner: throttleIndex.mIndex
                         // changed value between the earlier atomic_load_explicit() and sys_futex().
                         // Try to load index again, but give up if we are unable to converge.
                         if (retries-- > 0) {
@@ -276,6 +411,10 @@ ssize_t audio_utils_fifo_writer::obtain(audio_utils_iovec iovec[2], size_t count
                 LOG_ALWAYS_FATAL("mFifo.mThrottleFrontSync=%d", mFifo.mThrottleFrontSync);
                 break;
             }
+            if (err == 0 && mThrottleReaders > 0) {
+                // woken by any attached reader, which may not be the one throttling us
+                continue;
+            }
             timeout = NULL;
         }
     } else {
@@ -323,7 +462,9 @@ void audio_utils_fifo_writer::release(size_t count)
             // returns -EIO if mIsShutdown
             int32_t filled = mFifo.diff(mLocalRear, front);
             mLocalRear = mFifo.sum(mLocalRear, count);
-            if (mFifo.mWriterRearSync == AUDIO_UTILS_FIFO_SYNC_SINGLE_THREADED) {
+            if (mBatching) {
+                mDeferredRear.set(mLocalRear);
+            } else if (mFifo.mWriterRearSync == AUDIO_UTILS_FIFO_SYNC_SINGLE_THREADED) {
                 mFifo.mWriterRear.storeSingleThreaded(mLocalRear);
             } else {
                 mFifo.mWriterRear.storeRelease(mLocalRear);
@@ -343,11 +484,15 @@ void audio_utils_fifo_writer::release(size_t count)
                         mIsArmed = true;
                     }
                     if (mIsArmed && filled + count > mTriggerLevel) {
-                        int err = mFifo.mWriterRear.wake(op, INT32_MAX /*waiters*/);
-                        // err is number of processes woken up
-                        if (err < 0) {
-                            LOG_ALWAYS_FATAL("%s: unexpected err=%d errno=%d",
-                                    __func__, err, errno);
+                        if (mBatching) {
+                            mDeferredRear.wakeDeferred(op, INT32_MAX /*waiters*/);
+                        } else {
+                            int err = mFifo.mWriterRear.wake(op, INT32_MAX /*waiters*/);
+                            // err is number of processes woken up
+                            if (err < 0) {
+                                LOG_ALWAYS_FATAL("%s: unexpected err=%d errno=%d",
+                                        __func__, err, errno);
+                            }
                         }
                         mIsArmed = false;
                     }
@@ -359,11 +504,31 @@ void audio_utils_fifo_writer::release(size_t count)
             }
         } else {
             mLocalRear = mFifo.sum(mLocalRear, count);
-            if (mFifo.mWriterRearSync == AUDIO_UTILS_FIFO_SYNC_SINGLE_THREADED) {
+            if (mBatching) {
+                mDeferredRear.set(mLocalRear);
+            } else if (mFifo.mWriterRearSync == AUDIO_UTILS_FIFO_SYNC_SINGLE_THREADED) {
                 mFifo.mWriterRear.storeSingleThreaded(mLocalRear);
             } else {
                 mFifo.mWriterRear.storeRelease(mLocalRear);
             }
+            // Broadcast readers each have their own fill level, so wake them without hysteresis.
+            if (mRegistry != NULL && (mFifo.mWriterRearSync == AUDIO_UTILS_FIFO_SYNC_PRIVATE ||
+                    mFifo.mWriterRearSync == AUDIO_UTILS_FIFO_SYNC_SHARED)) {
+                const int op = mFifo.mWriterRearSync == AUDIO_UTILS_FIFO_SYNC_PRIVATE ?
+                        FUTEX_WAKE_PRIVATE : FUTEX_WAKE;
+                if (mBatching) {
+                    mDeferredRear.wakeDeferred(op, INT32_MAX /*waiters*/);
+                } else {
+                    int err = mFifo.mWriterRear.wake(op, INT32_MAX /*waiters*/);
+                    // err is number of processes woken up
+                    if (err < 0) {
+                        LOG_ALWAYS_FATAL("%s: unexpected err=%d errno=%d", __func__, err, errno);
+                    }
+                }
+            }
+        }
+        if (mRegistry != NULL) {
+            mRegistry->recordLags(mFifo, mLocalRear);
         }
         mObtained -= count;
         mTotalReleased += count;
@@ -422,6 +587,274 @@ void audio_utils_fifo_writer::getHysteresis(uint32_t *armLevel, uint32_t *trigge
     *triggerLevel = mTriggerLevel;
 }
 
+void audio_utils_fifo_writer::setReaderRegistry(audio_utils_fifo_reader_registry *registry,
+        uint32_t throttleReaders)
+{
+    if (registry == NULL) {
+        throttleReaders = 0;
+    }
+    LOG_ALWAYS_FATAL_IF(throttleReaders > 0 && mFifo.mThrottleFront != NULL,
+            "%s: FIFO already has a throttling reader", __func__);
+    mRegistry = registry;
+    mThrottleReaders = throttleReaders;
+}
+
+void audio_utils_fifo_writer::setBatching(bool batching)
+{
+    if (!batching) {
+        commit();
+    }
+    mBatching = batching;
+}
+
+void audio_utils_fifo_writer::commit()
+{
+    // a no-op unless there was a release() in batching mode since the last commit
+    mDeferredRear.writeback();
+    mDeferredRear.wakeNowIfNeeded();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+// Number of times a multi-writer re-checks the rear index before blocking in release(),
+// while waiting for the writers that reserved before it to commit.
+static const int kCommitSpins = 64;
+
+audio_utils_fifo_multi_writer::audio_utils_fifo_multi_writer(audio_utils_fifo& fifo,
+        audio_utils_fifo_index& writerReserve) :
+    audio_utils_fifo_provider(fifo), mWriterReserve(writerReserve), mLocalRear(0)
+{
+    LOG_ALWAYS_FATAL_IF(fifo.mWriterRearSync == AUDIO_UTILS_FIFO_SYNC_SINGLE_THREADED ||
+            fifo.mThrottleFrontSync == AUDIO_UTILS_FIFO_SYNC_SINGLE_THREADED);
+}
+
+audio_utils_fifo_multi_writer::audio_utils_fifo_multi_writer(audio_utils_fifo& fifo) :
+    audio_utils_fifo_multi_writer(fifo, fifo.mSingleProcessSharedReserve)
+{
+    LOG_ALWAYS_FATAL_IF(&fifo.mWriterRear != &fifo.mSingleProcessSharedRear);
+}
+
+audio_utils_fifo_multi_writer::~audio_utils_fifo_multi_writer()
+{
+    // end any reservation, so that the other writers are not blocked
+    release(0);
+}
+
+ssize_t audio_utils_fifo_multi_writer::write(const void *buffer, size_t count,
+        const struct timespec *timeout)
+        __attribute__((no_sanitize("integer")))
+{
+    audio_utils_iovec iovec[2];
+    ssize_t availToWrite = obtain(iovec, count, timeout);
+    if (availToWrite > 0) {
+        memcpy((char *) mFifo.mBuffer + iovec[0].mOffset * mFifo.mFrameSize, buffer,
+                iovec[0].mLength * mFifo.mFrameSize);
+        if (iovec[1].mLength > 0) {
+            memcpy((char *) mFifo.mBuffer + iovec[1].mOffset * mFifo.mFrameSize,
+                    (char *) buffer + (iovec[0].mLength * mFifo.mFrameSize),
+                    iovec[1].mLength * mFifo.mFrameSize);
+        }
+        release(availToWrite);
+    }
+    return availToWrite;
+}
+
+// iovec == NULL is not part of the public API, but internally it means don't reserve
+ssize_t audio_utils_fifo_multi_writer::obtain(audio_utils_iovec iovec[2], size_t count,
+        const struct timespec *timeout)
+        __attribute__((no_sanitize("integer")))
+{
+    if (iovec != NULL && mObtained > 0) {
+        release(0);
+    }
+    // The reservations are limited by the throttling reader's front if there is one,
+    // otherwise by the rear so that the slices being written never overlap.
+    audio_utils_fifo_index& limit = mFifo.mThrottleFront != NULL ?
+            *mFifo.mThrottleFront : mFifo.mWriterRear;
+    const audio_utils_fifo_sync limitSync = mFifo.mThrottleFront != NULL ?
+            mFifo.mThrottleFrontSync : mFifo.mWriterRearSync;
+    int err = 0;
+    size_t availToWrite;
+    uint32_t reserve;
+    int retries = kRetries;
+    int overflowRetries = kRetries;
+    for (;;) {
+        // Load the limit first, so that the reserve is not older than it.
+        uint32_t front = limit.loadAcquire();
+        reserve = mWriterReserve.loadAcquire();
+        // returns -EIO if mIsShutdown
+        int32_t filled = mFifo.diff(reserve, front);
+        if (filled == -EOVERFLOW && overflowRetries-- > 0) {
+            // The limit is older than the reserve, and other writers have since reserved
+            // against a newer limit, so load both again, but give up if we are unable
+            // to converge.
+            continue;
+        }
+        if (filled < 0) {
+            // on error, return an empty slice
+            err = filled;
+            availToWrite = 0;
+            break;
+        }
+        availToWrite = mFifo.mFrameCount - (uint32_t) filled;
+        if (availToWrite > count) {
+            availToWrite = count;
+        }
+        if (availToWrite > 0) {
+            if (iovec == NULL ||
+                    mWriterReserve.compareExchange(reserve, mFifo.sum(reserve, availToWrite))) {
+                break;
+            }
+            // another writer reserved first
+            continue;
+        }
+        if (count == 0 || timeout == NULL || (timeout->tv_sec == 0 && timeout->tv_nsec == 0)) {
+            break;
+        }
+        int op = FUTEX_WAIT;
+        switch (limitSync) {
+        case AUDIO_UTILS_FIFO_SYNC_SLEEP:
+            err = audio_utils_clock_nanosleep(CLOCK_MONOTONIC, 0 /*flags*/, timeout,
+                    NULL /*remain*/);
+            if (err < 0) {
+                LOG_ALWAYS_FATAL_IF(errno != EINTR, "unexpected err=%d errno=%d", err, errno);
+                err = -errno;
+            } else {
+                err = -ETIMEDOUT;
+            }
+            break;
+        case AUDIO_UTILS_FIFO_SYNC_PRIVATE:
+            op = FUTEX_WAIT_PRIVATE;
+            FALLTHROUGH_INTENDED;
+        case AUDIO_UTILS_FIFO_SYNC_SHARED:
+            if (timeout->tv_sec == LONG_MAX) {
+                timeout = NULL;
+            }
+            err = limit.wait(op, front, timeout);
+            if (err < 0) {
+                switch (errno) {
+                case EWOULDBLOCK:
+                    // Benign race condition with partner: the limit index changed value
+                    // between the earlier load and sys_futex().
+                    // Try to load indices again, but give up if we are unable to converge.
+                    if (retries-- > 0) {
+                        // bypass the "timeout = NULL;" below
+                        continue;
+                    }
+                    FALLTHROUGH_INTENDED;
+                case EINTR:
+                case ETIMEDOUT:
+                    err = -errno;
+                    break;
+                default:
+                    LOG_ALWAYS_FATAL("unexpected err=%d errno=%d", err, errno);
+                    break;
+                }
+            }
+            break;
+        default:
+            LOG_ALWAYS_FATAL("limitSync=%d", limitSync);
+            break;
+        }
+        // one wait only, then report what is available
+        timeout = NULL;
+    }
+    uint32_t rearOffset = reserve & (mFifo.mFrameCountP2 - 1);
+    size_t part1 = mFifo.mFrameCount - rearOffset;
+    if (part1 > availToWrite) {
+        part1 = availToWrite;
+    }
+    size_t part2 = part1 > 0 ? availToWrite - part1 : 0;
+    // return slice
+    if (iovec != NULL) {
+        iovec[0].mOffset = rearOffset;
+        iovec[0].mLength = part1;
+        iovec[1].mOffset = 0;
+        iovec[1].mLength = part2;
+        mLocalRear = reserve;
+        mObtained = availToWrite;
+    }
+    return availToWrite > 0 ? availToWrite : err;
+}
+
+void audio_utils_fifo_multi_writer::release(size_t count)
+        __attribute__((no_sanitize("integer")))
+{
+    if (count > mObtained) {
+        ALOGE("%s(count=%zu) > mObtained=%u", __func__, count, mObtained);
+        mFifo.shutdown();
+        return;
+    }
+    if (mObtained == 0) {
+        return;
+    }
+    const uint32_t reservedRear = mFifo.sum(mLocalRear, mObtained);
+    uint32_t rear = mFifo.sum(mLocalRear, count);
+    if (count < mObtained) {
+        // Give back the tail, unless another writer has reserved since.
+        uint32_t expected = reservedRear;
+        if (!mWriterReserve.compareExchange(expected, rear)) {
+            // Too late, so commit the tail as silence.
+            uint32_t offset = rear & (mFifo.mFrameCountP2 - 1);
+            size_t length = mObtained - count;
+            size_t part1 = mFifo.mFrameCount - offset;
+            if (part1 > length) {
+                part1 = length;
+            }
+            memset((char *) mFifo.mBuffer + offset * mFifo.mFrameSize, 0,
+                    part1 * mFifo.mFrameSize);
+            memset(mFifo.mBuffer, 0, (length - part1) * mFifo.mFrameSize);
+            rear = reservedRear;
+        }
+    }
+    mObtained = 0;
+    if (rear == mLocalRear) {
+        return;
+    }
+
+    // Commit in reservation order: wait for the writers that reserved before us.
+    int op = mFifo.mWriterRearSync == AUDIO_UTILS_FIFO_SYNC_PRIVATE ?
+            FUTEX_WAIT_PRIVATE : FUTEX_WAIT;
+    for (int spins = 0; ; ++spins) {
+        uint32_t committed = mFifo.mWriterRear.loadAcquire();
+        if (committed == mLocalRear) {
+            break;
+        }
+        if (mFifo.mIsShutdown) {
+            return;
+        }
+        if (spins < kCommitSpins) {
+            continue;
+        }
+        if (mFifo.mWriterRearSync == AUDIO_UTILS_FIFO_SYNC_SLEEP) {
+            sched_yield();
+            continue;
+        }
+        int err = mFifo.mWriterRear.wait(op, committed, NULL /*timeout*/);
+        if (err < 0 && errno != EWOULDBLOCK && errno != EINTR) {
+            LOG_ALWAYS_FATAL("%s: unexpected err=%d errno=%d", __func__, err, errno);
+        }
+    }
+    mFifo.mWriterRear.storeRelease(rear);
+    if (mFifo.mWriterRearSync != AUDIO_UTILS_FIFO_SYNC_SLEEP) {
+        // wake the readers, and the writers waiting to commit after us
+        int err = mFifo.mWriterRear.wake(
+                mFifo.mWriterRearSync == AUDIO_UTILS_FIFO_SYNC_PRIVATE ?
+                        FUTEX_WAKE_PRIVATE : FUTEX_WAKE, INT32_MAX /*waiters*/);
+        // err is number of processes woken up
+        if (err < 0) {
+            LOG_ALWAYS_FATAL("%s: unexpected err=%d errno=%d", __func__, err, errno);
+        }
+    }
+    mTotalReleased += count;
+}
+
+ssize_t audio_utils_fifo_multi_writer::available()
+{
+    // iovec == NULL is not part of the public API, but internally it means don't reserve
+    return obtain(NULL /*iovec*/, SIZE_MAX /*count*/, NULL /*timeout*/);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 audio_utils_fifo_reader::audio_utils_fifo_reader(audio_utils_fifo& fifo, bool throttlesWriter,
@@ -437,16 +870,36 @@ audio_utils_fifo_reader::audio_utils_fifo_reader(audio_utils_fifo& fifo, bool th
     mLocalFront(throttlesWriter ? 0 : mFifo.mWriterRear.loadAcquire()),
 
     mThrottleFront(throttlesWriter ? mFifo.mThrottleFront : NULL),
+    mRegistry(NULL), mRegistrySlot(-ENOENT),
     mFlush(flush),
+    mCachedRear(mFifo.mWriterRear), mCaching(false),
     mArmLevel(-1), mTriggerLevel(mFifo.mFrameCount),
     mIsArmed(true), // because initial fill level of zero is > mArmLevel
     mTotalLost(0), mTotalFlushed(0)
 {
 }
 
+audio_utils_fifo_reader::audio_utils_fifo_reader(audio_utils_fifo& fifo,
+        audio_utils_fifo_reader_registry& registry, bool flush) :
+    audio_utils_fifo_reader(fifo, false /*throttlesWriter*/, flush)
+{
+    mRegistry = &registry;
+    mRegistrySlot = registry.attach(mLocalFront);
+}
+
 audio_utils_fifo_reader::~audio_utils_fifo_reader()
 {
     // TODO Need a way to pass throttle capability to the another reader, should one reader exit.
+    if (mRegistrySlot >= 0) {
+        mRegistry->detach(mRegistrySlot);
+        // the writer may be waiting for us
+        if (mFifo.mThrottleFrontSync == AUDIO_UTILS_FIFO_SYNC_PRIVATE ||
+                mFifo.mThrottleFrontSync == AUDIO_UTILS_FIFO_SYNC_SHARED) {
+            (void) mRegistry->mReleased.wake(
+                    mFifo.mThrottleFrontSync == AUDIO_UTILS_FIFO_SYNC_PRIVATE ?
+                            FUTEX_WAKE_PRIVATE : FUTEX_WAKE, INT32_MAX /*waiters*/);
+        }
+    }
 }
 
 ssize_t audio_utils_fifo_reader::read(void *buffer, size_t count, const struct timespec *timeout,
@@ -485,13 +938,20 @@ void audio_utils_fifo_reader::release(size_t count)
             mFifo.shutdown();
             return;
         }
-        if (mThrottleFront != NULL) {
-            uint32_t rear = mFifo.mWriterRearSync == AUDIO_UTILS_FIFO_SYNC_SINGLE_THREADED ?
+        if (mThrottleFront != NULL || mRegistrySlot >= 0) {
+            // in caching mode, the rear index from obtain() is recent enough for hysteresis
+            uint32_t rear = mCaching ? mCachedRear.get() :
+                    mFifo.mWriterRearSync == AUDIO_UTILS_FIFO_SYNC_SINGLE_THREADED ?
                     mFifo.mWriterRear.loadSingleThreaded() : mFifo.mWriterRear.loadAcquire();
             // returns -EIO if mIsShutdown
             int32_t filled = mFifo.diff(rear, mLocalFront);
             mLocalFront = mFifo.sum(mLocalFront, count);
-            if (mFifo.mThrottleFrontSync == AUDIO_UTILS_FIFO_SYNC_SINGLE_THREADED) {
+            // a broadcast reader wakes the writer through the registry
+            audio_utils_fifo_index& throttleFront = mThrottleFront != NULL ?
+                    *mThrottleFront : mRegistry->mReleased;
+            if (mThrottleFront == NULL) {
+                mRegistry->publish(mRegistrySlot, mLocalFront);
+            } else if (mFifo.mThrottleFrontSync == AUDIO_UTILS_FIFO_SYNC_SINGLE_THREADED) {
                 mThrottleFront->storeSingleThreaded(mLocalFront);
             } else {
                 mThrottleFront->storeRelease(mLocalFront);
@@ -511,9 +971,10 @@ void audio_utils_fifo_reader::release(size_t count)
                         mIsArmed = true;
                     }
                     if (mIsArmed && filled - count < mTriggerLevel) {
-                        int err = mThrottleFront->wake(op, 1 /*waiters*/);
+                        // there may be several multi-writers waiting
+                        int err = throttleFront.wake(op, INT32_MAX /*waiters*/);
                         // err is number of processes woken up
-                        if (err < 0 || err > 1) {
+                        if (err < 0) {
                             LOG_ALWAYS_FATAL("%s: unexpected err=%d errno=%d",
                                     __func__, err, errno);
                         }
@@ -542,8 +1003,17 @@ ssize_t audio_utils_fifo_reader::obtain(audio_utils_iovec iovec[2], size_t count
     int retries = kRetries;
     uint32_t rear;
     for (;;) {
-        rear = mFifo.mWriterRearSync == AUDIO_UTILS_FIFO_SYNC_SINGLE_THREADED ?
-                mFifo.mWriterRear.loadSingleThreaded() : mFifo.mWriterRear.loadAcquire();
+        if (mCaching) {
+            // reload only if the cached rear index has too few frames for the request
+            rear = mCachedRear.get();
+            int32_t cached = mFifo.diff(rear, mLocalFront);
+            if (cached >= 0 && (size_t) cached < count) {
+                rear = mCachedRear.readthrough();
+            }
+        } else {
+            rear = mFifo.mWriterRearSync == AUDIO_UTILS_FIFO_SYNC_SINGLE_THREADED ?
+                    mFifo.mWriterRear.loadSingleThreaded() : mFifo.mWriterRear.loadAcquire();
+        }
         // TODO pull out "count == 0"
         if (count == 0 || rear != mLocalFront || timeout == NULL ||
                 (timeout->tv_sec == 0 && timeout->tv_nsec == 0)) {
@@ -572,7 +1042,9 @@ ssize_t audio_utils_fifo_reader::obtain(audio_utils_iovec iovec[2], size_t count
             if (timeout->tv_sec == LONG_MAX) {
                 timeout = NULL;
             }
-            err = mFifo.mWriterRear.wait(op, rear, timeout);
+            // in caching mode this also invalidates the cache, so the next load is fresh
+            err = mCaching ? mCachedRear.wait(op, timeout) :
+                    mFifo.mWriterRear.wait(op, rear, timeout);
             if (err < 0) {
                 switch (errno) {
                 case EWOULDBLOCK:
@@ -686,3 +1158,9 @@ void audio_utils_fifo_reader::getHysteresis(int32_t *armLevel, uint32_t *trigger
     *armLevel = mArmLevel;
     *triggerLevel = mTriggerLevel;
 }
+
+void audio_utils_fifo_reader::setCaching(bool caching)
+{
+    mCachedRear.invalidate();
+    mCaching = caching;
+}
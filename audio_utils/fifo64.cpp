@@ -0,0 +1,406 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "audio_utils_fifo64"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <audio_utils/clock_nanosleep.h>
+#include <audio_utils/fifo64.h>
+#include <audio_utils/futex.h>
+#include <log/log.h>
+#include <system/audio.h> // FALLTHROUGH_INTENDED
+
+// Number of times to retry a futex wait that failed due to a benign race with the partner.
+static const int kRetries = 2;
+
+audio_utils_fifo64::audio_utils_fifo64(uint32_t frameCount, uint32_t frameSize, void *buffer,
+        audio_utils_fifo_index64& writerRear, audio_utils_fifo_index64 *throttleFront) :
+    mFrameCount(frameCount), mFrameSize(frameSize), mBuffer(buffer),
+    mWriterRear(writerRear), mWriterRearSync(AUDIO_UTILS_FIFO_SYNC_SHARED),
+    mThrottleFront(throttleFront), mThrottleFrontSync(AUDIO_UTILS_FIFO_SYNC_SHARED),
+    mIsShutdown(false)
+{
+    // maximum value of frameCount * frameSize is INT32_MAX (2^31 - 1), not 2^31, because we need to
+    // be able to distinguish successful and error return values from read and write.
+    LOG_ALWAYS_FATAL_IF(frameCount == 0 || frameSize == 0 || buffer == NULL ||
+            frameCount > ((uint32_t) INT32_MAX) / frameSize);
+}
+
+audio_utils_fifo64::audio_utils_fifo64(uint32_t frameCount, uint32_t frameSize, void *buffer,
+        bool throttlesWriter, audio_utils_fifo_sync sync) :
+    audio_utils_fifo64(frameCount, frameSize, buffer, mSingleProcessSharedRear,
+        throttlesWriter ? &mSingleProcessSharedFront : NULL)
+{
+    LOG_ALWAYS_FATAL_IF(sync == AUDIO_UTILS_FIFO_SYNC_SHARED);
+    mWriterRearSync = sync;
+    mThrottleFrontSync = sync;
+}
+
+audio_utils_fifo64::~audio_utils_fifo64()
+{
+}
+
+int32_t audio_utils_fifo64::diff(uint64_t rear, uint64_t front, uint64_t *lost, bool flush) const
+{
+    if (lost != NULL) {
+        *lost = 0;
+    }
+    if (mIsShutdown) {
+        return -EIO;
+    }
+    if (rear < front) {
+        ALOGE("%s front=%llu > rear=%llu", __func__,
+                (unsigned long long) front, (unsigned long long) rear);
+        shutdown();
+        return -EIO;
+    }
+    uint64_t diff = rear - front;
+    if (diff > mFrameCount) {
+        if (lost != NULL) {
+            *lost = diff - (flush ? 0 : mFrameCount);
+        }
+        return -EOVERFLOW;
+    }
+    return (int32_t) diff;
+}
+
+void audio_utils_fifo64::shutdown() const
+{
+    ALOGE("%s", __func__);
+    mIsShutdown = true;
+}
+
+uint64_t audio_utils_fifo64::load(const audio_utils_fifo_index64& index,
+        audio_utils_fifo_sync sync) const
+{
+    return sync == AUDIO_UTILS_FIFO_SYNC_SINGLE_THREADED ?
+            index.loadSingleThreaded() : index.loadAcquire();
+}
+
+void audio_utils_fifo64::store(audio_utils_fifo_index64& index, audio_utils_fifo_sync sync,
+        uint64_t value)
+{
+    if (sync == AUDIO_UTILS_FIFO_SYNC_SINGLE_THREADED) {
+        index.storeSingleThreaded(value);
+    } else {
+        index.storeRelease(value);
+    }
+}
+
+int audio_utils_fifo64::wait(audio_utils_fifo_index64& index, audio_utils_fifo_sync sync,
+        uint64_t expected, const struct timespec *timeout)
+{
+    int err = 0;
+    int op = FUTEX_WAIT;
+    switch (sync) {
+    case AUDIO_UTILS_FIFO_SYNC_SINGLE_THREADED:
+        err = -ENOTSUP;
+        break;
+    case AUDIO_UTILS_FIFO_SYNC_SLEEP:
+        err = audio_utils_clock_nanosleep(CLOCK_MONOTONIC, 0 /*flags*/, timeout, NULL /*remain*/);
+        if (err < 0) {
+            LOG_ALWAYS_FATAL_IF(errno != EINTR, "unexpected err=%d errno=%d", err, errno);
+            err = -errno;
+        } else {
+            err = -ETIMEDOUT;
+        }
+        break;
+    case AUDIO_UTILS_FIFO_SYNC_PRIVATE:
+        op = FUTEX_WAIT_PRIVATE;
+        FALLTHROUGH_INTENDED;
+    case AUDIO_UTILS_FIFO_SYNC_SHARED:
+        if (timeout->tv_sec == LONG_MAX) {
+            timeout = NULL;
+        }
+        err = index.wait(op, expected, timeout);
+        if (err < 0) {
+            switch (errno) {
+            case EWOULDBLOCK:
+            case EINTR:
+            case ETIMEDOUT:
+                err = -errno;
+                break;
+            default:
+                LOG_ALWAYS_FATAL("unexpected err=%d errno=%d", err, errno);
+                break;
+            }
+        }
+        break;
+    default:
+        LOG_ALWAYS_FATAL("sync=%d", sync);
+        break;
+    }
+    return err;
+}
+
+void audio_utils_fifo64::wake(audio_utils_fifo_index64& index, audio_utils_fifo_sync sync)
+{
+    if (sync == AUDIO_UTILS_FIFO_SYNC_PRIVATE || sync == AUDIO_UTILS_FIFO_SYNC_SHARED) {
+        int err = index.wake(sync == AUDIO_UTILS_FIFO_SYNC_PRIVATE ?
+                FUTEX_WAKE_PRIVATE : FUTEX_WAKE, INT32_MAX /*waiters*/);
+        // err is number of processes woken up
+        if (err < 0) {
+            LOG_ALWAYS_FATAL("%s: unexpected err=%d errno=%d", __func__, err, errno);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+audio_utils_fifo64_writer::audio_utils_fifo64_writer(audio_utils_fifo64& fifo) :
+    mFifo(fifo),
+    mLocalRear(fifo.load(fifo.mWriterRear, fifo.mWriterRearSync)),
+    mRearOffset(mLocalRear % fifo.mFrameCount),
+    mObtained(0), mTotalReleased(0)
+{
+}
+
+audio_utils_fifo64_writer::~audio_utils_fifo64_writer()
+{
+}
+
+ssize_t audio_utils_fifo64_writer::write(const void *buffer, size_t count,
+        const struct timespec *timeout)
+{
+    audio_utils_iovec iovec[2];
+    ssize_t availToWrite = obtain(iovec, count, timeout);
+    if (availToWrite > 0) {
+        memcpy((char *) mFifo.mBuffer + iovec[0].mOffset * mFifo.mFrameSize, buffer,
+                iovec[0].mLength * mFifo.mFrameSize);
+        if (iovec[1].mLength > 0) {
+            memcpy((char *) mFifo.mBuffer + iovec[1].mOffset * mFifo.mFrameSize,
+                    (char *) buffer + (iovec[0].mLength * mFifo.mFrameSize),
+                    iovec[1].mLength * mFifo.mFrameSize);
+        }
+        release(availToWrite);
+    }
+    return availToWrite;
+}
+
+// iovec == NULL is not part of the public API, but internally it means don't set mObtained
+ssize_t audio_utils_fifo64_writer::obtain(audio_utils_iovec iovec[2], size_t count,
+        const struct timespec *timeout)
+{
+    int err = 0;
+    size_t availToWrite;
+    if (mFifo.mThrottleFront != NULL) {
+        int retries = kRetries;
+        for (;;) {
+            uint64_t front = mFifo.load(*mFifo.mThrottleFront, mFifo.mThrottleFrontSync);
+            // returns -EIO if mIsShutdown
+            int32_t filled = mFifo.diff(mLocalRear, front);
+            if (filled < 0) {
+                // on error, return an empty slice
+                err = filled;
+                availToWrite = 0;
+                break;
+            }
+            availToWrite = mFifo.mFrameCount - (uint32_t) filled;
+            if (count == 0 || availToWrite > 0 || timeout == NULL ||
+                    (timeout->tv_sec == 0 && timeout->tv_nsec == 0)) {
+                break;
+            }
+            err = mFifo.wait(*mFifo.mThrottleFront, mFifo.mThrottleFrontSync, front, timeout);
+            // Benign race condition with partner: the front changed value between the load
+            // and sys_futex().  Try to load it again, but give up if we are unable to converge.
+            if (err == -EWOULDBLOCK && retries-- > 0) {
+                continue;
+            }
+            timeout = NULL;
+        }
+    } else {
+        if (mFifo.mIsShutdown) {
+            err = -EIO;
+            availToWrite = 0;
+        } else {
+            availToWrite = mFifo.mFrameCount;
+        }
+    }
+    if (availToWrite > count) {
+        availToWrite = count;
+    }
+    size_t part1 = mFifo.mFrameCount - mRearOffset;
+    if (part1 > availToWrite) {
+        part1 = availToWrite;
+    }
+    // return slice
+    if (iovec != NULL) {
+        iovec[0].mOffset = mRearOffset;
+        iovec[0].mLength = part1;
+        iovec[1].mOffset = 0;
+        iovec[1].mLength = availToWrite - part1;
+        mObtained = availToWrite;
+    }
+    return availToWrite > 0 ? availToWrite : err;
+}
+
+void audio_utils_fifo64_writer::release(size_t count)
+{
+    // no need to do an early check for mIsShutdown, because the extra code executed is harmless
+    if (count > 0) {
+        if (count > mObtained) {
+            ALOGE("%s(count=%zu) > mObtained=%u", __func__, count, mObtained);
+            mFifo.shutdown();
+            return;
+        }
+        mLocalRear += count;
+        mRearOffset += count;
+        if (mRearOffset >= mFifo.mFrameCount) {
+            mRearOffset -= mFifo.mFrameCount;
+        }
+        mFifo.store(mFifo.mWriterRear, mFifo.mWriterRearSync, mLocalRear);
+        mFifo.wake(mFifo.mWriterRear, mFifo.mWriterRearSync);
+        mObtained -= count;
+        mTotalReleased += count;
+    }
+}
+
+ssize_t audio_utils_fifo64_writer::available()
+{
+    // iovec == NULL is not part of the public API, but internally it means don't set mObtained
+    return obtain(NULL /*iovec*/, SIZE_MAX /*count*/, NULL /*timeout*/);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+audio_utils_fifo64_reader::audio_utils_fifo64_reader(audio_utils_fifo64& fifo,
+        bool throttlesWriter, bool flush) :
+    mFifo(fifo),
+    // If we throttle the writer, then start at the throttling front so that we see all data
+    // currently in the buffer.  Otherwise ignore everything currently in the buffer.
+    mLocalFront(throttlesWriter && fifo.mThrottleFront != NULL ?
+            fifo.load(*fifo.mThrottleFront, fifo.mThrottleFrontSync) :
+            fifo.load(fifo.mWriterRear, fifo.mWriterRearSync)),
+    mFrontOffset(mLocalFront % fifo.mFrameCount),
+    mThrottleFront(throttlesWriter ? fifo.mThrottleFront : NULL),
+    mFlush(flush),
+    mObtained(0), mTotalReleased(0), mTotalLost(0)
+{
+}
+
+audio_utils_fifo64_reader::~audio_utils_fifo64_reader()
+{
+}
+
+ssize_t audio_utils_fifo64_reader::read(void *buffer, size_t count,
+        const struct timespec *timeout, size_t *lost)
+{
+    audio_utils_iovec iovec[2];
+    ssize_t availToRead = obtain(iovec, count, timeout, lost);
+    if (availToRead > 0) {
+        memcpy(buffer, (char *) mFifo.mBuffer + iovec[0].mOffset * mFifo.mFrameSize,
+                iovec[0].mLength * mFifo.mFrameSize);
+        if (iovec[1].mLength > 0) {
+            memcpy((char *) buffer + (iovec[0].mLength * mFifo.mFrameSize),
+                    (char *) mFifo.mBuffer + iovec[1].mOffset * mFifo.mFrameSize,
+                    iovec[1].mLength * mFifo.mFrameSize);
+        }
+        release(availToRead);
+    }
+    return availToRead;
+}
+
+// iovec == NULL is not part of the public API, but internally it means don't set mObtained
+ssize_t audio_utils_fifo64_reader::obtain(audio_utils_iovec iovec[2], size_t count,
+        const struct timespec *timeout, size_t *lost)
+{
+    int err = 0;
+    int retries = kRetries;
+    uint64_t rear;
+    for (;;) {
+        rear = mFifo.load(mFifo.mWriterRear, mFifo.mWriterRearSync);
+        if (count == 0 || rear != mLocalFront || timeout == NULL ||
+                (timeout->tv_sec == 0 && timeout->tv_nsec == 0)) {
+            break;
+        }
+        err = mFifo.wait(mFifo.mWriterRear, mFifo.mWriterRearSync, rear, timeout);
+        // Benign race condition with partner: the rear changed value between the load
+        // and sys_futex().  Try to load it again, but give up if we are unable to converge.
+        if (err == -EWOULDBLOCK && retries-- > 0) {
+            continue;
+        }
+        timeout = NULL;
+    }
+    uint64_t ourLost;
+    // returns -EIO if mIsShutdown
+    int32_t filled = mFifo.diff(rear, mLocalFront, &ourLost, mFlush);
+    mTotalLost += ourLost;
+    mTotalReleased += ourLost;
+    if (lost != NULL) {
+        *lost = ourLost;
+    }
+    if (filled < 0) {
+        if (filled == -EOVERFLOW) {
+            // catch up with writer, but preserve the still valid frames in buffer
+            mLocalFront = rear - (mFlush ? 0 : mFifo.mFrameCount);
+            mFrontOffset = mLocalFront % mFifo.mFrameCount;
+        }
+        // on error, return an empty slice
+        err = filled;
+        filled = 0;
+    }
+    size_t availToRead = (size_t) filled;
+    if (availToRead > count) {
+        availToRead = count;
+    }
+    size_t part1 = mFifo.mFrameCount - mFrontOffset;
+    if (part1 > availToRead) {
+        part1 = availToRead;
+    }
+    // return slice
+    if (iovec != NULL) {
+        iovec[0].mOffset = mFrontOffset;
+        iovec[0].mLength = part1;
+        iovec[1].mOffset = 0;
+        iovec[1].mLength = availToRead - part1;
+        mObtained = availToRead;
+    }
+    return availToRead > 0 ? availToRead : err;
+}
+
+void audio_utils_fifo64_reader::release(size_t count)
+{
+    // no need to do an early check for mIsShutdown, because the extra code executed is harmless
+    if (count > 0) {
+        if (count > mObtained) {
+            ALOGE("%s(count=%zu) > mObtained=%u", __func__, count, mObtained);
+            mFifo.shutdown();
+            return;
+        }
+        mLocalFront += count;
+        mFrontOffset += count;
+        if (mFrontOffset >= mFifo.mFrameCount) {
+            mFrontOffset -= mFifo.mFrameCount;
+        }
+        if (mThrottleFront != NULL) {
+            mFifo.store(*mThrottleFront, mFifo.mThrottleFrontSync, mLocalFront);
+            mFifo.wake(*mThrottleFront, mFifo.mThrottleFrontSync);
+        }
+        mObtained -= count;
+        mTotalReleased += count;
+    }
+}
+
+ssize_t audio_utils_fifo64_reader::available(size_t *lost)
+{
+    // iovec == NULL is not part of the public API, but internally it means don't set mObtained
+    return obtain(NULL /*iovec*/, SIZE_MAX /*count*/, NULL /*timeout*/, lost);
+}
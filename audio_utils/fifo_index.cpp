@@ -24,13 +24,13 @@
 
 // FIXME should inline these, so that writer_T can also inline it
 
-uint32_t audio_utils_fifo_index::loadSingleThreaded()
+uint32_t audio_utils_fifo_index::loadSingleThreaded() const
 {
     // TODO Should be a read from simple non-atomic variable
     return atomic_load_explicit(&mIndex, std::memory_order_relaxed);
 }
 
-uint32_t audio_utils_fifo_index::loadAcquire()
+uint32_t audio_utils_fifo_index::loadAcquire() const
 {
     return atomic_load_explicit(&mIndex, std::memory_order_acquire);
 }
@@ -46,6 +46,15 @@ void audio_utils_fifo_index::storeRelease(uint32_t value)
     atomic_store_explicit(&mIndex, value, std::memory_order_release);
 }
 
+bool audio_utils_fifo_index::compareExchange(uint32_t& expected, uint32_t value)
+{
+    uint_least32_t expectedLeast = expected;
+    const bool stored = atomic_compare_exchange_strong_explicit(&mIndex, &expectedLeast, value,
+            std::memory_order_acq_rel, std::memory_order_acquire);
+    expected = expectedLeast;
+    return stored;
+}
+
 int audio_utils_fifo_index::wait(int op, uint32_t expected, const struct timespec *timeout)
 {
     return sys_futex(&mIndex, op, expected, timeout, NULL, 0);
@@ -58,11 +67,50 @@ int audio_utils_fifo_index::wake(int op, int waiters)
 
 // ----------------------------------------------------------------------------
 
-#if 0   // TODO not currently used, review this code later: bug 150627616
+uint64_t audio_utils_fifo_index64::loadSingleThreaded() const
+{
+    return atomic_load_explicit(&mIndex, std::memory_order_relaxed);
+}
+
+uint64_t audio_utils_fifo_index64::loadAcquire() const
+{
+    return atomic_load_explicit(&mIndex, std::memory_order_acquire);
+}
+
+void audio_utils_fifo_index64::storeSingleThreaded(uint64_t value)
+{
+    atomic_store_explicit(&mIndex, value, std::memory_order_relaxed);
+}
+
+void audio_utils_fifo_index64::storeRelease(uint64_t value)
+{
+    atomic_store_explicit(&mIndex, value, std::memory_order_release);
+}
+
+void *audio_utils_fifo_index64::futex()
+{
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return (uint32_t *) &mIndex + 1;
+#else
+    return &mIndex;
+#endif
+}
+
+int audio_utils_fifo_index64::wait(int op, uint64_t expected, const struct timespec *timeout)
+{
+    return sys_futex(futex(), op, (uint32_t) expected, timeout, NULL, 0);
+}
+
+int audio_utils_fifo_index64::wake(int op, int waiters)
+{
+    return sys_futex(futex(), op, waiters, NULL, NULL, 0);
+}
+
+// ----------------------------------------------------------------------------
 
 RefIndexDeferredStoreReleaseDeferredWake::RefIndexDeferredStoreReleaseDeferredWake(
         audio_utils_fifo_index& index)
-    : mIndex(index), mValue(0), mWriteback(false), mWaiters(0), mWakeOp(FUTEX_WAIT_PRIVATE)
+    : mIndex(index), mValue(0), mWriteback(false), mWaiters(0), mWakeOp(FUTEX_WAKE_PRIVATE)
 {
 }
 
@@ -154,13 +202,11 @@ void RefIndexCachedLoadAcquireDeferredWait::invalidate()
     mLoaded = false;
 }
 
-#if 0
 uint32_t RefIndexCachedLoadAcquireDeferredWait::readthrough()
 {
     invalidate();
     return get();
 }
-#endif
 
 int RefIndexCachedLoadAcquireDeferredWait::wait(int op, const struct timespec *timeout)
 {
@@ -171,5 +217,3 @@ int RefIndexCachedLoadAcquireDeferredWait::wait(int op, const struct timespec *t
     invalidate();
     return err;
 }
-
-#endif  // 0
@@ -200,6 +200,67 @@ size_t memcpy_by_index_array_initialization_from_channel_mask(int8_t *idxary, si
     }
 }
 
+void memcpy_by_audio_format_and_index_array(void *dst, audio_format_t dst_format,
+        uint32_t dst_channels, const void *src, audio_format_t src_format,
+        uint32_t src_channels, const int8_t *idxary, size_t count)
+{
+    const size_t dst_sample_size = audio_bytes_per_sample(dst_format);
+    const size_t src_sample_size = audio_bytes_per_sample(src_format);
+
+    if (dst_channels == 0 || count == 0) {
+        return;
+    }
+    if (src_channels == 0) {
+        // no source channel to index, memcpy_by_index_array() zero fills the frames.
+        memset(dst, 0, count * dst_channels * dst_sample_size);
+        return;
+    }
+    if (dst_channels == src_channels) {
+        uint32_t i = 0;
+        while (i < dst_channels && idxary[i] == (int8_t)i) {
+            ++i;
+        }
+        if (i == dst_channels) { // identity remap
+            memcpy_by_audio_format(dst, dst_format, src, src_format, count * dst_channels);
+            return;
+        }
+    }
+
+    // Remap in the source format if that converts fewer samples.
+    // Not for 8 bit, as unmatched channels are filled with 0 which isn't silence there.
+    const bool remap_first = dst_channels < src_channels
+            && dst_format != AUDIO_FORMAT_PCM_8_BIT && src_format != AUDIO_FORMAT_PCM_8_BIT;
+    const size_t temp_frame_size = remap_first
+            ? dst_channels * src_sample_size : src_channels * dst_sample_size;
+    const size_t dst_frame_size = dst_channels * dst_sample_size;
+    const size_t src_frame_size = src_channels * src_sample_size;
+
+    // Each block goes through temp, which is small enough to stay in cache.
+    int32_t temp[1024];
+    const size_t block_frames = sizeof(temp) / temp_frame_size;
+    assert(block_frames > 0);
+
+    // A block is read completely before it is written, so in-place works if blocks
+    // run forward when frames shrink and backward when they grow.
+    const bool backward = dst_frame_size > src_frame_size;
+    for (size_t done = 0; done < count; ) {
+        const size_t frames = count - done < block_frames ? count - done : block_frames;
+        const size_t first = backward ? count - done - frames : done;
+        const uint8_t *s = (const uint8_t *)src + first * src_frame_size;
+        uint8_t *d = (uint8_t *)dst + first * dst_frame_size;
+        if (remap_first) {
+            memcpy_by_index_array(temp, dst_channels, s, src_channels,
+                    idxary, src_sample_size, frames);
+            memcpy_by_audio_format(d, dst_format, temp, src_format, frames * dst_channels);
+        } else {
+            memcpy_by_audio_format(temp, dst_format, s, src_format, frames * src_channels);
+            memcpy_by_index_array(d, dst_channels, temp, src_channels,
+                    idxary, dst_sample_size, frames);
+        }
+        done += frames;
+    }
+}
+
 void accumulate_by_audio_format(void *dst, const void *src,
         audio_format_t format, size_t count) {
     switch (format) {
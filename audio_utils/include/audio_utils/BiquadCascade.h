@@ -0,0 +1,342 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_UTILS_BIQUAD_CASCADE_H
+#define ANDROID_AUDIO_UTILS_BIQUAD_CASCADE_H
+
+#include "BiquadFilter.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <vector>
+
+#include <assert.h>
+#include <string.h>
+
+namespace android::audio_utils {
+
+namespace details {
+
+/**
+ * Applies all sections of a cascade to each sample before the next sample,
+ * so the intermediate results stay in registers.
+ *
+ * The recursion of a single biquad is latency bound, so for few channels the sections of
+ * one sample are computed in parallel by the out-of-order core, rather than waiting for
+ * the previous sample of the same section.
+ *
+ * \param coefs  per channel and section, b0, b1, b2, -a1, -a2, indexed by
+ *               (channel * sectionCount + section) * kBiquadNumCoefs.
+ * \param delays per channel and section, s1, s2, indexed by
+ *               (channel * sectionCount + section) * 2.
+ */
+template <typename D>
+void biquad_cascade_fused(D *out, const D *in, size_t frames, size_t stride,
+        size_t channelCount, size_t sectionCount, D *delays, const D *coefs) {
+    for (size_t i = 0; i < channelCount; ++i) {
+        D *s = delays + i * sectionCount * 2;
+        const D *c = coefs + i * sectionCount * kBiquadNumCoefs;
+        const D *input = in + i;
+        D *output = out + i;
+        for (size_t j = 0; j < frames; ++j) {
+            D x = *input;
+            input += stride;
+            for (size_t k = 0; k < sectionCount; ++k) {
+                const D *ck = c + k * kBiquadNumCoefs;
+                D *sk = s + k * 2;
+                // transposed direct form II, as the BiquadFilter kernels.
+                const D y = ck[0] * x + sk[0];
+                sk[0] = ck[1] * x + ck[3] * y + sk[1];
+                sk[1] = ck[2] * x + ck[4] * y;
+                x = y;
+            }
+            *output = x;
+            output += stride;
+        }
+    }
+}
+
+} // namespace details
+
+/**
+ * BiquadCascade
+ *
+ * A multichannel cascade of Biquad filters, or second order sections (SOS),
+ * for example a parametric EQ with one section per band.
+ *
+ * \f[
+ *  H(z) = \prod_{k=0}^{N-1} \frac { b_{0,k} + b_{1,k} z^{-1} + b_{2,k} z^{-2} }
+ *                                 { 1       + a_{1,k} z^{-1} + a_{2,k} z^{-2} }
+ * \f]
+ *
+ *  Details:
+ *    1. Each section is a BiquadFilter, so each section uses the kernel specialized for its
+ *       own coefficient occupancy, and the NEON or SSE/AVX kernels when optimized.
+ *    2. The data is processed in blocks of about kBlockSamples samples, and every section is
+ *       applied to a block before the next block, so the block stays in L1 cache
+ *       between sections.  Applying N BiquadFilters one after another to a whole buffer
+ *       instead reads and writes the whole buffer N times.
+ *    3. For at most kFusedMaxChannels channels, there is too little data parallelism for
+ *       the vectorized kernels, and the recursion of each section is latency bound.
+ *       Instead all sections are applied to each sample in turn, see
+ *       details::biquad_cascade_fused(), which is 2x faster for mono in the benchmark.
+ *    4. Section 0 is applied first.
+ *    5. The coefficients are updated lock-free: setCoefficients() may be called from
+ *       one control thread concurrently with process(), and the changes take effect
+ *       at the start of the next process() after commitCoefficients().
+ *
+ * \param D type variable representing the data type, one of float or double.
+ *         The default is float.
+ * \param SAME_COEF_PER_CHANNEL bool which is true if the coefficients of each section
+ *         are shared between channels, or false if they may differ between channels.
+ *         The default is true.
+ */
+template <typename D = float, bool SAME_COEF_PER_CHANNEL = true>
+class BiquadCascade {
+public:
+    /** Number of samples in a block which is processed by all sections in turn. */
+    static constexpr size_t kBlockSamples = 1024;
+
+    /** Maximum number of channels processed with all sections fused per sample. */
+    static constexpr size_t kFusedMaxChannels = 2;
+
+    /**
+     * \param channelCount number of channels.
+     * \param sectionCount number of second order sections in the cascade.
+     * \param optimized whether to use processor optimized functions (optional, defaults true).
+     *
+     * All sections are initialized with all-zero coefficients, which output zero,
+     * so the coefficients must be set and committed before processing.
+     */
+    BiquadCascade(size_t channelCount, size_t sectionCount, bool optimized = true)
+            : mChannelCount(channelCount)
+            , mOptimized(optimized)
+            , mFused(channelCount <= kFusedMaxChannels)
+            , mPending(sectionCount, std::vector<D>(coefsPerSection())) {
+        // BiquadFilter move does not transfer the selected filter function,
+        // so construct the sections in place without reallocation.
+        mSections.reserve(sectionCount);
+        for (size_t i = 0; i < sectionCount; ++i) {
+            mSections.emplace_back(channelCount, std::array<D, kBiquadNumCoefs>{}, optimized);
+        }
+        for (auto& slot : mSlots) {
+            slot = mPending;
+        }
+        if (mFused) {
+            mFusedCoefs.resize(channelCount * sectionCount * kBiquadNumCoefs);
+            mFusedDelays.resize(channelCount * sectionCount * 2);
+        }
+    }
+
+    BiquadCascade(const BiquadCascade&) = delete;
+    BiquadCascade& operator=(const BiquadCascade&) = delete;
+
+    size_t getChannelCount() const { return mChannelCount; }
+    size_t getSectionCount() const { return mSections.size(); }
+
+    /**
+     * \brief Sets the pending coefficients of a section, for all channels.
+     *
+     * May be called concurrently with process(), but only from one thread at a time.
+     * The coefficients take effect after commitCoefficients().
+     *
+     * \param section index of the section.
+     * \param coefs the coefficients, 5 (normalized) or 6 (general), see
+     *        BiquadFilter::setCoefficients().  If SAME_COEF_PER_CHANNEL is false,
+     *        may also be 5 * channel count coefficients interleaved by channel.
+     * \return true if the section is stable, otherwise, return false.
+     */
+    template <typename T = std::array<D, kBiquadNumCoefs>>
+    bool setCoefficients(size_t section, const T& coefs) {
+        assert(section < mPending.size());
+        auto& dest = mPending[section];
+        if constexpr (SAME_COEF_PER_CHANNEL) {
+            details::setCoefficients<D, T>(
+                    dest, 0 /* offset */, 1 /* stride */, 1 /* channelCount */, coefs);
+        } else {
+            if (coefs.size() == dest.size()) {
+                std::copy(coefs.begin(), coefs.end(), dest.begin());
+            } else {
+                details::setCoefficients<D, T>(
+                        dest, 0 /* offset */, mChannelCount, mChannelCount, coefs);
+            }
+        }
+        return isPendingStable(section);
+    }
+
+    /**
+     * \brief Sets the pending coefficients of a section, for one channel.
+     *
+     * This method is only available if SAME_COEF_PER_CHANNEL is false.
+     * See setCoefficients(size_t, const T&).
+     */
+    template <typename T = std::array<D, kBiquadNumCoefs>>
+    bool setCoefficients(size_t section, const T& coefs, size_t channelIndex) {
+        static_assert(!SAME_COEF_PER_CHANNEL);
+        assert(section < mPending.size() && channelIndex < mChannelCount);
+        details::setCoefficients<D, T>(
+                mPending[section], channelIndex, mChannelCount, 1 /* channelCount */, coefs);
+        return isPendingStable(section);
+    }
+
+    /**
+     * \brief Publishes the pending coefficients of all sections to process().
+     *
+     * Lock-free and allocation-free.  Call from the same thread as setCoefficients().
+     * If there are several commits between two process(), only the last takes effect.
+     */
+    void commitCoefficients() {
+        auto& back = mSlots[mBackSlot];
+        for (size_t i = 0; i < back.size(); ++i) {
+            std::copy(mPending[i].begin(), mPending[i].end(), back[i].begin());
+        }
+        mBackSlot = mMiddleSlot.exchange(mBackSlot | kDirty, std::memory_order_acq_rel) & kIndex;
+    }
+
+    /**
+     * \brief Filters the input data, which may be the same as the output data.
+     *
+     * \param out     pointer to the output data
+     * \param in      pointer to the input data
+     * \param frames  number of audio frames to be processed
+     */
+    void process(D* out, const D* in, size_t frames) {
+        process(out, in, frames, mChannelCount);
+    }
+
+    /**
+     * \brief Filters the input data with stride
+     *
+     * \param out     pointer to the output data
+     * \param in      pointer to the input data
+     * \param frames  number of audio frames to be processed
+     * \param stride  the total number of samples associated with a frame, if not channelCount.
+     */
+    void process(D* out, const D* in, size_t frames, size_t stride) {
+        assert(stride >= mChannelCount);
+        acquireCoefficients();
+        if (mSections.empty()) {
+            if (out != in) {
+                for (size_t i = 0; i < frames; ++i) {
+                    memcpy(out + i * stride, in + i * stride, mChannelCount * sizeof(D));
+                }
+            }
+            return;
+        }
+        if (mFused) {
+            details::biquad_cascade_fused(out, in, frames, stride, mChannelCount,
+                    mSections.size(), mFusedDelays.data(), mFusedCoefs.data());
+            return;
+        }
+        const size_t blockFrames = std::max(kBlockSamples / stride, (size_t)1);
+        for (size_t offset = 0; offset < frames; offset += blockFrames) {
+            const size_t count = std::min(blockFrames, frames - offset);
+            const D* src = in + offset * stride;
+            D* dst = out + offset * stride;
+            for (auto& section : mSections) {
+                section.process(dst, src, count, stride);
+                src = dst;  // subsequent sections are in place, within L1 cache.
+            }
+        }
+    }
+
+    /**
+     * \brief Clears the delay elements of all sections.
+     */
+    void clear() {
+        for (auto& section : mSections) {
+            section.clear();
+        }
+        std::fill(mFusedDelays.begin(), mFusedDelays.end(), D(0));
+    }
+
+    /**
+     * \brief Returns a section, with the coefficients last acquired by process().
+     *
+     * For at most kFusedMaxChannels channels, the delays of the section are not used.
+     */
+    const BiquadFilter<D, SAME_COEF_PER_CHANNEL>& getSection(size_t section) const {
+        return mSections[section];
+    }
+
+private:
+    size_t coefsPerSection() const {
+        return kBiquadNumCoefs * (SAME_COEF_PER_CHANNEL ? 1 : mChannelCount);
+    }
+
+    bool isPendingStable(size_t section) const {
+        const auto& coefs = mPending[section];
+        const size_t stride = SAME_COEF_PER_CHANNEL ? 1 : mChannelCount;
+        for (size_t j = 0; j < stride; ++j) {
+            if (!details::isStable(coefs[3 * stride + j], coefs[4 * stride + j])) return false;
+        }
+        return true;
+    }
+
+    // Called by process() to take the most recently committed coefficients, if any.
+    void acquireCoefficients() {
+        if ((mMiddleSlot.load(std::memory_order_relaxed) & kDirty) == 0) return;
+        mFrontSlot = mMiddleSlot.exchange(mFrontSlot, std::memory_order_acq_rel) & kIndex;
+        const auto& front = mSlots[mFrontSlot];
+        for (size_t i = 0; i < mSections.size(); ++i) {
+            // copies into the existing coefficient vector, so there is no allocation.
+            mSections[i].setCoefficients(front[i], mOptimized);
+        }
+        if (!mFused) return;
+        const size_t sectionCount = mSections.size();
+        const size_t stride = SAME_COEF_PER_CHANNEL ? 1 : mChannelCount;
+        for (size_t ch = 0; ch < mChannelCount; ++ch) {
+            const size_t j = SAME_COEF_PER_CHANNEL ? 0 : ch;
+            for (size_t i = 0; i < sectionCount; ++i) {
+                D *c = &mFusedCoefs[(ch * sectionCount + i) * kBiquadNumCoefs];
+                c[0] = front[i][0 * stride + j];
+                c[1] = front[i][1 * stride + j];
+                c[2] = front[i][2 * stride + j];
+                c[3] = -front[i][3 * stride + j];
+                c[4] = -front[i][4 * stride + j];
+            }
+        }
+    }
+
+    const size_t mChannelCount;
+    const bool mOptimized;
+    const bool mFused;  // channel count is at most kFusedMaxChannels
+
+    // The coefficients and delays for details::biquad_cascade_fused(), if mFused.
+    std::vector<D> mFusedCoefs;
+    std::vector<D> mFusedDelays;
+
+    // The sections, accessed by process() only.
+    std::vector<BiquadFilter<D, SAME_COEF_PER_CHANNEL>> mSections;
+
+    // Coefficients being edited by setCoefficients(), one vector per section.
+    std::vector<std::vector<D>> mPending;
+
+    // Triple buffer of committed coefficients.  The control thread owns the back slot,
+    // process() owns the front slot, and they exchange their slot with the middle slot.
+    // The middle slot is marked dirty when it holds coefficients not yet seen by process().
+    static constexpr uint32_t kIndex = 3;
+    static constexpr uint32_t kDirty = 4;
+    std::array<std::vector<std::vector<D>>, 3> mSlots;
+    uint32_t mBackSlot = 0;                     // control thread
+    uint32_t mFrontSlot = 1;                    // process()
+    std::atomic<uint32_t> mMiddleSlot{2};       // shared
+};
+
+} // namespace android::audio_utils
+
+#endif  // !ANDROID_AUDIO_UTILS_BIQUAD_CASCADE_H
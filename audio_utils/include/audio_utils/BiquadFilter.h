@@ -19,6 +19,7 @@
 
 #include "intrinsic_utils.h"
 
+#include <algorithm>
 #include <array>
 #include <cmath>
 #include <functional>
@@ -31,9 +32,21 @@
 #pragma push_macro("USE_NEON")
 #undef USE_NEON
 
+// and SSE/AVX optimizations for x86 devices.
+#pragma push_macro("USE_SSE")
+#undef USE_SSE
+#pragma push_macro("USE_AVX")
+#undef USE_AVX
+
 #if defined(__ARM_NEON__) || defined(__aarch64__)
 #include <arm_neon.h>
 #define USE_NEON
+#elif defined(__SSE2__)
+#include <immintrin.h>
+#define USE_SSE
+#if defined(__AVX__)
+#define USE_AVX
+#endif
 #endif
 
 namespace android::audio_utils {
@@ -191,7 +204,30 @@ void biquad_filter_fast(D *out, const D *in, size_t frames, size_t stride,
             out, in, frames, stride, channelCount, delays, coefs, localStride);
 }
 
-#ifdef USE_NEON
+#if defined(USE_NEON) || defined(USE_SSE)
+
+// The vector types used by biquad_filter_neon() for the wide channel counts.
+// On x86 the "neon" kernels are instantiated with the equivalent SSE/AVX types.
+//
+// float_x16_t and double_x8_t are used for blocks of 16 float or 8 double channels.
+// x86 has only 16 vector registers (compared to 32 for aarch64 NEON), so we use
+// a narrower type there which is iterated over the block to avoid register spills.
+#if defined(USE_NEON)
+using float_x16_t = float32x4x4_t;
+using float_x8_t = float32x4x2_t;
+using float_x4_t = float32x4_t;
+using double_x8_t = intrinsics::internal_array_t<double, 8>;
+#elif defined(USE_AVX)
+using float_x16_t = __m256;
+using float_x8_t = __m256;
+using float_x4_t = __m128;
+using double_x8_t = __m256d;
+#else
+using float_x16_t = intrinsics::internal_array_t<__m128, 2>;
+using float_x8_t = intrinsics::internal_array_t<__m128, 2>;
+using float_x4_t = __m128;
+using double_x8_t = intrinsics::internal_array_t<__m128d, 2>;
+#endif
 
 template <size_t OCCUPANCY, bool SAME_COEF_PER_CHANNEL, typename T, typename F>
 void biquad_filter_neon_impl(F *out, const F *in, size_t frames, size_t stride,
@@ -282,7 +318,7 @@ void biquad_filter_neon(D *out, const D *in, size_t frames, size_t stride,
             default:
                 if (remaining >= 16) {
                     remaining &= ~15;
-                    biquad_filter_neon_impl<OCCUPANCY, SAME_COEF_PER_CHANNEL, float32x4x4_t>(
+                    biquad_filter_neon_impl<OCCUPANCY, SAME_COEF_PER_CHANNEL, float_x16_t>(
                             out + offset, in + offset, frames, stride, remaining,
                             delays + offset, c, localStride);
                     offset += remaining;
@@ -299,11 +335,11 @@ void biquad_filter_neon(D *out, const D *in, size_t frames, size_t stride,
             // We choose the NEON intrinsic type over internal_array for 8 to
             // check if there is any performance difference in benchmark (should be similar).
             // BIQUAD_FILTER_CASE(8, intrinsics::internal_array_t<float, 8>)
-            BIQUAD_FILTER_CASE(8, float32x4x2_t)
+            BIQUAD_FILTER_CASE(8, float_x8_t)
             BIQUAD_FILTER_CASE(7, intrinsics::internal_array_t<float, 7>)
             BIQUAD_FILTER_CASE(6, intrinsics::internal_array_t<float, 6>)
             BIQUAD_FILTER_CASE(5, intrinsics::internal_array_t<float, 5>)
-            BIQUAD_FILTER_CASE(4, float32x4_t)
+            BIQUAD_FILTER_CASE(4, float_x4_t)
             // We choose the NEON intrinsic type over internal_array for 4 to
             // check if there is any performance difference in benchmark (should be similar).
             // BIQUAD_FILTER_CASE(4, intrinsics::internal_array_t<float, 4>)
@@ -311,13 +347,12 @@ void biquad_filter_neon(D *out, const D *in, size_t frames, size_t stride,
             BIQUAD_FILTER_CASE(2, intrinsics::internal_array_t<float, 2>)
             }
         } else if constexpr (std::is_same_v<D, double>) {
-#if defined(__aarch64__)
+#if defined(__aarch64__) || defined(USE_SSE)
             switch (remaining) {
             default:
                 if (remaining >= 8) {
                     remaining &= ~7;
-                    biquad_filter_neon_impl<OCCUPANCY, SAME_COEF_PER_CHANNEL,
-                              intrinsics::internal_array_t<double, 8>>(
+                    biquad_filter_neon_impl<OCCUPANCY, SAME_COEF_PER_CHANNEL, double_x8_t>(
                             out + offset, in + offset, frames, stride, remaining,
                             delays + offset, c, localStride);
                     offset += remaining;
@@ -344,7 +379,110 @@ void biquad_filter_neon(D *out, const D *in, size_t frames, size_t stride,
     exit:;
 }
 
-#endif // USE_NEON
+#endif // USE_NEON || USE_SSE
+
+// Full Biquad with the coefficients incremented by deltas after every frame,
+// for a linear coefficient ramp.  T may be D, or a vector type as for biquad_filter_neon_impl().
+// The coefficients and deltas are not modified; the caller advances the coefficients.
+template <bool SAME_COEF_PER_CHANNEL, typename T, typename F>
+void biquad_filter_ramp_impl(F *out, const F *in, size_t frames, size_t stride,
+        size_t channelCount, F *delays, const F *coefs, const F *deltas, size_t localStride) {
+    using namespace android::audio_utils::intrinsics;
+
+    constexpr size_t elements = sizeof(T) / sizeof(F); // how many float elements in T.
+    for (size_t i = 0; i < channelCount; i += elements) {
+        // As the coefficients change over the frames, they are reloaded for every channel block.
+        T b0, b1, b2, negativeA1, negativeA2;
+        T deltaB0, deltaB1, deltaB2, negativeDeltaA1, negativeDeltaA2;
+        if constexpr (SAME_COEF_PER_CHANNEL) {
+            b0 = vdupn<T>(coefs[0]);
+            b1 = vdupn<T>(coefs[1]);
+            b2 = vdupn<T>(coefs[2]);
+            negativeA1 = vneg(vdupn<T>(coefs[3]));
+            negativeA2 = vneg(vdupn<T>(coefs[4]));
+            deltaB0 = vdupn<T>(deltas[0]);
+            deltaB1 = vdupn<T>(deltas[1]);
+            deltaB2 = vdupn<T>(deltas[2]);
+            negativeDeltaA1 = vneg(vdupn<T>(deltas[3]));
+            negativeDeltaA2 = vneg(vdupn<T>(deltas[4]));
+        } else {
+            b0 = vld1<T>(coefs);
+            b1 = vld1<T>(coefs + localStride);
+            b2 = vld1<T>(coefs + localStride * 2);
+            negativeA1 = vneg(vld1<T>(coefs + localStride * 3));
+            negativeA2 = vneg(vld1<T>(coefs + localStride * 4));
+            deltaB0 = vld1<T>(deltas);
+            deltaB1 = vld1<T>(deltas + localStride);
+            deltaB2 = vld1<T>(deltas + localStride * 2);
+            negativeDeltaA1 = vneg(vld1<T>(deltas + localStride * 3));
+            negativeDeltaA2 = vneg(vld1<T>(deltas + localStride * 4));
+            coefs += elements;
+            deltas += elements;
+        }
+        T s1 = vld1<T>(&delays[0]);
+        T s2 = vld1<T>(&delays[localStride]);
+        const F *input = &in[i];
+        F *output = &out[i];
+        for (size_t j = frames; j > 0; --j) {
+            T xn = vld1<T>(input);
+            T yn = vmla(s1, b0, xn);
+            s1 = vmla(vmla(s2, negativeA1, yn), b1, xn);
+            s2 = vmla(vmul(b2, xn), negativeA2, yn);
+
+            b0 = vadd(b0, deltaB0);
+            b1 = vadd(b1, deltaB1);
+            b2 = vadd(b2, deltaB2);
+            negativeA1 = vadd(negativeA1, negativeDeltaA1);
+            negativeA2 = vadd(negativeA2, negativeDeltaA2);
+
+            input += stride;
+            vst1(output, yn);
+            output += stride;
+        }
+        vst1(&delays[0], s1);
+        vst1(&delays[localStride], s2);
+        delays += elements;
+    }
+}
+
+// Applies biquad_filter_ramp_impl() to all channels, if optimized with the
+// vector types of biquad_filter_neon() for each block of channels.
+// The recursion is latency bound, so the wider types are faster despite register spills.
+template <bool SAME_COEF_PER_CHANNEL, typename D>
+void biquad_filter_ramp(D *out, const D *in, size_t frames, size_t stride,
+        size_t channelCount, D *delays, const D *coefs, const D *deltas, size_t localStride,
+        bool optimized) {
+    size_t offset = 0;
+    auto block = [&](auto vector, size_t count) {
+        const size_t coefOffset = SAME_COEF_PER_CHANNEL ? 0 : offset;
+        biquad_filter_ramp_impl<SAME_COEF_PER_CHANNEL, decltype(vector)>(
+                out + offset, in + offset, frames, stride, count,
+                delays + offset, coefs + coefOffset, deltas + coefOffset, localStride);
+        offset += count;
+    };
+#if defined(USE_NEON) || defined(USE_SSE)
+    if (optimized) {
+        if constexpr (std::is_same_v<D, float>) {
+            if (channelCount >= 16) block(float_x16_t{}, channelCount & ~15);
+            if (channelCount - offset >= 8) block(float_x8_t{}, 8);
+            if (channelCount - offset >= 4) block(float_x4_t{}, 4);
+            switch (channelCount - offset) {
+            case 3: block(intrinsics::internal_array_t<float, 3>{}, 3); break;
+            case 2: block(intrinsics::internal_array_t<float, 2>{}, 2); break;
+            }
+        } else if constexpr (std::is_same_v<D, double>) {
+#if defined(__aarch64__) || defined(USE_SSE)
+            if (channelCount >= 8) block(double_x8_t{}, channelCount & ~7);
+            if (channelCount - offset >= 2) block(intrinsics::internal_array_t<double, 2>{},
+                    (channelCount - offset) & ~1);
+#endif
+        }
+    }
+#else
+    (void)optimized;
+#endif
+    if (offset < channelCount) block(D{}, channelCount - offset);
+}
 
 } // namespace details
 
@@ -380,6 +518,9 @@ void biquad_filter_neon(D *out, const D *in, size_t frames, size_t stride,
  *       in negated form.  We explicitly negate before entering into the inner loop.
  *    5. The full 6 coefficient Biquad filter form with a_0 != 1 may be used for setting
  *       coefficients.  See setCoefficients() below.
+ *    6. Coefficient changes may be ramped linearly over a number of frames inside the
+ *       kernel, to avoid zipper noise from parameter automation without processing
+ *       in small blocks.  See setRampFrames() below.
  *
  * If SAME_COEFFICIENTS_PER_CHANNEL is false, then mCoefs is stored interleaved by channel.
  *
@@ -412,7 +553,9 @@ public:
             const T& coefs = {}, bool optimized = true)
             : mChannelCount(channelCount)
             , mCoefs(kBiquadNumCoefs * (SAME_COEF_PER_CHANNEL ? 1 : mChannelCount))
-            , mDelays(channelCount * kBiquadNumDelays) {
+            , mDelays(channelCount * kBiquadNumDelays)
+            , mRampCoefs(mCoefs.size())
+            , mRampDeltas(mCoefs.size()) {
         setCoefficients(coefs, optimized);
     }
 
@@ -431,6 +574,10 @@ public:
         mChannelCount = other.mChannelCount;
         mCoefs = other.mCoefs;
         mDelays = other.mDelays;
+        mRampCoefs = other.mRampCoefs;
+        mRampDeltas = other.mRampDeltas;
+        mRampFrames = other.mRampFrames;
+        mRampRemaining = other.mRampRemaining;
         return *this;
     }
 
@@ -439,6 +586,10 @@ public:
         mChannelCount = other.mChannelCount;
         mCoefs = std::move(other.mCoefs);
         mDelays = std::move(other.mDelays);
+        mRampCoefs = std::move(other.mRampCoefs);
+        mRampDeltas = std::move(other.mRampDeltas);
+        mRampFrames = other.mRampFrames;
+        mRampRemaining = other.mRampRemaining;
         return *this;
     }
 
@@ -498,9 +649,13 @@ public:
      * -->
      *
      * The internal representation is a normalized Biquad.
+     *
+     * If the ramp frames are nonzero, see setRampFrames(), the coefficients used by
+     * process() are interpolated to the new coefficients over that number of frames.
      */
     template <typename T = std::array<D, kBiquadNumCoefs>>
     bool setCoefficients(const T& coefs, bool optimized = true) {
+        saveRampStart();
         if constexpr (SAME_COEF_PER_CHANNEL) {
             details::setCoefficients<D, T>(
                     mCoefs, 0 /* offset */, 1 /* stride */, 1 /* channelCount */, coefs);
@@ -512,6 +667,7 @@ public:
                         mCoefs, 0 /* offset */, mChannelCount, mChannelCount, coefs);
             }
         }
+        startRamp();
         setOptimization(optimized);
         return isStable();
     }
@@ -529,8 +685,10 @@ public:
     bool setCoefficients(const T& coefs, size_t channelIndex, bool optimized = true) {
         static_assert(!SAME_COEF_PER_CHANNEL);
 
+        saveRampStart();
         details::setCoefficients<D, T>(
                 mCoefs, channelIndex, mChannelCount, 1 /* channelCount */, coefs);
+        startRamp();
         setOptimization(optimized);
         return isStable();
     }
@@ -540,6 +698,7 @@ public:
      *
      * If multichannel and the template variable SAME_COEF_PER_CHANNEL is true,
      * the coefficients are interleaved by channel.
+     * During a ramp, these are the coefficients at the end of the ramp.
      */
     const std::vector<D>& getCoefficients() const {
         return mCoefs;
@@ -584,10 +743,10 @@ public:
         }
 
         // Select the proper filtering function from our array.
-        (void)optimized;                // avoid unused variable warning.
+        mOptimized = optimized;
         mFunc = mFilterFast[category];  // default if we don't have processor optimization.
 
-#ifdef USE_NEON
+#if defined(USE_NEON) || defined(USE_SSE)
         /* if constexpr (std::is_same_v<D, float>) */ {
             if (optimized) {
                 mFunc = mFilterNeon[category];
@@ -617,6 +776,23 @@ public:
      */
     void process(D* out, const D *in, size_t frames, size_t stride) {
         assert(stride >= mChannelCount);
+        if (mRampRemaining > 0) {
+            const size_t rampFrames = std::min(frames, mRampRemaining);
+            details::biquad_filter_ramp<SAME_COEF_PER_CHANNEL>(out, in, rampFrames, stride,
+                    mChannelCount, mDelays.data(), mRampCoefs.data(), mRampDeltas.data(),
+                    mChannelCount, mOptimized);
+            mRampRemaining -= rampFrames;
+            if (mRampRemaining > 0) {
+                for (size_t i = 0; i < mRampCoefs.size(); ++i) {
+                    mRampCoefs[i] += D(rampFrames) * mRampDeltas[i];
+                }
+                return;
+            }
+            // The ramp is complete, continue with the function selected for mCoefs.
+            out += rampFrames * stride;
+            in += rampFrames * stride;
+            frames -= rampFrames;
+        }
         mFunc(out, in, frames, stride, mChannelCount, mDelays.data(),
                 mCoefs.data(), mChannelCount);
     }
@@ -638,6 +814,8 @@ public:
      * On NEON, the data cannot be written then read in-place without incurring
      * memory stall penalties.  A shifting NEON holding register is required to make this
      * a practical improvement.
+     *
+     * Coefficient ramps are not supported, the coefficients at the end of the ramp are used.
      */
     void process1D(D* inout, size_t frames) {
         size_t remaining = mChannelCount;
@@ -688,10 +866,40 @@ public:
     /**
      * \brief Clears the delay elements
      *
-     * This function clears the delay elements representing the filter state.
+     * This function clears the delay elements representing the filter state,
+     * and completes any coefficient ramp.
      */
     void clear() {
         std::fill(mDelays.begin(), mDelays.end(), 0.f);
+        mRampRemaining = 0;
+    }
+
+    /**
+     * \brief Sets the number of frames over which coefficient changes are ramped.
+     *
+     * If nonzero, each subsequent setCoefficients() linearly interpolates the coefficients
+     * from those in use to the new ones over rampFrames frames of process(),
+     * instead of changing them at the next frame.  A change during a ramp starts a new
+     * ramp from the interpolated coefficients.  Interpolating between two stable filters
+     * is stable, as the stable region of a1 and a2 is a triangle, which is convex.
+     *
+     * During a ramp, process() uses the full Biquad kernel with the coefficients incremented
+     * every frame, then the kernel specialized for the coefficients at the end of the ramp.
+     *
+     * \param rampFrames number of frames to ramp over, or 0 (the default) for no ramp.
+     */
+    void setRampFrames(size_t rampFrames) {
+        mRampFrames = rampFrames;
+    }
+
+    /** Returns the number of frames over which coefficient changes are ramped. */
+    size_t getRampFrames() const {
+        return mRampFrames;
+    }
+
+    /** Returns the number of frames of process() until the current ramp is complete, or 0. */
+    size_t getRampFramesRemaining() const {
+        return mRampRemaining;
     }
 
     /**
@@ -724,6 +932,22 @@ public:
     }
 
 private:
+    // Called before the coefficients change, to start a ramp from the coefficients in use.
+    void saveRampStart() {
+        if (mRampFrames > 0 && mRampRemaining == 0) {
+            std::copy(mCoefs.begin(), mCoefs.end(), mRampCoefs.begin());
+        }
+    }
+
+    // Called after the coefficients change, to compute the increments per frame of the ramp.
+    void startRamp() {
+        mRampRemaining = mRampFrames;
+        if (mRampFrames == 0) return;
+        for (size_t i = 0; i < mCoefs.size(); ++i) {
+            mRampDeltas[i] = (mCoefs[i] - mRampCoefs[i]) / D(mRampFrames);
+        }
+    }
+
     /* const */ size_t mChannelCount; // not const because we can assign to it on operator equals.
 
     /*
@@ -746,6 +970,15 @@ private:
      */
     std::vector<D> mDelays;
 
+    // The coefficient ramp, see setRampFrames().
+    // mRampCoefs are the coefficients in use, incremented by mRampDeltas every frame,
+    // which reach mCoefs after mRampRemaining frames.  Same layout as mCoefs.
+    std::vector<D> mRampCoefs;
+    std::vector<D> mRampDeltas;
+    size_t mRampFrames = 0;
+    size_t mRampRemaining = 0;
+    bool mOptimized = true;  // for the ramp kernel
+
     using filter_func = decltype(details::biquad_filter_fast<0, true, D>);
 
     /**
@@ -813,7 +1046,7 @@ private:
             details::make_functional_array<
                     FuncWrap, 1 << kBiquadNumCoefs, SAME_COEF_PER_CHANNEL>();
 
-#ifdef USE_NEON
+#if defined(USE_NEON) || defined(USE_SSE)
     // OCCUPANCY is a bitmask corresponding to the presence of nonzero Biquad coefficients
     // b0 b1 b2 a1 a2  (from lsb to msb)
 
@@ -851,16 +1084,18 @@ private:
         }
     };
 
-    // Neon optimized array of functions.
+    // Neon (or SSE/AVX on x86) optimized array of functions.
     static inline constexpr auto mFilterNeon =
             details::make_functional_array<
                     FuncWrapNeon, 1 << kBiquadNumCoefs, SAME_COEF_PER_CHANNEL>();
-#endif // USE_NEON
+#endif // USE_NEON || USE_SSE
 
 };
 
 } // namespace android::audio_utils
 
+#pragma pop_macro("USE_AVX")
+#pragma pop_macro("USE_SSE")
 #pragma pop_macro("USE_NEON")
 
 #endif  // !ANDROID_AUDIO_UTILS_BIQUAD_FILTER_H
@@ -17,18 +17,113 @@
 #pragma once
 #include "channels.h"
 #include <math.h>
+#include <memory>
+#include <utility>
 
 namespace android::audio_utils::channels {
 
 /**
- * ChannelMix
+ * IChannelMix
  *
- * Converts audio streams with different positional channel configurations.
- * Currently only downmix to stereo is supported, so there is no outputChannelMask argument.
+ * Interface of the ChannelMix and SurroundChannelMix objects, for clients that select the
+ * output channel mask at runtime.  Use create() to obtain one for a given output channel mask.
+ * Clients that know the output channel mask at compile time should use ChannelMix or
+ * SurroundChannelMix directly, which have no virtual calls.
+ */
+class IChannelMix {
+public:
+    virtual ~IChannelMix() = default;
+
+    /**
+     * Set the input channel mask.
+     *
+     * \param inputChannelMask channel position mask for input data.
+     *
+     * \return false if the channel mask is not supported.
+     */
+    virtual bool setInputChannelMask(audio_channel_mask_t inputChannelMask) = 0;
+
+    /**
+     * Returns the input channel mask.
+     */
+    virtual audio_channel_mask_t getInputChannelMask() const = 0;
+
+    /**
+     * Returns the output channel mask.
+     */
+    virtual audio_channel_mask_t getOutputChannelMask() const = 0;
+
+    /**
+     * Remixes audio data in src to dst.
+     *
+     * \param src          input audio buffer to remix
+     * \param dst          remixed audio samples in the output channel mask
+     * \param frameCount   number of frames to remix
+     * \param accumulate   is true if the remix is added to the destination or
+     *                     false if the remix replaces the destination.
+     *
+     * \return false if the channel mask set is not supported.
+     */
+    virtual bool process(
+            const float *src, float *dst, size_t frameCount, bool accumulate) const = 0;
+
+    /**
+     * Remixes audio data in src to dst after setting the input channel mask.
+     *
+     * \return false if the channel mask set is not supported.
+     */
+    virtual bool process(const float *src, float *dst, size_t frameCount, bool accumulate,
+            audio_channel_mask_t inputChannelMask) = 0;
+
+    // The maximum channels supported (bits in the channel mask).
+    static constexpr size_t MAX_INPUT_CHANNELS_SUPPORTED = FCC_26;
+
+    /**
+     * Returns true if outputChannelMask may be used as the output of an IChannelMix.
+     *
+     * Supported are stereo, and the surround masks of the horizontal plane with
+     * front left, front right, front center and LFE, plus back and/or side pairs
+     * (AUDIO_CHANNEL_OUT_5POINT1, AUDIO_CHANNEL_OUT_5POINT1_SIDE, AUDIO_CHANNEL_OUT_7POINT1).
+     */
+    static constexpr bool isOutputChannelMaskSupported(audio_channel_mask_t outputChannelMask) {
+        if (outputChannelMask == AUDIO_CHANNEL_OUT_STEREO) return true;
+        constexpr unsigned kFront = AUDIO_CHANNEL_OUT_FRONT_LEFT | AUDIO_CHANNEL_OUT_FRONT_RIGHT
+                | AUDIO_CHANNEL_OUT_FRONT_CENTER | AUDIO_CHANNEL_OUT_LOW_FREQUENCY;
+        constexpr unsigned kBack = AUDIO_CHANNEL_OUT_BACK_LEFT | AUDIO_CHANNEL_OUT_BACK_RIGHT;
+        constexpr unsigned kSide = AUDIO_CHANNEL_OUT_SIDE_LEFT | AUDIO_CHANNEL_OUT_SIDE_RIGHT;
+        const unsigned back = outputChannelMask & kBack;
+        const unsigned side = outputChannelMask & kSide;
+        return (outputChannelMask & ~(kFront | kBack | kSide)) == 0
+                && (outputChannelMask & kFront) == kFront
+                && (back == 0 || back == kBack) && (side == 0 || side == kSide)
+                && (back | side) != 0;
+    }
+
+    /**
+     * Creates a channel mix object for an output channel mask chosen at runtime.
+     *
+     * \param outputChannelMask  one of AUDIO_CHANNEL_OUT_STEREO, AUDIO_CHANNEL_OUT_5POINT1,
+     *                           AUDIO_CHANNEL_OUT_5POINT1_SIDE or AUDIO_CHANNEL_OUT_7POINT1.
+     *                           Other supported masks need a SurroundChannelMix instantiation.
+     *
+     * \return the object or nullptr if the output channel mask is not supported.
+     */
+    static std::shared_ptr<IChannelMix> create(audio_channel_mask_t outputChannelMask);
+};
+
+namespace details {
+
+/**
+ * ChannelMixBase
  *
- * TODO: In the future, consider downmix to 7.1 and 5.1 targets instead of just stereo.
+ * The implementation of ChannelMix and SurroundChannelMix.
+ * The output channel mask is a compile time parameter, so the mix matrix has exactly
+ * as many columns as there are output channels and the inner loop over them is unrolled.
+ * The matrix itself is computed once per input channel mask, when it is set.
  */
-class ChannelMix {
+template <audio_channel_mask_t OUTPUT_CHANNEL_MASK>
+class ChannelMixBase {
+    static_assert(IChannelMix::isOutputChannelMaskSupported(OUTPUT_CHANNEL_MASK));
 public:
 
     /**
@@ -39,11 +134,11 @@ public:
      *
      * \param inputChannelMask   channel position mask for input audio data.
      */
-    explicit ChannelMix(audio_channel_mask_t inputChannelMask) {
+    explicit ChannelMixBase(audio_channel_mask_t inputChannelMask) {
         setInputChannelMask(inputChannelMask);
     }
 
-    ChannelMix() = default;
+    ChannelMixBase() = default;
 
     /**
      * Set the input channel mask.
@@ -57,113 +152,19 @@ public:
             if (inputChannelMask & ~((1 << MAX_INPUT_CHANNELS_SUPPORTED) - 1)) {
                 return false;  // not channel position mask, or has unknown channels.
             }
-
-            // Compute at what index each channel is: samples will be in the following order:
-            //   FL  FR  FC    LFE   BL  BR  BC    SL  SR
-            //
-            // Prior to API 32, use of downmix resulted in channels being scaled in half amplitude.
-            // We now use a compliant downmix matrix for 5.1 with the following standards:
-            // ITU-R 775-2, ATSC A/52, ETSI TS 101 154, IEC 14496-3, which is unity gain for the
-            // front left and front right channel contribution.
-            //
-            // For 7.1 to 5.1 we set equal contributions for the side and back channels
-            // which follow Dolby downmix recommendations.
-            //
-            // We add contributions from the LFE into the L and R channels
-            // at a weight of 0.5 (rather than the power preserving 0.707)
-            // which is to ensure that headphones can still experience LFE
-            // with lesser risk of speaker overload.
-            //
-            // Note: geometrically left and right channels contribute only to the corresponding
-            // left and right outputs respectively.  Geometrically center channels contribute
-            // to both left and right outputs, so they are scaled by 0.707 to preserve power.
-            //
-            //  (transfer matrix)
-            //   FL  FR  FC    LFE  BL  BR     BC  SL    SR
-            //   1.0     0.707 0.5  0.707      0.5 0.707
-            //       1.0 0.707 0.5       0.707 0.5       0.707
-            int index = 0;
-            constexpr float COEF_25 = 0.2508909536f;
-            constexpr float COEF_35 = 0.3543928915f;
-            constexpr float COEF_36 = 0.3552343859f;
-            constexpr float COEF_61 = 0.6057043428f;
-            for (unsigned tmp = inputChannelMask; tmp != 0; ++index) {
-                const unsigned lowestBit = tmp & -(signed)tmp;
-                switch (lowestBit) {
-                    case AUDIO_CHANNEL_OUT_FRONT_LEFT:
-                    case AUDIO_CHANNEL_OUT_TOP_FRONT_LEFT:
-                    case AUDIO_CHANNEL_OUT_BOTTOM_FRONT_LEFT:
-                        mMatrix[index][0] = 1.f;
-                        mMatrix[index][1] = 0.f;
-                        break;
-                    case AUDIO_CHANNEL_OUT_SIDE_LEFT:
-                    case AUDIO_CHANNEL_OUT_BACK_LEFT:
-                    case AUDIO_CHANNEL_OUT_TOP_BACK_LEFT:
-                    case AUDIO_CHANNEL_OUT_FRONT_WIDE_LEFT: // FRONT_WIDE closer to SIDE.
-                        mMatrix[index][0] = MINUS_3_DB_IN_FLOAT;
-                        mMatrix[index][1] = 0.f;
-                        break;
-                    case AUDIO_CHANNEL_OUT_FRONT_RIGHT:
-                    case AUDIO_CHANNEL_OUT_TOP_FRONT_RIGHT:
-                    case AUDIO_CHANNEL_OUT_BOTTOM_FRONT_RIGHT:
-                        mMatrix[index][0] = 0.f;
-                        mMatrix[index][1] = 1.f;
-                        break;
-                    case AUDIO_CHANNEL_OUT_SIDE_RIGHT:
-                    case AUDIO_CHANNEL_OUT_BACK_RIGHT:
-                    case AUDIO_CHANNEL_OUT_TOP_BACK_RIGHT:
-                    case AUDIO_CHANNEL_OUT_FRONT_WIDE_RIGHT: // FRONT_WIDE closer to SIDE.
-                        mMatrix[index][0] = 0.f;
-                        mMatrix[index][1] = MINUS_3_DB_IN_FLOAT;
-                        break;
-                    case AUDIO_CHANNEL_OUT_FRONT_CENTER:
-                    case AUDIO_CHANNEL_OUT_TOP_FRONT_CENTER:
-                    case AUDIO_CHANNEL_OUT_BOTTOM_FRONT_CENTER:
-                        mMatrix[index][0] = mMatrix[index][1] = MINUS_3_DB_IN_FLOAT;
-                        break;
-                    case AUDIO_CHANNEL_OUT_TOP_SIDE_LEFT:
-                        mMatrix[index][0] = COEF_61;
-                        mMatrix[index][1] = 0.f;
-                        break;
-                    case AUDIO_CHANNEL_OUT_TOP_SIDE_RIGHT:
-                        mMatrix[index][0] = 0.f;
-                        mMatrix[index][1] = COEF_61;
-                        break;
-                    case AUDIO_CHANNEL_OUT_FRONT_LEFT_OF_CENTER:
-                        mMatrix[index][0] = COEF_61;
-                        mMatrix[index][1] = COEF_25;
-                        break;
-                    case AUDIO_CHANNEL_OUT_FRONT_RIGHT_OF_CENTER:
-                        mMatrix[index][0] = COEF_25;
-                        mMatrix[index][1] = COEF_61;
-                        break;
-                    case AUDIO_CHANNEL_OUT_TOP_CENTER:
-                        mMatrix[index][0] = mMatrix[index][1] = COEF_36;
-                        break;
-                    case AUDIO_CHANNEL_OUT_TOP_BACK_CENTER:
-                        mMatrix[index][0] = mMatrix[index][1] = COEF_35;
-                        break;
-                    case AUDIO_CHANNEL_OUT_LOW_FREQUENCY_2:
-                        mMatrix[index][0] = 0.f;
-                        mMatrix[index][1] = MINUS_3_DB_IN_FLOAT;
-                        break;
-                    case AUDIO_CHANNEL_OUT_LOW_FREQUENCY:
-                        if (inputChannelMask & AUDIO_CHANNEL_OUT_LOW_FREQUENCY_2) {
-                            mMatrix[index][0] = MINUS_3_DB_IN_FLOAT;
-                            mMatrix[index][1] = 0.f;
-                            break;
-                        }
-                        FALLTHROUGH_INTENDED;
-                    case AUDIO_CHANNEL_OUT_BACK_CENTER:
-                        mMatrix[index][0] = mMatrix[index][1] = 0.5f;
-                        break;
-                }
-                tmp ^= lowestBit;
+            // Note: mLastValidChannelIndexPlusOne is the same as mInputChannelCount for
+            // these matrices, as they have a nonzero row for every channel position.
+            mInputChannelCount = mLastValidChannelIndexPlusOne =
+                    fillMatrix(inputChannelMask, mMatrix);
+            mSparseMatrix = makeSparseMatrix(mMatrix, mInputChannelCount);
+            // The sparse kernel pays an indexed load per coefficient and does not
+            // vectorize, so it is only used if at least half of the coefficients are zero.
+            size_t nonzero = 0;
+            for (size_t j = 0; j < mOutputChannelCount; ++j) {
+                nonzero += mSparseMatrix.count[j];
             }
+            mUseSparseMatrix = nonzero * 2 <= mInputChannelCount * mOutputChannelCount;
             mInputChannelMask = inputChannelMask;
-            // Note: mLastValidChannelIndexPlusOne is the same as mInputChannelCount for
-            // this particular matrix, as it has a nonzero column for every channel position.
-            mInputChannelCount = mLastValidChannelIndexPlusOne = index;
         }
         return true;
     }
@@ -175,11 +176,18 @@ public:
         return mInputChannelMask;
     }
 
+    /**
+     * Returns the output channel mask.
+     */
+    audio_channel_mask_t getOutputChannelMask() const {
+        return OUTPUT_CHANNEL_MASK;
+    }
+
     /**
      * Downmixes audio data in src to dst.
      *
      * \param src          input audio buffer to downmix
-     * \param dst          downmixed stereo audio samples
+     * \param dst          downmixed audio samples in OUTPUT_CHANNEL_MASK
      * \param frameCount   number of frames to downmix
      * \param accumulate   is true if the downmix is added to the destination or
      *                     false if the downmix replaces the destination.
@@ -195,7 +203,7 @@ public:
      * Downmixes audio data in src to dst.
      *
      * \param src          input audio buffer to downmix
-     * \param dst          downmixed stereo audio samples
+     * \param dst          downmixed audio samples in OUTPUT_CHANNEL_MASK
      * \param frameCount   number of frames to downmix
      * \param accumulate   is true if the downmix is added to the destination or
      *                     false if the downmix replaces the destination.
@@ -209,23 +217,309 @@ public:
     }
 
     // The maximum channels supported (bits in the channel mask).
-    static constexpr size_t MAX_INPUT_CHANNELS_SUPPORTED = FCC_26;
+    static constexpr size_t MAX_INPUT_CHANNELS_SUPPORTED =
+            IChannelMix::MAX_INPUT_CHANNELS_SUPPORTED;
 
 private:
+    // Static/const parameters.
+    static inline constexpr size_t mOutputChannelCount =
+            __builtin_popcount(OUTPUT_CHANNEL_MASK);
+    static inline constexpr float MINUS_3_DB_IN_FLOAT = M_SQRT1_2; // -3dB = 0.70710678
+    static inline constexpr float LIMIT_AMPLITUDE = M_SQRT2;       // 3dB = 1.41421356
+    static inline float clamp(float value) {
+        return fmin(fmax(value, -LIMIT_AMPLITUDE), LIMIT_AMPLITUDE);
+    }
+
+    using Matrix = float[MAX_INPUT_CHANNELS_SUPPORTED][mOutputChannelCount];
+
+    /**
+     * The nonzero coefficients of a Matrix, as a list of (input index, gain)
+     * for each output channel, in increasing input index order.
+     */
+    struct SparseMatrix {
+        size_t count[mOutputChannelCount]{};
+        uint8_t index[mOutputChannelCount][MAX_INPUT_CHANNELS_SUPPORTED]{};
+        float gain[mOutputChannelCount][MAX_INPUT_CHANNELS_SUPPORTED]{};
+    };
+
     // These values are modified only when the input channel mask changes.
     // Keep alignment for matrix for more stable benchmarking.
-    // Currently only stereo output supported.
-    alignas(128) float mMatrix[MAX_INPUT_CHANNELS_SUPPORTED][FCC_2];
+    alignas(128) Matrix mMatrix;
+    SparseMatrix mSparseMatrix;
+    bool mUseSparseMatrix = false;
     audio_channel_mask_t mInputChannelMask = AUDIO_CHANNEL_NONE;
     size_t mLastValidChannelIndexPlusOne = 0;
     size_t mInputChannelCount = 0;
 
-    // Static/const parameters.
-    static inline constexpr size_t mOutputChannelCount = FCC_2;    // stereo out only
-    static inline constexpr float MINUS_3_DB_IN_FLOAT = M_SQRT1_2; // -3dB = 0.70710678
-    static inline constexpr float LIMIT_AMPLITUDE = M_SQRT2;       // 3dB = 1.41421356
-    static inline float clamp(float value) {
-        return fmin(fmax(value, -LIMIT_AMPLITUDE), LIMIT_AMPLITUDE);
+    /**
+     * Computes the downmix matrix for inputChannelMask.
+     *
+     * \return the number of input channels.
+     */
+    static constexpr size_t fillMatrix(audio_channel_mask_t inputChannelMask, Matrix& matrix) {
+        if constexpr (OUTPUT_CHANNEL_MASK == AUDIO_CHANNEL_OUT_STEREO) {
+            return fillStereoMatrix(inputChannelMask, matrix);
+        } else {
+            return fillSurroundMatrix(inputChannelMask, matrix);
+        }
+    }
+
+    /**
+     * Returns the nonzero coefficients of the first inputChannelCount rows of matrix.
+     */
+    static constexpr SparseMatrix makeSparseMatrix(
+            const Matrix& matrix, size_t inputChannelCount) {
+        SparseMatrix sparse{};
+        for (size_t j = 0; j < mOutputChannelCount; ++j) {
+            for (size_t i = 0; i < inputChannelCount; ++i) {
+                if (matrix[i][j] != 0.f) {
+                    sparse.index[j][sparse.count[j]] = i;
+                    sparse.gain[j][sparse.count[j]] = matrix[i][j];
+                    ++sparse.count[j];
+                }
+            }
+        }
+        return sparse;
+    }
+
+    /**
+     * Computes the stereo downmix matrix for inputChannelMask.
+     */
+    static constexpr size_t fillStereoMatrix(
+            audio_channel_mask_t inputChannelMask, Matrix& matrix) {
+        // Compute at what index each channel is: samples will be in the following order:
+        //   FL  FR  FC    LFE   BL  BR  BC    SL  SR
+        //
+        // Prior to API 32, use of downmix resulted in channels being scaled in half amplitude.
+        // We now use a compliant downmix matrix for 5.1 with the following standards:
+        // ITU-R 775-2, ATSC A/52, ETSI TS 101 154, IEC 14496-3, which is unity gain for the
+        // front left and front right channel contribution.
+        //
+        // For 7.1 to 5.1 we set equal contributions for the side and back channels
+        // which follow Dolby downmix recommendations.
+        //
+        // We add contributions from the LFE into the L and R channels
+        // at a weight of 0.5 (rather than the power preserving 0.707)
+        // which is to ensure that headphones can still experience LFE
+        // with lesser risk of speaker overload.
+        //
+        // Note: geometrically left and right channels contribute only to the corresponding
+        // left and right outputs respectively.  Geometrically center channels contribute
+        // to both left and right outputs, so they are scaled by 0.707 to preserve power.
+        //
+        //  (transfer matrix)
+        //   FL  FR  FC    LFE  BL  BR     BC  SL    SR
+        //   1.0     0.707 0.5  0.707      0.5 0.707
+        //       1.0 0.707 0.5       0.707 0.5       0.707
+        int index = 0;
+        constexpr float COEF_25 = 0.2508909536f;
+        constexpr float COEF_35 = 0.3543928915f;
+        constexpr float COEF_36 = 0.3552343859f;
+        constexpr float COEF_61 = 0.6057043428f;
+        for (unsigned tmp = inputChannelMask; tmp != 0; ++index) {
+            const unsigned lowestBit = tmp & -(signed)tmp;
+            switch (lowestBit) {
+                case AUDIO_CHANNEL_OUT_FRONT_LEFT:
+                case AUDIO_CHANNEL_OUT_TOP_FRONT_LEFT:
+                case AUDIO_CHANNEL_OUT_BOTTOM_FRONT_LEFT:
+                    matrix[index][0] = 1.f;
+                    matrix[index][1] = 0.f;
+                    break;
+                case AUDIO_CHANNEL_OUT_SIDE_LEFT:
+                case AUDIO_CHANNEL_OUT_BACK_LEFT:
+                case AUDIO_CHANNEL_OUT_TOP_BACK_LEFT:
+                case AUDIO_CHANNEL_OUT_FRONT_WIDE_LEFT: // FRONT_WIDE closer to SIDE.
+                    matrix[index][0] = MINUS_3_DB_IN_FLOAT;
+                    matrix[index][1] = 0.f;
+                    break;
+                case AUDIO_CHANNEL_OUT_FRONT_RIGHT:
+                case AUDIO_CHANNEL_OUT_TOP_FRONT_RIGHT:
+                case AUDIO_CHANNEL_OUT_BOTTOM_FRONT_RIGHT:
+                    matrix[index][0] = 0.f;
+                    matrix[index][1] = 1.f;
+                    break;
+                case AUDIO_CHANNEL_OUT_SIDE_RIGHT:
+                case AUDIO_CHANNEL_OUT_BACK_RIGHT:
+                case AUDIO_CHANNEL_OUT_TOP_BACK_RIGHT:
+                case AUDIO_CHANNEL_OUT_FRONT_WIDE_RIGHT: // FRONT_WIDE closer to SIDE.
+                    matrix[index][0] = 0.f;
+                    matrix[index][1] = MINUS_3_DB_IN_FLOAT;
+                    break;
+                case AUDIO_CHANNEL_OUT_FRONT_CENTER:
+                case AUDIO_CHANNEL_OUT_TOP_FRONT_CENTER:
+                case AUDIO_CHANNEL_OUT_BOTTOM_FRONT_CENTER:
+                    matrix[index][0] = matrix[index][1] = MINUS_3_DB_IN_FLOAT;
+                    break;
+                case AUDIO_CHANNEL_OUT_TOP_SIDE_LEFT:
+                    matrix[index][0] = COEF_61;
+                    matrix[index][1] = 0.f;
+                    break;
+                case AUDIO_CHANNEL_OUT_TOP_SIDE_RIGHT:
+                    matrix[index][0] = 0.f;
+                    matrix[index][1] = COEF_61;
+                    break;
+                case AUDIO_CHANNEL_OUT_FRONT_LEFT_OF_CENTER:
+                    matrix[index][0] = COEF_61;
+                    matrix[index][1] = COEF_25;
+                    break;
+                case AUDIO_CHANNEL_OUT_FRONT_RIGHT_OF_CENTER:
+                    matrix[index][0] = COEF_25;
+                    matrix[index][1] = COEF_61;
+                    break;
+                case AUDIO_CHANNEL_OUT_TOP_CENTER:
+                    matrix[index][0] = matrix[index][1] = COEF_36;
+                    break;
+                case AUDIO_CHANNEL_OUT_TOP_BACK_CENTER:
+                    matrix[index][0] = matrix[index][1] = COEF_35;
+                    break;
+                case AUDIO_CHANNEL_OUT_LOW_FREQUENCY_2:
+                    matrix[index][0] = 0.f;
+                    matrix[index][1] = MINUS_3_DB_IN_FLOAT;
+                    break;
+                case AUDIO_CHANNEL_OUT_LOW_FREQUENCY:
+                    if (inputChannelMask & AUDIO_CHANNEL_OUT_LOW_FREQUENCY_2) {
+                        matrix[index][0] = MINUS_3_DB_IN_FLOAT;
+                        matrix[index][1] = 0.f;
+                        break;
+                    }
+                    FALLTHROUGH_INTENDED;
+                case AUDIO_CHANNEL_OUT_BACK_CENTER:
+                    matrix[index][0] = matrix[index][1] = 0.5f;
+                    break;
+            }
+            tmp ^= lowestBit;
+        }
+        return index;
+    }
+
+    /**
+     * Computes the downmix matrix from inputChannelMask to a surround OUTPUT_CHANNEL_MASK.
+     *
+     * A channel position present in the output is copied at unity gain.
+     * Otherwise, for the horizontal plane:
+     *   side and back channels replace each other, at unity gain if only one of the pairs
+     *       is in the input, or else both at -3dB into the same output pair to keep the power,
+     *   the back center is split over the back (or side) pair at -3dB,
+     *   the front left and right of center are split at -3dB over front center and
+     *       the front left or right,
+     *   the front wide are split at -3dB over the front and side (or back) channel,
+     *   two LFE are summed into the LFE at -3dB each.
+     * The top and bottom channels are folded at -3dB into the channels of the horizontal
+     * plane below or above them; the top center is split over the four corners.
+     */
+    static constexpr size_t fillSurroundMatrix(
+            audio_channel_mask_t inputChannelMask, Matrix& matrix) {
+        // Output channel index of a channel position in OUTPUT_CHANNEL_MASK.
+        constexpr auto out = [](unsigned channel) {
+            return __builtin_popcount(OUTPUT_CHANNEL_MASK & (channel - 1));
+        };
+        constexpr bool HAS_BACK = (OUTPUT_CHANNEL_MASK & AUDIO_CHANNEL_OUT_BACK_LEFT) != 0;
+        constexpr bool HAS_SIDE = (OUTPUT_CHANNEL_MASK & AUDIO_CHANNEL_OUT_SIDE_LEFT) != 0;
+        constexpr int FL = out(AUDIO_CHANNEL_OUT_FRONT_LEFT);
+        constexpr int FR = out(AUDIO_CHANNEL_OUT_FRONT_RIGHT);
+        constexpr int FC = out(AUDIO_CHANNEL_OUT_FRONT_CENTER);
+        constexpr int LFE = out(AUDIO_CHANNEL_OUT_LOW_FREQUENCY);
+        // Surround pairs, the back ones preferring the back channels if present,
+        // the side ones preferring the side channels if present.
+        constexpr int BL = out(HAS_BACK
+                ? AUDIO_CHANNEL_OUT_BACK_LEFT : AUDIO_CHANNEL_OUT_SIDE_LEFT);
+        constexpr int BR = out(HAS_BACK
+                ? AUDIO_CHANNEL_OUT_BACK_RIGHT : AUDIO_CHANNEL_OUT_SIDE_RIGHT);
+        constexpr int SL = out(HAS_SIDE
+                ? AUDIO_CHANNEL_OUT_SIDE_LEFT : AUDIO_CHANNEL_OUT_BACK_LEFT);
+        constexpr int SR = out(HAS_SIDE
+                ? AUDIO_CHANNEL_OUT_SIDE_RIGHT : AUDIO_CHANNEL_OUT_BACK_RIGHT);
+        constexpr float COEF_35 = 0.3535533906f; // -9dB, top center to each of four corners.
+        constexpr unsigned kBack = AUDIO_CHANNEL_OUT_BACK_LEFT | AUDIO_CHANNEL_OUT_BACK_RIGHT;
+        constexpr unsigned kSide = AUDIO_CHANNEL_OUT_SIDE_LEFT | AUDIO_CHANNEL_OUT_SIDE_RIGHT;
+        // Side and back channels summed into the same output channel, as for 7.1 to 5.1.
+        const bool foldSurround = !(HAS_BACK && HAS_SIDE)
+                && (inputChannelMask & kBack) != 0 && (inputChannelMask & kSide) != 0;
+        const float surroundGain = foldSurround ? MINUS_3_DB_IN_FLOAT : 1.f;
+
+        int index = 0;
+        for (unsigned tmp = inputChannelMask; tmp != 0; ++index) {
+            const unsigned lowestBit = tmp & -(signed)tmp;
+            float *row = matrix[index];
+            for (size_t j = 0; j < mOutputChannelCount; ++j) {
+                row[j] = 0.f;
+            }
+            if ((lowestBit & OUTPUT_CHANNEL_MASK & ~(kBack | kSide)) != 0
+                    && !(lowestBit == AUDIO_CHANNEL_OUT_LOW_FREQUENCY
+                            && (inputChannelMask & AUDIO_CHANNEL_OUT_LOW_FREQUENCY_2))) {
+                row[out(lowestBit)] = 1.f;
+                tmp ^= lowestBit;
+                continue;
+            }
+            switch (lowestBit) {
+                case AUDIO_CHANNEL_OUT_BACK_LEFT:
+                    row[BL] = surroundGain;
+                    break;
+                case AUDIO_CHANNEL_OUT_BACK_RIGHT:
+                    row[BR] = surroundGain;
+                    break;
+                case AUDIO_CHANNEL_OUT_SIDE_LEFT:
+                    row[SL] = surroundGain;
+                    break;
+                case AUDIO_CHANNEL_OUT_SIDE_RIGHT:
+                    row[SR] = surroundGain;
+                    break;
+                case AUDIO_CHANNEL_OUT_BACK_CENTER:
+                    row[BL] = row[BR] = MINUS_3_DB_IN_FLOAT;
+                    break;
+                case AUDIO_CHANNEL_OUT_FRONT_LEFT_OF_CENTER:
+                    row[FL] = row[FC] = MINUS_3_DB_IN_FLOAT;
+                    break;
+                case AUDIO_CHANNEL_OUT_FRONT_RIGHT_OF_CENTER:
+                    row[FR] = row[FC] = MINUS_3_DB_IN_FLOAT;
+                    break;
+                case AUDIO_CHANNEL_OUT_FRONT_WIDE_LEFT:
+                    row[FL] = row[SL] = MINUS_3_DB_IN_FLOAT;
+                    break;
+                case AUDIO_CHANNEL_OUT_FRONT_WIDE_RIGHT:
+                    row[FR] = row[SR] = MINUS_3_DB_IN_FLOAT;
+                    break;
+                case AUDIO_CHANNEL_OUT_LOW_FREQUENCY:   // with LOW_FREQUENCY_2.
+                    row[LFE] = MINUS_3_DB_IN_FLOAT;
+                    break;
+                case AUDIO_CHANNEL_OUT_LOW_FREQUENCY_2:
+                    row[LFE] = (inputChannelMask & AUDIO_CHANNEL_OUT_LOW_FREQUENCY)
+                            ? MINUS_3_DB_IN_FLOAT : 1.f;
+                    break;
+                case AUDIO_CHANNEL_OUT_TOP_FRONT_LEFT:
+                case AUDIO_CHANNEL_OUT_BOTTOM_FRONT_LEFT:
+                    row[FL] = MINUS_3_DB_IN_FLOAT;
+                    break;
+                case AUDIO_CHANNEL_OUT_TOP_FRONT_RIGHT:
+                case AUDIO_CHANNEL_OUT_BOTTOM_FRONT_RIGHT:
+                    row[FR] = MINUS_3_DB_IN_FLOAT;
+                    break;
+                case AUDIO_CHANNEL_OUT_TOP_FRONT_CENTER:
+                case AUDIO_CHANNEL_OUT_BOTTOM_FRONT_CENTER:
+                    row[FC] = MINUS_3_DB_IN_FLOAT;
+                    break;
+                case AUDIO_CHANNEL_OUT_TOP_SIDE_LEFT:
+                    row[SL] = MINUS_3_DB_IN_FLOAT;
+                    break;
+                case AUDIO_CHANNEL_OUT_TOP_SIDE_RIGHT:
+                    row[SR] = MINUS_3_DB_IN_FLOAT;
+                    break;
+                case AUDIO_CHANNEL_OUT_TOP_BACK_LEFT:
+                    row[BL] = MINUS_3_DB_IN_FLOAT;
+                    break;
+                case AUDIO_CHANNEL_OUT_TOP_BACK_RIGHT:
+                    row[BR] = MINUS_3_DB_IN_FLOAT;
+                    break;
+                case AUDIO_CHANNEL_OUT_TOP_BACK_CENTER:
+                    row[BL] = row[BR] = 0.5f;
+                    break;
+                case AUDIO_CHANNEL_OUT_TOP_CENTER:
+                    row[FL] = row[FR] = row[SL] = row[SR] = COEF_35;
+                    break;
+            }
+            tmp ^= lowestBit;
+        }
+        return index;
     }
 
     /**
@@ -235,7 +529,7 @@ private:
      *               false if the downmix replaces the destination.
      *
      * \param src          multichannel audio buffer to downmix
-     * \param dst          downmixed stereo audio samples
+     * \param dst          downmixed audio samples in OUTPUT_CHANNEL_MASK
      * \param frameCount   number of multichannel frames to downmix
      *
      * \return false if the CHANNEL_COUNT is not supported.
@@ -244,49 +538,80 @@ private:
     bool processSwitch(const float *src, float *dst, size_t frameCount) const {
         constexpr bool ANDROID_SPECIFIC = true;  // change for testing.
         if constexpr (ANDROID_SPECIFIC) {
+            if constexpr (OUTPUT_CHANNEL_MASK == AUDIO_CHANNEL_OUT_STEREO) {
+                switch (mInputChannelMask) {
+                case AUDIO_CHANNEL_OUT_QUAD_BACK:
+                case AUDIO_CHANNEL_OUT_QUAD_SIDE:
+                    return specificProcess<4 /* CHANNEL_COUNT */, ACCUMULATE>(
+                            src, dst, frameCount);
+                case AUDIO_CHANNEL_OUT_5POINT1_BACK:
+                case AUDIO_CHANNEL_OUT_5POINT1_SIDE:
+                    return specificProcess<6 /* CHANNEL_COUNT */, ACCUMULATE>(
+                            src, dst, frameCount);
+                case AUDIO_CHANNEL_OUT_7POINT1:
+                    return specificProcess<8 /* CHANNEL_COUNT */, ACCUMULATE>(
+                            src, dst, frameCount);
+                default:
+                    break; // handled below.
+                }
+            }
             switch (mInputChannelMask) {
-            case AUDIO_CHANNEL_OUT_QUAD_BACK:
-            case AUDIO_CHANNEL_OUT_QUAD_SIDE:
-                return specificProcess<4 /* CHANNEL_COUNT */, ACCUMULATE>(src, dst, frameCount);
             case AUDIO_CHANNEL_OUT_5POINT1_BACK:
+                return sparseProcess<AUDIO_CHANNEL_OUT_5POINT1_BACK, ACCUMULATE>(
+                        src, dst, frameCount);
             case AUDIO_CHANNEL_OUT_5POINT1_SIDE:
-                return specificProcess<6 /* CHANNEL_COUNT */, ACCUMULATE>(src, dst, frameCount);
+                return sparseProcess<AUDIO_CHANNEL_OUT_5POINT1_SIDE, ACCUMULATE>(
+                        src, dst, frameCount);
             case AUDIO_CHANNEL_OUT_7POINT1:
-                return specificProcess<8 /* CHANNEL_COUNT */, ACCUMULATE>(src, dst, frameCount);
+                return sparseProcess<AUDIO_CHANNEL_OUT_7POINT1, ACCUMULATE>(
+                        src, dst, frameCount);
+            case AUDIO_CHANNEL_OUT_7POINT1POINT4:
+                return sparseProcess<AUDIO_CHANNEL_OUT_7POINT1POINT4, ACCUMULATE>(
+                        src, dst, frameCount);
+            case AUDIO_CHANNEL_OUT_9POINT1POINT6:
+                return sparseProcess<AUDIO_CHANNEL_OUT_9POINT1POINT6, ACCUMULATE>(
+                        src, dst, frameCount);
             default:
                 break; // handled below.
             }
         }
-        return matrixProcess(src, dst, frameCount, ACCUMULATE);
+        return mUseSparseMatrix ? sparseMatrixProcess<ACCUMULATE>(src, dst, frameCount)
+                : matrixProcess<ACCUMULATE>(src, dst, frameCount);
     }
 
     /**
      * Converts a source audio stream to destination audio stream with a matrix
      * channel conversion.
      *
+     * The output channel count is a compile time constant, so the loops over the
+     * output channels are unrolled and the accumulators stay in registers.
+     *
+     * ACCUMULATE is true if the downmix is added to the destination or
+     *               false if the downmix replaces the destination.
+     *
      * \param src          multichannel audio buffer to downmix
-     * \param dst          downmixed stereo audio samples
+     * \param dst          downmixed audio samples in OUTPUT_CHANNEL_MASK
      * \param frameCount   number of multichannel frames to downmix
-     * \param accumulate   is true if the downmix is added to the destination or
-     *                     false if the downmix replaces the destination.
      *
      * \return false if the CHANNEL_COUNT is not supported.
      */
-    bool matrixProcess(const float *src, float *dst, size_t frameCount, bool accumulate) const {
+    template <bool ACCUMULATE>
+    bool matrixProcess(const float *src, float *dst, size_t frameCount) const {
         // matrix multiply
         if (mInputChannelMask == AUDIO_CHANNEL_NONE) return false;
         while (frameCount) {
-            float ch[2]{}; // left, right
+            float ch[mOutputChannelCount]{};
             for (size_t i = 0; i < mLastValidChannelIndexPlusOne; ++i) {
-                ch[0] += mMatrix[i][0] * src[i];
-                ch[1] += mMatrix[i][1] * src[i];
+                for (size_t j = 0; j < mOutputChannelCount; ++j) {
+                    ch[j] += mMatrix[i][j] * src[i];
+                }
             }
-            if (accumulate) {
-                ch[0] += dst[0];
-                ch[1] += dst[1];
+            for (size_t j = 0; j < mOutputChannelCount; ++j) {
+                if constexpr (ACCUMULATE) {
+                    ch[j] += dst[j];
+                }
+                dst[j] = clamp(ch[j]);
             }
-            dst[0] = clamp(ch[0]);
-            dst[1] = clamp(ch[1]);
             src += mInputChannelCount;
             dst += mOutputChannelCount;
             --frameCount;
@@ -294,6 +619,104 @@ private:
         return true;
     }
 
+    /**
+     * Converts a source audio stream to destination audio stream with the
+     * nonzero coefficients of the matrix only.
+     *
+     * Most coefficients are zero, for example a left channel does not contribute to the
+     * right outputs, so this does far fewer multiply-adds than matrixProcess() for
+     * many input channels.  The sums are done in the same order, so the results are the same.
+     *
+     * ACCUMULATE is true if the downmix is added to the destination or
+     *               false if the downmix replaces the destination.
+     *
+     * \param src          multichannel audio buffer to downmix
+     * \param dst          downmixed audio samples in OUTPUT_CHANNEL_MASK
+     * \param frameCount   number of multichannel frames to downmix
+     *
+     * \return false if the CHANNEL_COUNT is not supported.
+     */
+    template <bool ACCUMULATE>
+    bool sparseMatrixProcess(const float *src, float *dst, size_t frameCount) const {
+        if (mInputChannelMask == AUDIO_CHANNEL_NONE) return false;
+        while (frameCount) {
+            for (size_t j = 0; j < mOutputChannelCount; ++j) {
+                float ch = 0.f;
+                for (size_t k = 0; k < mSparseMatrix.count[j]; ++k) {
+                    ch += mSparseMatrix.gain[j][k] * src[mSparseMatrix.index[j][k]];
+                }
+                if constexpr (ACCUMULATE) {
+                    ch += dst[j];
+                }
+                dst[j] = clamp(ch);
+            }
+            src += mInputChannelCount;
+            dst += mOutputChannelCount;
+            --frameCount;
+        }
+        return true;
+    }
+
+    /**
+     * The nonzero coefficients of the matrix for INPUT_CHANNEL_MASK, computed at compile time.
+     */
+    template <audio_channel_mask_t INPUT_CHANNEL_MASK>
+    static constexpr SparseMatrix makeSparseMatrix() {
+        Matrix matrix{};
+        const size_t inputChannelCount = fillMatrix(INPUT_CHANNEL_MASK, matrix);
+        return makeSparseMatrix(matrix, inputChannelCount);
+    }
+
+    template <audio_channel_mask_t INPUT_CHANNEL_MASK>
+    static constexpr SparseMatrix kSparseMatrix = makeSparseMatrix<INPUT_CHANNEL_MASK>();
+
+    // Returns output channel J of a frame, as the sum of the nonzero terms K.
+    template <audio_channel_mask_t INPUT_CHANNEL_MASK, size_t J, size_t... K>
+    static float sparseDot([[maybe_unused]] const float *src, std::index_sequence<K...>) {
+        constexpr const SparseMatrix& sparse = kSparseMatrix<INPUT_CHANNEL_MASK>;
+        return (0.f + ... + (sparse.gain[J][K] * src[sparse.index[J][K]]));
+    }
+
+    template <audio_channel_mask_t INPUT_CHANNEL_MASK, bool ACCUMULATE, size_t... J>
+    static void sparseFrame(const float *src, float *dst, std::index_sequence<J...>) {
+        constexpr const SparseMatrix& sparse = kSparseMatrix<INPUT_CHANNEL_MASK>;
+        if constexpr (ACCUMULATE) {
+            ((dst[J] = clamp(sparseDot<INPUT_CHANNEL_MASK, J>(
+                    src, std::make_index_sequence<sparse.count[J]>()) + dst[J])), ...);
+        } else {
+            ((dst[J] = clamp(sparseDot<INPUT_CHANNEL_MASK, J>(
+                    src, std::make_index_sequence<sparse.count[J]>()))), ...);
+        }
+    }
+
+    /**
+     * Downmixes a multichannel signal of a specified channel mask with the matrix
+     * computed at compile time, so only the multiply-adds of the nonzero coefficients
+     * remain, fully unrolled with constant coefficients.
+     *
+     * INPUT_CHANNEL_MASK is the channel mask of the src input.
+     * ACCUMULATE is true if the downmix is added to the destination or
+     *               false if the downmix replaces the destination.
+     *
+     * \param src          multichannel audio buffer to downmix
+     * \param dst          downmixed audio samples in OUTPUT_CHANNEL_MASK
+     * \param frameCount   number of multichannel frames to downmix
+     *
+     * \return true.
+     */
+    template <audio_channel_mask_t INPUT_CHANNEL_MASK, bool ACCUMULATE>
+    static bool sparseProcess(const float *src, float *dst, size_t frameCount) {
+        constexpr size_t CHANNEL_COUNT = __builtin_popcount(INPUT_CHANNEL_MASK);
+        while (frameCount > 0) {
+            sparseFrame<INPUT_CHANNEL_MASK, ACCUMULATE>(
+                    src, dst, std::make_index_sequence<mOutputChannelCount>());
+            src += CHANNEL_COUNT;
+            dst += mOutputChannelCount;
+            --frameCount;
+        }
+        return true;
+    }
+
     /**
      * Downmixes to stereo a multichannel signal of specified number of channels
      *
@@ -364,4 +787,82 @@ private:
     }
 };
 
+/**
+ * The IChannelMix returned by IChannelMix::create(), which forwards to a ChannelMix
+ * or a SurroundChannelMix.
+ */
+template <typename ChannelMixType>
+class ChannelMixAdapter : public IChannelMix {
+public:
+    bool setInputChannelMask(audio_channel_mask_t inputChannelMask) override {
+        return mChannelMix.setInputChannelMask(inputChannelMask);
+    }
+
+    audio_channel_mask_t getInputChannelMask() const override {
+        return mChannelMix.getInputChannelMask();
+    }
+
+    audio_channel_mask_t getOutputChannelMask() const override {
+        return mChannelMix.getOutputChannelMask();
+    }
+
+    bool process(const float *src, float *dst, size_t frameCount, bool accumulate) const override {
+        return mChannelMix.process(src, dst, frameCount, accumulate);
+    }
+
+    bool process(const float *src, float *dst, size_t frameCount, bool accumulate,
+            audio_channel_mask_t inputChannelMask) override {
+        return mChannelMix.process(src, dst, frameCount, accumulate, inputChannelMask);
+    }
+
+private:
+    ChannelMixType mChannelMix;
+};
+
+} // namespace details
+
+/**
+ * ChannelMix
+ *
+ * Converts audio streams with different positional channel configurations to stereo.
+ * For 5.1 and 7.1 outputs, use SurroundChannelMix.
+ */
+class ChannelMix : public details::ChannelMixBase<AUDIO_CHANNEL_OUT_STEREO> {
+public:
+    using ChannelMixBase::ChannelMixBase;
+};
+
+/**
+ * SurroundChannelMix
+ *
+ * Converts audio streams with different positional channel configurations to the
+ * surround OUTPUT_CHANNEL_MASK, for example AUDIO_CHANNEL_OUT_5POINT1 or
+ * AUDIO_CHANNEL_OUT_7POINT1.  Each input channel is routed to the same position if
+ * present, otherwise to the nearest output channels of the horizontal plane.
+ */
+template <audio_channel_mask_t OUTPUT_CHANNEL_MASK>
+class SurroundChannelMix : public details::ChannelMixBase<OUTPUT_CHANNEL_MASK> {
+    static_assert(OUTPUT_CHANNEL_MASK != AUDIO_CHANNEL_OUT_STEREO, "use ChannelMix for stereo");
+public:
+    using details::ChannelMixBase<OUTPUT_CHANNEL_MASK>::ChannelMixBase;
+};
+
+inline std::shared_ptr<IChannelMix> IChannelMix::create(audio_channel_mask_t outputChannelMask) {
+    switch (outputChannelMask) {
+    case AUDIO_CHANNEL_OUT_STEREO:
+        return std::make_shared<details::ChannelMixAdapter<ChannelMix>>();
+    case AUDIO_CHANNEL_OUT_5POINT1:
+        return std::make_shared<details::ChannelMixAdapter<
+                SurroundChannelMix<AUDIO_CHANNEL_OUT_5POINT1>>>();
+    case AUDIO_CHANNEL_OUT_5POINT1_SIDE:
+        return std::make_shared<details::ChannelMixAdapter<
+                SurroundChannelMix<AUDIO_CHANNEL_OUT_5POINT1_SIDE>>>();
+    case AUDIO_CHANNEL_OUT_7POINT1:
+        return std::make_shared<details::ChannelMixAdapter<
+                SurroundChannelMix<AUDIO_CHANNEL_OUT_7POINT1>>>();
+    default:
+        return nullptr;
+    }
+}
+
 } // android::audio_utils::channels
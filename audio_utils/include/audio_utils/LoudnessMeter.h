@@ -0,0 +1,248 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_LOUDNESS_METER_H
+#define ANDROID_AUDIO_LOUDNESS_METER_H
+
+#include <sys/cdefs.h>
+#include <system/audio.h>
+
+#ifdef __cplusplus
+
+#include <array>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <audio_utils/BiquadCascade.h>
+
+namespace android {
+
+/**
+ * LoudnessMeter measures the loudness of audio data as it is played,
+ * following ITU-R BS.1770-4 and EBU R128.
+ *
+ * The audio data is K-weighted by a two section BiquadCascade, and the weighted energy
+ * of the channels is summed over 100 ms steps.  From the steps are computed:
+ *
+ *   1. The momentary loudness, over the last 400 ms.
+ *   2. The short-term loudness, over the last 3 s.
+ *   3. The integrated loudness since creation or reset(), over the 400 ms gating blocks
+ *      (overlapping by 75%) with the absolute gate of -70 LUFS and the relative gate
+ *      of -10 LU.  The gating blocks are kept in a histogram of kHistogramBins
+ *      bins of 0.1 LU, so the cost per step and the memory are constant
+ *      however long the measurement.  The energy in each bin is summed exactly,
+ *      and the blocks in the bin of the relative gate are gated by the mean of the bin.
+ *   4. The maximum true peak since creation or reset(), by oversampling the audio data
+ *      to at least 192 kHz with a windowed sinc polyphase filter.
+ *
+ * The channel weights are from the channel mask: 0 for the LFE channels, 1.41 for the
+ * surround channels (side, or back if there are no side channels), and 1 otherwise.
+ *
+ * process() and reset() are real-time safe: they do not allocate, lock or block,
+ * and must be called from one thread at a time.
+ * The loudness getters may be called from any thread, and return the values
+ * of the last complete 100 ms step.
+ */
+class LoudnessMeter {
+public:
+    /** Loudness in LUFS of a gating block below which it is ignored by the integrated loudness. */
+    static constexpr float kAbsoluteGateLufs = -70.f;
+
+    /** Loudness in LU relative to the ungated loudness, below which a block is ignored. */
+    static constexpr float kRelativeGateLu = -10.f;
+
+    /** Number of histogram bins of the gating blocks from kAbsoluteGateLufs, of 0.1 LU each. */
+    static constexpr size_t kHistogramBins = 900;
+
+    /** Number of frames converted and filtered at once within process(). */
+    static constexpr size_t kBlockFrames = 256;
+
+    /**
+     * \brief Creates a LoudnessMeter object.
+     *
+     * \param sampleRate        sample rate of the audio data.
+     * \param channelMask       output channel mask of the audio data, positional or index.
+     * \param format            format of the audio data. It must be allowed by
+     *                          audio_utils_is_compute_power_format_supported().
+     */
+    LoudnessMeter(uint32_t sampleRate, audio_channel_mask_t channelMask, audio_format_t format);
+
+    /**
+     * \brief Adds new audio data to the meter.
+     *
+     * \param buffer            pointer to the audio data buffer.
+     * \param frames            buffer size in audio frames.
+     */
+    void process(const void *buffer, size_t frames);
+
+    /**
+     * \brief Restarts the measurement, as if newly created.
+     */
+    void reset();
+
+    /** Returns the momentary loudness in LUFS, which is -infinity for silence. */
+    float getMomentaryLoudness() const {
+        return mMomentaryLoudness.load(std::memory_order_relaxed);
+    }
+
+    /** Returns the short-term loudness in LUFS, which is -infinity for silence. */
+    float getShortTermLoudness() const {
+        return mShortTermLoudness.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Returns the integrated loudness in LUFS, which is -infinity if no gating block
+     * is above the absolute gate.
+     */
+    float getIntegratedLoudness() const {
+        return mIntegratedLoudness.load(std::memory_order_relaxed);
+    }
+
+    /** Returns the maximum true peak in dBTP, which is -infinity for silence. */
+    float getTruePeak() const {
+        return mTruePeak.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * \brief Returns a string with the current loudness values.
+     *
+     * \param prefix            the prefix to use for the line.
+     */
+    std::string toString(const char *prefix = "") const;
+
+    /** Returns the oversampling factor used for the true peak. */
+    size_t getTruePeakOversampling() const { return mOversampling; }
+
+private:
+    // Taps of the true peak filter per oversampled phase.
+    static constexpr size_t kTruePeakTaps = 12;
+    // Number of 100 ms steps in the momentary and short-term windows.
+    static constexpr size_t kMomentarySteps = 4;
+    static constexpr size_t kShortTermSteps = 30;
+
+    // Processes a block of at most kBlockFrames float frames in mBuffer.
+    void processBlock(size_t frames);
+    // Completes a 100 ms step, and updates the loudness values.
+    void completeStep();
+
+    const uint32_t mChannelCount;       // audio data channel count
+    const audio_format_t mFormat;       // audio data format
+    const size_t mStepFrames;           // frames in a 100 ms step
+    const size_t mOversampling;         // true peak oversampling factor
+
+    std::vector<float> mWeights;        // per channel weight
+    std::vector<float> mBuffer;         // kBlockFrames of float audio data
+    audio_utils::BiquadCascade<float> mFilter; // K-weighting filter
+
+    // The true peak filter, phase major, and the per channel input history,
+    // which is duplicated so that the last kTruePeakTaps samples are contiguous.
+    std::vector<float> mTruePeakCoefs;
+    std::vector<float> mTruePeakHistory;
+    size_t mTruePeakIndex = 0;
+    float mPeak = 0.f;                  // max absolute oversampled amplitude
+
+    double mStepEnergy = 0.;            // weighted energy of the current step
+    size_t mStepFramesDone = 0;         // frames in the current step
+    std::array<double, kShortTermSteps> mSteps{};  // mean square of the last steps, a ring
+    size_t mStepCount = 0;              // number of complete steps
+
+    // The gating blocks above the absolute gate: the count and the sum of the mean squares,
+    // in total and per histogram bin.
+    uint64_t mGatedCount = 0;
+    double mGatedEnergy = 0.;
+    std::array<uint32_t, kHistogramBins> mHistogramCounts{};
+    std::array<double, kHistogramBins> mHistogramEnergies{};
+
+    std::atomic<float> mMomentaryLoudness;
+    std::atomic<float> mShortTermLoudness;
+    std::atomic<float> mIntegratedLoudness;
+    std::atomic<float> mTruePeak;
+};
+
+} // namespace android
+
+#endif // __cplusplus
+
+/** \cond */
+__BEGIN_DECLS
+/** \endcond */
+
+// C API (see C++ api above for details)
+
+typedef struct loudness_meter_t loudness_meter_t;
+
+/**
+ * \brief Creates a loudness meter object.
+ *
+ * \param sample_rate       sample rate of the audio data.
+ * \param channel_mask      output channel mask of the audio data.
+ * \param format            format of the audio data. It must be allowed by
+ *                          audio_utils_is_compute_power_format_supported().
+ *
+ * \return loudness meter object or NULL on failure.
+ */
+loudness_meter_t *loudness_meter_create(uint32_t sample_rate,
+        audio_channel_mask_t channel_mask, audio_format_t format);
+
+/**
+ * \brief Adds new audio data to the loudness meter.
+ *
+ * \param loudness_meter    object returned by create, if NULL nothing happens.
+ * \param buffer            pointer to the audio data buffer.
+ * \param frames            buffer size in audio frames.
+ */
+void loudness_meter_process(loudness_meter_t *loudness_meter, const void *buffer, size_t frames);
+
+/**
+ * \brief Restarts the measurement.
+ *
+ * \param loudness_meter    object returned by create, if NULL nothing happens.
+ */
+void loudness_meter_reset(loudness_meter_t *loudness_meter);
+
+/**
+ * \brief Returns the momentary loudness in LUFS, or NAN if loudness_meter is NULL.
+ */
+float loudness_meter_get_momentary(const loudness_meter_t *loudness_meter);
+
+/**
+ * \brief Returns the short-term loudness in LUFS, or NAN if loudness_meter is NULL.
+ */
+float loudness_meter_get_short_term(const loudness_meter_t *loudness_meter);
+
+/**
+ * \brief Returns the integrated loudness in LUFS, or NAN if loudness_meter is NULL.
+ */
+float loudness_meter_get_integrated(const loudness_meter_t *loudness_meter);
+
+/**
+ * \brief Returns the maximum true peak in dBTP, or NAN if loudness_meter is NULL.
+ */
+float loudness_meter_get_true_peak(const loudness_meter_t *loudness_meter);
+
+/**
+ * \brief Destroys the loudness meter object.
+ *
+ * \param loudness_meter    object returned by create, if NULL nothing happens.
+ */
+void loudness_meter_destroy(loudness_meter_t *loudness_meter);
+
+/** \cond */
+__END_DECLS
+/** \endcond */
+
+#endif // !ANDROID_AUDIO_LOUDNESS_METER_H
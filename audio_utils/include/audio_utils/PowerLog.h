@@ -19,6 +19,8 @@
 
 #ifdef __cplusplus
 
+#include <atomic>
+#include <memory>
 #include <mutex>
 #include <vector>
 #include <system/audio.h>
@@ -37,6 +39,10 @@ namespace android {
  * summed together for energy purposes.
  *
  * The public methods are internally protected by a mutex to be thread-safe.
+ *
+ * Alternatively in lock-free mode, log() never blocks and the dump methods take
+ * a snapshot of the log without blocking log(), so a dump cannot delay a real-time
+ * audio thread.  In lock-free mode log() must be called by only one thread at a time.
  */
 class PowerLog {
 public:
@@ -50,12 +56,15 @@ public:
      *                          else the constructor will abort.
      * \param entries           total number of energy entries "bins" to use.
      * \param framesPerEntry    total number of audio frames used in each entry.
+     * \param lockFree          true for lock-free mode, where log() is wait-free
+     *                          for a single writer thread.
      */
     PowerLog(uint32_t sampleRate,
             uint32_t channelCount,
             audio_format_t format,
             size_t entries,
-            size_t framesPerEntry);
+            size_t framesPerEntry,
+            bool lockFree = false);
 
     /**
      * \brief Adds new audio data to the power log.
@@ -93,17 +102,36 @@ public:
             bool logPlot = true) const;
 
 private:
-    mutable std::mutex mLock;     // monitor mutex
+    // An entry of the log, written by log() while a dump may be reading it.
+    struct Entry {
+        std::atomic<int64_t> mTime{0};    // real time ns
+        std::atomic<float> mEnergy{0.f};
+    };
+
+    // Appends an entry, overwriting the oldest.
+    void writeEntry(int64_t timeNs, float energy);
+
+    // Copies the entries to a vector of size mEntryCount, and sets idx to the next usable
+    // index.  The entries overwritten by log() during the copy are set to zero.
+    void readEntries(std::vector<std::pair<int64_t, float>>& entries, size_t& idx) const;
+
+    mutable std::mutex mLock;     // monitor mutex, unused in lock-free mode
+    const bool mLockFree;         // whether in lock-free mode
     int64_t mCurrentTime;         // time of first frame in buffer
     float mCurrentEnergy;         // local energy accumulation
     size_t mCurrentFrames;        // number of frames in the energy
-    size_t mIdx;                  // next usable index in mEntries
     size_t mConsecutiveZeroes;    // current run of consecutive zero entries
     const uint32_t mSampleRate;   // audio data sample rate
     const uint32_t mChannelCount; // audio data channel count
     const audio_format_t mFormat; // audio data format
     const size_t mFramesPerEntry; // number of audio frames per entry
-    std::vector<std::pair<int64_t /* real time ns */, float /* energy */>> mEntries;
+    const size_t mEntryCount;     // number of entries in mEntries
+    const std::unique_ptr<Entry[]> mEntries;
+
+    // The entries are a seqlock: writeEntry() increments mBeginCount before writing
+    // the entry at index mEndCount % mEntryCount, and increments mEndCount after.
+    std::atomic<uint64_t> mBeginCount{0};
+    std::atomic<uint64_t> mEndCount{0};
 };
 
 } // namespace android
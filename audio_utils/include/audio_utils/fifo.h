@@ -37,7 +37,8 @@ enum audio_utils_fifo_sync {
 };
 
 /**
- * Base class for single-writer, single-reader or multi-reader, optionally blocking FIFO.
+ * Base class for single-writer or multi-writer, single-reader or multi-reader,
+ * optionally blocking FIFO.
  * The base class manipulates frame indices only, and has no knowledge of frame sizes or the buffer.
  * At most one reader, called the "throttling reader", can block the writer.
  * The "fill level", or unread frame count, is defined with respect to the throttling reader.
@@ -144,7 +145,10 @@ class audio_utils_fifo : public audio_utils_fifo_base {
 
     friend class audio_utils_fifo_reader;
     friend class audio_utils_fifo_writer;
+    friend class audio_utils_fifo_multi_writer;
+    friend class audio_utils_fifo_reader_registry;
     template <typename T> friend class audio_utils_fifo_writer_T;
+    template <typename T> friend class audio_utils_fifo_reader_T;
 
 public:
 
@@ -162,6 +166,9 @@ public:
      *  \param writerRear  Writer's rear index.  Passed by reference because it must be non-NULL.
      *  \param throttleFront Pointer to the front index of at most one reader that throttles the
      *                       writer, or NULL for no throttling.
+     *
+     * To avoid false sharing between the writer and the reader, place the indices on separate
+     * cache lines, for example by using audio_utils_fifo_indices.
      */
     audio_utils_fifo(uint32_t frameCount, uint32_t frameSize, void *buffer,
             audio_utils_fifo_index& writerRear, audio_utils_fifo_index *throttleFront = NULL);
@@ -213,6 +220,9 @@ private:
 
     // only used for single-process constructor when throttlesWriter == true
     audio_utils_fifo_index      mSingleProcessSharedFront;
+
+    // only used for single-process constructor with audio_utils_fifo_multi_writer
+    audio_utils_fifo_index      mSingleProcessSharedReserve;
 };
 
 /**
@@ -334,7 +344,10 @@ protected:
     /** Number of frames obtained at most recent obtain(), less total number of frames released. */
     uint32_t    mObtained;
 
-    /** Number of times to retry a futex wait that fails with EWOULDBLOCK. */
+    /**
+     * Number of times to retry a futex wait that fails with EWOULDBLOCK,
+     * or a multi-writer reservation that raced with a newer limit index.
+     */
     static const int kRetries = 2;
 
     /**
@@ -346,6 +359,89 @@ protected:
 
 ////////////////////////////////////////////////////////////////////////////////
 
+/**
+ * Registry of broadcast readers, which lets the writer see the front index of every attached
+ * reader without a lock.  The writer uses it to record a histogram of each reader's lag,
+ * and optionally to block rather than overrun the slowest readers; see
+ * audio_utils_fifo_writer::setReaderRegistry().
+ * Readers attach and detach at any time by constructing and destroying an
+ * audio_utils_fifo_reader with the registry.
+ *
+ * The registry contains only indices and counters, so it may be placed in shared memory next
+ * to the FIFO indices, and constructed there once before use.
+ */
+class audio_utils_fifo_reader_registry {
+
+    friend class audio_utils_fifo_reader;
+    friend class audio_utils_fifo_writer;
+
+public:
+    /** Maximum number of attached readers. */
+    static constexpr uint32_t kMaxReaders = 8;
+
+    /**
+     * Number of lag histogram buckets.  Bucket i < kLagBuckets - 1 counts the writes after which
+     * the reader's lag was within [i, i + 1) eighths of the FIFO capacity,
+     * and the last bucket counts the writes after which the reader had been overrun.
+     */
+    static constexpr uint32_t kLagBuckets = 9;
+
+    audio_utils_fifo_reader_registry();
+    ~audio_utils_fifo_reader_registry();
+
+    /**
+     * Return the number of readers currently attached.
+     * There's an inherent race condition: the value may soon be obsolete.
+     */
+    uint32_t attachedReaders() const;
+
+    /**
+     * Get the lag histogram of an attached reader, as recorded by the writer since the reader
+     * attached.  The counters are 32-bit and wrap.
+     *
+     * \param slot      Registry slot of the reader, see audio_utils_fifo_reader::registrySlot().
+     * \param histogram Set to the kLagBuckets counters of the reader.
+     *
+     * \return 0 on success.
+     * \retval -EINVAL  \p slot is out of range or has no reader attached.
+     */
+    int getLagHistogram(uint32_t slot, uint32_t histogram[kLagBuckets]) const;
+
+private:
+    // Returns the index of a free slot after publishing the reader's front, or -ENOSPC.
+    int32_t attach(uint32_t front);
+    void detach(uint32_t slot);
+    // Publishes the front of the reader attached at slot, and signals the writer.
+    void publish(uint32_t slot, uint32_t front);
+
+    // Returns the fill level with respect to the throttleReaders-th slowest reader which
+    // has not been overrun, 0 if there is none, or a negative errno.
+    int32_t filled(const audio_utils_fifo& fifo, uint32_t rear, uint32_t throttleReaders) const;
+    // Called by the writer after each write.
+    void recordLags(const audio_utils_fifo& fifo, uint32_t rear);
+
+    enum : uint32_t {
+        SLOT_FREE,
+        SLOT_CLAIMED,   // being attached, mFront and mLagHistogram are not valid yet
+        SLOT_ATTACHED,
+    };
+
+    struct Slot {
+        audio_utils_fifo_index      mState;     // SLOT_*
+        audio_utils_fifo_index      mFront;     // reader's front, valid when SLOT_ATTACHED
+        // Written by the writer only, read by anyone.
+        std::atomic_uint_least32_t  mLagHistogram[kLagBuckets];
+    };
+
+    Slot mSlots[kMaxReaders];
+
+    // Incremented by every release of an attached reader, and by detach.
+    // The writer waits on this when it is throttled by the registry.
+    audio_utils_fifo_index mReleased;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
 /**
  * Used to write to a FIFO.  There should be exactly one writer per FIFO.
  * The writer is multi-thread safe with respect to reader(s),
@@ -446,10 +542,57 @@ public:
      */
     void getHysteresis(uint32_t *armLevel, uint32_t *triggerLevel) const;
 
+    /**
+     * Set the registry of broadcast readers.  After each non-empty write() or release(),
+     * the writer records the lag of every attached reader in the registry.
+     * The writer can also be throttled by the attached readers: when \p throttleReaders > 0,
+     * the \p throttleReaders-th slowest reader throttles the writer, or the fastest reader
+     * if fewer are attached.  So 1 means the slowest reader throttles the writer,
+     * and 2 means the slowest reader may be overrun but not the second slowest.
+     * Readers already overrun are ignored until they re-synchronize.
+     * A blocked writer is woken by every attached reader's release, and waits again with the
+     * same timeout if there is still no room, so the timeout bounds each wait rather than the
+     * total.
+     *
+     * \param registry        Registry of broadcast readers, or NULL for none.
+     * \param throttleReaders Rank of the slowest attached reader that throttles the writer,
+     *                        0 for no throttling by the registry.  Throttling by the registry
+     *                        requires a FIFO with no throttling reader.
+     */
+    void setReaderRegistry(audio_utils_fifo_reader_registry *registry,
+            uint32_t throttleReaders = 0);
+
+    /**
+     * Enable or disable batching mode, which is disabled initially.
+     * In batching mode, a non-empty write() or release() updates the rear index only locally,
+     * and any wake of the readers is deferred; the frames become visible to the readers at the
+     * next commit().  So several small releases cost a single store-release and at most one
+     * futex wake.  A blocking write() or obtain() commits before it waits for room.
+     * Disabling batching mode commits any frames released since the last commit().
+     *
+     * \param batching Whether to enable batching mode.
+     */
+    void setBatching(bool batching);
+
+    /**
+     * Make the frames released since the last commit visible to the readers,
+     * and wake the readers if any of those releases would have done so.
+     * Has no effect if there is nothing to commit, or batching mode is disabled.
+     * Frames released but not yet committed are also committed by the destructor.
+     */
+    void commit();
+
 private:
     // Accessed by writer only using ordinary operations
     uint32_t    mLocalRear; // frame index of next frame slot available to write, or write index
 
+    // Used only in batching mode, to defer the store-release of mLocalRear and the wake.
+    RefIndexDeferredStoreReleaseDeferredWake mDeferredRear;
+    bool        mBatching;          // whether in batching mode
+
+    audio_utils_fifo_reader_registry *mRegistry;    // registry of broadcast readers, or NULL
+    uint32_t    mThrottleReaders;   // number of attached readers not to overrun, or 0
+
     // TODO make a separate class and associate with the synchronization object
     uint32_t    mArmLevel;          // arm if filled < arm level before release()
     uint32_t    mTriggerLevel;      // trigger if armed and filled > trigger level after release()
@@ -460,6 +603,80 @@ private:
 
 ////////////////////////////////////////////////////////////////////////////////
 
+/**
+ * Used to write to a FIFO from several threads or processes concurrently, without a lock.
+ * There may be any number of multi-writers per FIFO, each used by one thread at a time,
+ * but they may not be combined with an ordinary writer.
+ *
+ * Frames are written with a reserve/commit protocol on two indices:
+ * obtain() reserves a slice by a compare-and-swap on a shared reserve index,
+ * and release() commits it by storing the writer's rear index with memory order 'release'.
+ * Commits are made in the order of the reservations, so a writer may wait in release()
+ * for the writers which reserved before it to commit.  Readers only see the rear index,
+ * and are unchanged.  Blocking and timeouts are as for audio_utils_fifo_writer,
+ * and every non-empty release() wakes the readers.  Hysteresis and resize() are not supported.
+ *
+ * A writer that is never scheduled between obtain() and release() blocks the other writers
+ * from committing, so keep that section short and non-blocking.
+ */
+class audio_utils_fifo_multi_writer : public audio_utils_fifo_provider {
+
+public:
+    /**
+     * Multi-process constructor.
+     *
+     * \param fifo          Associated FIFO.  Passed by reference because it must be non-NULL.
+     *                      The FIFO sync must be AUDIO_UTILS_FIFO_SYNC_SLEEP, PRIVATE or SHARED.
+     * \param writerReserve Reserve index shared by all the multi-writers of the FIFO,
+     *                      typically placed in shared memory next to the writer's rear index,
+     *                      with the same initial value.
+     */
+    audio_utils_fifo_multi_writer(audio_utils_fifo& fifo, audio_utils_fifo_index& writerReserve);
+
+    /**
+     * Single-process constructor, using a reserve index owned by the FIFO.
+     * The FIFO must have been constructed by the single-process constructor.
+     *
+     * \param fifo Associated FIFO.  Passed by reference because it must be non-NULL.
+     */
+    explicit audio_utils_fifo_multi_writer(audio_utils_fifo& fifo);
+
+    virtual ~audio_utils_fifo_multi_writer();
+
+    /**
+     * Write to FIFO, as audio_utils_fifo_writer::write().
+     * The frames are written contiguously with respect to the other writers.
+     */
+    ssize_t write(const void *buffer, size_t count, const struct timespec *timeout = NULL);
+
+    // Implement audio_utils_fifo_provider
+
+    /**
+     * Reserve a slice of at most \p count frames, as audio_utils_fifo_provider::obtain().
+     * A reservation that was not released is first released with a count of zero.
+     */
+    virtual ssize_t obtain(audio_utils_iovec iovec[2], size_t count = SIZE_MAX,
+            const struct timespec *timeout = NULL);
+
+    /**
+     * Commit the first \p count frames of the most recently obtained slice.
+     * Unlike the ordinary writer, this ends the reservation:
+     * the remaining frames are given back if no other writer reserved frames since,
+     * otherwise they are committed as silence (zero bytes).
+     *
+     * \param count Number of frames to commit, <= the frame count of the slice.
+     */
+    virtual void release(size_t count);
+
+    virtual ssize_t available();
+
+private:
+    audio_utils_fifo_index& mWriterReserve; // shared reserve index, ahead of or equal to rear
+    uint32_t    mLocalRear;     // frame index of the first reserved frame, valid if mObtained > 0
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
 /**
  * Used to read from a FIFO.  There can be one or more readers per FIFO,
  * and at most one of those readers can throttle the writer.
@@ -485,6 +702,20 @@ public:
      */
     explicit audio_utils_fifo_reader(audio_utils_fifo& fifo, bool throttlesWriter = true,
                                      bool flush = false);
+
+    /**
+     * Broadcast reader constructor.  The reader attaches to \p registry, so that the writer
+     * can see its front index, and detaches on destruction.  It does not see any data written
+     * prior to construction.  If the registry is full, the reader is an ordinary
+     * non-throttling reader; see registrySlot().
+     *
+     * \param fifo     Associated FIFO.  Passed by reference because it must be non-NULL.
+     * \param registry Registry of broadcast readers of the FIFO, used by the writer.
+     * \param flush    See the other constructor.
+     */
+    audio_utils_fifo_reader(audio_utils_fifo& fifo, audio_utils_fifo_reader_registry& registry,
+                            bool flush = false);
+
     virtual ~audio_utils_fifo_reader();
 
     /**
@@ -622,6 +853,29 @@ public:
     uint64_t totalFlushed() const
             { return mTotalFlushed; }
 
+    /**
+     * Return the registry slot of a broadcast reader, for use with
+     * audio_utils_fifo_reader_registry::getLagHistogram().
+     *
+     * \return Slot index, if greater than or equal to zero.
+     *  \retval -ENOSPC  the registry was full, so the reader is not attached.
+     *  \retval -ENOENT  the reader was not constructed with a registry.
+     */
+    int32_t registrySlot() const
+            { return mRegistrySlot; }
+
+    /**
+     * Enable or disable caching mode, which is disabled initially.
+     * In caching mode, the reader keeps the most recently loaded value of the writer's rear index,
+     * and loads it again only when the cached value has too few frames to satisfy an obtain()
+     * or read(), or for available().  This avoids moving the cache line of the rear index
+     * between cores on every read, but a reader that does not throttle the writer
+     * may then detect an overrun later.
+     *
+     * \param caching Whether to enable caching mode.
+     */
+    void setCaching(bool caching);
+
 private:
     // Accessed by reader only using ordinary operations
     uint32_t     mLocalFront;   // frame index of first frame slot available to read, or read index
@@ -630,8 +884,15 @@ private:
     // FIXME consider making it a boolean
     audio_utils_fifo_index*     mThrottleFront;
 
+    audio_utils_fifo_reader_registry *mRegistry;    // registry we are attached to, or NULL
+    int32_t     mRegistrySlot;      // our slot in mRegistry, or a negative errno
+
     bool        mFlush;             // whether to flush the entire buffer on -EOVERFLOW
 
+    // Used only in caching mode, to avoid reloading the writer's rear index.
+    RefIndexCachedLoadAcquireDeferredWait mCachedRear;
+    bool        mCaching;           // whether in caching mode
+
     int32_t     mArmLevel;          // arm if filled > arm level before release()
     uint32_t    mTriggerLevel;      // trigger if armed and filled < trigger level after release()
     bool        mIsArmed;           // whether currently armed
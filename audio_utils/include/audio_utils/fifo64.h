@@ -0,0 +1,232 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_FIFO64_H
+#define ANDROID_AUDIO_FIFO64_H
+
+#include <audio_utils/fifo.h>
+
+/**
+ * FIFO with 64-bit indices, for long-running high-rate streams.
+ *
+ * The indices of audio_utils_fifo are 32 bits, so they wrap, and diff() must infer the
+ * distance between rear and front from generation counts; lost frame counts are approximate
+ * once the writer is more than one generation ahead.  Here the indices are 64-bit frame counts,
+ * which never wrap in practice (2^64 frames last over 700,000 years at 768 kHz),
+ * so the fill level is simply rear - front and the lost frame count is exact.
+ * The buffer offsets are tracked incrementally by the reader and writer, so there is no masking
+ * or rounding of the capacity to a power of 2.
+ * The futex is the low-order 32 bits of each index; see audio_utils_fifo_index64.
+ *
+ * Compared to audio_utils_fifo, the writer has no effective buffer size or hysteresis:
+ * every non-empty release wakes the blocked readers and writer.
+ * The usage is otherwise the same, with audio_utils_fifo64_writer and audio_utils_fifo64_reader.
+ */
+class audio_utils_fifo64 {
+
+    friend class audio_utils_fifo64_reader;
+    friend class audio_utils_fifo64_writer;
+
+public:
+
+    /**
+     * Construct a FIFO object: multi-process.
+     * Index synchronization is AUDIO_UTILS_FIFO_SYNC_SHARED.
+     *
+     *  \param frameCount  Maximum usable frames to be stored in the FIFO > 0 && <= INT32_MAX.
+     *  \param frameSize   Size of each frame in bytes > 0,
+     *                     \p frameSize * \p frameCount <= INT32_MAX.
+     *  \param buffer      Pointer to a non-NULL caller-allocated buffer of \p frameCount frames.
+     *  \param writerRear  Writer's rear index.  Passed by reference because it must be non-NULL.
+     *  \param throttleFront Pointer to the front index of at most one reader that throttles the
+     *                       writer, or NULL for no throttling.
+     *                       The indices may start at any value, provided front <= rear.
+     */
+    audio_utils_fifo64(uint32_t frameCount, uint32_t frameSize, void *buffer,
+            audio_utils_fifo_index64& writerRear, audio_utils_fifo_index64 *throttleFront = NULL);
+
+    /**
+     * Construct a FIFO object: single-process.
+     *
+     *  \param frameCount  See the multi-process constructor.
+     *  \param frameSize   See the multi-process constructor.
+     *  \param buffer      See the multi-process constructor.
+     *  \param throttlesWriter Whether there is one reader that throttles the writer.
+     *  \param sync        Index synchronization, defaults to AUDIO_UTILS_FIFO_SYNC_PRIVATE but
+     *                     can also be AUDIO_UTILS_FIFO_SYNC_SINGLE_THREADED or
+     *                     AUDIO_UTILS_FIFO_SYNC_SLEEP.
+     *                     AUDIO_UTILS_FIFO_SYNC_SHARED is not permitted.
+     */
+    audio_utils_fifo64(uint32_t frameCount, uint32_t frameSize, void *buffer,
+            bool throttlesWriter = true,
+            audio_utils_fifo_sync sync = AUDIO_UTILS_FIFO_SYNC_PRIVATE);
+
+    ~audio_utils_fifo64();
+
+    /** Return the capacity in frames. */
+    uint32_t frameCount() const
+            { return mFrameCount; }
+
+    /** Return the frame size in bytes. */
+    uint32_t frameSize() const
+            { return mFrameSize; }
+
+    /** Return a pointer to the caller-allocated buffer. */
+    void *buffer() const
+            { return mBuffer; }
+
+private:
+    /**
+     * Return the fill level, that is the number of frames between front and rear.
+     *
+     * \param rear  Writer's rear index.
+     * \param front Reader's front index.
+     * \param lost  If non-NULL, set to the exact number of lost frames on -EOVERFLOW,
+     *              which is rear - front less the frames still in the buffer (unless flushing),
+     *              or zero otherwise.
+     * \param flush Whether to flush the entire buffer on -EOVERFLOW.
+     *
+     * \return the fill level, in range [0, mFrameCount].
+     *  \retval -EIO        corrupted indices, no recovery is possible
+     *  \retval -EOVERFLOW  reader doesn't throttle writer, and frames were lost because reader
+     *                      isn't keeping up with writer; see \p lost
+     */
+    int32_t diff(uint64_t rear, uint64_t front, uint64_t *lost = NULL, bool flush = false) const;
+
+    // Mark the FIFO as shutdown (permanently unusable), usually due to an -EIO status from an API.
+    void shutdown() const;
+
+    uint64_t load(const audio_utils_fifo_index64& index, audio_utils_fifo_sync sync) const;
+    void store(audio_utils_fifo_index64& index, audio_utils_fifo_sync sync, uint64_t value);
+
+    // Wait at most once for index to change from expected, as for a blocking read or write.
+    // Returns 0 when woken, or a negative errno.
+    int wait(audio_utils_fifo_index64& index, audio_utils_fifo_sync sync, uint64_t expected,
+            const struct timespec *timeout);
+    // Wake all waiters if the sync uses a futex.
+    void wake(audio_utils_fifo_index64& index, audio_utils_fifo_sync sync);
+
+    // These fields are const after initialization
+    const uint32_t mFrameCount;     // max number of significant frames to be stored in the FIFO > 0
+    const uint32_t mFrameSize;      // size of each frame in bytes
+    void * const   mBuffer;         // non-NULL pointer to caller-allocated buffer
+
+    audio_utils_fifo_index64&           mWriterRear;    // reference to writer's rear index
+    audio_utils_fifo_sync               mWriterRearSync;
+    audio_utils_fifo_index64* const     mThrottleFront; // pointer to the throttling front index,
+                                                        // or NULL for no throttling
+    audio_utils_fifo_sync               mThrottleFrontSync;
+
+    // only used for single-process constructor
+    audio_utils_fifo_index64    mSingleProcessSharedRear;
+    audio_utils_fifo_index64    mSingleProcessSharedFront;
+
+    mutable bool                mIsShutdown;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Used to write to a 64-bit FIFO.  There should be exactly one writer per FIFO.
+ * See audio_utils_fifo_writer, which has the same methods and return values.
+ */
+class audio_utils_fifo64_writer {
+
+public:
+    explicit audio_utils_fifo64_writer(audio_utils_fifo64& fifo);
+    ~audio_utils_fifo64_writer();
+
+    /** See audio_utils_fifo_writer::write(). */
+    ssize_t write(const void *buffer, size_t count, const struct timespec *timeout = NULL);
+
+    /** See audio_utils_fifo_provider::obtain(). */
+    ssize_t obtain(audio_utils_iovec iovec[2], size_t count = SIZE_MAX,
+            const struct timespec *timeout = NULL);
+
+    /** See audio_utils_fifo_provider::release(). */
+    void release(size_t count);
+
+    /** See audio_utils_fifo_provider::available(). */
+    ssize_t available();
+
+    /** Return the total number of frames released since construction. */
+    uint64_t totalReleased() const
+            { return mTotalReleased; }
+
+private:
+    audio_utils_fifo64& mFifo;
+
+    uint64_t    mLocalRear;     // frame index of next frame slot available to write
+    uint32_t    mRearOffset;    // mLocalRear modulo mFifo.mFrameCount
+    uint32_t    mObtained;      // number of frames obtained at most recent obtain(), less released
+    uint64_t    mTotalReleased; // total frames released since construction
+};
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Used to read from a 64-bit FIFO.  There can be one or more readers per FIFO,
+ * and at most one of those readers can throttle the writer.
+ * See audio_utils_fifo_reader, which has the same methods and return values,
+ * except that lost frame counts are exact.
+ */
+class audio_utils_fifo64_reader {
+
+public:
+    /** See audio_utils_fifo_reader::audio_utils_fifo_reader(). */
+    explicit audio_utils_fifo64_reader(audio_utils_fifo64& fifo, bool throttlesWriter = true,
+            bool flush = false);
+    ~audio_utils_fifo64_reader();
+
+    /** See audio_utils_fifo_reader::read(). */
+    ssize_t read(void *buffer, size_t count, const struct timespec *timeout = NULL,
+            size_t *lost = NULL);
+
+    /** See audio_utils_fifo_reader::obtain(). */
+    ssize_t obtain(audio_utils_iovec iovec[2], size_t count = SIZE_MAX,
+            const struct timespec *timeout = NULL, size_t *lost = NULL);
+
+    /** See audio_utils_fifo_provider::release(). */
+    void release(size_t count);
+
+    /** See audio_utils_fifo_reader::available(). */
+    ssize_t available(size_t *lost = NULL);
+
+    /** Return the total number of frames released or lost since construction. */
+    uint64_t totalReleased() const
+            { return mTotalReleased; }
+
+    /** Return the exact total number of lost frames since construction. */
+    uint64_t totalLost() const
+            { return mTotalLost; }
+
+private:
+    audio_utils_fifo64& mFifo;
+
+    uint64_t    mLocalFront;    // frame index of first frame slot available to read
+    uint32_t    mFrontOffset;   // mLocalFront modulo mFifo.mFrameCount
+
+    // Points to shared front index if this reader throttles writer, or NULL if we don't throttle
+    audio_utils_fifo_index64*   mThrottleFront;
+
+    const bool  mFlush;         // whether to flush the entire buffer on -EOVERFLOW
+
+    uint32_t    mObtained;      // number of frames obtained at most recent obtain(), less released
+    uint64_t    mTotalReleased; // total frames released since construction, including lost
+    uint64_t    mTotalLost;     // total lost frames
+};
+
+#endif  // !ANDROID_AUDIO_FIFO64_H
@@ -18,6 +18,7 @@
 #define ANDROID_AUDIO_FIFO_INDEX_H
 
 #include <atomic>
+#include <stddef.h>
 #include <stdint.h>
 #include <time.h>
 
@@ -38,14 +39,14 @@ public:
      *
      * \return Index value
      */
-    uint32_t loadSingleThreaded();
+    uint32_t loadSingleThreaded() const;
 
     /**
      * Load value of index now with memory order 'acquire'.
      *
      * \return Index value
      */
-    uint32_t loadAcquire();
+    uint32_t loadAcquire() const;
 
     /**
      * Store new value into index by a simple non-atomic memory write.
@@ -61,6 +62,17 @@ public:
      */
     void storeRelease(uint32_t value);
 
+    /**
+     * Store new value into index if it still has the expected value, with memory order
+     * 'acquire' and 'release'.  Used by multiple writers to reserve frames.
+     *
+     * \param expected Expected value of index.  Updated to the current value on failure.
+     * \param value    New value to store into index.
+     *
+     * \return true if the new value was stored.
+     */
+    bool compareExchange(uint32_t& expected, uint32_t value);
+
     // TODO op should be set in the constructor.
     /**
      * Wait for value of index to change from the specified expected value.
@@ -93,7 +105,7 @@ public:
 private:
     // Linux futex is 32 bits regardless of platform.
     // It would make more sense to declare this as atomic_uint32_t, but there is no such type name.
-    // TODO Support 64-bit index with 32-bit futex in low-order bits.
+    // See audio_utils_fifo_index64 for a 64-bit index.
     std::atomic_uint_least32_t  mIndex; // accessed by both sides using atomic operations
     // TODO Should be a union with a simple non-atomic variable
     static_assert(sizeof(mIndex) == sizeof(uint32_t), "mIndex must be 32 bits");
@@ -102,9 +114,93 @@ private:
 static_assert(sizeof(audio_utils_fifo_index) == sizeof(uint32_t),
         "audio_utils_fifo_index must be 32 bits");
 
-// ----------------------------------------------------------------------------
+/**
+ * A 64-bit index that may optionally be placed in shared memory, for indices that never wrap.
+ * Same as audio_utils_fifo_index, except that the futex is the low-order 32 bits of the index.
+ * A change of index value is seen by a waiter provided that the index never advances by a
+ * multiple of 2^32 between the waiter's load and wait, which holds for a FIFO as a transfer
+ * is at most INT32_MAX frames.
+ */
+class audio_utils_fifo_index64 {
+
+public:
+    explicit audio_utils_fifo_index64(uint64_t value = 0) : mIndex(value) { }
+    ~audio_utils_fifo_index64() { }
+
+    /** See audio_utils_fifo_index::loadSingleThreaded(). */
+    uint64_t loadSingleThreaded() const;
+
+    /** See audio_utils_fifo_index::loadAcquire(). */
+    uint64_t loadAcquire() const;
+
+    /** See audio_utils_fifo_index::storeSingleThreaded(). */
+    void storeSingleThreaded(uint64_t value);
+
+    /** See audio_utils_fifo_index::storeRelease(). */
+    void storeRelease(uint64_t value);
+
+    /**
+     * Wait for the low-order 32 bits of index to change from those of the expected value.
+     * See audio_utils_fifo_index::wait().
+     */
+    int wait(int op, uint64_t expected, const struct timespec *timeout);
+
+    /** See audio_utils_fifo_index::wake(). */
+    int wake(int op, int waiters = 1);
 
-#if 0   // TODO not currently used, review this code later: bug 150627616
+private:
+    // Address of the low-order 32 bits, which are the futex.
+    void *futex();
+
+    std::atomic_uint_least64_t  mIndex; // accessed by both sides using atomic operations
+    static_assert(sizeof(mIndex) == sizeof(uint64_t), "mIndex must be 64 bits");
+    // A lock would not be shared between processes.
+    static_assert(std::atomic_uint_least64_t::is_always_lock_free, "mIndex must be lock-free");
+};
+
+static_assert(sizeof(audio_utils_fifo_index64) == sizeof(uint64_t),
+        "audio_utils_fifo_index64 must be 64 bits");
+
+/**
+ * Alignment in bytes that places each index of audio_utils_fifo_indices on its own cache line.
+ * Cache lines are 64 bytes on current ARM and x86 cores, but some cores fetch lines in
+ * adjacent pairs.
+ */
+constexpr size_t AUDIO_UTILS_FIFO_CACHE_LINE_ALIGNMENT = 128;
+
+/** Alignment in bytes that places each index of audio_utils_fifo_indices on its own page. */
+constexpr size_t AUDIO_UTILS_FIFO_PAGE_ALIGNMENT = 4096;
+
+/**
+ * Layout of the indices of one audio_utils_fifo, with each index aligned to \p Alignment bytes.
+ * The writer's rear index is written by the writer on each release and read by the readers,
+ * and the throttling reader's front index is the reverse, so when both indices share a cache line
+ * each release invalidates the line in the partner's cache even if the partner is only polling
+ * its own index ("false sharing").
+ *
+ * Use the default alignment within one process, or to place the indices in shared memory that
+ * is mapped by each process at a page-aligned address.
+ * Use audio_utils_fifo_page_indices for indices that must be on separate pages, for example so
+ * that each page can be mapped with different protection in the writer and reader processes.
+ * The object must be constructed (by placement new when in shared memory) at an address that is
+ * aligned to \p Alignment.
+ */
+template <size_t Alignment = AUDIO_UTILS_FIFO_CACHE_LINE_ALIGNMENT>
+struct audio_utils_fifo_indices {
+    static_assert(Alignment >= sizeof(audio_utils_fifo_index) &&
+            (Alignment & (Alignment - 1)) == 0, "Alignment must be a power of 2");
+
+    /** Writer's rear index, see audio_utils_fifo::audio_utils_fifo(). */
+    alignas(Alignment) audio_utils_fifo_index mRear;
+    /** Front index of the reader that throttles the writer, if any. */
+    alignas(Alignment) audio_utils_fifo_index mFront;
+    /** Reservation index shared by all audio_utils_fifo_multi_writer, if any. */
+    alignas(Alignment) audio_utils_fifo_index mReserve;
+};
+
+using audio_utils_fifo_page_indices = audio_utils_fifo_indices<AUDIO_UTILS_FIFO_PAGE_ALIGNMENT>;
+
+// ----------------------------------------------------------------------------
 
 // TODO
 // From a design POV, these next two classes should be related.
@@ -115,6 +211,8 @@ static_assert(sizeof(audio_utils_fifo_index) == sizeof(uint32_t),
 
 /**
  * A reference to an audio_utils_fifo_index with deferred store-release and deferred wake.
+ * Used by audio_utils_fifo_writer in batching mode, so that several releases
+ * cost a single store-release and at most one futex wake; see audio_utils_fifo_writer::commit().
  *
  * TODO Currently the index and futex share the same 32-bit cell.
  * In the future, the index may optionally be increased to 64-bits,
@@ -125,7 +223,8 @@ static_assert(sizeof(audio_utils_fifo_index) == sizeof(uint32_t),
 class RefIndexDeferredStoreReleaseDeferredWake
 {
 public:
-    RefIndexDeferredStoreReleaseDeferredWake(audio_utils_fifo_index& index);
+    explicit RefIndexDeferredStoreReleaseDeferredWake(audio_utils_fifo_index& index);
+    // Does writeback() and then wakeNowIfNeeded().
     ~RefIndexDeferredStoreReleaseDeferredWake();
 
     // Place 'value' into the cache, but do not store it to memory yet.
@@ -155,13 +254,15 @@ private:
 
 /**
  * A reference to an audio_utils_fifo_index with cached load-acquire, and deferred wait.
+ * Used by audio_utils_fifo_reader in caching mode, so that the reader only loads the writer's
+ * rear index when the cached value can not satisfy a request.
  *
  * TODO Same as RefIndexDeferredStoreReleaseDeferredWake.
  */
 class RefIndexCachedLoadAcquireDeferredWait
 {
 public:
-    RefIndexCachedLoadAcquireDeferredWait(audio_utils_fifo_index& index);
+    explicit RefIndexCachedLoadAcquireDeferredWait(audio_utils_fifo_index& index);
     ~RefIndexCachedLoadAcquireDeferredWait();
 
     // If value is already cached, return the cached value.
@@ -175,12 +276,10 @@ public:
     // Discard any value in the cache.
     void        invalidate();
 
-#if 0
     /**
      * Load a fresh value for index, ignoring any previously cached information.
      */
     uint32_t    readthrough();
-#endif
 
     // TODO This is an immediate wait, but we needed deferred wait
     /**
@@ -196,6 +295,8 @@ public:
      *
      * \return Zero for success, or a negative error code as specified at "man 2 futex".
      * \retval -EINVAL caller did not call get() prior to wait()
+     *
+     * The cache is invalidated, whether or not the wait succeeds.
      */
     int         wait(int op, const struct timespec *timeout);
 
@@ -205,6 +306,4 @@ private:
     bool                    mLoaded;    // whether mValue is valid
 };
 
-#endif  // 0
-
 #endif  // !ANDROID_AUDIO_FIFO_INDEX_H
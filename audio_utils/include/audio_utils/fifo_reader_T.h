@@ -0,0 +1,170 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_FIFO_READER_T_H
+#define ANDROID_AUDIO_FIFO_READER_T_H
+
+#if __cplusplus <= 201703L
+#error fifo_reader_T.h requires C++20 for std::span
+#endif
+
+#include <algorithm>
+#include <span>
+#include <audio_utils/fifo.h>
+#include <audio_utils/futex.h>
+
+/**
+ * Optimized FIFO reader for fixed-sized POD such as primitives, which obtains typed spans of the
+ * FIFO memory, so that frames can be consumed or processed in place without a copy.
+ * All methods are inline.
+ *
+ * Has these restrictions compared to the ordinary FIFO reader:
+ *  - buffer must be aligned on an appropriate boundary for T
+ *  - frame size must be sizeof(T)
+ *  - capacity must be power-of-2
+ *  - no blocking reads, and no hysteresis
+ *  - does not implement the provider interface
+ *  - may not be combined with a broadcast reader registry
+ *
+ * A throttling reader stores its front index with memory order 'release' on every non-empty
+ * release(), and wakes a writer blocked on the FIFO.
+ * See also audio_utils_fifo_writer_T::obtain().
+ */
+template <typename T>
+class audio_utils_fifo_reader_T {
+
+public:
+    /**
+     * Construct a reader_T from a FIFO.
+     * See audio_utils_fifo_reader::audio_utils_fifo_reader() for the parameters.
+     */
+    explicit audio_utils_fifo_reader_T(audio_utils_fifo& fifo, bool throttlesWriter = true,
+            bool flush = false) :
+        mFifo(fifo),
+        // as for audio_utils_fifo_reader
+        mLocalFront(throttlesWriter ? 0 : fifo.mWriterRear.loadAcquire()),
+        mFrameCountP2(fifo.mFrameCountP2), mBuffer((T *) fifo.mBuffer),
+        mThrottleFront(throttlesWriter ? fifo.mThrottleFront : NULL),
+        mFlush(flush), mObtained(0), mTotalLost(0)
+    {
+        if (fifo.mFrameSize != sizeof(T) || fifo.mFudgeFactor != 0) {
+            abort();
+        }
+    }
+
+    ~audio_utils_fifo_reader_T() { }
+
+    /**
+     * Obtain the next \p count readable frames as two typed spans of the FIFO memory.
+     * The second span is the part that wraps around to the start of the buffer,
+     * and is empty if there is no wrap.  Follow with release().
+     *
+     * \param span  Set to the two parts of the obtained frames.
+     * \param count Maximum number of frames to obtain.
+     * \param lost  If non-NULL, set to the approximate number of frames lost on -EOVERFLOW,
+     *              or zero otherwise.
+     *
+     * \return Number of frames obtained, which is the total size of the two spans,
+     *         or a negative error code with two empty spans.
+     *  \retval -EIO        corrupted indices, no recovery is possible
+     *  \retval -EOVERFLOW  reader doesn't throttle writer, and frames were lost because reader
+     *                      isn't keeping up with writer; see \p lost
+     */
+    ssize_t obtain(std::span<T> span[2], size_t count = SIZE_MAX, size_t *lost = NULL)
+            __attribute__((no_sanitize("integer")))     // mLocalFront arithmetic can wrap
+    {
+        const uint32_t rear = mFifo.mWriterRear.loadAcquire();
+        size_t ourLost;
+        if (lost == NULL) {
+            lost = &ourLost;
+        }
+        // returns -EIO if mIsShutdown
+        int32_t filled = mFifo.diff(rear, mLocalFront, lost, mFlush);
+        mTotalLost += *lost;
+        ssize_t err = 0;
+        if (filled < 0) {
+            if (filled == -EOVERFLOW) {
+                // catch up with writer, but preserve the still valid frames in buffer
+                mLocalFront = rear - (mFlush ? 0 : mFrameCountP2);
+            }
+            err = filled;
+            filled = 0;
+        }
+        const uint32_t availToRead = (uint32_t) std::min<size_t>(filled, count);
+        const uint32_t frontOffset = mLocalFront & (mFrameCountP2 - 1);
+        const uint32_t part1 = std::min(mFrameCountP2 - frontOffset, availToRead);
+        span[0] = std::span<T>(&mBuffer[frontOffset], part1);
+        span[1] = std::span<T>(mBuffer, availToRead - part1);
+        mObtained = availToRead;
+        return availToRead > 0 ? availToRead : err;
+    }
+
+    /**
+     * Release \p count frames from the most recent obtain(), which must not be more than
+     * were obtained, so that the writer may reuse them if this reader throttles the writer.
+     */
+    void release(size_t count)
+            __attribute__((no_sanitize("integer")))     // mLocalFront += can wrap
+    {
+        if (count == 0) {
+            return;
+        }
+        if (count > mObtained) {
+            mFifo.shutdown();
+            return;
+        }
+        mLocalFront += (uint32_t) count;
+        mObtained -= count;
+        if (mThrottleFront != NULL) {
+            mThrottleFront->storeRelease(mLocalFront);
+            if (mFifo.mThrottleFrontSync == AUDIO_UTILS_FIFO_SYNC_PRIVATE ||
+                    mFifo.mThrottleFrontSync == AUDIO_UTILS_FIFO_SYNC_SHARED) {
+                (void) mThrottleFront->wake(
+                        mFifo.mThrottleFrontSync == AUDIO_UTILS_FIFO_SYNC_PRIVATE ?
+                                FUTEX_WAKE_PRIVATE : FUTEX_WAKE, INT32_MAX /*waiters*/);
+            }
+        }
+    }
+
+    /**
+     * Return the total number of lost frames since construction, due to reader not keeping up with
+     * writer.  See audio_utils_fifo_reader::totalLost().
+     */
+    uint64_t totalLost() const
+            { return mTotalLost; }
+
+private:
+    const audio_utils_fifo& mFifo;
+
+    // Accessed by reader only using ordinary operations
+    uint32_t    mLocalFront;    // frame index of first frame slot available to read, or read index
+
+    // These fields are copied from fifo for better performance (avoids an extra de-reference)
+    const uint32_t          mFrameCountP2;
+    T * const               mBuffer;
+
+    // Points to shared front index if this reader throttles writer, or NULL if we don't throttle
+    audio_utils_fifo_index* const mThrottleFront;
+
+    const bool  mFlush;         // whether to flush the entire buffer on -EOVERFLOW
+    uint32_t    mObtained;      // number of frames obtained at most recent obtain(), less released
+    uint64_t    mTotalLost;     // total lost frames
+};
+
+using audio_utils_fifo_reader32 = audio_utils_fifo_reader_T<int32_t>;
+using audio_utils_fifo_reader64 = audio_utils_fifo_reader_T<int64_t>;
+
+#endif // !ANDROID_AUDIO_FIFO_READER_T_H
@@ -17,6 +17,10 @@
 #ifndef ANDROID_AUDIO_FIFO_WRITER32_H
 #define ANDROID_AUDIO_FIFO_WRITER32_H
 
+#if __cplusplus > 201703L
+#include <algorithm>
+#include <span>
+#endif
 #include <audio_utils/fifo.h>
 
 /**
@@ -40,6 +44,9 @@
  *  - construct an ordinary reader based on that FIFO
  *  - construct a writer_T using the FIFO
  *  - use a sequence of write and write1, followed by storeSingleThreaded or storeRelease to commit
+ *
+ * With C++20, obtain() and release() can be used instead of write() to produce frames in place.
+ * See also audio_utils_fifo_reader_T.
  */
 template <typename T>
 class audio_utils_fifo_writer_T /* : public audio_utils_fifo_provider */ {
@@ -68,6 +75,40 @@ public:
         mBuffer[mLocalRear++ & (mFrameCountP2 - 1)] = value;
     }
 
+#if __cplusplus > 201703L
+    /**
+     * Obtain the FIFO memory for the next \p count frames as two typed spans, so that the frames
+     * can be produced in place without a copy.  The second span is the part that wraps around to
+     * the start of the buffer, and is empty if there is no wrap.
+     * As the writer is not throttled, min(\p count, capacity) frames are always available.
+     * Follow with release(), and then storeSingleThreaded or storeRelease to commit.
+     *
+     * \param span  Set to the two parts of the obtained frames.
+     * \param count Maximum number of frames to obtain.
+     *
+     * \return Number of frames obtained, which is the total size of the two spans.
+     */
+    size_t obtain(std::span<T> span[2], size_t count)
+    {
+        const uint32_t availToWrite = (uint32_t) std::min<size_t>(count, mFrameCountP2);
+        const uint32_t rearOffset = mLocalRear & (mFrameCountP2 - 1);
+        const uint32_t part1 = std::min(mFrameCountP2 - rearOffset, availToWrite);
+        span[0] = std::span<T>(&mBuffer[rearOffset], part1);
+        span[1] = std::span<T>(mBuffer, availToWrite - part1);
+        return availToWrite;
+    }
+
+    /**
+     * Advance past \p count frames from the most recent obtain(), which must not be more than
+     * were obtained.  As for write(), the frames are not observable by the readers until committed.
+     */
+    void release(size_t count)
+            __attribute__((no_sanitize("integer")))     // mLocalRear += can wrap
+    {
+        mLocalRear += (uint32_t) count;
+    }
+#endif
+
     /**
      * Commit all previous write and write1 so that they are observable by reader(s),
      * with a simple non-atomic memory write.
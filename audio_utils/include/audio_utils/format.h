@@ -85,6 +85,31 @@ void memcpy_by_audio_format(void *dst, audio_format_t dst_format,
 size_t memcpy_by_index_array_initialization_from_channel_mask(int8_t *idxary, size_t arysize,
         audio_channel_mask_t dst_channel_mask, audio_channel_mask_t src_channel_mask);
 
+/**
+ * Converts the sample format and rearranges the channels of each frame in a single pass.
+ * This gives the same result as memcpy_by_audio_format() to dst_format followed by
+ * memcpy_by_index_array(), without the intermediate buffer and the second pass over
+ * the data.
+ *
+ *  \param dst           Destination buffer
+ *  \param dst_format    Destination buffer format
+ *  \param dst_channels  Number of destination channels per frame
+ *  \param src           Source buffer
+ *  \param src_format    Source buffer format
+ *  \param src_channels  Number of source channels per frame
+ *  \param idxary        Array of indices representing channels in the source frame,
+ *                       see memcpy_by_index_array() and its initialization functions.
+ *  \param count         Number of frames to copy
+ *
+ * The formats allowed are as for memcpy_by_audio_format().
+ *
+ * The destination and source buffers must be completely separate
+ * or point to the same starting buffer address.
+ */
+void memcpy_by_audio_format_and_index_array(void *dst, audio_format_t dst_format,
+        uint32_t dst_channels, const void *src, audio_format_t src_format,
+        uint32_t src_channels, const int8_t *idxary, size_t count);
+
 /**
  * Accumulates samples from src and dst buffers into dst buffer.
  *
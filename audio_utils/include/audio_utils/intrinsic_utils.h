@@ -32,9 +32,26 @@
 #pragma push_macro("USE_NEON")
 #undef USE_NEON
 
+// and SSE/AVX optimizations for x86 devices.
+#pragma push_macro("USE_SSE")
+#undef USE_SSE
+#pragma push_macro("USE_AVX")
+#undef USE_AVX
+#pragma push_macro("USE_AVX512")
+#undef USE_AVX512
+
 #if defined(__ARM_NEON__) || defined(__aarch64__)
 #include <arm_neon.h>
 #define USE_NEON
+#elif defined(__SSE2__)
+#include <immintrin.h>
+#define USE_SSE
+#if defined(__AVX__)
+#define USE_AVX
+#endif
+#if defined(__AVX512F__)
+#define USE_AVX512
+#endif
 #endif
 
 namespace android::audio_utils::intrinsics {
@@ -59,6 +76,9 @@ struct internal_array_t {
 
   Notes:
   1) We provide scalar equivalents which are compilable even on non-ARM processors.
+     On x86 processors we map the SSE (__m128, __m128d), AVX (__m256, __m256d) and
+     AVX-512 (__m512, __m512d) types, selected at compile time by the target flags.
+     Only SSE2 is required for the 128 bit types, so this is enabled for all x86-64 builds.
   2) We use recursive calls to decompose array types, e.g. float32x4x4_t -> float32x4_t
   3) NEON double SIMD acceleration is only available on 64 bit architectures.
      On Pixel 3XL, NEON double x 2 SIMD is actually slightly slower than the FP unit.
@@ -94,6 +114,24 @@ static inline T vdupn(F f) {
         return vdupq_n_f64(f);
 #endif
 #endif // USE_NEON
+#ifdef USE_SSE
+    } else if constexpr (std::is_same_v<T, __m128>) {
+        return _mm_set1_ps(f);
+    } else if constexpr (std::is_same_v<T, __m128d>) {
+        return _mm_set1_pd(f);
+#ifdef USE_AVX
+    } else if constexpr (std::is_same_v<T, __m256>) {
+        return _mm256_set1_ps(f);
+    } else if constexpr (std::is_same_v<T, __m256d>) {
+        return _mm256_set1_pd(f);
+#endif // USE_AVX
+#ifdef USE_AVX512
+    } else if constexpr (std::is_same_v<T, __m512>) {
+        return _mm512_set1_ps(f);
+    } else if constexpr (std::is_same_v<T, __m512d>) {
+        return _mm512_set1_pd(f);
+#endif // USE_AVX512
+#endif // USE_SSE
 
     } else /* constexpr */ {
         T ret;
@@ -131,6 +169,24 @@ static inline T vld1(const F *f) {
         return vld1q_f64(f);
 #endif
 #endif // USE_NEON
+#ifdef USE_SSE
+    } else if constexpr (std::is_same_v<T, __m128>) {
+        return _mm_loadu_ps(f);
+    } else if constexpr (std::is_same_v<T, __m128d>) {
+        return _mm_loadu_pd(f);
+#ifdef USE_AVX
+    } else if constexpr (std::is_same_v<T, __m256>) {
+        return _mm256_loadu_ps(f);
+    } else if constexpr (std::is_same_v<T, __m256d>) {
+        return _mm256_loadu_pd(f);
+#endif // USE_AVX
+#ifdef USE_AVX512
+    } else if constexpr (std::is_same_v<T, __m512>) {
+        return _mm512_loadu_ps(f);
+    } else if constexpr (std::is_same_v<T, __m512d>) {
+        return _mm512_loadu_pd(f);
+#endif // USE_AVX512
+#endif // USE_SSE
 
     } else /* constexpr */ {
         T ret;
@@ -156,6 +212,63 @@ static inline T vld1(const F *f) {
     }
 }
 
+// add a + b
+template<typename T>
+static inline T vadd(T a, T b) {
+    if constexpr (std::is_same_v<T, float> || std::is_same_v<T, double>) {
+        return a + b;
+
+#ifdef USE_NEON
+    } else if constexpr (std::is_same_v<T, float32x2_t>) {
+        return vadd_f32(a, b);
+    } else if constexpr (std::is_same_v<T, float32x4_t>) {
+        return vaddq_f32(a, b);
+#if defined(__aarch64__)
+    } else if constexpr (std::is_same_v<T, float64x2_t>) {
+        return vaddq_f64(a, b);
+#endif
+#endif // USE_NEON
+#ifdef USE_SSE
+    } else if constexpr (std::is_same_v<T, __m128>) {
+        return _mm_add_ps(a, b);
+    } else if constexpr (std::is_same_v<T, __m128d>) {
+        return _mm_add_pd(a, b);
+#ifdef USE_AVX
+    } else if constexpr (std::is_same_v<T, __m256>) {
+        return _mm256_add_ps(a, b);
+    } else if constexpr (std::is_same_v<T, __m256d>) {
+        return _mm256_add_pd(a, b);
+#endif // USE_AVX
+#ifdef USE_AVX512
+    } else if constexpr (std::is_same_v<T, __m512>) {
+        return _mm512_add_ps(a, b);
+    } else if constexpr (std::is_same_v<T, __m512d>) {
+        return _mm512_add_pd(a, b);
+#endif // USE_AVX512
+#endif // USE_SSE
+
+    } else /* constexpr */ {
+        T ret;
+        auto &[retval] = ret;  // single-member struct
+        const auto &[aval] = a;
+        const auto &[bval] = b;
+        if constexpr (std::is_array_v<decltype(retval)>) {
+#pragma unroll
+            for (size_t i = 0; i < std::size(aval); ++i) {
+                retval[i] = vadd(aval[i], bval[i]);
+            }
+            return ret;
+        } else /* constexpr */ {
+             auto &[r1, r2] = retval;
+             const auto &[a1, a2] = aval;
+             const auto &[b1, b2] = bval;
+             r1 = vadd(a1, b1);
+             r2 = vadd(a2, b2);
+             return ret;
+        }
+    }
+}
+
 // fused multiply-add a + b * c
 template<typename T>
 static inline T vmla(T a, T b, T c) {
@@ -172,6 +285,24 @@ static inline T vmla(T a, T b, T c) {
         return vmlaq_f64(a, b, c);
 #endif
 #endif // USE_NEON
+#ifdef USE_SSE
+    } else if constexpr (std::is_same_v<T, __m128>) {
+        return _mm_add_ps(a, _mm_mul_ps(b, c));
+    } else if constexpr (std::is_same_v<T, __m128d>) {
+        return _mm_add_pd(a, _mm_mul_pd(b, c));
+#ifdef USE_AVX
+    } else if constexpr (std::is_same_v<T, __m256>) {
+        return _mm256_add_ps(a, _mm256_mul_ps(b, c));
+    } else if constexpr (std::is_same_v<T, __m256d>) {
+        return _mm256_add_pd(a, _mm256_mul_pd(b, c));
+#endif // USE_AVX
+#ifdef USE_AVX512
+    } else if constexpr (std::is_same_v<T, __m512>) {
+        return _mm512_add_ps(a, _mm512_mul_ps(b, c));
+    } else if constexpr (std::is_same_v<T, __m512d>) {
+        return _mm512_add_pd(a, _mm512_mul_pd(b, c));
+#endif // USE_AVX512
+#endif // USE_SSE
 
     } else /* constexpr */ {
         T ret;
@@ -213,6 +344,24 @@ static inline T vmul(T a, T b) {
         return vmulq_f64(a, b);
 #endif
 #endif // USE_NEON
+#ifdef USE_SSE
+    } else if constexpr (std::is_same_v<T, __m128>) {
+        return _mm_mul_ps(a, b);
+    } else if constexpr (std::is_same_v<T, __m128d>) {
+        return _mm_mul_pd(a, b);
+#ifdef USE_AVX
+    } else if constexpr (std::is_same_v<T, __m256>) {
+        return _mm256_mul_ps(a, b);
+    } else if constexpr (std::is_same_v<T, __m256d>) {
+        return _mm256_mul_pd(a, b);
+#endif // USE_AVX
+#ifdef USE_AVX512
+    } else if constexpr (std::is_same_v<T, __m512>) {
+        return _mm512_mul_ps(a, b);
+    } else if constexpr (std::is_same_v<T, __m512d>) {
+        return _mm512_mul_pd(a, b);
+#endif // USE_AVX512
+#endif // USE_SSE
 
     } else /* constexpr */ {
         T ret;
@@ -252,6 +401,27 @@ static inline T vneg(T f) {
         return vnegq_f64(f);
 #endif
 #endif // USE_NEON
+#ifdef USE_SSE
+    } else if constexpr (std::is_same_v<T, __m128>) {
+        return _mm_xor_ps(f, _mm_set1_ps(-0.f));
+    } else if constexpr (std::is_same_v<T, __m128d>) {
+        return _mm_xor_pd(f, _mm_set1_pd(-0.));
+#ifdef USE_AVX
+    } else if constexpr (std::is_same_v<T, __m256>) {
+        return _mm256_xor_ps(f, _mm256_set1_ps(-0.f));
+    } else if constexpr (std::is_same_v<T, __m256d>) {
+        return _mm256_xor_pd(f, _mm256_set1_pd(-0.));
+#endif // USE_AVX
+#ifdef USE_AVX512
+    } else if constexpr (std::is_same_v<T, __m512>) {
+        // flip the sign bit as above, through the integer xor which needs only AVX512F.
+        return _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(f),
+                _mm512_castps_si512(_mm512_set1_ps(-0.f))));
+    } else if constexpr (std::is_same_v<T, __m512d>) {
+        return _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(f),
+                _mm512_castpd_si512(_mm512_set1_pd(-0.))));
+#endif // USE_AVX512
+#endif // USE_SSE
 
     } else /* constexpr */ {
         T ret;
@@ -273,6 +443,60 @@ static inline T vneg(T f) {
     }
 }
 
+// add across all elements, returning a scalar.
+template<typename T>
+static inline auto vaddv(T a) {
+    if constexpr (std::is_same_v<T, float> || std::is_same_v<T, double>) {
+        return a;
+
+#ifdef USE_NEON
+    } else if constexpr (std::is_same_v<T, float32x2_t>) {
+        return vget_lane_f32(vpadd_f32(a, a), 0);
+    } else if constexpr (std::is_same_v<T, float32x4_t>) {
+        const float32x2_t a2 = vadd_f32(vget_low_f32(a), vget_high_f32(a));
+        return vget_lane_f32(vpadd_f32(a2, a2), 0);
+#if defined(__aarch64__)
+    } else if constexpr (std::is_same_v<T, float64x2_t>) {
+        return vaddvq_f64(a);
+#endif
+#endif // USE_NEON
+#ifdef USE_SSE
+    } else if constexpr (std::is_same_v<T, __m128>) {
+        // same summation order as NEON: (a0 + a2) + (a1 + a3).
+        const __m128 a2 = _mm_add_ps(a, _mm_movehl_ps(a, a));
+        return _mm_cvtss_f32(_mm_add_ss(a2, _mm_shuffle_ps(a2, a2, 1)));
+    } else if constexpr (std::is_same_v<T, __m128d>) {
+        return _mm_cvtsd_f64(_mm_add_sd(a, _mm_unpackhi_pd(a, a)));
+#ifdef USE_AVX
+    } else if constexpr (std::is_same_v<T, __m256>) {
+        return vaddv(_mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1)));
+    } else if constexpr (std::is_same_v<T, __m256d>) {
+        return vaddv(_mm_add_pd(_mm256_castpd256_pd128(a), _mm256_extractf128_pd(a, 1)));
+#endif // USE_AVX
+#ifdef USE_AVX512
+    } else if constexpr (std::is_same_v<T, __m512>) {
+        return _mm512_reduce_add_ps(a);
+    } else if constexpr (std::is_same_v<T, __m512d>) {
+        return _mm512_reduce_add_pd(a);
+#endif // USE_AVX512
+#endif // USE_SSE
+
+    } else /* constexpr */ {
+        const auto &[aval] = a;
+        if constexpr (std::is_array_v<decltype(aval)>) {
+            auto accum = vaddv(aval[0]);
+#pragma unroll
+            for (size_t i = 1; i < std::size(aval); ++i) {
+                accum += vaddv(aval[i]);
+            }
+            return accum;
+        } else /* constexpr */ {
+             const auto &[a1, a2] = aval;
+             return vaddv(a1) + vaddv(a2);
+        }
+    }
+}
+
 // store to float pointer.
 template<typename T, typename F>
 static inline void vst1(F *f, T a) {
@@ -289,6 +513,24 @@ static inline void vst1(F *f, T a) {
         return vst1q_f64(f, a);
 #endif
 #endif // USE_NEON
+#ifdef USE_SSE
+    } else if constexpr (std::is_same_v<T, __m128>) {
+        return _mm_storeu_ps(f, a);
+    } else if constexpr (std::is_same_v<T, __m128d>) {
+        return _mm_storeu_pd(f, a);
+#ifdef USE_AVX
+    } else if constexpr (std::is_same_v<T, __m256>) {
+        return _mm256_storeu_ps(f, a);
+    } else if constexpr (std::is_same_v<T, __m256d>) {
+        return _mm256_storeu_pd(f, a);
+#endif // USE_AVX
+#ifdef USE_AVX512
+    } else if constexpr (std::is_same_v<T, __m512>) {
+        return _mm512_storeu_ps(f, a);
+    } else if constexpr (std::is_same_v<T, __m512d>) {
+        return _mm512_storeu_pd(f, a);
+#endif // USE_AVX512
+#endif // USE_SSE
 
     } else /* constexpr */ {
         const auto &[aval] = a;
@@ -310,6 +552,9 @@ static inline void vst1(F *f, T a) {
 
 } // namespace android::audio_utils::intrinsics
 
+#pragma pop_macro("USE_AVX512")
+#pragma pop_macro("USE_AVX")
+#pragma pop_macro("USE_SSE")
 #pragma pop_macro("USE_NEON")
 
 #endif // !ANDROID_AUDIO_UTILS_INTRINSIC_UTILS_H
@@ -0,0 +1,143 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_POLYPHASE_RESAMPLER_H
+#define ANDROID_AUDIO_POLYPHASE_RESAMPLER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/cdefs.h>
+#include <system/audio.h>
+
+// for struct resampler_buffer_provider and RESAMPLER_QUALITY_*
+#include <audio_utils/resampler.h>
+
+/** \cond */
+__BEGIN_DECLS
+/** \endcond */
+
+/**
+ * A rational polyphase FIR resampler with float or Q8.23 input and output.
+ *
+ * Unlike create_resampler(), which is int16 only, this computes in float and has
+ * no external dependency.  The windowed sinc filter bank for a given rate ratio and
+ * quality is computed once and shared, read-only, by all resamplers using it whatever
+ * their channel count and format, see polyphase_resampler_get_cache_stats().
+ * All memory is allocated at creation, nothing is allocated while resampling.
+ *
+ * The input is filtered directly from the caller's (or provider's) buffer; only the
+ * filter length in frames around each buffer boundary is copied.
+ */
+typedef struct polyphase_resampler_t polyphase_resampler_t;
+
+/**
+ * \brief Creates a resampler.
+ *
+ * \param in_sample_rate    input sample rate in Hz.
+ * \param out_sample_rate   output sample rate in Hz.  The reduced ratio
+ *                          out_sample_rate / in_sample_rate must have a
+ *                          numerator of at most 1024, which holds for all common rates.
+ * \param channel_count     number of interleaved channels.
+ * \param format            AUDIO_FORMAT_PCM_FLOAT or AUDIO_FORMAT_PCM_8_24_BIT,
+ *                          used for both input and output.
+ * \param quality           between RESAMPLER_QUALITY_MIN and RESAMPLER_QUALITY_MAX
+ *                          (exclusive).  Higher is a longer filter with a sharper
+ *                          transition band.
+ *
+ * \return resampler object or NULL if the parameters are not supported.
+ */
+polyphase_resampler_t *polyphase_resampler_create(uint32_t in_sample_rate,
+        uint32_t out_sample_rate, uint32_t channel_count, audio_format_t format,
+        uint32_t quality);
+
+/**
+ * \brief Destroys the resampler.
+ *
+ * \param resampler         object returned by create, if NULL nothing happens.
+ */
+void polyphase_resampler_destroy(polyphase_resampler_t *resampler);
+
+/**
+ * \brief Clears the filter history, as if newly created.
+ *
+ * \param resampler         object returned by create, if NULL nothing happens.
+ */
+void polyphase_resampler_reset(polyphase_resampler_t *resampler);
+
+/**
+ * \brief Returns the latency introduced by the filter in ns.
+ *
+ * \param resampler         object returned by create.
+ */
+int32_t polyphase_resampler_delay_ns(polyphase_resampler_t *resampler);
+
+/**
+ * \brief Resamples frames from an input buffer.
+ *
+ * \param resampler         object returned by create.
+ * \param in                input buffer.
+ * \param in_frames         as input, the number of frames in the input buffer.
+ *                          As output, the number of frames consumed; the caller
+ *                          must pass the frames not consumed on the next call.
+ * \param out               output buffer.
+ * \param out_frames        as input, the capacity of the output buffer in frames.
+ *                          As output, the number of frames written.
+ *
+ * \return 0 on success, -EINVAL if a parameter is NULL.
+ */
+int polyphase_resampler_resample_from_input(polyphase_resampler_t *resampler,
+        const void *in, size_t *in_frames, void *out, size_t *out_frames);
+
+/**
+ * \brief Resamples frames obtained from a buffer provider, without copying them.
+ *
+ * Frames are read directly from the buffers returned by get_next_buffer().
+ * If the output fills before a buffer is consumed, release_buffer() is called with
+ * the number of frames actually consumed, and the provider must return the
+ * remaining frames on the next get_next_buffer(), as AudioBufferProvider does.
+ *
+ * \param resampler         object returned by create.
+ * \param provider          buffer provider.
+ * \param out               output buffer.
+ * \param out_frames        as input, the capacity of the output buffer in frames.
+ *                          As output, the number of frames written, which is less
+ *                          than requested only if the provider ran out of data.
+ *
+ * \return 0 on success, -EINVAL if a parameter is NULL.
+ */
+int polyphase_resampler_resample_from_provider(polyphase_resampler_t *resampler,
+        struct resampler_buffer_provider *provider, void *out, size_t *out_frames);
+
+/** Statistics of the filter bank cache shared by all resamplers in the process. */
+typedef struct {
+    uint64_t hits;          /**< creations which reused an existing filter bank. */
+    uint64_t misses;        /**< creations which had to compute a new filter bank. */
+    size_t tables;          /**< filter banks currently in use. */
+    size_t bytes;           /**< memory used by the filter banks currently in use. */
+} polyphase_resampler_cache_stats_t;
+
+/**
+ * \brief Returns the statistics of the filter bank cache.
+ *
+ * \param stats             filled in with the statistics, if NULL nothing happens.
+ */
+void polyphase_resampler_get_cache_stats(polyphase_resampler_cache_stats_t *stats);
+
+/** \cond */
+__END_DECLS
+/** \endcond */
+
+#endif // !ANDROID_AUDIO_POLYPHASE_RESAMPLER_H
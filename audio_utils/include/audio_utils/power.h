@@ -62,6 +62,37 @@ float audio_utils_compute_power_mono(const void *buffer, audio_format_t format,
 
 float audio_utils_compute_energy_mono(const void *buffer, audio_format_t format, size_t samples);
 
+/**
+ * \brief Signal statistics of one channel, see audio_utils_compute_channel_stats().
+ *
+ * The amplitudes are normalized to a full scale of 1.f, as for
+ * audio_utils_compute_energy_mono().
+ */
+typedef struct audio_utils_channel_stats {
+    float energy;            /**< sum of squared amplitudes. */
+    float peak;              /**< maximum absolute amplitude. */
+    float dc;                /**< mean amplitude, the DC offset. */
+    uint32_t zero_crossings; /**< number of sign changes between consecutive frames,
+                                  where zero counts as positive. */
+} audio_utils_channel_stats;
+
+/**
+ * \brief Compute the energy, peak, DC offset and zero crossings of each channel
+ *        of an interleaved buffer in a single pass.
+ *
+ * This is equivalent to calling audio_utils_compute_energy_mono() and the like
+ * on each deinterleaved channel, but reads the buffer only once.
+ * Zero crossings are counted within the buffer, not across consecutive calls.
+ *
+ *   \param buffer       buffer of interleaved frames.
+ *   \param format       one of the formats of audio_utils_compute_energy_mono().
+ *   \param frames       number of audio frames in buffer.
+ *   \param channelCount number of channels in each frame > 0.
+ *   \param stats        array of \p channelCount statistics, which are overwritten.
+ */
+void audio_utils_compute_channel_stats(const void *buffer, audio_format_t format,
+        size_t frames, size_t channelCount, audio_utils_channel_stats *stats);
+
 /**
  * \brief  Returns true if the format is supported for compute_energy_for_mono()
  *         and compute_power_for_mono().
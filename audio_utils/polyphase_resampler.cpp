@@ -0,0 +1,398 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// #define LOG_NDEBUG 0
+#define LOG_TAG "audio_utils_polyphase_resampler"
+#include <log/log.h>
+
+#include <algorithm>
+#include <errno.h>
+#include <math.h>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <numeric>
+#include <string.h>
+#include <vector>
+
+#include <audio_utils/polyphase_resampler.h>
+#include <audio_utils/primitives.h>
+
+namespace android {
+
+namespace {
+
+// Limits the size of a filter bank to kMaxPhases * taps floats.
+constexpr uint32_t kMaxPhases = 1024;
+
+// The filter bank for an upsampling factor L and a downsampling factor M.
+// Output frame n is computed from the input frames ending at floor(n * M / L)
+// with the coefficients of phase (n * M) % L.
+struct FilterBank {
+    uint32_t L;
+    uint32_t M;
+    uint32_t quality;
+    size_t taps;                // coefficients per phase, the filter length in input frames.
+    std::vector<float> coefs;   // L phases of taps coefficients, in input frame order.
+};
+
+// Zeroth order modified Bessel function of the first kind, for the Kaiser window.
+double besselI0(double x)
+{
+    double sum = 1.;
+    double term = 1.;
+    for (int k = 1; k < 64 && term > sum * 1e-12; ++k) {
+        const double y = x / (2 * k);
+        term *= y * y;
+        sum += term;
+    }
+    return sum;
+}
+
+std::shared_ptr<const FilterBank> designFilterBank(uint32_t L, uint32_t M, uint32_t quality)
+{
+    auto bank = std::make_shared<FilterBank>();
+    bank->L = L;
+    bank->M = M;
+    bank->quality = quality;
+    bank->taps = 8 + 8 * quality;
+    bank->coefs.resize(L * bank->taps);
+
+    // Cutoff relative to the input Nyquist frequency, lowered when downsampling.
+    const double cutoff = (0.85 + 0.012 * quality) * std::min(1., (double)L / M);
+    const double beta = 4. + 0.6 * quality;
+    const double i0beta = besselI0(beta);
+    const double half = bank->taps / 2.;
+    for (uint32_t p = 0; p < L; ++p) {
+        float *h = &bank->coefs[p * bank->taps];
+        double sum = 0.;
+        for (size_t j = 0; j < bank->taps; ++j) {
+            // time in input frames from the tap to the output instant, delayed by half.
+            const double t = (double)p / L + half - 1 - j;
+            const double x = M_PI * cutoff * t;
+            const double sinc = x == 0. ? 1. : sin(x) / x;
+            const double r = t / half;
+            const double window = besselI0(beta * sqrt(std::max(0., 1. - r * r))) / i0beta;
+            h[j] = cutoff * sinc * window;
+            sum += h[j];
+        }
+        // unity gain at DC for every phase.
+        for (size_t j = 0; j < bank->taps; ++j) {
+            h[j] /= sum;
+        }
+    }
+    return bank;
+}
+
+// Filter banks are shared by all resamplers with the same (L, M, quality), and freed
+// when the last one is destroyed.  The filter bank doesn't depend on the channel count.
+std::mutex gFilterBankLock;
+std::vector<std::weak_ptr<const FilterBank>> gFilterBanks; // GUARDED_BY(gFilterBankLock)
+uint64_t gFilterBankHits;                                   // GUARDED_BY(gFilterBankLock)
+uint64_t gFilterBankMisses;                                 // GUARDED_BY(gFilterBankLock)
+
+void pruneFilterBanks_l()
+{
+    gFilterBanks.erase(std::remove_if(gFilterBanks.begin(), gFilterBanks.end(),
+            [](const auto& bank) { return bank.expired(); }), gFilterBanks.end());
+}
+
+std::shared_ptr<const FilterBank> getFilterBank(uint32_t L, uint32_t M, uint32_t quality)
+{
+    // The design is done with the lock held, so concurrent creation of
+    // resamplers with the same parameters computes the filter bank only once.
+    std::lock_guard<std::mutex> lock(gFilterBankLock);
+    pruneFilterBanks_l();
+    for (const auto& weak : gFilterBanks) {
+        auto bank = weak.lock();
+        if (bank != nullptr && bank->L == L && bank->M == M && bank->quality == quality) {
+            ++gFilterBankHits;
+            return bank;
+        }
+    }
+    ++gFilterBankMisses;
+    auto bank = designFilterBank(L, M, quality);
+    gFilterBanks.push_back(bank);
+    return bank;
+}
+
+// Dot product of the taps input frames x with h, for each channel.
+// Q8.23 input is filtered as integer valued floats.
+template <typename T>
+inline void filter(float *acc, const T *x, const float *h, size_t taps, uint32_t channels)
+{
+    if (channels == 1) {
+        // independent partial sums so the adds can overlap.
+        float a0 = 0.f, a1 = 0.f, a2 = 0.f, a3 = 0.f;
+        for (size_t j = 0; j < taps; j += 4) { // taps is a multiple of 8.
+            a0 += h[j] * x[j];
+            a1 += h[j + 1] * x[j + 1];
+            a2 += h[j + 2] * x[j + 2];
+            a3 += h[j + 3] * x[j + 3];
+        }
+        acc[0] = (a0 + a1) + (a2 + a3);
+    } else if (channels == 2) {
+        float l = 0.f, r = 0.f;
+        for (size_t j = 0; j < taps; ++j) {
+            l += h[j] * x[j * 2];
+            r += h[j] * x[j * 2 + 1];
+        }
+        acc[0] = l;
+        acc[1] = r;
+    } else {
+        std::fill(acc, acc + channels, 0.f);
+        for (size_t j = 0; j < taps; ++j) {
+            for (uint32_t c = 0; c < channels; ++c) {
+                acc[c] += h[j] * x[j * channels + c];
+            }
+        }
+    }
+}
+
+inline void store(float *out, const float *acc, uint32_t channels)
+{
+    memcpy(out, acc, channels * sizeof(float));
+}
+
+inline void store(int32_t *out, const float *acc, uint32_t channels)
+{
+    for (uint32_t c = 0; c < channels; ++c) {
+        out[c] = clamp24_from_float(acc[c] * (1.f / (1 << 23)));
+    }
+}
+
+} // namespace
+
+class PolyphaseResampler {
+public:
+    PolyphaseResampler(uint32_t inSampleRate, uint32_t channelCount,
+            std::shared_ptr<const FilterBank> bank)
+        : mInSampleRate(inSampleRate)
+        , mChannelCount(channelCount)
+        , mBank(std::move(bank))
+        , mStep(mBank->M / mBank->L)
+        , mStepRemainder(mBank->M % mBank->L)
+        , mAcc(channelCount) {}
+
+    virtual ~PolyphaseResampler() = default;
+
+    virtual void reset() = 0;
+
+    // Returns the number of input frames consumed and sets *produced to the number of
+    // output frames written.
+    virtual size_t process(const void *in, size_t inFrames,
+            void *out, size_t outFrames, size_t *produced) = 0;
+
+    int32_t delayNs() const {
+        return (int32_t)(1000000000LL * (mBank->taps / 2) / mInSampleRate);
+    }
+
+    size_t frameSize() const { return mChannelCount * sizeof(float); } // also Q8.23.
+
+    // Input frames to request for outFrames more output frames.
+    size_t framesNeeded(size_t outFrames) const {
+        return (outFrames * mBank->M + mPhase) / mBank->L + mNext + 1;
+    }
+
+protected:
+    const uint32_t mInSampleRate;
+    const uint32_t mChannelCount;
+    const std::shared_ptr<const FilterBank> mBank;
+    const size_t mStep;             // M / L, whole input frames per output frame.
+    const uint32_t mStepRemainder;  // M % L, phase increment per output frame.
+    std::vector<float> mAcc;        // one output frame before conversion.
+
+    uint32_t mPhase = 0;            // phase of the next output frame.
+    size_t mNext = 0;               // last input frame of the next output's window,
+                                    // relative to the start of the next input buffer.
+};
+
+template <typename T>
+class PolyphaseResamplerT : public PolyphaseResampler {
+public:
+    PolyphaseResamplerT(uint32_t inSampleRate, uint32_t channelCount,
+            std::shared_ptr<const FilterBank> bank)
+        : PolyphaseResampler(inSampleRate, channelCount, std::move(bank))
+        , mSeam(2 * (mBank->taps - 1) * channelCount) {}
+
+    void reset() override {
+        std::fill(mSeam.begin(), mSeam.end(), T{});
+        mPhase = 0;
+        mNext = 0;
+    }
+
+    size_t process(const void *input, size_t inFrames,
+            void *output, size_t outFrames, size_t *produced) override {
+        const T *in = (const T *)input;
+        T *out = (T *)output;
+        const size_t taps = mBank->taps;
+        const size_t history = taps - 1;
+        const uint32_t channels = mChannelCount;
+
+        // The seam holds the history followed by the start of the input, so windows
+        // straddling the two are contiguous.  Other windows are read in place.
+        memcpy(&mSeam[history * channels], in,
+                std::min(inFrames, history) * channels * sizeof(T));
+
+        size_t n = 0;
+        for (; mNext < inFrames && n < outFrames; ++n) {
+            const T *x = mNext < history
+                    ? &mSeam[mNext * channels] : in + (mNext - history) * channels;
+            filter(mAcc.data(), x, &mBank->coefs[mPhase * taps], taps, channels);
+            store(out + n * channels, mAcc.data(), channels);
+            mNext += mStep;
+            mPhase += mStepRemainder;
+            if (mPhase >= mBank->L) {
+                mPhase -= mBank->L;
+                ++mNext;
+            }
+        }
+
+        // Keep the history frames preceding the first frame not consumed.
+        const size_t consumed = std::min(mNext, inFrames);
+        if (consumed >= history) {
+            memcpy(&mSeam[0], in + (consumed - history) * channels,
+                    history * channels * sizeof(T));
+        } else {
+            memmove(&mSeam[0], &mSeam[consumed * channels], history * channels * sizeof(T));
+        }
+        mNext -= consumed;
+        *produced = n;
+        return consumed;
+    }
+
+private:
+    std::vector<T> mSeam;           // 2 * (taps - 1) frames.
+};
+
+} // namespace android
+
+using android::PolyphaseResampler;
+
+polyphase_resampler_t *polyphase_resampler_create(uint32_t in_sample_rate,
+        uint32_t out_sample_rate, uint32_t channel_count, audio_format_t format,
+        uint32_t quality)
+{
+    if (in_sample_rate == 0 || out_sample_rate == 0 || channel_count == 0
+            || quality <= RESAMPLER_QUALITY_MIN || quality >= RESAMPLER_QUALITY_MAX) {
+        return nullptr;
+    }
+    const uint32_t gcd = std::gcd(in_sample_rate, out_sample_rate);
+    const uint32_t L = out_sample_rate / gcd;
+    const uint32_t M = in_sample_rate / gcd;
+    if (L > android::kMaxPhases) {
+        ALOGW("%s: unsupported ratio %u / %u", __func__, out_sample_rate, in_sample_rate);
+        return nullptr;
+    }
+
+    PolyphaseResampler *resampler;
+    switch (format) {
+    case AUDIO_FORMAT_PCM_FLOAT:
+        resampler = new(std::nothrow) android::PolyphaseResamplerT<float>(
+                in_sample_rate, channel_count, android::getFilterBank(L, M, quality));
+        break;
+    case AUDIO_FORMAT_PCM_8_24_BIT:
+        resampler = new(std::nothrow) android::PolyphaseResamplerT<int32_t>(
+                in_sample_rate, channel_count, android::getFilterBank(L, M, quality));
+        break;
+    default:
+        return nullptr;
+    }
+    if (resampler != nullptr) {
+        resampler->reset();
+    }
+    return reinterpret_cast<polyphase_resampler_t *>(resampler);
+}
+
+void polyphase_resampler_destroy(polyphase_resampler_t *resampler)
+{
+    delete reinterpret_cast<PolyphaseResampler *>(resampler);
+}
+
+void polyphase_resampler_reset(polyphase_resampler_t *resampler)
+{
+    if (resampler == nullptr) {
+        return;
+    }
+    reinterpret_cast<PolyphaseResampler *>(resampler)->reset();
+}
+
+int32_t polyphase_resampler_delay_ns(polyphase_resampler_t *resampler)
+{
+    if (resampler == nullptr) {
+        return 0;
+    }
+    return reinterpret_cast<PolyphaseResampler *>(resampler)->delayNs();
+}
+
+void polyphase_resampler_get_cache_stats(polyphase_resampler_cache_stats_t *stats)
+{
+    if (stats == nullptr) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(android::gFilterBankLock);
+    android::pruneFilterBanks_l();
+    stats->hits = android::gFilterBankHits;
+    stats->misses = android::gFilterBankMisses;
+    stats->tables = 0;
+    stats->bytes = 0;
+    for (const auto& weak : android::gFilterBanks) {
+        auto bank = weak.lock();
+        if (bank != nullptr) {
+            ++stats->tables;
+            stats->bytes += sizeof(*bank) + bank->coefs.capacity() * sizeof(float);
+        }
+    }
+}
+
+int polyphase_resampler_resample_from_input(polyphase_resampler_t *resampler,
+        const void *in, size_t *in_frames, void *out, size_t *out_frames)
+{
+    if (resampler == nullptr || in == nullptr || in_frames == nullptr
+            || out == nullptr || out_frames == nullptr) {
+        return -EINVAL;
+    }
+    *in_frames = reinterpret_cast<PolyphaseResampler *>(resampler)->process(
+            in, *in_frames, out, *out_frames, out_frames);
+    return 0;
+}
+
+int polyphase_resampler_resample_from_provider(polyphase_resampler_t *resampler,
+        struct resampler_buffer_provider *provider, void *out, size_t *out_frames)
+{
+    if (resampler == nullptr || provider == nullptr || out == nullptr || out_frames == nullptr) {
+        return -EINVAL;
+    }
+    PolyphaseResampler *rsmp = reinterpret_cast<PolyphaseResampler *>(resampler);
+    const size_t frameSize = rsmp->frameSize();
+    size_t written = 0;
+    while (written < *out_frames) {
+        struct resampler_buffer buf;
+        buf.raw = nullptr;
+        buf.frame_count = rsmp->framesNeeded(*out_frames - written);
+        provider->get_next_buffer(provider, &buf);
+        if (buf.raw == nullptr || buf.frame_count == 0) {
+            break;
+        }
+        size_t produced;
+        buf.frame_count = rsmp->process(buf.raw, buf.frame_count,
+                (uint8_t *)out + written * frameSize, *out_frames - written, &produced);
+        provider->release_buffer(provider, &buf);
+        written += produced;
+    }
+    *out_frames = written;
+    return 0;
+}
@@ -20,13 +20,19 @@
 
 #include <algorithm>
 #include <math.h>
+#include <numeric>
+#include <string.h>
 
+#include <audio_utils/intrinsic_utils.h>
 #include <audio_utils/power.h>
 #include <audio_utils/primitives.h>
 
 #if defined(__aarch64__) || defined(__ARM_NEON__)
 #include <arm_neon.h>
 #define USE_NEON
+#elif defined(__SSE2__)
+#include <immintrin.h>
+#define USE_SSE
 #endif
 
 namespace {
@@ -135,8 +141,13 @@ inline float energyMono(const void *amplitudes, size_t size)
     return energyMonoRef<FORMAT>(amplitudes, size);
 }
 
-// fast float power computation for ARM processors that support NEON.
-#ifdef USE_NEON
+// fast float power computation for ARM processors that support NEON
+// and x86 processors that support SSE2.
+#if defined(USE_NEON) || defined(USE_SSE)
+
+#if defined(USE_NEON)
+
+using float_x4_t = float32x4_t;
 
 template <typename T>
 float32x4_t convertToFloatVectorAmplitude(T vamplitude) = delete;
@@ -157,6 +168,39 @@ float32x4_t convertToFloatVectorAmplitude<int32x4_t>(int32x4_t vamplitude) {
     return vcvtq_f32_s32(vamplitude);
 }
 
+#else // USE_SSE
+
+using float_x4_t = __m128;
+
+// SSE has no 64 bit integer vector type with element access, so we define one for int16 x 4.
+struct alignas(8) int16x4_t {
+    int16_t v[4];
+};
+using int32x4_t = __m128i;
+
+template <typename T>
+__m128 convertToFloatVectorAmplitude(T vamplitude) = delete;
+
+template <>
+__m128 convertToFloatVectorAmplitude<__m128>(__m128 vamplitude) {
+    return vamplitude;
+}
+
+template <>
+__m128 convertToFloatVectorAmplitude<int16x4_t>(int16x4_t vamplitude) {
+    const __m128i samples = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(vamplitude.v));
+    // expand s16 to s32 first, by placing in the upper half and arithmetic shifting down.
+    const __m128i iamplitude = _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16);
+    return _mm_cvtepi32_ps(iamplitude);
+}
+
+template <>
+__m128 convertToFloatVectorAmplitude<__m128i>(__m128i vamplitude) {
+    return _mm_cvtepi32_ps(vamplitude);
+}
+
+#endif // USE_SSE
+
 template <typename Vector, typename Scalar>
 inline float energyMonoVector(const void *amplitudes, size_t size)
 {
@@ -182,21 +226,17 @@ inline float energyMonoVector(const void *amplitudes, size_t size)
     const Vector *vamplitudes = reinterpret_cast<const Vector *>(samplitudes);
 
     // clear vector accumulator
-    float32x4_t accum = vdupq_n_f32(0);
+    float_x4_t accum = android::audio_utils::intrinsics::vdupn<float_x4_t>(0.f);
 
     // iterate over array getting sum of squares in vectorLength lanes.
     size_t i;
     for (i = 0; i < size - size % vectorLength /* compiler optimized */; i += vectorLength) {
-        const float32x4_t famplitude = convertToFloatVectorAmplitude(*vamplitudes++);
-        accum = vmlaq_f32(accum, famplitude, famplitude);
+        const float_x4_t famplitude = convertToFloatVectorAmplitude(*vamplitudes++);
+        accum = android::audio_utils::intrinsics::vmla(accum, famplitude, famplitude);
     }
 
-    // narrow vectorLength lanes of floats
-    float32x2_t accum2 = vadd_f32(vget_low_f32(accum), vget_high_f32(accum)); // get stereo volume
-    accum2 = vpadd_f32(accum2, accum2); // combine to mono
-
-    // accumulate vector
-    accumulator += vget_lane_f32(accum2, 0);
+    // narrow vectorLength lanes of floats and accumulate vector
+    accumulator += android::audio_utils::intrinsics::vaddv(accum);
 
     // accumulate any trailing elements too small for vector size
     for (; i < size; ++i) {
@@ -209,7 +249,7 @@ inline float energyMonoVector(const void *amplitudes, size_t size)
 template <>
 inline float energyMono<AUDIO_FORMAT_PCM_FLOAT>(const void *amplitudes, size_t size)
 {
-    return energyMonoVector<float32x4_t, float>(amplitudes, size);
+    return energyMonoVector<float_x4_t, float>(amplitudes, size);
 }
 
 template <>
@@ -235,7 +275,275 @@ inline float energyMono<AUDIO_FORMAT_PCM_8_24_BIT>(const void *amplitudes, size_
             * normalizeEnergy<AUDIO_FORMAT_PCM_8_24_BIT>();
 }
 
-#endif // USE_NEON
+#endif // USE_NEON || USE_SSE
+
+// returns the normalized amplitude of the sample at index.
+template <audio_format_t FORMAT>
+inline float amplitudeAt(const void *buffer, size_t index)
+{
+    const void *sample = reinterpret_cast<const uint8_t *>(buffer)
+            + index * audio_bytes_per_sample(FORMAT);
+    return convertToFloatAndIncrement<FORMAT>(&sample);
+}
+
+// Accumulates the statistics of channels [channelStart, channelEnd) over
+// frames [frameStart, frameEnd) into stats, with the dc field holding the sum of amplitudes.
+template <audio_format_t FORMAT>
+inline void channelStatsRef(const void *buffer, size_t frameStart, size_t frameEnd,
+        size_t channelCount, size_t channelStart, size_t channelEnd,
+        audio_utils_channel_stats *stats)
+{
+    for (size_t i = frameStart; i < frameEnd; ++i) {
+        for (size_t j = channelStart; j < channelEnd; ++j) {
+            const size_t index = i * channelCount + j;
+            const float amplitude = amplitudeAt<FORMAT>(buffer, index);
+            audio_utils_channel_stats &channel = stats[j];
+            channel.energy += amplitude * amplitude;
+            channel.peak = std::max(channel.peak, fabsf(amplitude));
+            channel.dc += amplitude;
+            if (i > 0 && (amplitude < 0.f)
+                    != (amplitudeAt<FORMAT>(buffer, index - channelCount) < 0.f)) {
+                ++channel.zero_crossings;
+            }
+        }
+    }
+}
+
+#if defined(USE_NEON) || defined(USE_SSE)
+
+#if defined(USE_NEON)
+
+using count_x4_t = uint32x4_t;
+
+inline float32x4_t absVector(float32x4_t x) {
+    return vabsq_f32(x);
+}
+
+inline float32x4_t maxVector(float32x4_t a, float32x4_t b) {
+    return vmaxq_f32(a, b);
+}
+
+// adds 1 to the lanes where x and previous differ in sign, counting zero as positive.
+inline uint32x4_t addZeroCrossings(uint32x4_t count, float32x4_t x, float32x4_t previous) {
+    const float32x4_t zero = vdupq_n_f32(0.f);
+    // a true comparison is all ones, or -1.
+    return vsubq_u32(count, veorq_u32(vcltq_f32(x, zero), vcltq_f32(previous, zero)));
+}
+
+inline uint32x4_t zeroCounts() {
+    return vdupq_n_u32(0);
+}
+
+inline void storeCounts(uint32_t *counts, uint32x4_t count) {
+    vst1q_u32(counts, count);
+}
+
+inline int16x4_t loadInt16x4(const void *samples) {
+    return vld1_s16(reinterpret_cast<const int16_t *>(samples));
+}
+
+inline int32x4_t loadInt32x4(const void *samples) {
+    return vld1q_s32(reinterpret_cast<const int32_t *>(samples));
+}
+
+#else // USE_SSE
+
+using count_x4_t = __m128i;
+
+inline __m128 absVector(__m128 x) {
+    return _mm_andnot_ps(_mm_set1_ps(-0.f), x);
+}
+
+inline __m128 maxVector(__m128 a, __m128 b) {
+    return _mm_max_ps(a, b);
+}
+
+// adds 1 to the lanes where x and previous differ in sign, counting zero as positive.
+inline __m128i addZeroCrossings(__m128i count, __m128 x, __m128 previous) {
+    const __m128 zero = _mm_setzero_ps();
+    // a true comparison is all ones, or -1.
+    return _mm_sub_epi32(count, _mm_castps_si128(
+            _mm_xor_ps(_mm_cmplt_ps(x, zero), _mm_cmplt_ps(previous, zero))));
+}
+
+inline __m128i zeroCounts() {
+    return _mm_setzero_si128();
+}
+
+inline void storeCounts(uint32_t *counts, __m128i count) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(counts), count);
+}
+
+inline int16x4_t loadInt16x4(const void *samples) {
+    int16x4_t vsamples;
+    memcpy(vsamples.v, samples, sizeof(vsamples.v));
+    return vsamples;
+}
+
+inline __m128i loadInt32x4(const void *samples) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(samples));
+}
+
+#endif // USE_SSE
+
+// returns the normalized amplitudes of the 4 consecutive samples starting at index.
+// The samples need only be aligned to the sample type.
+template <audio_format_t FORMAT>
+inline float_x4_t amplitudesAt(const void *buffer, size_t index)
+{
+    using namespace android::audio_utils::intrinsics;
+    const uint8_t *samples = reinterpret_cast<const uint8_t *>(buffer)
+            + index * audio_bytes_per_sample(FORMAT);
+    if constexpr (FORMAT == AUDIO_FORMAT_PCM_FLOAT) {
+        return vld1<float_x4_t>(reinterpret_cast<const float *>(samples));
+    } else if constexpr (FORMAT == AUDIO_FORMAT_PCM_16_BIT) {
+        return vmul(convertToFloatVectorAmplitude(loadInt16x4(samples)),
+                vdupn<float_x4_t>(normalizeAmplitude<FORMAT>()));
+    } else if constexpr (FORMAT == AUDIO_FORMAT_PCM_32_BIT
+            || FORMAT == AUDIO_FORMAT_PCM_8_24_BIT) {
+        return vmul(convertToFloatVectorAmplitude(loadInt32x4(samples)),
+                vdupn<float_x4_t>(normalizeAmplitude<FORMAT>()));
+    } else {
+        float amplitudes[4];
+        for (size_t i = 0; i < 4; ++i) {
+            amplitudes[i] = amplitudeAt<FORMAT>(buffer, index + i);
+        }
+        return vld1<float_x4_t>(amplitudes);
+    }
+}
+
+// The statistics accumulated in the lanes of a vector.
+class ChannelStatsVector {
+public:
+    static constexpr size_t kLanes = sizeof(float_x4_t) / sizeof(float);
+
+    ChannelStatsVector()
+        : mEnergy(android::audio_utils::intrinsics::vdupn<float_x4_t>(0.f))
+        , mPeak(mEnergy)
+        , mSum(mEnergy)
+        , mZeroCrossings(zeroCounts()) {}
+
+    void add(float_x4_t amplitude, float_x4_t previous) {
+        using namespace android::audio_utils::intrinsics;
+        mEnergy = vmla(mEnergy, amplitude, amplitude);
+        mPeak = maxVector(mPeak, absVector(amplitude));
+        mSum = vadd(mSum, amplitude);
+        mZeroCrossings = addZeroCrossings(mZeroCrossings, amplitude, previous);
+    }
+
+    // accumulates lane i into stats[(offset + i) % channelCount].
+    void addTo(audio_utils_channel_stats *stats, size_t channelCount, size_t offset) const {
+        float energy[kLanes], peak[kLanes], sum[kLanes];
+        uint32_t zeroCrossings[kLanes];
+        android::audio_utils::intrinsics::vst1(energy, mEnergy);
+        android::audio_utils::intrinsics::vst1(peak, mPeak);
+        android::audio_utils::intrinsics::vst1(sum, mSum);
+        storeCounts(zeroCrossings, mZeroCrossings);
+        for (size_t i = 0; i < kLanes; ++i) {
+            audio_utils_channel_stats &channel = stats[(offset + i) % channelCount];
+            channel.energy += energy[i];
+            channel.peak = std::max(channel.peak, peak[i]);
+            channel.dc += sum[i];
+            channel.zero_crossings += zeroCrossings[i];
+        }
+    }
+
+private:
+    float_x4_t mEnergy;
+    float_x4_t mPeak;
+    float_x4_t mSum;
+    count_x4_t mZeroCrossings;
+};
+
+constexpr size_t kMaxAccumulators = 32;
+
+// Accumulates the frames from frame 1 in whole cycles through the accumulators,
+// and returns the index of the first sample not accumulated.
+// ACCUMULATORS is the number of accumulators if known at compile time, so that they may be
+// kept in registers, or 0 to use the accumulators parameter.
+template <audio_format_t FORMAT, size_t ACCUMULATORS>
+inline size_t channelStatsVectorAccumulate(const void *buffer, size_t frames,
+        size_t channelCount, size_t accumulators, audio_utils_channel_stats *stats)
+{
+    constexpr size_t kLanes = ChannelStatsVector::kLanes;
+    if constexpr (ACCUMULATORS != 0) {
+        accumulators = ACCUMULATORS;
+    }
+    ChannelStatsVector accumulator[ACCUMULATORS != 0 ? ACCUMULATORS : kMaxAccumulators];
+    const size_t period = accumulators * kLanes;
+    const size_t samples = frames * channelCount;
+    size_t i = channelCount;
+    for (; i + period <= samples; i += period) {
+        for (size_t j = 0; j < accumulators; ++j) {
+            const size_t index = i + j * kLanes;
+            accumulator[j].add(amplitudesAt<FORMAT>(buffer, index),
+                    amplitudesAt<FORMAT>(buffer, index - channelCount));
+        }
+    }
+    for (size_t j = 0; j < accumulators; ++j) {
+        accumulator[j].addTo(stats, channelCount, j * kLanes);
+    }
+    return i;
+}
+
+// The vectors hold consecutive samples, so a channel may be in any lane of a vector.
+// There are enough accumulators that a whole number of frames is accumulated each cycle
+// through them, so each lane of each accumulator holds a single channel.
+// Each vector is compared with the samples one frame earlier for zero crossings,
+// which are loaded again rather than shuffled, as they are in L1 cache.
+template <audio_format_t FORMAT>
+inline void channelStatsVector(const void *buffer, size_t frames, size_t channelCount,
+        audio_utils_channel_stats *stats)
+{
+    constexpr size_t kLanes = ChannelStatsVector::kLanes;
+    // at least 4 accumulators to hide the latency of the additions.
+    constexpr size_t kMinAccumulators = 4;
+
+    // the number of vectors for a whole number of frames is lcm(kLanes, channelCount) / kLanes.
+    size_t accumulators = channelCount / std::gcd(channelCount, kLanes);
+    accumulators *= (kMinAccumulators + accumulators - 1) / accumulators;
+    if (accumulators > kMaxAccumulators) { // an unusually large and odd channel count.
+        channelStatsRef<FORMAT>(buffer, 0, frames, channelCount, 0, channelCount, stats);
+        return;
+    }
+
+    // the first frame has no previous frame.
+    channelStatsRef<FORMAT>(buffer, 0, std::min(frames, (size_t)1),
+            channelCount, 0, channelCount, stats);
+    if (frames <= 1) return;
+
+    size_t i;
+    switch (accumulators) {
+    case 4: // 1, 2, 4, 8, 16 channels.
+        i = channelStatsVectorAccumulate<FORMAT, 4>(
+                buffer, frames, channelCount, accumulators, stats);
+        break;
+    case 6: // 3, 6, 12, 24 channels.
+        i = channelStatsVectorAccumulate<FORMAT, 6>(
+                buffer, frames, channelCount, accumulators, stats);
+        break;
+    default:
+        i = channelStatsVectorAccumulate<FORMAT, 0>(
+                buffer, frames, channelCount, accumulators, stats);
+        break;
+    }
+    // the remaining frames, fewer than the frames in a cycle through the accumulators.
+    channelStatsRef<FORMAT>(buffer, i / channelCount, frames,
+            channelCount, 0, channelCount, stats);
+}
+
+#endif // USE_NEON || USE_SSE
+
+template <audio_format_t FORMAT>
+inline void channelStats(const void *buffer, size_t frames, size_t channelCount,
+        audio_utils_channel_stats *stats)
+{
+#if defined(USE_NEON) || defined(USE_SSE)
+    channelStatsVector<FORMAT>(buffer, frames, channelCount, stats);
+#else
+    channelStatsRef<FORMAT>(buffer, 0, frames, channelCount, 0, channelCount, stats);
+#endif
+}
 
 } // namespace
 
@@ -271,6 +579,46 @@ float audio_utils_compute_power_mono(const void *buffer, audio_format_t format,
             audio_utils_compute_energy_mono(buffer, format, samples) / samples);
 }
 
+void audio_utils_compute_channel_stats(const void *buffer, audio_format_t format,
+        size_t frames, size_t channelCount, audio_utils_channel_stats *stats)
+{
+    LOG_ALWAYS_FATAL_IF(channelCount == 0, "invalid channelCount: %zu", channelCount);
+    memset(stats, 0, channelCount * sizeof(*stats));
+    switch (format) {
+    case AUDIO_FORMAT_PCM_8_BIT:
+        channelStats<AUDIO_FORMAT_PCM_8_BIT>(buffer, frames, channelCount, stats);
+        break;
+
+    case AUDIO_FORMAT_PCM_16_BIT:
+        channelStats<AUDIO_FORMAT_PCM_16_BIT>(buffer, frames, channelCount, stats);
+        break;
+
+    case AUDIO_FORMAT_PCM_24_BIT_PACKED:
+        channelStats<AUDIO_FORMAT_PCM_24_BIT_PACKED>(buffer, frames, channelCount, stats);
+        break;
+
+    case AUDIO_FORMAT_PCM_8_24_BIT:
+        channelStats<AUDIO_FORMAT_PCM_8_24_BIT>(buffer, frames, channelCount, stats);
+        break;
+
+    case AUDIO_FORMAT_PCM_32_BIT:
+        channelStats<AUDIO_FORMAT_PCM_32_BIT>(buffer, frames, channelCount, stats);
+        break;
+
+    case AUDIO_FORMAT_PCM_FLOAT:
+        channelStats<AUDIO_FORMAT_PCM_FLOAT>(buffer, frames, channelCount, stats);
+        break;
+
+    default:
+        LOG_ALWAYS_FATAL("invalid format: %#x", format);
+    }
+    if (frames > 0) {
+        for (size_t i = 0; i < channelCount; ++i) {
+            stats[i].dc /= frames;
+        }
+    }
+}
+
 bool audio_utils_is_compute_power_format_supported(audio_format_t format)
 {
     return isFormatSupported(format);
@@ -16,6 +16,7 @@
 
 #include <audio_utils/primitives.h>
 #include <string.h>
+#include "private/primitives_simd.h"
 #include "private/private.h"
 
 void ditherAndClamp(int32_t *out, const int32_t *sums, size_t pairs)
@@ -83,20 +84,30 @@ void memcpy_to_u8_from_float(uint8_t *dst, const float *src, size_t count)
     }
 }
 
-void memcpy_to_i16_from_i32(int16_t *dst, const int32_t *src, size_t count)
+void memcpy_to_i16_from_i32_ref(int16_t *dst, const int32_t *src, size_t count)
 {
     for (; count > 0; --count) {
         *dst++ = *src++ >> 16;
     }
 }
 
-void memcpy_to_i16_from_float(int16_t *dst, const float *src, size_t count)
+void memcpy_to_i16_from_i32(int16_t *dst, const int32_t *src, size_t count)
+{
+    primitives_simd.memcpy_to_i16_from_i32(dst, src, count);
+}
+
+void memcpy_to_i16_from_float_ref(int16_t *dst, const float *src, size_t count)
 {
     for (; count > 0; --count) {
         *dst++ = clamp16_from_float(*src++);
     }
 }
 
+void memcpy_to_i16_from_float(int16_t *dst, const float *src, size_t count)
+{
+    primitives_simd.memcpy_to_i16_from_float(dst, src, count);
+}
+
 void memcpy_to_float_from_q4_27(float *dst, const int32_t *src, size_t count)
 {
     for (; count > 0; --count) {
@@ -104,7 +115,7 @@ void memcpy_to_float_from_q4_27(float *dst, const int32_t *src, size_t count)
     }
 }
 
-void memcpy_to_float_from_i16(float *dst, const int16_t *src, size_t count)
+void memcpy_to_float_from_i16_ref(float *dst, const int16_t *src, size_t count)
 {
     dst += count;
     src += count;
@@ -113,6 +124,11 @@ void memcpy_to_float_from_i16(float *dst, const int16_t *src, size_t count)
     }
 }
 
+void memcpy_to_float_from_i16(float *dst, const int16_t *src, size_t count)
+{
+    primitives_simd.memcpy_to_float_from_i16(dst, src, count);
+}
+
 void memcpy_to_float_from_u8(float *dst, const uint8_t *src, size_t count)
 {
     dst += count;
@@ -122,7 +138,7 @@ void memcpy_to_float_from_u8(float *dst, const uint8_t *src, size_t count)
     }
 }
 
-void memcpy_to_float_from_p24(float *dst, const uint8_t *src, size_t count)
+void memcpy_to_float_from_p24_ref(float *dst, const uint8_t *src, size_t count)
 {
     dst += count;
     src += count * 3;
@@ -132,6 +148,11 @@ void memcpy_to_float_from_p24(float *dst, const uint8_t *src, size_t count)
     }
 }
 
+void memcpy_to_float_from_p24(float *dst, const uint8_t *src, size_t count)
+{
+    primitives_simd.memcpy_to_float_from_p24(dst, src, count);
+}
+
 void memcpy_to_i16_from_p24(int16_t *dst, const uint8_t *src, size_t count)
 {
     for (; count > 0; --count) {
@@ -144,7 +165,7 @@ void memcpy_to_i16_from_p24(int16_t *dst, const uint8_t *src, size_t count)
     }
 }
 
-void memcpy_to_i32_from_p24(int32_t *dst, const uint8_t *src, size_t count)
+void memcpy_to_i32_from_p24_ref(int32_t *dst, const uint8_t *src, size_t count)
 {
     dst += count;
     src += count * 3;
@@ -158,6 +179,11 @@ void memcpy_to_i32_from_p24(int32_t *dst, const uint8_t *src, size_t count)
     }
 }
 
+void memcpy_to_i32_from_p24(int32_t *dst, const uint8_t *src, size_t count)
+{
+    primitives_simd.memcpy_to_i32_from_p24(dst, src, count);
+}
+
 void memcpy_to_p24_from_i16(uint8_t *dst, const int16_t *src, size_t count)
 {
     dst += count * 3;
@@ -177,7 +203,7 @@ void memcpy_to_p24_from_i16(uint8_t *dst, const int16_t *src, size_t count)
     }
 }
 
-void memcpy_to_p24_from_float(uint8_t *dst, const float *src, size_t count)
+void memcpy_to_p24_from_float_ref(uint8_t *dst, const float *src, size_t count)
 {
     for (; count > 0; --count) {
         int32_t ival = clamp24_from_float(*src++);
@@ -194,6 +220,11 @@ void memcpy_to_p24_from_float(uint8_t *dst, const float *src, size_t count)
     }
 }
 
+void memcpy_to_p24_from_float(uint8_t *dst, const float *src, size_t count)
+{
+    primitives_simd.memcpy_to_p24_from_float(dst, src, count);
+}
+
 void memcpy_to_p24_from_q8_23(uint8_t *dst, const int32_t *src, size_t count)
 {
     for (; count > 0; --count) {
@@ -211,7 +242,7 @@ void memcpy_to_p24_from_q8_23(uint8_t *dst, const int32_t *src, size_t count)
     }
 }
 
-void memcpy_to_p24_from_i32(uint8_t *dst, const int32_t *src, size_t count)
+void memcpy_to_p24_from_i32_ref(uint8_t *dst, const int32_t *src, size_t count)
 {
     for (; count > 0; --count) {
         int32_t ival = *src++ >> 8;
@@ -228,7 +259,12 @@ void memcpy_to_p24_from_i32(uint8_t *dst, const int32_t *src, size_t count)
     }
 }
 
-void memcpy_to_q8_23_from_i16(int32_t *dst, const int16_t *src, size_t count)
+void memcpy_to_p24_from_i32(uint8_t *dst, const int32_t *src, size_t count)
+{
+    primitives_simd.memcpy_to_p24_from_i32(dst, src, count);
+}
+
+void memcpy_to_q8_23_from_i16_ref(int32_t *dst, const int16_t *src, size_t count)
 {
     dst += count;
     src += count;
@@ -237,13 +273,23 @@ void memcpy_to_q8_23_from_i16(int32_t *dst, const int16_t *src, size_t count)
     }
 }
 
-void memcpy_to_q8_23_from_float_with_clamp(int32_t *dst, const float *src, size_t count)
+void memcpy_to_q8_23_from_i16(int32_t *dst, const int16_t *src, size_t count)
+{
+    primitives_simd.memcpy_to_q8_23_from_i16(dst, src, count);
+}
+
+void memcpy_to_q8_23_from_float_with_clamp_ref(int32_t *dst, const float *src, size_t count)
 {
     for (; count > 0; --count) {
         *dst++ = clamp24_from_float(*src++);
     }
 }
 
+void memcpy_to_q8_23_from_float_with_clamp(int32_t *dst, const float *src, size_t count)
+{
+    primitives_simd.memcpy_to_q8_23_from_float_with_clamp(dst, src, count);
+}
+
 void memcpy_to_q8_23_from_p24(int32_t *dst, const uint8_t *src, size_t count)
 {
     dst += count;
@@ -265,20 +311,30 @@ void memcpy_to_q4_27_from_float(int32_t *dst, const float *src, size_t count)
     }
 }
 
-void memcpy_to_i16_from_q8_23(int16_t *dst, const int32_t *src, size_t count)
+void memcpy_to_i16_from_q8_23_ref(int16_t *dst, const int32_t *src, size_t count)
 {
     for (; count > 0; --count) {
         *dst++ = clamp16(*src++ >> 8);
     }
 }
 
-void memcpy_to_float_from_q8_23(float *dst, const int32_t *src, size_t count)
+void memcpy_to_i16_from_q8_23(int16_t *dst, const int32_t *src, size_t count)
+{
+    primitives_simd.memcpy_to_i16_from_q8_23(dst, src, count);
+}
+
+void memcpy_to_float_from_q8_23_ref(float *dst, const int32_t *src, size_t count)
 {
     for (; count > 0; --count) {
         *dst++ = float_from_q8_23(*src++);
     }
 }
 
+void memcpy_to_float_from_q8_23(float *dst, const int32_t *src, size_t count)
+{
+    primitives_simd.memcpy_to_float_from_q8_23(dst, src, count);
+}
+
 void memcpy_to_i32_from_u8(int32_t *dst, const uint8_t *src, size_t count)
 {
     dst += count;
@@ -288,7 +344,7 @@ void memcpy_to_i32_from_u8(int32_t *dst, const uint8_t *src, size_t count)
     }
 }
 
-void memcpy_to_i32_from_i16(int32_t *dst, const int16_t *src, size_t count)
+void memcpy_to_i32_from_i16_ref(int32_t *dst, const int16_t *src, size_t count)
 {
     dst += count;
     src += count;
@@ -297,20 +353,35 @@ void memcpy_to_i32_from_i16(int32_t *dst, const int16_t *src, size_t count)
     }
 }
 
-void memcpy_to_i32_from_float(int32_t *dst, const float *src, size_t count)
+void memcpy_to_i32_from_i16(int32_t *dst, const int16_t *src, size_t count)
+{
+    primitives_simd.memcpy_to_i32_from_i16(dst, src, count);
+}
+
+void memcpy_to_i32_from_float_ref(int32_t *dst, const float *src, size_t count)
 {
     for (; count > 0; --count) {
         *dst++ = clamp32_from_float(*src++);
     }
 }
 
-void memcpy_to_float_from_i32(float *dst, const int32_t *src, size_t count)
+void memcpy_to_i32_from_float(int32_t *dst, const float *src, size_t count)
+{
+    primitives_simd.memcpy_to_i32_from_float(dst, src, count);
+}
+
+void memcpy_to_float_from_i32_ref(float *dst, const int32_t *src, size_t count)
 {
     for (; count > 0; --count) {
         *dst++ = float_from_i32(*src++);
     }
 }
 
+void memcpy_to_float_from_i32(float *dst, const int32_t *src, size_t count)
+{
+    primitives_simd.memcpy_to_float_from_i32(dst, src, count);
+}
+
 void memcpy_to_float_from_float_with_clamping(float *dst, const float *src, size_t count,
                                               float absMax) {
     // Note: using NEON intrinsics (vminq_f32, vld1q_f32...) did NOT accelerate
@@ -605,7 +676,7 @@ void accumulate_u8(uint8_t *dst, const uint8_t *src, size_t count) {
     }
 }
 
-void accumulate_p24(uint8_t *dst, const uint8_t *src, size_t count) {
+void accumulate_p24_ref(uint8_t *dst, const uint8_t *src, size_t count) {
     for (; count > 0; --count) {
         // Unpack.
         int32_t dst_q8_23 = 0;
@@ -623,6 +694,10 @@ void accumulate_p24(uint8_t *dst, const uint8_t *src, size_t count) {
   }
 }
 
+void accumulate_p24(uint8_t *dst, const uint8_t *src, size_t count) {
+    primitives_simd.accumulate_p24(dst, src, count);
+}
+
 void accumulate_q8_23(int32_t *dst, const int32_t *src, size_t count) {
     for (; count > 0; --count) {
         *dst = clamp24_from_q8_23(*dst + *src++);
@@ -0,0 +1,947 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <audio_utils/primitives.h>
+#include "private/primitives_simd.h"
+
+/*
+ * Vectorized sample format conversions.
+ *
+ * Each kernel processes whole vectors, then finishes the remaining samples with the
+ * same per-sample inline conversion (e.g. clamp16_from_float()) as the scalar reference,
+ * or the reference itself for the packed 24 bit formats, so results are bit-exact.
+ * The vectors are loaded before they are stored, and the loop direction matches
+ * the reference, so in-place conversion is preserved.
+ *
+ * The float to integer conversions in primitives.h round half away from zero (roundf).
+ * SSE/AVX convert with round to nearest even (the default MXCSR mode), so we correct
+ * the ties, see round_away_sse2(). aarch64 has a native round away conversion (FCVTAS);
+ * on 32 bit ARM those conversions stay scalar.
+ *
+ * Packed 24 bit samples are unpacked 16 at a time (48 bytes, 3 full vectors) to the
+ * Q0.31 layout of i32_from_p24(), where the 3 bytes occupy the upper 24 bits of each
+ * 32 bit lane, using a byte shuffle (PSHUFB) on x86 or the deinterleaving VLD3 on ARM;
+ * packing is the inverse.  Reading and writing whole 48 byte blocks avoids touching
+ * memory past the end of the buffer.  These kernels assume a little endian layout.
+ */
+
+#if defined(__ARM_NEON__) || defined(__aarch64__)
+#include <arm_neon.h>
+#define USE_NEON
+#elif defined(__SSE2__)
+#include <immintrin.h>
+#define USE_SSE2
+#define USE_SSE4_1 // compiled with a target attribute and selected at runtime.
+#define USE_AVX2   // compiled with a target attribute and selected at runtime.
+#endif
+
+#ifdef USE_SSE2
+
+// Rounds to nearest, ties away from 0, for |x| < 2^31.
+static inline __m128i round_away_sse2(__m128 x)
+{
+    const __m128i r = _mm_cvtps_epi32(x);  // ties to even.
+    const __m128 diff = _mm_sub_ps(x, _mm_cvtepi32_ps(r));
+    const __m128 signbit = _mm_and_ps(x, _mm_set1_ps(-0.f));
+    // a tie that was rounded towards 0 has diff == copysign(0.5, x).
+    const __m128i tie = _mm_castps_si128(
+            _mm_cmpeq_ps(diff, _mm_or_ps(signbit, _mm_set1_ps(0.5f))));
+    // sign is -1 for negative x, 1 otherwise.
+    const __m128i sign = _mm_or_si128(
+            _mm_srai_epi32(_mm_castps_si128(x), 31), _mm_set1_epi32(1));
+    return _mm_add_epi32(r, _mm_and_si128(tie, sign));
+}
+
+// Same as roundf(fmaxf(fminf(x, hi), lo)), including the fminf treatment of NaN.
+static inline __m128i clamp_round_sse2(__m128 x, __m128 lo, __m128 hi)
+{
+    // _mm_min_ps returns the second operand if either is NaN.
+    return round_away_sse2(_mm_max_ps(_mm_min_ps(x, hi), lo));
+}
+
+static void memcpy_to_i16_from_float_sse2(int16_t *dst, const float *src, size_t count)
+{
+    const __m128 scale = _mm_set1_ps(1 << 15);
+    const __m128 lo = _mm_set1_ps(-(1 << 15));
+    const __m128 hi = _mm_set1_ps((1 << 15) - 1);
+    for (; count >= 8; count -= 8) {
+        const __m128i a = clamp_round_sse2(_mm_mul_ps(_mm_loadu_ps(src), scale), lo, hi);
+        const __m128i b = clamp_round_sse2(_mm_mul_ps(_mm_loadu_ps(src + 4), scale), lo, hi);
+        _mm_storeu_si128((__m128i *)dst, _mm_packs_epi32(a, b));
+        src += 8;
+        dst += 8;
+    }
+    for (; count > 0; --count) {
+        *dst++ = clamp16_from_float(*src++);
+    }
+}
+
+static void memcpy_to_i16_from_i32_sse2(int16_t *dst, const int32_t *src, size_t count)
+{
+    for (; count >= 8; count -= 8) {
+        const __m128i a = _mm_srai_epi32(_mm_loadu_si128((const __m128i *)src), 16);
+        const __m128i b = _mm_srai_epi32(_mm_loadu_si128((const __m128i *)(src + 4)), 16);
+        _mm_storeu_si128((__m128i *)dst, _mm_packs_epi32(a, b));
+        src += 8;
+        dst += 8;
+    }
+    for (; count > 0; --count) {
+        *dst++ = *src++ >> 16;
+    }
+}
+
+static void memcpy_to_i16_from_q8_23_sse2(int16_t *dst, const int32_t *src, size_t count)
+{
+    for (; count >= 8; count -= 8) {
+        const __m128i a = _mm_srai_epi32(_mm_loadu_si128((const __m128i *)src), 8);
+        const __m128i b = _mm_srai_epi32(_mm_loadu_si128((const __m128i *)(src + 4)), 8);
+        _mm_storeu_si128((__m128i *)dst, _mm_packs_epi32(a, b));  // saturates as clamp16().
+        src += 8;
+        dst += 8;
+    }
+    for (; count > 0; --count) {
+        *dst++ = clamp16(*src++ >> 8);
+    }
+}
+
+static void memcpy_to_float_from_i16_sse2(float *dst, const int16_t *src, size_t count)
+{
+    const __m128 scale = _mm_set1_ps(1.f / (1 << 15));
+    dst += count;
+    src += count;
+    for (; count >= 8; count -= 8) {
+        src -= 8;
+        dst -= 8;
+        const __m128i v = _mm_loadu_si128((const __m128i *)src);
+        // sign extend by placing in the upper half and arithmetic shifting down.
+        const __m128i a = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        const __m128i b = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(dst, _mm_mul_ps(_mm_cvtepi32_ps(a), scale));
+        _mm_storeu_ps(dst + 4, _mm_mul_ps(_mm_cvtepi32_ps(b), scale));
+    }
+    for (; count > 0; --count) {
+        *--dst = float_from_i16(*--src);
+    }
+}
+
+static void memcpy_to_float_from_i32_sse2(float *dst, const int32_t *src, size_t count)
+{
+    const __m128 scale = _mm_set1_ps(1.f / (1UL << 31));
+    for (; count >= 4; count -= 4) {
+        const __m128i v = _mm_loadu_si128((const __m128i *)src);
+        _mm_storeu_ps(dst, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+        src += 4;
+        dst += 4;
+    }
+    for (; count > 0; --count) {
+        *dst++ = float_from_i32(*src++);
+    }
+}
+
+static void memcpy_to_float_from_q8_23_sse2(float *dst, const int32_t *src, size_t count)
+{
+    const __m128 scale = _mm_set1_ps(1.f / (1 << 23));
+    for (; count >= 4; count -= 4) {
+        const __m128i v = _mm_loadu_si128((const __m128i *)src);
+        _mm_storeu_ps(dst, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+        src += 4;
+        dst += 4;
+    }
+    for (; count > 0; --count) {
+        *dst++ = float_from_q8_23(*src++);
+    }
+}
+
+static void memcpy_to_i32_from_i16_sse2(int32_t *dst, const int16_t *src, size_t count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    dst += count;
+    src += count;
+    for (; count >= 8; count -= 8) {
+        src -= 8;
+        dst -= 8;
+        const __m128i v = _mm_loadu_si128((const __m128i *)src);
+        _mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi16(zero, v));
+        _mm_storeu_si128((__m128i *)(dst + 4), _mm_unpackhi_epi16(zero, v));
+    }
+    for (; count > 0; --count) {
+        *--dst = (int32_t)*--src << 16;
+    }
+}
+
+static void memcpy_to_i32_from_float_sse2(int32_t *dst, const float *src, size_t count)
+{
+    const __m128 scale = _mm_set1_ps(1UL << 31);
+    const __m128 limneg = _mm_set1_ps(-1.f);
+    const __m128 limpos = _mm_set1_ps(1.f);
+    const __m128i intmin = _mm_set1_epi32(INT32_MIN);
+    const __m128i intmax = _mm_set1_epi32(INT32_MAX);
+    for (; count >= 4; count -= 4) {
+        const __m128 f = _mm_loadu_ps(src);
+        const __m128i r = round_away_sse2(_mm_mul_ps(f, scale));
+        const __m128i neg = _mm_castps_si128(_mm_cmple_ps(f, limneg));
+        const __m128i pos = _mm_castps_si128(_mm_cmpge_ps(f, limpos));
+        const __m128i clamped = _mm_or_si128(
+                _mm_andnot_si128(_mm_or_si128(neg, pos), r),
+                _mm_or_si128(_mm_and_si128(neg, intmin), _mm_and_si128(pos, intmax)));
+        _mm_storeu_si128((__m128i *)dst, clamped);
+        src += 4;
+        dst += 4;
+    }
+    for (; count > 0; --count) {
+        *dst++ = clamp32_from_float(*src++);
+    }
+}
+
+static void memcpy_to_q8_23_from_i16_sse2(int32_t *dst, const int16_t *src, size_t count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    dst += count;
+    src += count;
+    for (; count >= 8; count -= 8) {
+        src -= 8;
+        dst -= 8;
+        const __m128i v = _mm_loadu_si128((const __m128i *)src);
+        _mm_storeu_si128((__m128i *)dst, _mm_srai_epi32(_mm_unpacklo_epi16(zero, v), 8));
+        _mm_storeu_si128((__m128i *)(dst + 4), _mm_srai_epi32(_mm_unpackhi_epi16(zero, v), 8));
+    }
+    for (; count > 0; --count) {
+        *--dst = (int32_t)*--src << 8;
+    }
+}
+
+static void memcpy_to_q8_23_from_float_with_clamp_sse2(
+        int32_t *dst, const float *src, size_t count)
+{
+    const __m128 scale = _mm_set1_ps(1 << 23);
+    const __m128 lo = _mm_set1_ps(-(1 << 23));
+    const __m128 hi = _mm_set1_ps((1 << 23) - 1);
+    for (; count >= 4; count -= 4) {
+        const __m128i v = clamp_round_sse2(_mm_mul_ps(_mm_loadu_ps(src), scale), lo, hi);
+        _mm_storeu_si128((__m128i *)dst, v);
+        src += 4;
+        dst += 4;
+    }
+    for (; count > 0; --count) {
+        *dst++ = clamp24_from_float(*src++);
+    }
+}
+
+#endif // USE_SSE2
+
+#ifdef USE_AVX2
+
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+AVX2_TARGET
+static inline __m256i round_away_avx2(__m256 x)
+{
+    const __m256i r = _mm256_cvtps_epi32(x);  // ties to even.
+    const __m256 diff = _mm256_sub_ps(x, _mm256_cvtepi32_ps(r));
+    const __m256 signbit = _mm256_and_ps(x, _mm256_set1_ps(-0.f));
+    const __m256i tie = _mm256_castps_si256(_mm256_cmp_ps(
+            diff, _mm256_or_ps(signbit, _mm256_set1_ps(0.5f)), _CMP_EQ_OQ));
+    const __m256i sign = _mm256_or_si256(
+            _mm256_srai_epi32(_mm256_castps_si256(x), 31), _mm256_set1_epi32(1));
+    return _mm256_add_epi32(r, _mm256_and_si256(tie, sign));
+}
+
+AVX2_TARGET
+static inline __m256i clamp_round_avx2(__m256 x, __m256 lo, __m256 hi)
+{
+    return round_away_avx2(_mm256_max_ps(_mm256_min_ps(x, hi), lo));
+}
+
+// Packs 8 int32 to 8 int16 with signed saturation.
+AVX2_TARGET
+static inline __m128i packs_epi32_avx2(__m256i v)
+{
+    return _mm_packs_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+}
+
+AVX2_TARGET
+static void memcpy_to_i16_from_float_avx2(int16_t *dst, const float *src, size_t count)
+{
+    const __m256 scale = _mm256_set1_ps(1 << 15);
+    const __m256 lo = _mm256_set1_ps(-(1 << 15));
+    const __m256 hi = _mm256_set1_ps((1 << 15) - 1);
+    for (; count >= 8; count -= 8) {
+        const __m256i v = clamp_round_avx2(_mm256_mul_ps(_mm256_loadu_ps(src), scale), lo, hi);
+        _mm_storeu_si128((__m128i *)dst, packs_epi32_avx2(v));
+        src += 8;
+        dst += 8;
+    }
+    for (; count > 0; --count) {
+        *dst++ = clamp16_from_float(*src++);
+    }
+}
+
+AVX2_TARGET
+static void memcpy_to_i16_from_i32_avx2(int16_t *dst, const int32_t *src, size_t count)
+{
+    for (; count >= 8; count -= 8) {
+        const __m256i v = _mm256_srai_epi32(_mm256_loadu_si256((const __m256i *)src), 16);
+        _mm_storeu_si128((__m128i *)dst, packs_epi32_avx2(v));
+        src += 8;
+        dst += 8;
+    }
+    for (; count > 0; --count) {
+        *dst++ = *src++ >> 16;
+    }
+}
+
+AVX2_TARGET
+static void memcpy_to_i16_from_q8_23_avx2(int16_t *dst, const int32_t *src, size_t count)
+{
+    for (; count >= 8; count -= 8) {
+        const __m256i v = _mm256_srai_epi32(_mm256_loadu_si256((const __m256i *)src), 8);
+        _mm_storeu_si128((__m128i *)dst, packs_epi32_avx2(v));
+        src += 8;
+        dst += 8;
+    }
+    for (; count > 0; --count) {
+        *dst++ = clamp16(*src++ >> 8);
+    }
+}
+
+AVX2_TARGET
+static void memcpy_to_float_from_i16_avx2(float *dst, const int16_t *src, size_t count)
+{
+    const __m256 scale = _mm256_set1_ps(1.f / (1 << 15));
+    dst += count;
+    src += count;
+    for (; count >= 8; count -= 8) {
+        src -= 8;
+        dst -= 8;
+        const __m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)src));
+        _mm256_storeu_ps(dst, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+    }
+    for (; count > 0; --count) {
+        *--dst = float_from_i16(*--src);
+    }
+}
+
+AVX2_TARGET
+static void memcpy_to_float_from_i32_avx2(float *dst, const int32_t *src, size_t count)
+{
+    const __m256 scale = _mm256_set1_ps(1.f / (1UL << 31));
+    for (; count >= 8; count -= 8) {
+        const __m256i v = _mm256_loadu_si256((const __m256i *)src);
+        _mm256_storeu_ps(dst, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+        src += 8;
+        dst += 8;
+    }
+    for (; count > 0; --count) {
+        *dst++ = float_from_i32(*src++);
+    }
+}
+
+AVX2_TARGET
+static void memcpy_to_float_from_q8_23_avx2(float *dst, const int32_t *src, size_t count)
+{
+    const __m256 scale = _mm256_set1_ps(1.f / (1 << 23));
+    for (; count >= 8; count -= 8) {
+        const __m256i v = _mm256_loadu_si256((const __m256i *)src);
+        _mm256_storeu_ps(dst, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+        src += 8;
+        dst += 8;
+    }
+    for (; count > 0; --count) {
+        *dst++ = float_from_q8_23(*src++);
+    }
+}
+
+AVX2_TARGET
+static void memcpy_to_i32_from_i16_avx2(int32_t *dst, const int16_t *src, size_t count)
+{
+    dst += count;
+    src += count;
+    for (; count >= 8; count -= 8) {
+        src -= 8;
+        dst -= 8;
+        const __m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)src));
+        _mm256_storeu_si256((__m256i *)dst, _mm256_slli_epi32(v, 16));
+    }
+    for (; count > 0; --count) {
+        *--dst = (int32_t)*--src << 16;
+    }
+}
+
+AVX2_TARGET
+static void memcpy_to_i32_from_float_avx2(int32_t *dst, const float *src, size_t count)
+{
+    const __m256 scale = _mm256_set1_ps(1UL << 31);
+    const __m256 limneg = _mm256_set1_ps(-1.f);
+    const __m256 limpos = _mm256_set1_ps(1.f);
+    const __m256i intmin = _mm256_set1_epi32(INT32_MIN);
+    const __m256i intmax = _mm256_set1_epi32(INT32_MAX);
+    for (; count >= 8; count -= 8) {
+        const __m256 f = _mm256_loadu_ps(src);
+        __m256i r = round_away_avx2(_mm256_mul_ps(f, scale));
+        r = _mm256_blendv_epi8(r, intmin,
+                _mm256_castps_si256(_mm256_cmp_ps(f, limneg, _CMP_LE_OQ)));
+        r = _mm256_blendv_epi8(r, intmax,
+                _mm256_castps_si256(_mm256_cmp_ps(f, limpos, _CMP_GE_OQ)));
+        _mm256_storeu_si256((__m256i *)dst, r);
+        src += 8;
+        dst += 8;
+    }
+    for (; count > 0; --count) {
+        *dst++ = clamp32_from_float(*src++);
+    }
+}
+
+AVX2_TARGET
+static void memcpy_to_q8_23_from_i16_avx2(int32_t *dst, const int16_t *src, size_t count)
+{
+    dst += count;
+    src += count;
+    for (; count >= 8; count -= 8) {
+        src -= 8;
+        dst -= 8;
+        const __m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)src));
+        _mm256_storeu_si256((__m256i *)dst, _mm256_slli_epi32(v, 8));
+    }
+    for (; count > 0; --count) {
+        *--dst = (int32_t)*--src << 8;
+    }
+}
+
+AVX2_TARGET
+static void memcpy_to_q8_23_from_float_with_clamp_avx2(
+        int32_t *dst, const float *src, size_t count)
+{
+    const __m256 scale = _mm256_set1_ps(1 << 23);
+    const __m256 lo = _mm256_set1_ps(-(1 << 23));
+    const __m256 hi = _mm256_set1_ps((1 << 23) - 1);
+    for (; count >= 8; count -= 8) {
+        const __m256i v = clamp_round_avx2(_mm256_mul_ps(_mm256_loadu_ps(src), scale), lo, hi);
+        _mm256_storeu_si256((__m256i *)dst, v);
+        src += 8;
+        dst += 8;
+    }
+    for (; count > 0; --count) {
+        *dst++ = clamp24_from_float(*src++);
+    }
+}
+
+#undef AVX2_TARGET
+
+#endif // USE_AVX2
+
+#ifdef USE_SSE4_1
+
+#define SSE4_1_TARGET __attribute__((target("sse4.1")))
+
+// Unpacks 16 packed 24 bit samples (48 bytes) to 4 vectors of Q0.31, as i32_from_p24().
+SSE4_1_TARGET
+static inline void unpack_p24_sse4_1(const uint8_t *src, __m128i v[4])
+{
+    // byte 0 of each lane is zero, bytes 1..3 are the packed sample.
+    const __m128i mask = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+    const __m128i a = _mm_loadu_si128((const __m128i *)src);
+    const __m128i b = _mm_loadu_si128((const __m128i *)(src + 16));
+    const __m128i c = _mm_loadu_si128((const __m128i *)(src + 32));
+    v[0] = _mm_shuffle_epi8(a, mask);                          // bytes 0..11
+    v[1] = _mm_shuffle_epi8(_mm_alignr_epi8(b, a, 12), mask);  // bytes 12..23
+    v[2] = _mm_shuffle_epi8(_mm_alignr_epi8(c, b, 8), mask);   // bytes 24..35
+    v[3] = _mm_shuffle_epi8(_mm_srli_si128(c, 4), mask);       // bytes 36..47
+}
+
+// Packs the upper 24 bits of 4 vectors of 32 bit samples to 16 packed 24 bit samples.
+SSE4_1_TARGET
+static inline void pack_p24_sse4_1(uint8_t *dst, const __m128i v[4])
+{
+    const __m128i mask = _mm_setr_epi8(1, 2, 3, 5, 6, 7, 9, 10, 11, 13, 14, 15, -1, -1, -1, -1);
+    const __m128i a = _mm_shuffle_epi8(v[0], mask);  // 12 bytes each.
+    const __m128i b = _mm_shuffle_epi8(v[1], mask);
+    const __m128i c = _mm_shuffle_epi8(v[2], mask);
+    const __m128i d = _mm_shuffle_epi8(v[3], mask);
+    _mm_storeu_si128((__m128i *)dst, _mm_or_si128(a, _mm_slli_si128(b, 12)));
+    _mm_storeu_si128((__m128i *)(dst + 16),
+            _mm_or_si128(_mm_srli_si128(b, 4), _mm_slli_si128(c, 8)));
+    _mm_storeu_si128((__m128i *)(dst + 32),
+            _mm_or_si128(_mm_srli_si128(c, 8), _mm_slli_si128(d, 4)));
+}
+
+SSE4_1_TARGET
+static void memcpy_to_float_from_p24_sse4_1(float *dst, const uint8_t *src, size_t count)
+{
+    const __m128 scale = _mm_set1_ps(1.f / (1UL << 31));
+    dst += count;
+    src += count * 3;
+    for (; count >= 16; count -= 16) {
+        src -= 48;
+        dst -= 16;
+        __m128i v[4];
+        unpack_p24_sse4_1(src, v);
+        for (int i = 0; i < 4; ++i) {
+            _mm_storeu_ps(dst + i * 4, _mm_mul_ps(_mm_cvtepi32_ps(v[i]), scale));
+        }
+    }
+    memcpy_to_float_from_p24_ref(dst - count, src - count * 3, count);
+}
+
+SSE4_1_TARGET
+static void memcpy_to_i32_from_p24_sse4_1(int32_t *dst, const uint8_t *src, size_t count)
+{
+    dst += count;
+    src += count * 3;
+    for (; count >= 16; count -= 16) {
+        src -= 48;
+        dst -= 16;
+        __m128i v[4];
+        unpack_p24_sse4_1(src, v);
+        for (int i = 0; i < 4; ++i) {
+            _mm_storeu_si128((__m128i *)(dst + i * 4), v[i]);
+        }
+    }
+    memcpy_to_i32_from_p24_ref(dst - count, src - count * 3, count);
+}
+
+SSE4_1_TARGET
+static void memcpy_to_p24_from_float_sse4_1(uint8_t *dst, const float *src, size_t count)
+{
+    const __m128 scale = _mm_set1_ps(1 << 23);
+    const __m128 lo = _mm_set1_ps(-(1 << 23));
+    const __m128 hi = _mm_set1_ps((1 << 23) - 1);
+    for (; count >= 16; count -= 16) {
+        __m128i v[4];
+        for (int i = 0; i < 4; ++i) {
+            v[i] = _mm_slli_epi32(clamp_round_sse2(
+                    _mm_mul_ps(_mm_loadu_ps(src + i * 4), scale), lo, hi), 8);
+        }
+        pack_p24_sse4_1(dst, v);
+        src += 16;
+        dst += 48;
+    }
+    memcpy_to_p24_from_float_ref(dst, src, count);
+}
+
+SSE4_1_TARGET
+static void memcpy_to_p24_from_i32_sse4_1(uint8_t *dst, const int32_t *src, size_t count)
+{
+    for (; count >= 16; count -= 16) {
+        __m128i v[4];
+        for (int i = 0; i < 4; ++i) {
+            v[i] = _mm_loadu_si128((const __m128i *)(src + i * 4));
+        }
+        pack_p24_sse4_1(dst, v);
+        src += 16;
+        dst += 48;
+    }
+    memcpy_to_p24_from_i32_ref(dst, src, count);
+}
+
+SSE4_1_TARGET
+static void accumulate_p24_sse4_1(uint8_t *dst, const uint8_t *src, size_t count)
+{
+    const __m128i lo = _mm_set1_epi32(-0x800000);
+    const __m128i hi = _mm_set1_epi32(0x7fffff);
+    for (; count >= 16; count -= 16) {
+        __m128i a[4], b[4];
+        unpack_p24_sse4_1(dst, a);
+        unpack_p24_sse4_1(src, b);
+        for (int i = 0; i < 4; ++i) {
+            // sum as Q8.23 and clamp, as clamp24_from_q8_23().
+            const __m128i sum = _mm_add_epi32(_mm_srai_epi32(a[i], 8), _mm_srai_epi32(b[i], 8));
+            a[i] = _mm_slli_epi32(_mm_max_epi32(_mm_min_epi32(sum, hi), lo), 8);
+        }
+        pack_p24_sse4_1(dst, a);
+        src += 48;
+        dst += 48;
+    }
+    accumulate_p24_ref(dst, src, count);
+}
+
+#undef SSE4_1_TARGET
+
+#endif // USE_SSE4_1
+
+#ifdef USE_NEON
+
+#if defined(__aarch64__)
+
+// Same as roundf(fmaxf(fminf(x, hi), lo)).
+// FMINNM/FMAXNM return the number if the other operand is NaN, as fminf/fmaxf.
+static inline int32x4_t clamp_round_neon(float32x4_t x, float32x4_t lo, float32x4_t hi)
+{
+    return vcvtaq_s32_f32(vmaxnmq_f32(vminnmq_f32(x, hi), lo));
+}
+
+static void memcpy_to_i16_from_float_neon(int16_t *dst, const float *src, size_t count)
+{
+    const float32x4_t scale = vdupq_n_f32(1 << 15);
+    const float32x4_t lo = vdupq_n_f32(-(1 << 15));
+    const float32x4_t hi = vdupq_n_f32((1 << 15) - 1);
+    for (; count >= 8; count -= 8) {
+        const int32x4_t a = clamp_round_neon(vmulq_f32(vld1q_f32(src), scale), lo, hi);
+        const int32x4_t b = clamp_round_neon(vmulq_f32(vld1q_f32(src + 4), scale), lo, hi);
+        vst1q_s16(dst, vcombine_s16(vmovn_s32(a), vmovn_s32(b)));
+        src += 8;
+        dst += 8;
+    }
+    for (; count > 0; --count) {
+        *dst++ = clamp16_from_float(*src++);
+    }
+}
+
+static void memcpy_to_i32_from_float_neon(int32_t *dst, const float *src, size_t count)
+{
+    const float32x4_t scale = vdupq_n_f32(1UL << 31);
+    for (; count >= 4; count -= 4) {
+        // FCVTAS saturates, which clamps [1.0, +inf] and [-inf, -1.0] as clamp32_from_float().
+        vst1q_s32(dst, vcvtaq_s32_f32(vmulq_f32(vld1q_f32(src), scale)));
+        src += 4;
+        dst += 4;
+    }
+    for (; count > 0; --count) {
+        *dst++ = clamp32_from_float(*src++);
+    }
+}
+
+static void memcpy_to_q8_23_from_float_with_clamp_neon(
+        int32_t *dst, const float *src, size_t count)
+{
+    const float32x4_t scale = vdupq_n_f32(1 << 23);
+    const float32x4_t lo = vdupq_n_f32(-(1 << 23));
+    const float32x4_t hi = vdupq_n_f32((1 << 23) - 1);
+    for (; count >= 4; count -= 4) {
+        vst1q_s32(dst, clamp_round_neon(vmulq_f32(vld1q_f32(src), scale), lo, hi));
+        src += 4;
+        dst += 4;
+    }
+    for (; count > 0; --count) {
+        *dst++ = clamp24_from_float(*src++);
+    }
+}
+
+#else // 32 bit ARM has no round away conversion.
+
+#define memcpy_to_i16_from_float_neon memcpy_to_i16_from_float_ref
+#define memcpy_to_i32_from_float_neon memcpy_to_i32_from_float_ref
+#define memcpy_to_q8_23_from_float_with_clamp_neon memcpy_to_q8_23_from_float_with_clamp_ref
+
+#endif // __aarch64__
+
+static void memcpy_to_i16_from_i32_neon(int16_t *dst, const int32_t *src, size_t count)
+{
+    for (; count >= 8; count -= 8) {
+        const int16x4_t a = vshrn_n_s32(vld1q_s32(src), 16);
+        const int16x4_t b = vshrn_n_s32(vld1q_s32(src + 4), 16);
+        vst1q_s16(dst, vcombine_s16(a, b));
+        src += 8;
+        dst += 8;
+    }
+    for (; count > 0; --count) {
+        *dst++ = *src++ >> 16;
+    }
+}
+
+static void memcpy_to_i16_from_q8_23_neon(int16_t *dst, const int32_t *src, size_t count)
+{
+    for (; count >= 8; count -= 8) {
+        const int16x4_t a = vqshrn_n_s32(vld1q_s32(src), 8);  // saturates as clamp16().
+        const int16x4_t b = vqshrn_n_s32(vld1q_s32(src + 4), 8);
+        vst1q_s16(dst, vcombine_s16(a, b));
+        src += 8;
+        dst += 8;
+    }
+    for (; count > 0; --count) {
+        *dst++ = clamp16(*src++ >> 8);
+    }
+}
+
+static void memcpy_to_float_from_i16_neon(float *dst, const int16_t *src, size_t count)
+{
+    const float32x4_t scale = vdupq_n_f32(1.f / (1 << 15));
+    dst += count;
+    src += count;
+    for (; count >= 8; count -= 8) {
+        src -= 8;
+        dst -= 8;
+        const int16x8_t v = vld1q_s16(src);
+        const int32x4_t a = vmovl_s16(vget_low_s16(v));
+        const int32x4_t b = vmovl_s16(vget_high_s16(v));
+        vst1q_f32(dst, vmulq_f32(vcvtq_f32_s32(a), scale));
+        vst1q_f32(dst + 4, vmulq_f32(vcvtq_f32_s32(b), scale));
+    }
+    for (; count > 0; --count) {
+        *--dst = float_from_i16(*--src);
+    }
+}
+
+static void memcpy_to_float_from_i32_neon(float *dst, const int32_t *src, size_t count)
+{
+    const float32x4_t scale = vdupq_n_f32(1.f / (1UL << 31));
+    for (; count >= 4; count -= 4) {
+        vst1q_f32(dst, vmulq_f32(vcvtq_f32_s32(vld1q_s32(src)), scale));
+        src += 4;
+        dst += 4;
+    }
+    for (; count > 0; --count) {
+        *dst++ = float_from_i32(*src++);
+    }
+}
+
+static void memcpy_to_float_from_q8_23_neon(float *dst, const int32_t *src, size_t count)
+{
+    const float32x4_t scale = vdupq_n_f32(1.f / (1 << 23));
+    for (; count >= 4; count -= 4) {
+        vst1q_f32(dst, vmulq_f32(vcvtq_f32_s32(vld1q_s32(src)), scale));
+        src += 4;
+        dst += 4;
+    }
+    for (; count > 0; --count) {
+        *dst++ = float_from_q8_23(*src++);
+    }
+}
+
+static void memcpy_to_i32_from_i16_neon(int32_t *dst, const int16_t *src, size_t count)
+{
+    dst += count;
+    src += count;
+    for (; count >= 8; count -= 8) {
+        src -= 8;
+        dst -= 8;
+        const int16x8_t v = vld1q_s16(src);
+        vst1q_s32(dst, vshll_n_s16(vget_low_s16(v), 16));
+        vst1q_s32(dst + 4, vshll_n_s16(vget_high_s16(v), 16));
+    }
+    for (; count > 0; --count) {
+        *--dst = (int32_t)*--src << 16;
+    }
+}
+
+static void memcpy_to_q8_23_from_i16_neon(int32_t *dst, const int16_t *src, size_t count)
+{
+    dst += count;
+    src += count;
+    for (; count >= 8; count -= 8) {
+        src -= 8;
+        dst -= 8;
+        const int16x8_t v = vld1q_s16(src);
+        vst1q_s32(dst, vshll_n_s16(vget_low_s16(v), 8));
+        vst1q_s32(dst + 4, vshll_n_s16(vget_high_s16(v), 8));
+    }
+    for (; count > 0; --count) {
+        *--dst = (int32_t)*--src << 8;
+    }
+}
+
+#if !HAVE_BIG_ENDIAN
+
+// Unpacks 16 packed 24 bit samples (48 bytes) to 4 vectors of Q0.31, as i32_from_p24().
+static inline void unpack_p24_neon(const uint8_t *src, int32x4_t v[4])
+{
+    const uint8x16x3_t b = vld3q_u8(src);  // byte 0, 1, 2 of each sample.
+    const uint8x16x2_t lo = vzipq_u8(vdupq_n_u8(0), b.val[0]);  // byte 0 << 8
+    const uint8x16x2_t hi = vzipq_u8(b.val[1], b.val[2]);       // byte 1 | byte 2 << 8
+    for (int i = 0; i < 2; ++i) {
+        const uint16x8x2_t w = vzipq_u16(
+                vreinterpretq_u16_u8(lo.val[i]), vreinterpretq_u16_u8(hi.val[i]));
+        v[i * 2] = vreinterpretq_s32_u16(w.val[0]);
+        v[i * 2 + 1] = vreinterpretq_s32_u16(w.val[1]);
+    }
+}
+
+// Packs the upper 24 bits of 4 vectors of 32 bit samples to 16 packed 24 bit samples.
+static inline void pack_p24_neon(uint8_t *dst, const int32x4_t v[4])
+{
+    const uint8x16x2_t a = vuzpq_u8(vreinterpretq_u8_s32(v[0]), vreinterpretq_u8_s32(v[1]));
+    const uint8x16x2_t b = vuzpq_u8(vreinterpretq_u8_s32(v[2]), vreinterpretq_u8_s32(v[3]));
+    const uint8x16x2_t even = vuzpq_u8(a.val[0], b.val[0]);  // byte 0, byte 2
+    const uint8x16x2_t odd = vuzpq_u8(a.val[1], b.val[1]);   // byte 1, byte 3
+    const uint8x16x3_t p = {{ odd.val[0], even.val[1], odd.val[1] }};
+    vst3q_u8(dst, p);
+}
+
+static void memcpy_to_float_from_p24_neon(float *dst, const uint8_t *src, size_t count)
+{
+    const float32x4_t scale = vdupq_n_f32(1.f / (1UL << 31));
+    dst += count;
+    src += count * 3;
+    for (; count >= 16; count -= 16) {
+        src -= 48;
+        dst -= 16;
+        int32x4_t v[4];
+        unpack_p24_neon(src, v);
+        for (int i = 0; i < 4; ++i) {
+            vst1q_f32(dst + i * 4, vmulq_f32(vcvtq_f32_s32(v[i]), scale));
+        }
+    }
+    memcpy_to_float_from_p24_ref(dst - count, src - count * 3, count);
+}
+
+static void memcpy_to_i32_from_p24_neon(int32_t *dst, const uint8_t *src, size_t count)
+{
+    const uint8x16_t zero = vdupq_n_u8(0);
+    dst += count;
+    src += count * 3;
+    for (; count >= 16; count -= 16) {
+        src -= 48;
+        dst -= 16;
+        const uint8x16x3_t b = vld3q_u8(src);
+        const uint8x16x4_t w = {{ zero, b.val[0], b.val[1], b.val[2] }};
+        vst4q_u8((uint8_t *)dst, w);  // interleaves to the upper 24 bits of each int32.
+    }
+    memcpy_to_i32_from_p24_ref(dst - count, src - count * 3, count);
+}
+
+#if defined(__aarch64__)
+static void memcpy_to_p24_from_float_neon(uint8_t *dst, const float *src, size_t count)
+{
+    const float32x4_t scale = vdupq_n_f32(1 << 23);
+    const float32x4_t lo = vdupq_n_f32(-(1 << 23));
+    const float32x4_t hi = vdupq_n_f32((1 << 23) - 1);
+    for (; count >= 16; count -= 16) {
+        int32x4_t v[4];
+        for (int i = 0; i < 4; ++i) {
+            v[i] = vshlq_n_s32(clamp_round_neon(
+                    vmulq_f32(vld1q_f32(src + i * 4), scale), lo, hi), 8);
+        }
+        pack_p24_neon(dst, v);
+        src += 16;
+        dst += 48;
+    }
+    memcpy_to_p24_from_float_ref(dst, src, count);
+}
+#else
+#define memcpy_to_p24_from_float_neon memcpy_to_p24_from_float_ref
+#endif // __aarch64__
+
+static void memcpy_to_p24_from_i32_neon(uint8_t *dst, const int32_t *src, size_t count)
+{
+    for (; count >= 16; count -= 16) {
+        const uint8x16x4_t b = vld4q_u8((const uint8_t *)src);  // byte 0..3 of each int32.
+        const uint8x16x3_t p = {{ b.val[1], b.val[2], b.val[3] }};
+        vst3q_u8(dst, p);
+        src += 16;
+        dst += 48;
+    }
+    memcpy_to_p24_from_i32_ref(dst, src, count);
+}
+
+static void accumulate_p24_neon(uint8_t *dst, const uint8_t *src, size_t count)
+{
+    for (; count >= 16; count -= 16) {
+        int32x4_t a[4], b[4];
+        unpack_p24_neon(dst, a);
+        unpack_p24_neon(src, b);
+        for (int i = 0; i < 4; ++i) {
+            // sum as Q8.23; the saturating shift back to Q0.31 clamps as clamp24_from_q8_23().
+            const int32x4_t sum = vaddq_s32(vshrq_n_s32(a[i], 8), vshrq_n_s32(b[i], 8));
+            a[i] = vqshlq_n_s32(sum, 8);
+        }
+        pack_p24_neon(dst, a);
+        src += 48;
+        dst += 48;
+    }
+    accumulate_p24_ref(dst, src, count);
+}
+
+#else // HAVE_BIG_ENDIAN
+
+#define memcpy_to_float_from_p24_neon memcpy_to_float_from_p24_ref
+#define memcpy_to_i32_from_p24_neon memcpy_to_i32_from_p24_ref
+#define memcpy_to_p24_from_float_neon memcpy_to_p24_from_float_ref
+#define memcpy_to_p24_from_i32_neon memcpy_to_p24_from_i32_ref
+#define accumulate_p24_neon accumulate_p24_ref
+
+#endif // HAVE_BIG_ENDIAN
+
+#endif // USE_NEON
+
+// SUFFIX selects the kernels for the sample formats, P24_SUFFIX for packed 24 bit.
+#define PRIMITIVES_SIMD_TABLE(NAME, SUFFIX, P24_SUFFIX) { \
+        .name = NAME, \
+        .memcpy_to_i16_from_float = memcpy_to_i16_from_float_##SUFFIX, \
+        .memcpy_to_i16_from_i32 = memcpy_to_i16_from_i32_##SUFFIX, \
+        .memcpy_to_i16_from_q8_23 = memcpy_to_i16_from_q8_23_##SUFFIX, \
+        .memcpy_to_float_from_i16 = memcpy_to_float_from_i16_##SUFFIX, \
+        .memcpy_to_float_from_i32 = memcpy_to_float_from_i32_##SUFFIX, \
+        .memcpy_to_float_from_q8_23 = memcpy_to_float_from_q8_23_##SUFFIX, \
+        .memcpy_to_i32_from_i16 = memcpy_to_i32_from_i16_##SUFFIX, \
+        .memcpy_to_i32_from_float = memcpy_to_i32_from_float_##SUFFIX, \
+        .memcpy_to_q8_23_from_i16 = memcpy_to_q8_23_from_i16_##SUFFIX, \
+        .memcpy_to_q8_23_from_float_with_clamp = \
+                memcpy_to_q8_23_from_float_with_clamp_##SUFFIX, \
+        .memcpy_to_float_from_p24 = memcpy_to_float_from_p24_##P24_SUFFIX, \
+        .memcpy_to_i32_from_p24 = memcpy_to_i32_from_p24_##P24_SUFFIX, \
+        .memcpy_to_p24_from_float = memcpy_to_p24_from_float_##P24_SUFFIX, \
+        .memcpy_to_p24_from_i32 = memcpy_to_p24_from_i32_##P24_SUFFIX, \
+        .accumulate_p24 = accumulate_p24_##P24_SUFFIX, \
+    }
+
+static const primitives_simd_t primitives_simd_ref = PRIMITIVES_SIMD_TABLE("scalar", ref, ref);
+
+#if defined(USE_NEON)
+#define PRIMITIVES_SIMD_DEFAULT_TABLE PRIMITIVES_SIMD_TABLE("neon", neon, neon)
+#elif defined(USE_SSE2)
+// SSE2 has no byte shuffle, packed 24 bit stays scalar until upgraded below.
+#define PRIMITIVES_SIMD_DEFAULT_TABLE PRIMITIVES_SIMD_TABLE("sse2", sse2, ref)
+#else
+#define PRIMITIVES_SIMD_DEFAULT_TABLE PRIMITIVES_SIMD_TABLE("scalar", ref, ref)
+#endif
+
+primitives_simd_t primitives_simd = PRIMITIVES_SIMD_DEFAULT_TABLE;
+
+#if defined(USE_NEON) || defined(USE_SSE2)
+static const primitives_simd_t primitives_simd_default = PRIMITIVES_SIMD_DEFAULT_TABLE;
+#endif
+
+#ifdef USE_AVX2
+static const primitives_simd_t primitives_simd_sse4_1 =
+        PRIMITIVES_SIMD_TABLE("sse4.1", sse2, sse4_1);
+// The packed 24 bit shuffles don't cross 128 bit lanes, so reuse the SSE4.1 kernels.
+static const primitives_simd_t primitives_simd_avx2 =
+        PRIMITIVES_SIMD_TABLE("avx2", avx2, sse4_1);
+
+// Runs at library load, before any other thread can use the table.
+// Until then (e.g. from another library constructor) the SSE2 table is used.
+__attribute__((constructor))
+static void primitives_simd_init(void)
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        primitives_simd = primitives_simd_avx2;
+    } else if (__builtin_cpu_supports("sse4.1")) {
+        primitives_simd = primitives_simd_sse4_1;
+    }
+}
+#endif // USE_AVX2
+
+size_t primitives_simd_get_tables(const primitives_simd_t *tables[PRIMITIVES_SIMD_MAX_TABLES])
+{
+    size_t count = 0;
+    tables[count++] = &primitives_simd_ref;
+#if defined(USE_NEON) || defined(USE_SSE2)
+    tables[count++] = &primitives_simd_default;
+#endif
+#ifdef USE_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.1")) {
+        tables[count++] = &primitives_simd_sse4_1;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        tables[count++] = &primitives_simd_avx2;
+    }
+#endif
+    return count;
+}
+
+#undef PRIMITIVES_SIMD_DEFAULT_TABLE
+#undef PRIMITIVES_SIMD_TABLE
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_AUDIO_PRIMITIVES_SIMD_H
+#define ANDROID_AUDIO_PRIMITIVES_SIMD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/cdefs.h>
+
+__BEGIN_DECLS
+
+/* Nothing here is exported from the library: the kernels are reached through the public
+ * memcpy_to_* functions of primitives.h, and tests link the library statically.
+ */
+#pragma GCC visibility push(hidden)
+
+/* Table of the memcpy_to_* sample format conversions which have vectorized
+ * implementations.
+ *
+ * The public functions in primitives.c call through primitives_simd, which is
+ * statically initialized to the best implementation available for the compile time
+ * target (NEON on ARM, SSE2 on x86-64, otherwise the scalar reference), and is
+ * upgraded once at library load time if the processor supports a wider instruction
+ * set (SSE4.1 or AVX2 on x86).
+ *
+ * Every implementation must be bit-exact with the scalar reference, and must
+ * preserve the in-place behavior of the scalar reference: expanding conversions
+ * run downwards, shrinking and same-size conversions run upwards.
+ */
+typedef struct {
+    const char *name;  /* name of the instruction set, for debugging. */
+    void (*memcpy_to_i16_from_float)(int16_t *dst, const float *src, size_t count);
+    void (*memcpy_to_i16_from_i32)(int16_t *dst, const int32_t *src, size_t count);
+    void (*memcpy_to_i16_from_q8_23)(int16_t *dst, const int32_t *src, size_t count);
+    void (*memcpy_to_float_from_i16)(float *dst, const int16_t *src, size_t count);
+    void (*memcpy_to_float_from_i32)(float *dst, const int32_t *src, size_t count);
+    void (*memcpy_to_float_from_q8_23)(float *dst, const int32_t *src, size_t count);
+    void (*memcpy_to_i32_from_i16)(int32_t *dst, const int16_t *src, size_t count);
+    void (*memcpy_to_i32_from_float)(int32_t *dst, const float *src, size_t count);
+    void (*memcpy_to_q8_23_from_i16)(int32_t *dst, const int16_t *src, size_t count);
+    void (*memcpy_to_q8_23_from_float_with_clamp)(int32_t *dst, const float *src, size_t count);
+    /* packed 24 bit */
+    void (*memcpy_to_float_from_p24)(float *dst, const uint8_t *src, size_t count);
+    void (*memcpy_to_i32_from_p24)(int32_t *dst, const uint8_t *src, size_t count);
+    void (*memcpy_to_p24_from_float)(uint8_t *dst, const float *src, size_t count);
+    void (*memcpy_to_p24_from_i32)(uint8_t *dst, const int32_t *src, size_t count);
+    void (*accumulate_p24)(uint8_t *dst, const uint8_t *src, size_t count);
+} primitives_simd_t;
+
+/* The selected implementation, see above. */
+extern primitives_simd_t primitives_simd;
+
+/* Maximum number of implementations returned by primitives_simd_get_tables(). */
+#define PRIMITIVES_SIMD_MAX_TABLES 4
+
+/* Sets tables to every implementation supported by this processor, starting with the
+ * scalar reference, and returns their number.  For testing each implementation against
+ * the scalar reference, whichever one is selected.
+ */
+size_t primitives_simd_get_tables(const primitives_simd_t *tables[PRIMITIVES_SIMD_MAX_TABLES]);
+
+/* Scalar reference implementations, defined in primitives.c. */
+void memcpy_to_i16_from_float_ref(int16_t *dst, const float *src, size_t count);
+void memcpy_to_i16_from_i32_ref(int16_t *dst, const int32_t *src, size_t count);
+void memcpy_to_i16_from_q8_23_ref(int16_t *dst, const int32_t *src, size_t count);
+void memcpy_to_float_from_i16_ref(float *dst, const int16_t *src, size_t count);
+void memcpy_to_float_from_i32_ref(float *dst, const int32_t *src, size_t count);
+void memcpy_to_float_from_q8_23_ref(float *dst, const int32_t *src, size_t count);
+void memcpy_to_i32_from_i16_ref(int32_t *dst, const int16_t *src, size_t count);
+void memcpy_to_i32_from_float_ref(int32_t *dst, const float *src, size_t count);
+void memcpy_to_q8_23_from_i16_ref(int32_t *dst, const int16_t *src, size_t count);
+void memcpy_to_q8_23_from_float_with_clamp_ref(int32_t *dst, const float *src, size_t count);
+void memcpy_to_float_from_p24_ref(float *dst, const uint8_t *src, size_t count);
+void memcpy_to_i32_from_p24_ref(int32_t *dst, const uint8_t *src, size_t count);
+void memcpy_to_p24_from_float_ref(uint8_t *dst, const float *src, size_t count);
+void memcpy_to_p24_from_i32_ref(uint8_t *dst, const int32_t *src, size_t count);
+void accumulate_p24_ref(uint8_t *dst, const uint8_t *src, size_t count);
+
+#pragma GCC visibility pop
+
+__END_DECLS
+
+#endif /*ANDROID_AUDIO_PRIMITIVES_SIMD_H*/
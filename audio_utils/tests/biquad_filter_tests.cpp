@@ -21,6 +21,7 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <audio_utils/BiquadCascade.h>
 #include <audio_utils/BiquadFilter.h>
 
 using ::testing::Pointwise;
@@ -317,3 +318,232 @@ TYPED_TEST(BiquadBasicTest, Equivalence) {
 TYPED_TEST(BiquadBasicTest, CoefReductionEquivalence) {
     this->testCoefReductionEquivalence();
 }
+
+// The BiquadCascadeTest is parameterized on channel count.
+class BiquadCascadeTest : public ::testing::TestWithParam<size_t> {
+protected:
+    // A cascade must be equivalent to its sections applied one after another,
+    // over several blocks and with extra channels in the stride.
+    template <typename D, bool SAME_COEF_PER_CHANNEL>
+    static void testEquivalence() {
+        const size_t channelCount = GetParam();
+        constexpr size_t SECTIONS = 5;
+        constexpr size_t ZERO_CHANNELS = 1;
+        const size_t stride = channelCount + ZERO_CHANNELS;
+        const size_t frames = 3 * BiquadCascade<D>::kBlockSamples / stride + 7;
+        std::vector<D> reference(frames * stride);
+        randomBuffer(reference.data(), frames, stride);
+
+        BiquadCascade<D, SAME_COEF_PER_CHANNEL> cascade(channelCount, SECTIONS);
+        std::vector<std::unique_ptr<BiquadFilter<D, SAME_COEF_PER_CHANNEL>>> biquads(SECTIONS);
+        for (size_t i = 0; i < SECTIONS; ++i) {
+            biquads[i].reset(new BiquadFilter<D, SAME_COEF_PER_CHANNEL>(channelCount));
+            if constexpr (SAME_COEF_PER_CHANNEL) {
+                const auto coefs = randomFilter<D>();
+                ASSERT_TRUE(cascade.setCoefficients(i, coefs));
+                ASSERT_TRUE(biquads[i]->setCoefficients(coefs));
+            } else {
+                for (size_t j = 0; j < channelCount; ++j) {
+                    const auto coefs = randomFilter<D>();
+                    ASSERT_TRUE(cascade.setCoefficients(i, coefs, j));
+                    ASSERT_TRUE(biquads[i]->setCoefficients(coefs, j));
+                }
+            }
+        }
+        cascade.commitCoefficients();
+
+        std::vector<D> test1(frames * stride);
+        cascade.process(test1.data(), reference.data(), frames, stride);
+        auto test2 = reference;
+        for (auto& biquad : biquads) {
+            biquad->process(test2.data(), test2.data(), frames, stride);
+        }
+        for (size_t i = 0; i < frames; ++i) {
+            for (size_t j = channelCount; j < stride; ++j) {
+                test2[i * stride + j] = 0;  // not written by the cascade
+            }
+        }
+        EXPECT_THAT(test1, Pointwise(FloatNear(EPS), test2));
+    }
+};
+
+TEST_P(BiquadCascadeTest, EquivalenceFloat) {
+    testEquivalence<float, true>();
+}
+
+TEST_P(BiquadCascadeTest, EquivalenceDouble) {
+    testEquivalence<double, true>();
+}
+
+TEST_P(BiquadCascadeTest, EquivalenceFloatDifferentFiltersPerChannel) {
+    testEquivalence<float, false>();
+}
+
+INSTANTIATE_TEST_CASE_P(
+        CascadeBiquadFilter,
+        BiquadCascadeTest,
+        ::testing::Values(1, 2, 3, 4, 8, 11)
+        );
+
+// Coefficients take effect at the first process() after commitCoefficients().
+TEST(BiquadCascadeBasicTest, Commit) {
+    using D = float;
+    constexpr size_t TEST_LENGTH = 64;
+    std::vector<D> input(TEST_LENGTH);
+    randomBuffer(input.data(), TEST_LENGTH, 1 /* channelCount */);
+    std::vector<D> output(TEST_LENGTH);
+    const std::vector<D> zero(TEST_LENGTH);
+
+    BiquadCascade<D> cascade(1 /* channelCount */, 2 /* sectionCount */);
+    constexpr std::array<D, kBiquadNumCoefs> GAIN = {2.f, 0.f, 0.f, 0.f, 0.f};
+    ASSERT_TRUE(cascade.setCoefficients(0, GAIN));
+    ASSERT_TRUE(cascade.setCoefficients(1, GAIN));
+    cascade.process(output.data(), input.data(), TEST_LENGTH);
+    EXPECT_EQ(zero, output);
+
+    cascade.commitCoefficients();
+    cascade.process(output.data(), input.data(), TEST_LENGTH);
+    for (size_t i = 0; i < TEST_LENGTH; ++i) {
+        EXPECT_EQ(4.f * input[i], output[i]);
+    }
+
+    // Only the last of several commits takes effect.
+    ASSERT_TRUE(cascade.setCoefficients(1, std::array<D, kBiquadNumCoefs>{0.f}));
+    cascade.commitCoefficients();
+    ASSERT_TRUE(cascade.setCoefficients(1, std::array<D, kBiquadNumCoefs>{0.5f}));
+    cascade.commitCoefficients();
+    cascade.process(output.data(), input.data(), TEST_LENGTH);
+    for (size_t i = 0; i < TEST_LENGTH; ++i) {
+        EXPECT_EQ(input[i], output[i]);
+    }
+    EXPECT_EQ(0.5f, cascade.getSection(1).getCoefficients()[0]);
+
+    // An empty cascade copies.
+    BiquadCascade<D> empty(1 /* channelCount */, 0 /* sectionCount */);
+    empty.process(output.data(), input.data(), TEST_LENGTH);
+    EXPECT_EQ(input, output);
+}
+
+// The BiquadRampTest is parameterized on channel count.
+class BiquadRampTest : public ::testing::TestWithParam<size_t> {
+protected:
+    // Compares a ramp in the (optimized) kernel against a non-optimized reference filter,
+    // whose coefficients are interpolated and set before every frame.
+    template <typename D, bool SAME_COEF_PER_CHANNEL>
+    static void testRamp() {
+        const size_t channelCount = static_cast<size_t>(GetParam());
+        constexpr size_t ZERO_CHANNELS = 1;
+        constexpr size_t RAMP_FRAMES = 100;
+        constexpr size_t BLOCK_FRAMES = 7;  // ramp and process() boundaries differ
+        constexpr size_t FRAMES = 2 * RAMP_FRAMES + 10;
+        const size_t stride = channelCount + ZERO_CHANNELS;
+        std::vector<D> input(FRAMES * stride);
+        randomBuffer(input.data(), FRAMES, stride);
+
+        const size_t coefCount = kBiquadNumCoefs * (SAME_COEF_PER_CHANNEL ? 1 : channelCount);
+        const size_t coefStride = SAME_COEF_PER_CHANNEL ? 1 : channelCount;
+        std::vector<D> start(coefCount), target(coefCount);
+        for (size_t j = 0; j < coefStride; ++j) {
+            const auto startCoefs = randomFilter<D>();
+            const auto targetCoefs = randomFilter<D>();
+            for (size_t i = 0; i < kBiquadNumCoefs; ++i) {
+                start[i * coefStride + j] = startCoefs[i];
+                target[i * coefStride + j] = targetCoefs[i];
+            }
+        }
+
+        BiquadFilter<D, SAME_COEF_PER_CHANNEL> filter(channelCount, start);
+        filter.setRampFrames(RAMP_FRAMES);
+        EXPECT_EQ(RAMP_FRAMES, filter.getRampFrames());
+        EXPECT_EQ(0u, filter.getRampFramesRemaining());
+        ASSERT_TRUE(filter.setCoefficients(target));
+        EXPECT_EQ(target, filter.getCoefficients());
+        EXPECT_EQ(RAMP_FRAMES, filter.getRampFramesRemaining());
+
+        std::vector<D> output(FRAMES * stride);
+        for (size_t i = 0; i < FRAMES; i += BLOCK_FRAMES) {
+            const size_t frames = std::min(BLOCK_FRAMES, FRAMES - i);
+            filter.process(&output[i * stride], &input[i * stride], frames, stride);
+        }
+        EXPECT_EQ(0u, filter.getRampFramesRemaining());
+
+        BiquadFilter<D, SAME_COEF_PER_CHANNEL> reference(
+                channelCount, start, false /* optimized */);
+        std::vector<D> expected(FRAMES * stride);
+        std::vector<D> coefs(coefCount);
+        for (size_t i = 0; i < FRAMES; ++i) {
+            const D fraction = std::min(D(i) / RAMP_FRAMES, D(1));
+            for (size_t j = 0; j < coefCount; ++j) {
+                coefs[j] = start[j] + fraction * (target[j] - start[j]);
+            }
+            reference.setCoefficients(coefs, false /* optimized */);
+            reference.process(&expected[i * stride], &input[i * stride], 1 /* frames */, stride);
+        }
+        for (size_t i = 0; i < FRAMES; ++i) {
+            for (size_t j = channelCount; j < stride; ++j) {
+                expected[i * stride + j] = output[i * stride + j] = 0;  // not written
+            }
+        }
+        EXPECT_THAT(output, Pointwise(FloatNear(EPS), expected));
+    }
+};
+
+TEST_P(BiquadRampTest, RampFloat) {
+    testRamp<float, true>();
+}
+
+TEST_P(BiquadRampTest, RampDouble) {
+    testRamp<double, true>();
+}
+
+TEST_P(BiquadRampTest, RampFloatDifferentFiltersPerChannel) {
+    testRamp<float, false>();
+}
+
+TEST_P(BiquadRampTest, RampDoubleDifferentFiltersPerChannel) {
+    testRamp<double, false>();
+}
+
+INSTANTIATE_TEST_CASE_P(
+        RampBiquadFilter,
+        BiquadRampTest,
+        ::testing::Values(1, 2, 3, 4, 5, 8, 11, 16, 21, 24)
+        );
+
+// A change during a ramp starts a new ramp from the interpolated coefficients,
+// and clear() completes the ramp.
+TEST(BiquadRampBasicTest, Restart) {
+    using D = float;
+    constexpr size_t RAMP_FRAMES = 8;
+    constexpr std::array<D, kBiquadNumCoefs> GAIN1 = {1.f, 0.f, 0.f, 0.f, 0.f};
+    constexpr std::array<D, kBiquadNumCoefs> GAIN3 = {3.f, 0.f, 0.f, 0.f, 0.f};
+    std::vector<D> input(RAMP_FRAMES, 1.f);
+    std::vector<D> output(RAMP_FRAMES);
+
+    BiquadFilter<D> filter(1 /* channelCount */, GAIN1);
+    filter.setRampFrames(RAMP_FRAMES);
+    ASSERT_TRUE(filter.setCoefficients(GAIN3));
+    filter.process(output.data(), input.data(), RAMP_FRAMES / 2);
+    EXPECT_THAT(std::vector<D>(output.begin(), output.begin() + RAMP_FRAMES / 2),
+            Pointwise(FloatNear(EPS), std::vector<D>{1.f, 1.25f, 1.5f, 1.75f}));
+
+    // Ramp back from gain 2 to gain 1.
+    ASSERT_TRUE(filter.setCoefficients(GAIN1));
+    EXPECT_EQ(RAMP_FRAMES, filter.getRampFramesRemaining());
+    filter.process(output.data(), input.data(), RAMP_FRAMES);
+    EXPECT_NEAR(2.f, output[0], EPS);
+    EXPECT_NEAR(1.125f, output[RAMP_FRAMES - 1], EPS);
+
+    ASSERT_TRUE(filter.setCoefficients(GAIN3));
+    filter.clear();
+    EXPECT_EQ(0u, filter.getRampFramesRemaining());
+    filter.process(output.data(), input.data(), 1 /* frames */);
+    EXPECT_EQ(3.f, output[0]);
+
+    // Without a ramp, the change is immediate.
+    filter.setRampFrames(0);
+    ASSERT_TRUE(filter.setCoefficients(GAIN1));
+    EXPECT_EQ(0u, filter.getRampFramesRemaining());
+    filter.process(output.data(), input.data(), 1 /* frames */);
+    EXPECT_EQ(1.f, output[0]);
+}
@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 
+#include <random>
+
 #include <audio_utils/ChannelMix.h>
 #include <audio_utils/Statistics.h>
 #include <gtest/gtest.h>
@@ -44,6 +46,7 @@ static constexpr audio_channel_mask_t kChannelPositionMasks[] = {
     AUDIO_CHANNEL_OUT_7POINT1POINT4,
     AUDIO_CHANNEL_OUT_13POINT_360RA,
     AUDIO_CHANNEL_OUT_22POINT2,
+    AUDIO_CHANNEL_OUT_9POINT1POINT6,
     audio_channel_mask_t(AUDIO_CHANNEL_OUT_22POINT2
             | AUDIO_CHANNEL_OUT_FRONT_WIDE_LEFT | AUDIO_CHANNEL_OUT_FRONT_WIDE_RIGHT),
 };
@@ -277,3 +280,162 @@ TEST(channelmix, input_channel_mask) {
     ASSERT_TRUE(channelMix.setInputChannelMask(AUDIO_CHANNEL_OUT_STEREO));
     ASSERT_EQ(AUDIO_CHANNEL_OUT_STEREO, channelMix.getInputChannelMask());
 }
+
+TEST(channelmix, output_channel_mask) {
+    using namespace ::android::audio_utils::channels;
+    static_assert(IChannelMix::isOutputChannelMaskSupported(AUDIO_CHANNEL_OUT_STEREO));
+    static_assert(IChannelMix::isOutputChannelMaskSupported(AUDIO_CHANNEL_OUT_5POINT1));
+    static_assert(IChannelMix::isOutputChannelMaskSupported(AUDIO_CHANNEL_OUT_5POINT1_SIDE));
+    static_assert(IChannelMix::isOutputChannelMaskSupported(AUDIO_CHANNEL_OUT_7POINT1));
+    static_assert(!IChannelMix::isOutputChannelMaskSupported(AUDIO_CHANNEL_OUT_MONO));
+    static_assert(!IChannelMix::isOutputChannelMaskSupported(AUDIO_CHANNEL_OUT_QUAD));
+    static_assert(!IChannelMix::isOutputChannelMaskSupported(AUDIO_CHANNEL_OUT_7POINT1POINT4));
+
+    for (const audio_channel_mask_t outputChannelMask : { AUDIO_CHANNEL_OUT_STEREO,
+            AUDIO_CHANNEL_OUT_5POINT1, AUDIO_CHANNEL_OUT_5POINT1_SIDE,
+            AUDIO_CHANNEL_OUT_7POINT1 }) {
+        const auto channelMix = IChannelMix::create(outputChannelMask);
+        ASSERT_NE(nullptr, channelMix);
+        ASSERT_EQ(outputChannelMask, channelMix->getOutputChannelMask());
+        ASSERT_EQ(AUDIO_CHANNEL_NONE, channelMix->getInputChannelMask());
+    }
+    ASSERT_EQ(nullptr, IChannelMix::create(AUDIO_CHANNEL_OUT_QUAD));
+    ASSERT_EQ(nullptr, IChannelMix::create(AUDIO_CHANNEL_OUT_7POINT1POINT4));
+}
+
+using ChannelMixSurroundParam = std::tuple<int /* channel mask */, int /* output mask */>;
+class ChannelMixSurroundTest : public ::testing::TestWithParam<ChannelMixSurroundParam> {
+};
+
+// Each input channel must go to the same output channel if present, otherwise only to
+// output channels on its side, with at most unity power.
+TEST_P(ChannelMixSurroundTest, routing) {
+    using namespace ::android::audio_utils::channels;
+    const audio_channel_mask_t channelMask = kChannelPositionMasks[std::get<0>(GetParam())];
+    const audio_channel_mask_t outputChannelMask = (audio_channel_mask_t)std::get<1>(GetParam());
+    const auto channelMix = IChannelMix::create(outputChannelMask);
+    ASSERT_NE(nullptr, channelMix);
+    ASSERT_TRUE(channelMix->setInputChannelMask(channelMask));
+
+    constexpr size_t frames = 4;
+    constexpr float kOffset = 0.25f;
+    constexpr unsigned kBack = AUDIO_CHANNEL_OUT_BACK_LEFT | AUDIO_CHANNEL_OUT_BACK_RIGHT;
+    constexpr unsigned kSide = AUDIO_CHANNEL_OUT_SIDE_LEFT | AUDIO_CHANNEL_OUT_SIDE_RIGHT;
+    constexpr unsigned kSurround = kBack | kSide;
+    const size_t inChannels = audio_channel_count_from_out_mask(channelMask);
+    const size_t outChannels = audio_channel_count_from_out_mask(outputChannelMask);
+    std::vector<float> input(frames * inChannels);
+    std::vector<float> output(frames * outChannels);
+    for (unsigned i = 0, channel = channelMask; channel != 0; ++i) {
+        const int index = __builtin_ctz(channel);
+        const unsigned channelBit = 1 << index;
+        channel &= ~channelBit;
+
+        for (size_t j = 0; j < frames; ++j) {
+            for (size_t k = 0; k < inChannels; ++k) {
+                input[j * inChannels + k] = k == i ? 0.5f : 0.f;
+            }
+        }
+        std::fill(output.begin(), output.end(), kOffset);
+        ASSERT_TRUE(channelMix->process(input.data(), output.data(), frames, true /* accumulate */));
+
+        // gains from the last frame, all frames are the same.
+        double power = 0.;
+        for (unsigned k = 0, outChannel = outputChannelMask; outChannel != 0; ++k) {
+            const int outIndex = __builtin_ctz(outChannel);
+            outChannel &= ~(1 << outIndex);
+            const float gain = (output[(frames - 1) * outChannels + k] - kOffset) * 2.f;
+            power += gain * gain;
+            if ((channelBit & outputChannelMask) != 0
+                    && (channelMask & AUDIO_CHANNEL_OUT_LOW_FREQUENCY_2) == 0) {
+                // side and back channels folded together are at -3dB.
+                const bool folded = (channelBit & kSurround) != 0
+                        && (outputChannelMask & kSurround) != kSurround
+                        && (channelMask & kBack) != 0 && (channelMask & kSide) != 0;
+                EXPECT_FLOAT_EQ(outIndex == index ? (folded ? (float)M_SQRT1_2 : 1.f) : 0.f, gain);
+            }
+            const AUDIO_GEOMETRY_SIDE side = sideFromChannelIdx(index);
+            const AUDIO_GEOMETRY_SIDE outSide = sideFromChannelIdx(outIndex);
+            if ((side == AUDIO_GEOMETRY_SIDE_LEFT && outSide == AUDIO_GEOMETRY_SIDE_RIGHT)
+                    || (side == AUDIO_GEOMETRY_SIDE_RIGHT && outSide == AUDIO_GEOMETRY_SIDE_LEFT)) {
+                EXPECT_EQ(0.f, gain);
+            }
+        }
+        EXPECT_GT(power, 0.49);
+        EXPECT_LT(power, 1.01);
+    }
+}
+
+// The specialized, sparse and matrix kernels must all compute the same linear map:
+// the output for random input must be the sum of the responses to each input channel.
+TEST_P(ChannelMixSurroundTest, linearity) {
+    using namespace ::android::audio_utils::channels;
+    const audio_channel_mask_t channelMask = kChannelPositionMasks[std::get<0>(GetParam())];
+    const audio_channel_mask_t outputChannelMask = (audio_channel_mask_t)std::get<1>(GetParam());
+    const auto channelMix = IChannelMix::create(outputChannelMask);
+    ASSERT_NE(nullptr, channelMix);
+    ASSERT_TRUE(channelMix->setInputChannelMask(channelMask));
+
+    const size_t inChannels = audio_channel_count_from_out_mask(channelMask);
+    const size_t outChannels = audio_channel_count_from_out_mask(outputChannelMask);
+    std::vector<float> gains(inChannels * outChannels);
+    std::vector<float> impulse(inChannels);
+    for (size_t i = 0; i < inChannels; ++i) {
+        impulse[i] = 1.f;
+        ASSERT_TRUE(channelMix->process(impulse.data(), &gains[i * outChannels],
+                1 /* frameCount */, false /* accumulate */));
+        impulse[i] = 0.f;
+    }
+
+    constexpr size_t frames = 37;
+    std::vector<float> input(frames * inChannels);
+    std::minstd_rand gen(channelMask);
+    std::uniform_real_distribution<> dis(-0.1, 0.1);
+    for (auto& in : input) {
+        in = dis(gen);
+    }
+    std::vector<float> output(frames * outChannels);
+    ASSERT_TRUE(channelMix->process(input.data(), output.data(), frames, false /* accumulate */));
+    for (size_t f = 0; f < frames; ++f) {
+        for (size_t j = 0; j < outChannels; ++j) {
+            double expected = 0.;
+            for (size_t i = 0; i < inChannels; ++i) {
+                expected += gains[i * outChannels + j] * input[f * inChannels + i];
+            }
+            EXPECT_NEAR(expected, output[f * outChannels + j], 1e-6) << f << " " << j;
+        }
+    }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+        ChannelMixSurroundAll, ChannelMixSurroundTest,
+        ::testing::Combine(
+                ::testing::Range(0, (int)std::size(kChannelPositionMasks)),
+                ::testing::Values(AUDIO_CHANNEL_OUT_5POINT1, AUDIO_CHANNEL_OUT_5POINT1_SIDE,
+                        AUDIO_CHANNEL_OUT_7POINT1)
+                ),
+        [](const testing::TestParamInfo<ChannelMixSurroundTest::ParamType>& info) {
+            const int index = std::get<0>(info.param);
+            const audio_channel_mask_t channelMask = kChannelPositionMasks[index];
+            const std::string name = std::string(audio_channel_out_mask_to_string(channelMask))
+                    + "_to_" + audio_channel_out_mask_to_string(
+                            (audio_channel_mask_t)std::get<1>(info.param))
+                    + "_" + std::to_string(index);
+            return name;
+        });
+
+TEST(channelmix, 7point1_to_5point1) {
+    using namespace ::android::audio_utils::channels;
+    SurroundChannelMix<AUDIO_CHANNEL_OUT_5POINT1> channelMix(AUDIO_CHANNEL_OUT_7POINT1);
+    //                    FL    FR    FC    LFE   BL    BR    SL    SR
+    const float input[] = {0.1f, 0.2f, 0.3f, 0.4f, 0.1f, 0.2f, 0.3f, 0.4f};
+    float output[6];
+    ASSERT_TRUE(channelMix.process(input, output, 1 /* frameCount */, false /* accumulate */));
+    EXPECT_EQ(0.1f, output[0]);
+    EXPECT_EQ(0.2f, output[1]);
+    EXPECT_EQ(0.3f, output[2]);
+    EXPECT_EQ(0.4f, output[3]);
+    // back and side are summed at -3dB each.
+    EXPECT_FLOAT_EQ((0.1f + 0.3f) * M_SQRT1_2, output[4]);
+    EXPECT_FLOAT_EQ((0.2f + 0.4f) * M_SQRT1_2, output[5]);
+}
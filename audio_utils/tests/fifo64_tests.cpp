@@ -0,0 +1,118 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "audio_utils_fifo64_tests"
+
+#include <limits.h>
+#include <thread>
+
+#include <audio_utils/fifo64.h>
+#include <gtest/gtest.h>
+
+TEST(fifo64, wrap) {
+    constexpr uint32_t kFrameCount = 7; // not a power of 2
+    int32_t buffer[kFrameCount];
+    audio_utils_fifo64 fifo(kFrameCount, sizeof(int32_t), buffer);
+    audio_utils_fifo64_writer writer(fifo);
+    audio_utils_fifo64_reader reader(fifo);
+
+    int32_t next = 0, expected = 0;
+    for (int i = 0; i < 1000; ++i) {
+        int32_t frames[kFrameCount];
+        const size_t count = 1 + i % kFrameCount;
+        for (size_t j = 0; j < count; ++j) {
+            frames[j] = next + j;
+        }
+        ssize_t written = writer.write(frames, count);
+        ASSERT_GE(written, 0);
+        next += written;
+        EXPECT_EQ(next - expected, reader.available());
+        ssize_t read = reader.read(frames, 1 + (i * 3) % kFrameCount);
+        ASSERT_GE(read, 0);
+        for (ssize_t j = 0; j < read; ++j) {
+            ASSERT_EQ(expected++, frames[j]);
+        }
+    }
+    EXPECT_EQ((uint64_t) next, writer.totalReleased());
+    EXPECT_EQ((uint64_t) expected, reader.totalReleased());
+}
+
+// The lost frame count is exact, however far behind the reader is.
+TEST(fifo64, lost) {
+    constexpr uint32_t kFrameCount = 6;
+    int16_t buffer[kFrameCount];
+    audio_utils_fifo64 fifo(kFrameCount, sizeof(int16_t), buffer, false /*throttlesWriter*/);
+    audio_utils_fifo64_writer writer(fifo);
+    audio_utils_fifo64_reader reader(fifo, false /*throttlesWriter*/);
+    audio_utils_fifo64_reader flusher(fifo, false /*throttlesWriter*/, true /*flush*/);
+
+    int16_t frames[kFrameCount];
+    constexpr int16_t kWritten = 1000 * kFrameCount + 5;
+    for (int16_t i = 0; i < kWritten; ++i) {
+        ASSERT_EQ(1, writer.write(&i, 1));
+    }
+    size_t lost;
+    EXPECT_EQ(-EOVERFLOW, reader.read(frames, kFrameCount, NULL /*timeout*/, &lost));
+    EXPECT_EQ((size_t) kWritten - kFrameCount, lost);
+    EXPECT_EQ((uint64_t) kWritten - kFrameCount, reader.totalLost());
+    // the most recent frames are still valid
+    ASSERT_EQ((ssize_t) kFrameCount, reader.read(frames, kFrameCount));
+    for (uint32_t i = 0; i < kFrameCount; ++i) {
+        EXPECT_EQ((int16_t) (kWritten - kFrameCount + i), frames[i]);
+    }
+
+    EXPECT_EQ(-EOVERFLOW, flusher.available(&lost));
+    EXPECT_EQ((size_t) kWritten, lost);
+    EXPECT_EQ(0, flusher.available());
+}
+
+// Blocking transfer with indices crossing 2^32, where the futex word wraps.
+TEST(fifo64, futex_low_order_bits) {
+    constexpr uint32_t kFrameCount = 48;
+    constexpr uint32_t kFrames = 100000;
+    constexpr uint64_t kStart = (1ULL << 32) - kFrames / 2;
+    uint32_t buffer[kFrameCount];
+    audio_utils_fifo_index64 rear(kStart), front(kStart);
+    audio_utils_fifo64 fifo(kFrameCount, sizeof(uint32_t), buffer, rear, &front);
+    audio_utils_fifo64_writer writer(fifo);
+    audio_utils_fifo64_reader reader(fifo);
+    const struct timespec forever = {LONG_MAX /*tv_sec*/, 0 /*tv_nsec*/};
+
+    std::thread thread([&reader, &forever] {
+        for (uint32_t expected = 0; expected < kFrames; ) {
+            uint32_t frames[kFrameCount];
+            ssize_t read = reader.read(frames, 5, &forever);
+            ASSERT_GE(read, 0);
+            for (ssize_t i = 0; i < read; ++i) {
+                ASSERT_EQ(expected++, frames[i]);
+            }
+        }
+    });
+    for (uint32_t sequence = 0; sequence < kFrames; ) {
+        uint32_t frames[kFrameCount / 3];
+        const size_t count = std::min<size_t>(std::size(frames), kFrames - sequence);
+        for (size_t i = 0; i < count; ++i) {
+            frames[i] = sequence + i;
+        }
+        ssize_t written = writer.write(frames, count, &forever);
+        ASSERT_GE(written, 0);
+        sequence += written;
+    }
+    thread.join();
+    EXPECT_EQ(kStart + kFrames, rear.loadAcquire());
+    EXPECT_EQ(kStart + kFrames, front.loadAcquire());
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "audio_utils_fifo_batching_tests"
+
+#include <limits.h>
+#include <thread>
+
+#include <audio_utils/fifo.h>
+#include <gtest/gtest.h>
+
+TEST(fifo_batching, commit) {
+    constexpr uint32_t kFrameCount = 16;
+    int16_t buffer[kFrameCount];
+    audio_utils_fifo fifo(kFrameCount, sizeof(int16_t), buffer);
+    audio_utils_fifo_writer writer(fifo);
+    audio_utils_fifo_reader reader(fifo);
+    int16_t frames[kFrameCount] = {};
+
+    writer.setBatching(true);
+    ASSERT_EQ(4, writer.write(frames, 4));
+    ASSERT_EQ(4, writer.write(frames, 4));
+    // released but not yet visible to the reader
+    EXPECT_EQ(0, reader.available());
+    EXPECT_EQ(8, writer.available());
+    EXPECT_EQ(8u, writer.totalReleased());
+    writer.commit();
+    EXPECT_EQ(8, reader.available());
+    writer.commit();
+    EXPECT_EQ(8, reader.available());
+
+    ASSERT_EQ(2, writer.write(frames, 2));
+    // disabling batching mode commits
+    writer.setBatching(false);
+    EXPECT_EQ(10, reader.available());
+    ASSERT_EQ(1, writer.write(frames, 1));
+    EXPECT_EQ(11, reader.available());
+}
+
+TEST(fifo_batching, caching) {
+    constexpr uint32_t kFrameCount = 8;
+    int16_t buffer[kFrameCount];
+    audio_utils_fifo fifo(kFrameCount, sizeof(int16_t), buffer);
+    audio_utils_fifo_writer writer(fifo);
+    audio_utils_fifo_reader reader(fifo);
+    reader.setCaching(true);
+
+    int16_t frames[kFrameCount];
+    for (int16_t i = 0; i < 4; ++i) {
+        frames[i] = i;
+    }
+    ASSERT_EQ(4, writer.write(frames, 4));
+    ASSERT_EQ(1, reader.read(frames, 1));
+    EXPECT_EQ(0, frames[0]);
+    // satisfied from the cached rear index, which does not see the frames written since
+    ASSERT_EQ(4, writer.write(frames, 4));
+    audio_utils_iovec iovec[2];
+    EXPECT_EQ(2, reader.obtain(iovec, 2));
+    // a request larger than the cache reloads the rear index
+    EXPECT_EQ(7, reader.obtain(iovec, 8));
+    // available() always reloads
+    ASSERT_EQ(1, writer.write(frames, 1));
+    EXPECT_EQ(8, reader.available());
+}
+
+// Frames are neither lost nor reordered when both sides use their batching modes.
+TEST(fifo_batching, blocking) {
+    constexpr uint32_t kFrameCount = 96;
+    constexpr uint32_t kFrames = 100000;
+    constexpr uint32_t kReleasesPerCommit = 4;
+    uint32_t buffer[kFrameCount];
+    audio_utils_fifo fifo(kFrameCount, sizeof(uint32_t), buffer);
+    audio_utils_fifo_writer writer(fifo);
+    audio_utils_fifo_reader reader(fifo);
+    writer.setBatching(true);
+    reader.setCaching(true);
+    const struct timespec forever = {LONG_MAX /*tv_sec*/, 0 /*tv_nsec*/};
+
+    std::thread thread([&reader, &forever] {
+        for (uint32_t expected = 0; expected < kFrames; ) {
+            uint32_t frames[kFrameCount];
+            ssize_t read = reader.read(frames, 7, &forever);
+            ASSERT_GE(read, 0);
+            for (ssize_t i = 0; i < read; ++i) {
+                ASSERT_EQ(expected++, frames[i]);
+            }
+        }
+    });
+    uint32_t releases = 0;
+    for (uint32_t sequence = 0; sequence < kFrames; ) {
+        uint32_t frames[kFrameCount / 8];
+        const size_t count = std::min<size_t>(std::size(frames), kFrames - sequence);
+        for (size_t i = 0; i < count; ++i) {
+            frames[i] = sequence + i;
+        }
+        ssize_t written = writer.write(frames, count, &forever);
+        ASSERT_GE(written, 0);
+        sequence += written;
+        if (++releases % kReleasesPerCommit == 0) {
+            writer.commit();
+        }
+    }
+    writer.commit();
+    thread.join();
+    EXPECT_EQ((uint64_t) kFrames, reader.totalReleased());
+}
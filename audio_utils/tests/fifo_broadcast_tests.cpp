@@ -0,0 +1,153 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "audio_utils_fifo_broadcast_tests"
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <audio_utils/fifo.h>
+#include <gtest/gtest.h>
+
+using Registry = audio_utils_fifo_reader_registry;
+
+TEST(fifo_broadcast, attach_detach) {
+    constexpr uint32_t kFrameCount = 4;
+    int16_t buffer[kFrameCount];
+    audio_utils_fifo fifo(kFrameCount, sizeof(int16_t), buffer, false /*throttlesWriter*/);
+    Registry registry;
+
+    std::vector<std::unique_ptr<audio_utils_fifo_reader>> readers;
+    for (uint32_t i = 0; i < Registry::kMaxReaders; ++i) {
+        readers.emplace_back(new audio_utils_fifo_reader(fifo, registry));
+        EXPECT_EQ((int32_t) i, readers.back()->registrySlot());
+    }
+    EXPECT_EQ(Registry::kMaxReaders, registry.attachedReaders());
+    audio_utils_fifo_reader extra(fifo, registry);
+    EXPECT_EQ(-ENOSPC, extra.registrySlot());
+    audio_utils_fifo_reader plain(fifo, false /*throttlesWriter*/);
+    EXPECT_EQ(-ENOENT, plain.registrySlot());
+
+    uint32_t histogram[Registry::kLagBuckets];
+    readers[3].reset();
+    EXPECT_EQ(Registry::kMaxReaders - 1, registry.attachedReaders());
+    EXPECT_EQ(-EINVAL, registry.getLagHistogram(3, histogram));
+    EXPECT_EQ(-EINVAL, registry.getLagHistogram(Registry::kMaxReaders, histogram));
+    audio_utils_fifo_reader reattached(fifo, registry);
+    EXPECT_EQ(3, reattached.registrySlot());
+    EXPECT_EQ(0, registry.getLagHistogram(3, histogram));
+}
+
+TEST(fifo_broadcast, throttle_and_lag) {
+    constexpr uint32_t kFrameCount = 8;
+    int16_t buffer[kFrameCount];
+    audio_utils_fifo fifo(kFrameCount, sizeof(int16_t), buffer, false /*throttlesWriter*/);
+    Registry registry;
+    audio_utils_fifo_writer writer(fifo);
+    writer.setReaderRegistry(&registry, 1 /*throttleReaders*/);
+    audio_utils_fifo_reader fast(fifo, registry);
+    audio_utils_fifo_reader slow(fifo, registry);
+    int16_t frames[kFrameCount] = {};
+
+    // The slowest reader throttles the writer.
+    ASSERT_EQ((ssize_t) kFrameCount, writer.write(frames, kFrameCount));
+    EXPECT_EQ(0, writer.write(frames, 1));
+    ASSERT_EQ((ssize_t) kFrameCount, fast.read(frames, kFrameCount));
+    EXPECT_EQ(0, writer.available());
+    ASSERT_EQ(2, slow.read(frames, 2));
+    EXPECT_EQ(2, writer.available());
+
+    // The second slowest reader throttles the writer, so the slowest is overrun.
+    writer.setReaderRegistry(&registry, 2 /*throttleReaders*/);
+    EXPECT_EQ((ssize_t) kFrameCount, writer.available());
+    ASSERT_EQ(4, writer.write(frames, 4));
+    ASSERT_EQ(4, writer.write(frames, 4));
+    // Ignored by the throttle after being overrun.
+    EXPECT_EQ(0, writer.available());
+    size_t lost;
+    EXPECT_EQ(-EOVERFLOW, slow.read(frames, kFrameCount, NULL /*timeout*/, &lost));
+    EXPECT_EQ(6u, lost);
+
+    // Lag after each of the 3 non-empty writes, in eighths of the capacity.
+    uint32_t histogram[Registry::kLagBuckets];
+    ASSERT_EQ(0, registry.getLagHistogram(fast.registrySlot(), histogram));
+    const uint32_t expectedFast[Registry::kLagBuckets] = {0, 0, 0, 0, 1, 0, 0, 2, 0};
+    for (uint32_t i = 0; i < Registry::kLagBuckets; ++i) {
+        EXPECT_EQ(expectedFast[i], histogram[i]) << i;
+    }
+    const uint32_t expectedSlow[Registry::kLagBuckets] = {0, 0, 0, 0, 0, 0, 0, 1, 2};
+    ASSERT_EQ(0, registry.getLagHistogram(slow.registrySlot(), histogram));
+    for (uint32_t i = 0; i < Registry::kLagBuckets; ++i) {
+        EXPECT_EQ(expectedSlow[i], histogram[i]) << i;
+    }
+
+    // Without throttling, the writer only records.
+    writer.setReaderRegistry(&registry);
+    EXPECT_EQ((ssize_t) kFrameCount, writer.available());
+}
+
+// Every attached reader sees every frame when the slowest throttles a blocking writer.
+TEST(fifo_broadcast, blocking) {
+    constexpr uint32_t kReaders = 3;
+    constexpr uint32_t kFrames = 50000;
+    constexpr uint32_t kFrameCount = 64;
+    uint32_t buffer[kFrameCount];
+    audio_utils_fifo fifo(kFrameCount, sizeof(uint32_t), buffer, false /*throttlesWriter*/);
+    Registry registry;
+    audio_utils_fifo_writer writer(fifo);
+    writer.setReaderRegistry(&registry, 1 /*throttleReaders*/);
+
+    std::vector<std::unique_ptr<audio_utils_fifo_reader>> readers;
+    std::vector<std::thread> threads;
+    for (uint32_t r = 0; r < kReaders; ++r) {
+        readers.emplace_back(new audio_utils_fifo_reader(fifo, registry));
+    }
+    for (uint32_t r = 0; r < kReaders; ++r) {
+        threads.emplace_back([&reader = *readers[r], r] {
+            const struct timespec timeout = {1 /*tv_sec*/, 0 /*tv_nsec*/};
+            for (uint32_t expected = 0; expected < kFrames; ) {
+                uint32_t frames[kFrameCount];
+                // read fewer frames the higher r, so that the readers run at different rates
+                // may be 0 after a wake for frames already read
+                ssize_t read = reader.read(frames, kFrameCount >> r, &timeout);
+                ASSERT_GE(read, 0);
+                for (ssize_t i = 0; i < read; ++i) {
+                    ASSERT_EQ(expected++, frames[i]);
+                }
+            }
+        });
+    }
+
+    const struct timespec timeout = {1 /*tv_sec*/, 0 /*tv_nsec*/};
+    for (uint32_t sequence = 0; sequence < kFrames; ) {
+        uint32_t frames[kFrameCount / 2];
+        for (uint32_t i = 0; i < kFrameCount / 2; ++i) {
+            frames[i] = sequence + i;
+        }
+        ssize_t written = writer.write(frames,
+                std::min<size_t>(kFrameCount / 2, kFrames - sequence), &timeout);
+        ASSERT_GE(written, 0);
+        sequence += written;
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (const auto& reader : readers) {
+        EXPECT_EQ(0u, reader->totalLost());
+    }
+}
@@ -0,0 +1,154 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Compares the throughput of a FIFO between two threads, with the writer's rear index and
+// the reader's front index packed next to each other, and on separate cache lines
+// using audio_utils_fifo_indices.  Both threads poll without blocking, and the hysteresis
+// is set so that there are no futex wakes, so that the difference is due to the index layout.
+// The difference is only visible when the threads run on separate cores.
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <audio_utils/fifo.h>
+
+// The usual layout, with the indices on the same cache line.
+struct PackedIndices {
+    audio_utils_fifo_index mRear;
+    audio_utils_fifo_index mFront;
+};
+
+struct Context {
+    audio_utils_fifo_reader *mReader;
+    size_t mFramesPerRead;
+    volatile bool mDone;
+    uint64_t mFramesRead;
+};
+
+static void *reader_routine(void *arg)
+{
+    Context *context = (Context *) arg;
+    int32_t buffer[256];
+    uint64_t framesRead = 0;
+    while (!context->mDone) {
+        ssize_t actual = context->mReader->read(buffer, context->mFramesPerRead,
+                NULL /*timeout*/);
+        if (actual > 0) {
+            framesRead += actual;
+        } else if (actual < 0) {
+            printf("read actual = %d\n", (int) actual);
+            abort();
+        }
+    }
+    context->mFramesRead = framesRead;
+    return NULL;
+}
+
+static int64_t now_ns()
+{
+    struct timespec ts;
+    (void) clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Return the throughput in frames per second.
+static double measure(audio_utils_fifo_index& rear, audio_utils_fifo_index& front,
+        size_t framesPerTransfer, int seconds)
+{
+    int32_t fifoBuffer[1024];
+    const uint32_t frameCount = sizeof(fifoBuffer) / sizeof(fifoBuffer[0]);
+    audio_utils_fifo fifo(frameCount, sizeof(fifoBuffer[0]), fifoBuffer, rear, &front);
+    audio_utils_fifo_writer writer(fifo);
+    audio_utils_fifo_reader reader(fifo, true /*throttlesWriter*/);
+    // never re-arm, so there is at most one futex wake in each direction
+    writer.setHysteresis(0 /*armLevel*/, frameCount /*triggerLevel*/);
+    reader.setHysteresis(frameCount /*armLevel*/, 0 /*triggerLevel*/);
+
+    Context context;
+    context.mReader = &reader;
+    context.mFramesPerRead = framesPerTransfer;
+    context.mDone = false;
+    context.mFramesRead = 0;
+    pthread_t reader_thread;
+    int ok = pthread_create(&reader_thread, (const pthread_attr_t *) NULL, reader_routine,
+            (void *) &context);
+    if (ok != 0) {
+        printf("pthread_create = %d\n", ok);
+        abort();
+    }
+
+    int32_t buffer[256] = {};
+    const int64_t start = now_ns();
+    const int64_t end = start + seconds * 1000000000LL;
+    int64_t elapsed = start;
+    for (uint32_t i = 0; ; ++i) {
+        ssize_t actual = writer.write(buffer, framesPerTransfer, NULL /*timeout*/);
+        if (actual < 0) {
+            printf("write actual = %d\n", (int) actual);
+            abort();
+        }
+        if ((i & 1023) == 0 && (elapsed = now_ns()) >= end) {
+            break;
+        }
+    }
+    context.mDone = true;
+    (void) pthread_join(reader_thread, NULL);
+    return context.mFramesRead * 1e9 / (elapsed - start);
+}
+
+int main(int argc, char **argv)
+{
+    size_t framesPerTransfer = 16;
+    int seconds = 2;
+    int opt;
+    while ((opt = getopt(argc, argv, "f:s:")) != -1) {
+        switch (opt) {
+        case 'f':
+            framesPerTransfer = atoi(optarg);
+            break;
+        case 's':
+            seconds = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-f frames per transfer <= 256] [-s seconds]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (framesPerTransfer == 0 || framesPerTransfer > 256 || seconds <= 0) {
+        fprintf(stderr, "invalid option\n");
+        return EXIT_FAILURE;
+    }
+    printf("%zu frames per transfer, %ld online CPUs\n", framesPerTransfer,
+            sysconf(_SC_NPROCESSORS_ONLN));
+
+    // expect a warning from the audio_utils_fifo constructor
+    PackedIndices packed;
+    const double packedRate = measure(packed.mRear, packed.mFront, framesPerTransfer, seconds);
+    printf("packed indices:      %12.0f frames/s\n", packedRate);
+
+    audio_utils_fifo_indices<> padded;
+    const double paddedRate = measure(padded.mRear, padded.mFront, framesPerTransfer, seconds);
+    printf("cache line indices:  %12.0f frames/s  (%.2fx)\n", paddedRate, paddedRate / packedRate);
+
+    audio_utils_fifo_page_indices *paged = new audio_utils_fifo_page_indices;
+    const double pagedRate = measure(paged->mRear, paged->mFront, framesPerTransfer, seconds);
+    printf("page indices:        %12.0f frames/s  (%.2fx)\n", pagedRate, pagedRate / packedRate);
+    delete paged;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,160 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "audio_utils_fifo_multi_writer_tests"
+
+#include <limits.h>
+#include <thread>
+#include <vector>
+
+#include <audio_utils/fifo.h>
+#include <gtest/gtest.h>
+
+namespace {
+
+// A frame identifies its writer and its position in that writer's sequence.
+struct Frame {
+    uint32_t writer;
+    uint32_t sequence;
+};
+
+// short enough for AUDIO_UTILS_FIFO_SYNC_SLEEP, which polls
+const struct timespec kTimeout = {0 /*tv_sec*/, 1000000 /*tv_nsec*/};
+
+} // namespace
+
+class FifoMultiWriterTest : public testing::TestWithParam<audio_utils_fifo_sync> {
+};
+
+// Each writer's frames must be read in order, and none may be lost or duplicated.
+TEST_P(FifoMultiWriterTest, ordering) {
+    constexpr uint32_t kWriters = 4;
+    constexpr uint32_t kFramesPerWriter = 20000;
+    constexpr uint32_t kFrameCount = 100; // not a power of 2, to exercise the fudge factor
+    std::vector<Frame> buffer(kFrameCount);
+    audio_utils_fifo fifo(kFrameCount, sizeof(Frame), buffer.data(), true /*throttlesWriter*/,
+            GetParam());
+    audio_utils_fifo_reader reader(fifo, true /*throttlesWriter*/);
+
+    std::vector<std::thread> threads;
+    for (uint32_t w = 0; w < kWriters; ++w) {
+        threads.emplace_back([&fifo, w] {
+            audio_utils_fifo_multi_writer writer(fifo);
+            uint32_t sequence = 0;
+            while (sequence < kFramesPerWriter) {
+                // vary the slice sizes, up to more than the buffer
+                Frame frames[3 * kFrameCount / 2];
+                const size_t count = std::min<size_t>(1 + (sequence * 7 + w) % std::size(frames),
+                        kFramesPerWriter - sequence);
+                for (size_t i = 0; i < count; ++i) {
+                    frames[i] = {w, sequence + (uint32_t) i};
+                }
+                ssize_t written = writer.write(frames, count, &kTimeout);
+                if (written < 0) {
+                    ASSERT_EQ(-ETIMEDOUT, written);
+                    continue;
+                }
+                sequence += written;
+            }
+        });
+    }
+
+    std::vector<uint32_t> expected(kWriters);
+    for (uint32_t total = 0; total < kWriters * kFramesPerWriter; ) {
+        Frame frames[kFrameCount];
+        size_t lost;
+        ssize_t read = reader.read(frames, std::size(frames), &kTimeout, &lost);
+        ASSERT_EQ(0u, lost);
+        if (read < 0) {
+            ASSERT_EQ(-ETIMEDOUT, read);
+            continue;
+        }
+        for (ssize_t i = 0; i < read; ++i) {
+            ASSERT_LT(frames[i].writer, kWriters);
+            ASSERT_EQ(expected[frames[i].writer]++, frames[i].sequence);
+        }
+        total += read;
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(0, reader.available());
+}
+
+INSTANTIATE_TEST_CASE_P(FifoMultiWriterSyncs, FifoMultiWriterTest, ::testing::Values(
+        AUDIO_UTILS_FIFO_SYNC_SLEEP, AUDIO_UTILS_FIFO_SYNC_PRIVATE));
+
+TEST(fifo_multi_writer, partial_release) {
+    constexpr uint32_t kFrameCount = 16;
+    int16_t buffer[kFrameCount];
+    audio_utils_fifo fifo(kFrameCount, sizeof(int16_t), buffer, true /*throttlesWriter*/);
+    audio_utils_fifo_multi_writer a(fifo), b(fifo);
+    audio_utils_fifo_reader reader(fifo, true /*throttlesWriter*/);
+    audio_utils_iovec iovec[2];
+
+    // No other reservation since: the unreleased tail is given back.
+    ASSERT_EQ(10, a.obtain(iovec, 10));
+    ASSERT_EQ(0u, iovec[0].mOffset);
+    buffer[0] = buffer[1] = buffer[2] = 1;
+    a.release(3);
+    EXPECT_EQ(3, reader.available());
+    EXPECT_EQ(13, b.available());
+
+    // b reserves after a: a's tail is committed as silence, after which b commits.
+    buffer[3] = buffer[4] = buffer[5] = buffer[6] = -1;
+    ASSERT_EQ(4, a.obtain(iovec, 4));
+    ASSERT_EQ(3u, iovec[0].mOffset);
+    ASSERT_EQ(2, b.obtain(iovec, 2));
+    ASSERT_EQ(7u, iovec[0].mOffset);
+    buffer[3] = 2;
+    buffer[7] = buffer[8] = 3;
+    a.release(1);
+    b.release(2);
+    EXPECT_EQ(4u, a.totalReleased());
+    EXPECT_EQ(2u, b.totalReleased());
+
+    int16_t frames[kFrameCount];
+    ASSERT_EQ(9, reader.read(frames, kFrameCount));
+    const int16_t expected[] = {1, 1, 1, 2, 0, 0, 0, 3, 3};
+    for (size_t i = 0; i < std::size(expected); ++i) {
+        EXPECT_EQ(expected[i], frames[i]) << i;
+    }
+
+    // Full: nothing can be reserved until the reader releases.
+    ASSERT_EQ(16, a.write(frames, kFrameCount));
+    EXPECT_EQ(0, b.write(frames, 1));
+    ASSERT_EQ(1, reader.read(frames, 1));
+    EXPECT_EQ(1, b.write(frames, 1));
+}
+
+// Without a throttling reader, the slices being written never overlap.
+TEST(fifo_multi_writer, unthrottled) {
+    constexpr uint32_t kFrameCount = 8;
+    int32_t buffer[kFrameCount];
+    audio_utils_fifo fifo(kFrameCount, sizeof(int32_t), buffer, false /*throttlesWriter*/);
+    audio_utils_fifo_multi_writer a(fifo), b(fifo);
+    audio_utils_iovec iovec[2];
+
+    ASSERT_EQ(6, a.obtain(iovec, 6));
+    EXPECT_EQ(2, b.obtain(iovec, SIZE_MAX));
+    a.release(6);
+    b.release(2);
+    EXPECT_EQ(8, a.available());
+    ASSERT_EQ(5, a.obtain(iovec, 5));
+    EXPECT_EQ(0u, iovec[0].mOffset);
+    EXPECT_EQ(5u, iovec[0].mLength);
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "audio_utils_fifo_span_tests"
+
+#include <audio_utils/fifo_reader_T.h>
+#include <audio_utils/fifo_writer_T.h>
+#include <gtest/gtest.h>
+
+// Produce and consume in place, with the spans wrapping around the end of the buffer.
+TEST(fifo_span, in_place) {
+    constexpr uint32_t kFrameCount = 8;
+    int32_t buffer[kFrameCount];
+    audio_utils_fifo fifo(kFrameCount, sizeof(int32_t), buffer, false /*throttlesWriter*/);
+    audio_utils_fifo_writer32 writer(fifo);
+    audio_utils_fifo_reader32 reader(fifo, false /*throttlesWriter*/);
+
+    int32_t next = 0, expected = 0;
+    for (int i = 0; i < 100; ++i) {
+        std::span<int32_t> span[2];
+        const size_t count = 1 + i % kFrameCount;
+        ASSERT_EQ(count, writer.obtain(span, count));
+        ASSERT_EQ(count, span[0].size() + span[1].size());
+        for (auto& part : span) {
+            for (auto& frame : part) {
+                frame = next++;
+            }
+        }
+        writer.release(count);
+        writer.storeRelease();
+
+        ASSERT_EQ((ssize_t) count, reader.obtain(span));
+        for (auto& part : span) {
+            for (auto& frame : part) {
+                EXPECT_EQ(expected++, frame);
+                frame = -frame;     // process in place
+            }
+        }
+        reader.release(count);
+        EXPECT_EQ(0, reader.obtain(span));
+        EXPECT_TRUE(span[0].empty() && span[1].empty());
+    }
+    EXPECT_EQ(0u, reader.totalLost());
+}
+
+TEST(fifo_span, throttle_and_lost) {
+    constexpr uint32_t kFrameCount = 4;
+    int64_t buffer[kFrameCount];
+    audio_utils_fifo fifo(kFrameCount, sizeof(int64_t), buffer);
+    audio_utils_fifo_writer writer(fifo);
+    audio_utils_fifo_reader64 reader(fifo);
+    std::span<int64_t> span[2];
+
+    const int64_t frames[kFrameCount] = {1, 2, 3, 4};
+    ASSERT_EQ(3, writer.write(frames, 3));
+    ASSERT_EQ(2, reader.obtain(span, 2));
+    EXPECT_EQ(1, span[0][0]);
+    reader.release(2);
+    // the throttling reader's release makes room for the writer
+    EXPECT_EQ((ssize_t) kFrameCount - 1, writer.available());
+    ASSERT_EQ(3, writer.write(frames, 3));
+    ASSERT_EQ(4, reader.obtain(span));
+    EXPECT_EQ(2u, span[0].size());
+    EXPECT_EQ(2u, span[1].size());
+    EXPECT_EQ(3, span[0][0]);
+    EXPECT_EQ(3, span[1][1]);
+    reader.release(4);
+
+    // A reader that does not throttle the writer detects an overrun.
+    audio_utils_fifo unthrottled(kFrameCount, sizeof(int64_t), buffer, false /*throttlesWriter*/);
+    audio_utils_fifo_writer64 writer64(unthrottled);
+    audio_utils_fifo_reader64 lagging(unthrottled, false /*throttlesWriter*/);
+    for (int64_t i = 0; i < 10; ++i) {
+        writer64.write1(i);
+    }
+    writer64.storeRelease();
+    size_t lost;
+    EXPECT_EQ(-EOVERFLOW, lagging.obtain(span, SIZE_MAX, &lost));
+    EXPECT_GT(lost, 0u);
+    ASSERT_EQ((ssize_t) kFrameCount, lagging.obtain(span));
+    EXPECT_EQ(6, span[0][0]);
+}
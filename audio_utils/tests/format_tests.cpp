@@ -18,7 +18,10 @@
 #define LOG_TAG "audio_utils_format_tests"
 #include <log/log.h>
 
+#include <utility>
+
 #include <audio_utils/format.h>
+#include <audio_utils/primitives.h>
 #include <gtest/gtest.h>
 
 /** returns true if the format is a common source or destination format.
@@ -114,6 +117,83 @@ TEST_P(FormatTest, memcpy_by_audio_format)
             memcmp(data, orig_data, SAMPLES * audio_bytes_per_sample(orig_encoding)));
 }
 
+TEST_P(FormatTest, memcpy_by_audio_format_and_index_array)
+{
+    const auto param = GetParam();
+    const audio_format_t src_encoding = std::get<0>(param);
+    const audio_format_t dst_encoding = std::get<1>(param);
+    if (!is_common_src_format(src_encoding) && !is_common_dst_format(dst_encoding)) {
+        return;
+    }
+
+    // Enough frames to span several internal blocks.
+    constexpr size_t FRAMES = 1000;
+    constexpr size_t MAX_CHANNELS = 8;
+    constexpr size_t SAMPLES = FRAMES * MAX_CHANNELS;
+    int16_t orig_data[SAMPLES];
+    fillRamp(orig_data);
+
+    // (dst channel mask, src channel mask): identity, shrinking, growing, swapped.
+    const std::pair<audio_channel_mask_t, audio_channel_mask_t> masks[] = {
+        {AUDIO_CHANNEL_OUT_STEREO, AUDIO_CHANNEL_OUT_STEREO},
+        {AUDIO_CHANNEL_OUT_STEREO, AUDIO_CHANNEL_OUT_5POINT1},
+        {AUDIO_CHANNEL_OUT_7POINT1, AUDIO_CHANNEL_OUT_5POINT1},
+        {AUDIO_CHANNEL_OUT_5POINT1, AUDIO_CHANNEL_OUT_MONO},
+        {AUDIO_CHANNEL_OUT_QUAD, audio_channel_mask_for_index_assignment_from_count(4)},
+    };
+    for (const auto& [dst_mask, src_mask] : masks) {
+        const uint32_t dst_channels = audio_channel_count_from_out_mask(dst_mask);
+        const uint32_t src_channels = audio_channel_count_from_out_mask(src_mask);
+        int8_t idxary[MAX_CHANNELS];
+        ASSERT_EQ(dst_channels, memcpy_by_index_array_initialization_from_channel_mask(
+                idxary, MAX_CHANNELS, dst_mask, src_mask));
+        if (dst_mask == AUDIO_CHANNEL_OUT_QUAD) {
+            std::swap(idxary[0], idxary[1]);  // swizzle as well.
+        }
+
+        uint32_t src[SAMPLES];
+        memcpy_by_audio_format(src, src_encoding,
+                orig_data, AUDIO_FORMAT_PCM_16_BIT, FRAMES * src_channels);
+
+        // Two pass reference.
+        uint32_t temp[SAMPLES];
+        uint32_t expected[SAMPLES];
+        memcpy_by_audio_format(temp, dst_encoding, src, src_encoding, FRAMES * src_channels);
+        memcpy_by_index_array(expected, dst_channels, temp, src_channels, idxary,
+                audio_bytes_per_sample(dst_encoding), FRAMES);
+        const size_t dst_bytes = FRAMES * dst_channels * audio_bytes_per_sample(dst_encoding);
+
+        uint32_t dst[SAMPLES];
+        memcpy_by_audio_format_and_index_array(dst, dst_encoding, dst_channels,
+                src, src_encoding, src_channels, idxary, FRAMES);
+        EXPECT_EQ(0, memcmp(expected, dst, dst_bytes))
+                << "src:" << src_encoding << " dst:" << dst_encoding
+                << " channels " << src_channels << "->" << dst_channels;
+
+        memcpy_by_audio_format_and_index_array(src, dst_encoding, dst_channels,
+                src, src_encoding, src_channels, idxary, FRAMES);
+        EXPECT_EQ(0, memcmp(expected, src, dst_bytes))
+                << "src:" << src_encoding << " dst:" << dst_encoding
+                << " channels " << src_channels << "->" << dst_channels << " in-place";
+    }
+
+    // No source channels, and no destination channels.
+    const int8_t idxary[2] = {-1, -1};
+    const size_t dst_bytes = FRAMES * 2 * audio_bytes_per_sample(dst_encoding);
+    uint8_t expected[FRAMES * 2 * sizeof(uint32_t)];
+    memset(expected, 0x5a, sizeof(expected));
+    memcpy_by_index_array(expected, 2, orig_data, 0, idxary,
+            audio_bytes_per_sample(dst_encoding), FRAMES);
+    uint8_t dst[FRAMES * 2 * sizeof(uint32_t)];
+    memset(dst, 0x5a, sizeof(dst));
+    memcpy_by_audio_format_and_index_array(dst, dst_encoding, 2,
+            orig_data, src_encoding, 0, idxary, FRAMES);
+    EXPECT_EQ(0, memcmp(expected, dst, dst_bytes));
+    memcpy_by_audio_format_and_index_array(dst, dst_encoding, 0,
+            orig_data, src_encoding, 2, idxary, FRAMES);
+    EXPECT_EQ(0, memcmp(expected, dst, sizeof(dst)));
+}
+
 INSTANTIATE_TEST_CASE_P(FormatVariations, FormatTest, ::testing::Combine(
     ::testing::Values(
         AUDIO_FORMAT_PCM_8_BIT,
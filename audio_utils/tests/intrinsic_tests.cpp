@@ -35,6 +35,13 @@ TYPED_TEST(IntrisicUtilsTest, vld1) {
     ASSERT_EQ(value, android::audio_utils::intrinsics::vld1<TypeParam>(&value));
 }
 
+TYPED_TEST(IntrisicUtilsTest, vadd) {
+    constexpr TypeParam a = 2.25f;
+    constexpr TypeParam b = 2.5f;
+    constexpr TypeParam result = a + b;
+    ASSERT_EQ(result, android::audio_utils::intrinsics::vadd(a, b));
+}
+
 TYPED_TEST(IntrisicUtilsTest, vmla) {
     constexpr TypeParam a = 2.125f;
     constexpr TypeParam b = 2.25f;
@@ -62,3 +69,85 @@ TYPED_TEST(IntrisicUtilsTest, vst1) {
             &destination, android::audio_utils::intrinsics::vdupn<TypeParam>(value));
     ASSERT_EQ(value, destination);
 }
+
+TYPED_TEST(IntrisicUtilsTest, vaddv) {
+    constexpr TypeParam value = 2.5f;
+    ASSERT_EQ(value, android::audio_utils::intrinsics::vaddv(value));
+}
+
+// Vector intrinsic tests, on the host these exercise the SSE/AVX specializations.
+template <typename V>
+class IntrisicUtilsVectorTest : public ::testing::Test {
+protected:
+    static constexpr size_t kElements = sizeof(V) / sizeof(float);
+
+    static std::array<float, kElements> toArray(V v) {
+        std::array<float, kElements> result;
+        android::audio_utils::intrinsics::vst1(result.data(), v);
+        return result;
+    }
+};
+
+using VectorTypes = ::testing::Types<
+        android::audio_utils::intrinsics::internal_array_t<float, 4>
+#if defined(__ARM_NEON__) || defined(__aarch64__)
+        , float32x4_t
+        , float32x4x4_t
+#elif defined(__SSE2__)
+        , __m128
+        , android::audio_utils::intrinsics::internal_array_t<__m128, 4>
+#if defined(__AVX__)
+        , __m256
+#endif
+#if defined(__AVX512F__)
+        , __m512
+#endif
+#endif
+        >;
+TYPED_TEST_CASE(IntrisicUtilsVectorTest, VectorTypes);
+
+TYPED_TEST(IntrisicUtilsVectorTest, vmla) {
+    using namespace android::audio_utils::intrinsics;
+    constexpr size_t N = TestFixture::kElements;
+    float a[N], b[N], c[N];
+    for (size_t i = 0; i < N; ++i) {
+        a[i] = i * 0.5f;
+        b[i] = i + 1.f;
+        c[i] = -2.f * i;
+    }
+    const auto result = TestFixture::toArray(
+            vmla(vld1<TypeParam>(c), vld1<TypeParam>(a), vld1<TypeParam>(b)));
+    for (size_t i = 0; i < N; ++i) {
+        ASSERT_EQ(c[i] + a[i] * b[i], result[i]);
+    }
+}
+
+TYPED_TEST(IntrisicUtilsVectorTest, vmul_vneg) {
+    using namespace android::audio_utils::intrinsics;
+    constexpr size_t N = TestFixture::kElements;
+    float a[N], b[N];
+    for (size_t i = 0; i < N; ++i) {
+        a[i] = i * 0.25f;
+        b[i] = 3.f - i;
+    }
+    const auto product = TestFixture::toArray(vmul(vld1<TypeParam>(a), vld1<TypeParam>(b)));
+    const auto negated = TestFixture::toArray(vneg(vld1<TypeParam>(b)));
+    for (size_t i = 0; i < N; ++i) {
+        ASSERT_EQ(a[i] * b[i], product[i]);
+        ASSERT_EQ(-b[i], negated[i]);
+    }
+}
+
+TYPED_TEST(IntrisicUtilsVectorTest, vdupn_vaddv) {
+    using namespace android::audio_utils::intrinsics;
+    constexpr size_t N = TestFixture::kElements;
+    const auto dup = TestFixture::toArray(vdupn<TypeParam>(1.5f));
+    for (size_t i = 0; i < N; ++i) {
+        ASSERT_EQ(1.5f, dup[i]);
+    }
+    float a[N];
+    for (size_t i = 0; i < N; ++i) {
+        a[i] = i;
+    }
+    ASSERT_EQ(N * (N - 1) / 2.f, vaddv(vld1<TypeParam>(a)));
+}
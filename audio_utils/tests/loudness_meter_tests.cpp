@@ -0,0 +1,153 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "audio_utils_loudness_meter_tests"
+
+#include <math.h>
+#include <vector>
+
+#include <audio_utils/LoudnessMeter.h>
+#include <gtest/gtest.h>
+
+using namespace android;
+
+// Adds seconds of a sine to the channels selected by channelBits, which start at phase.
+static void processSine(LoudnessMeter *meter, uint32_t sampleRate, size_t channelCount,
+        uint32_t channelBits, float frequency, float amplitudeDbfs, float seconds,
+        float phase = 0.f) {
+    const float amplitude = powf(10.f, amplitudeDbfs / 20.f);
+    const size_t frames = sampleRate * seconds;
+    std::vector<float> buffer(channelCount * 1000);
+    for (size_t i = 0; i < frames; ) {
+        const size_t count = std::min(frames - i, (size_t)1000);
+        for (size_t j = 0; j < count; ++j) {
+            const double cycles = (double)frequency * (i + j) / sampleRate;
+            const float sample = amplitude * sin(2. * M_PI * (cycles - floor(cycles)) + phase);
+            for (size_t ch = 0; ch < channelCount; ++ch) {
+                buffer[j * channelCount + ch] = (channelBits >> ch) & 1 ? sample : 0.f;
+            }
+        }
+        meter->process(buffer.data(), count);
+        i += count;
+    }
+}
+
+// EBU Tech 3341 minimum requirements test signals 1 to 5, 1 kHz sines.
+TEST(audio_utils_loudness_meter, ebu_tech_3341) {
+    for (uint32_t sampleRate : {44100, 48000}) {
+        LoudnessMeter meter(sampleRate, AUDIO_CHANNEL_OUT_STEREO, AUDIO_FORMAT_PCM_FLOAT);
+        EXPECT_EQ(-INFINITY, meter.getIntegratedLoudness());
+
+        processSine(&meter, sampleRate, 2, 3, 1000.f, -23.f, 20.f);
+        EXPECT_NEAR(-23.f, meter.getMomentaryLoudness(), 0.1f);
+        EXPECT_NEAR(-23.f, meter.getShortTermLoudness(), 0.1f);
+        EXPECT_NEAR(-23.f, meter.getIntegratedLoudness(), 0.1f);
+
+        meter.reset();
+        processSine(&meter, sampleRate, 2, 3, 1000.f, -33.f, 20.f);
+        EXPECT_NEAR(-33.f, meter.getIntegratedLoudness(), 0.1f);
+
+        // The -36 dBFS is gated out by the relative gate, the -72 dBFS by the absolute gate.
+        meter.reset();
+        processSine(&meter, sampleRate, 2, 3, 1000.f, -36.f, 10.f);
+        processSine(&meter, sampleRate, 2, 3, 1000.f, -23.f, 60.f);
+        processSine(&meter, sampleRate, 2, 3, 1000.f, -36.f, 10.f);
+        EXPECT_NEAR(-23.f, meter.getIntegratedLoudness(), 0.1f);
+
+        meter.reset();
+        processSine(&meter, sampleRate, 2, 3, 1000.f, -72.f, 10.f);
+        processSine(&meter, sampleRate, 2, 3, 1000.f, -36.f, 10.f);
+        processSine(&meter, sampleRate, 2, 3, 1000.f, -23.f, 60.f);
+        processSine(&meter, sampleRate, 2, 3, 1000.f, -36.f, 10.f);
+        processSine(&meter, sampleRate, 2, 3, 1000.f, -72.f, 10.f);
+        EXPECT_NEAR(-23.f, meter.getIntegratedLoudness(), 0.1f);
+
+        meter.reset();
+        processSine(&meter, sampleRate, 2, 3, 1000.f, -26.f, 20.1f);
+        processSine(&meter, sampleRate, 2, 3, 1000.f, -20.f, 20.1f);
+        processSine(&meter, sampleRate, 2, 3, 1000.f, -26.f, 20.1f);
+        EXPECT_NEAR(-23.f, meter.getIntegratedLoudness(), 0.1f);
+    }
+}
+
+TEST(audio_utils_loudness_meter, momentary_short_term) {
+    constexpr uint32_t kSampleRate = 48000;
+    LoudnessMeter meter(kSampleRate, AUDIO_CHANNEL_OUT_STEREO, AUDIO_FORMAT_PCM_FLOAT);
+    processSine(&meter, kSampleRate, 2, 3, 1000.f, -23.f, 5.f);
+    processSine(&meter, kSampleRate, 2, 3, 1000.f, -100.f, 1.f);
+    // The momentary window has only the quiet second, the short-term window has 2 s
+    // of the sine.
+    EXPECT_LT(meter.getMomentaryLoudness(), -70.f);
+    EXPECT_NEAR(-23.f + 10.f * log10f(2.f / 3.f), meter.getShortTermLoudness(), 0.1f);
+}
+
+// The 5.1 surround channels are weighted by 1.41, the LFE is ignored.
+TEST(audio_utils_loudness_meter, channel_weights) {
+    constexpr uint32_t kSampleRate = 48000;
+    constexpr size_t kChannels = 6;  // L R C LFE Ls Rs
+    LoudnessMeter meter(kSampleRate, AUDIO_CHANNEL_OUT_5POINT1, AUDIO_FORMAT_PCM_FLOAT);
+    processSine(&meter, kSampleRate, kChannels, 1 << 2, 1000.f, -20.f, 3.f);
+    EXPECT_NEAR(-23.f, meter.getIntegratedLoudness(), 0.1f);
+
+    meter.reset();
+    processSine(&meter, kSampleRate, kChannels, 1 << 4, 1000.f, -20.f, 3.f);
+    EXPECT_NEAR(-23.f + 10.f * log10f(1.41f), meter.getIntegratedLoudness(), 0.1f);
+
+    meter.reset();
+    processSine(&meter, kSampleRate, kChannels, 1 << 3, 1000.f, -20.f, 3.f);
+    EXPECT_EQ(-INFINITY, meter.getIntegratedLoudness());
+}
+
+// A sine at a quarter of the sample rate sampled 45 degrees from its peaks has
+// its sample peak 3 dB below its true peak.
+TEST(audio_utils_loudness_meter, true_peak) {
+    for (uint32_t sampleRate : {44100, 48000, 96000, 192000}) {
+        LoudnessMeter meter(sampleRate, AUDIO_CHANNEL_OUT_MONO, AUDIO_FORMAT_PCM_FLOAT);
+        EXPECT_EQ(-INFINITY, meter.getTruePeak());
+        processSine(&meter, sampleRate, 1, 1, sampleRate / 4.f, -6.f, 1.f, M_PI / 4);
+        if (meter.getTruePeakOversampling() == 1) {
+            EXPECT_NEAR(-9.f, meter.getTruePeak(), 0.1f);
+        } else {
+            EXPECT_NEAR(-6.f, meter.getTruePeak(), 0.2f);
+        }
+    }
+}
+
+TEST(audio_utils_loudness_meter, c) {
+    EXPECT_EQ(nullptr, loudness_meter_create(
+            48000 /* sample_rate */, AUDIO_CHANNEL_OUT_STEREO, AUDIO_FORMAT_MP3));
+    EXPECT_TRUE(isnan(loudness_meter_get_integrated(nullptr)));
+
+    loudness_meter_t *loudness_meter = loudness_meter_create(
+            48000 /* sample_rate */, AUDIO_CHANNEL_OUT_STEREO, AUDIO_FORMAT_PCM_16_BIT);
+    ASSERT_NE(nullptr, loudness_meter);
+
+    // a full scale square wave at 1.5 kHz, which is 3 dB louder than the sine.
+    std::vector<int16_t> buffer(48000 * 2);
+    for (size_t i = 0; i < buffer.size(); ++i) {
+        buffer[i] = (i / 2) % 32 < 16 ? INT16_MAX : INT16_MIN;
+    }
+    loudness_meter_process(loudness_meter, buffer.data(), buffer.size() / 2);
+    EXPECT_GT(loudness_meter_get_momentary(loudness_meter), 0.f);
+    EXPECT_GT(loudness_meter_get_short_term(loudness_meter), -10.f);
+    EXPECT_GT(loudness_meter_get_integrated(loudness_meter), 0.f);
+    EXPECT_GE(loudness_meter_get_true_peak(loudness_meter), 0.f);
+
+    loudness_meter_reset(loudness_meter);
+    EXPECT_EQ(-INFINITY, loudness_meter_get_integrated(loudness_meter));
+    loudness_meter_destroy(loudness_meter);
+}
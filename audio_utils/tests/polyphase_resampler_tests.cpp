@@ -0,0 +1,248 @@
+/*
+ * Copyright 2021 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "audio_utils_polyphase_resampler_tests"
+
+#include <math.h>
+#include <random>
+#include <vector>
+
+#include <audio_utils/polyphase_resampler.h>
+#include <audio_utils/primitives.h>
+#include <gtest/gtest.h>
+
+namespace {
+
+std::vector<float> makeSine(size_t frames, uint32_t channels, double frequency, double rate) {
+    std::vector<float> buffer(frames * channels);
+    for (size_t i = 0; i < frames; ++i) {
+        for (uint32_t c = 0; c < channels; ++c) {
+            // a different phase for each channel.
+            buffer[i * channels + c] = 0.5 * sin(2 * M_PI * frequency * i / rate + c);
+        }
+    }
+    return buffer;
+}
+
+// Resamples all of in with one call, returns the output.
+template <typename T>
+std::vector<T> resampleAll(polyphase_resampler_t *resampler, uint32_t channels,
+        const std::vector<T>& in, size_t outFrames) {
+    std::vector<T> out(outFrames * channels);
+    size_t inFrames = in.size() / channels;
+    EXPECT_EQ(0, polyphase_resampler_resample_from_input(
+            resampler, in.data(), &inFrames, out.data(), &outFrames));
+    out.resize(outFrames * channels);
+    return out;
+}
+
+// A provider returning pseudo random sized pieces of a buffer.
+struct TestProvider {
+    struct resampler_buffer_provider itfe;
+    const float *data;
+    size_t frames;
+    uint32_t channels;
+    size_t position = 0;
+    size_t outstanding = 0;
+    std::minstd_rand gen{42};
+
+    static int getNextBuffer(struct resampler_buffer_provider *provider,
+            struct resampler_buffer *buffer) {
+        TestProvider *self = (TestProvider *)provider;
+        EXPECT_EQ(0u, self->outstanding);
+        std::uniform_int_distribution<size_t> dis(1, 300);
+        const size_t count = std::min({buffer->frame_count, dis(self->gen),
+                self->frames - self->position});
+        buffer->frame_count = count;
+        buffer->raw = count == 0 ? nullptr : (void *)(self->data + self->position * self->channels);
+        self->outstanding = count;
+        return 0;
+    }
+
+    static void releaseBuffer(struct resampler_buffer_provider *provider,
+            struct resampler_buffer *buffer) {
+        TestProvider *self = (TestProvider *)provider;
+        EXPECT_LE(buffer->frame_count, self->outstanding);
+        self->position += buffer->frame_count;
+        self->outstanding = 0;
+    }
+
+    TestProvider(const std::vector<float>& buffer, uint32_t channelCount)
+        : itfe{getNextBuffer, releaseBuffer}
+        , data(buffer.data())
+        , frames(buffer.size() / channelCount)
+        , channels(channelCount) {}
+};
+
+} // namespace
+
+TEST(polyphase_resampler, invalid_parameters) {
+    EXPECT_EQ(nullptr, polyphase_resampler_create(
+            48000, 44100, 2, AUDIO_FORMAT_PCM_16_BIT, RESAMPLER_QUALITY_DEFAULT));
+    EXPECT_EQ(nullptr, polyphase_resampler_create(
+            48000, 44100, 2, AUDIO_FORMAT_PCM_FLOAT, RESAMPLER_QUALITY_MAX));
+    EXPECT_EQ(nullptr, polyphase_resampler_create(
+            48000, 0, 2, AUDIO_FORMAT_PCM_FLOAT, RESAMPLER_QUALITY_DEFAULT));
+    EXPECT_EQ(nullptr, polyphase_resampler_create(  // 48001 / 48000 needs too many phases.
+            48000, 48001, 2, AUDIO_FORMAT_PCM_FLOAT, RESAMPLER_QUALITY_DEFAULT));
+}
+
+TEST(polyphase_resampler, cache) {
+    polyphase_resampler_cache_stats_t before, stats;
+    polyphase_resampler_get_cache_stats(&before);
+
+    // 44100 -> 48000 and 22050 -> 24000 share the filter bank, whatever the channel count
+    // and format; a different quality does not.
+    polyphase_resampler_t *a = polyphase_resampler_create(
+            44100, 48000, 2, AUDIO_FORMAT_PCM_FLOAT, RESAMPLER_QUALITY_DEFAULT);
+    polyphase_resampler_t *b = polyphase_resampler_create(
+            22050, 24000, 6, AUDIO_FORMAT_PCM_8_24_BIT, RESAMPLER_QUALITY_DEFAULT);
+    polyphase_resampler_t *c = polyphase_resampler_create(
+            44100, 48000, 2, AUDIO_FORMAT_PCM_FLOAT, RESAMPLER_QUALITY_DESKTOP);
+    ASSERT_NE(nullptr, a);
+    ASSERT_NE(nullptr, b);
+    ASSERT_NE(nullptr, c);
+    polyphase_resampler_get_cache_stats(&stats);
+    EXPECT_EQ(before.hits + 1, stats.hits);
+    EXPECT_EQ(before.misses + 2, stats.misses);
+    EXPECT_EQ(before.tables + 2, stats.tables);
+    // 160 phases, at least 40 taps for the default quality.
+    EXPECT_GT(stats.bytes, before.bytes + 160 * 40 * sizeof(float));
+
+    polyphase_resampler_destroy(a);
+    polyphase_resampler_destroy(c);
+    polyphase_resampler_get_cache_stats(&stats);
+    EXPECT_EQ(before.tables + 1, stats.tables); // still used by b.
+
+    polyphase_resampler_destroy(b);
+    polyphase_resampler_get_cache_stats(&stats);
+    EXPECT_EQ(before.tables, stats.tables);
+    EXPECT_EQ(before.bytes, stats.bytes);
+}
+
+class PolyphaseResamplerTest
+        : public testing::TestWithParam<std::tuple<uint32_t, uint32_t, uint32_t>> {
+};
+
+// A sine well below both Nyquist frequencies must come out as the same sine,
+// delayed by delay_ns().
+TEST_P(PolyphaseResamplerTest, sine) {
+    const auto [inRate, outRate, channels] = GetParam();
+    constexpr double kFrequency = 1000.;
+    polyphase_resampler_t *resampler = polyphase_resampler_create(
+            inRate, outRate, channels, AUDIO_FORMAT_PCM_FLOAT, RESAMPLER_QUALITY_DESKTOP);
+    ASSERT_NE(nullptr, resampler);
+
+    const size_t inFrames = inRate / 4;
+    const std::vector<float> in = makeSine(inFrames, channels, kFrequency, inRate);
+    const std::vector<float> out = resampleAll(resampler, channels, in, outRate);
+    const size_t outFrames = out.size() / channels;
+    EXPECT_GE(outFrames, (size_t)((uint64_t)inFrames * outRate / inRate) - 1);
+
+    const double delay = polyphase_resampler_delay_ns(resampler) * 1e-9;
+    double signal = 0., noise = 0.;
+    for (size_t i = outFrames / 4; i < outFrames; ++i) { // skip the filter warm up.
+        for (uint32_t c = 0; c < channels; ++c) {
+            const double expected =
+                    0.5 * sin(2 * M_PI * kFrequency * ((double)i / outRate - delay) + c);
+            const double error = out[i * channels + c] - expected;
+            signal += expected * expected;
+            noise += error * error;
+        }
+    }
+    const double snr = 10. * log10(signal / noise);
+    EXPECT_GT(snr, 60.) << inRate << " -> " << outRate;
+    polyphase_resampler_destroy(resampler);
+}
+
+// The output must not depend on how the input is split, in either mode.
+TEST_P(PolyphaseResamplerTest, streaming) {
+    const auto [inRate, outRate, channels] = GetParam();
+    const size_t inFrames = inRate / 10;
+    const size_t outCapacity = outRate / 5;
+    const std::vector<float> in = makeSine(inFrames, channels, 3000., inRate);
+
+    polyphase_resampler_t *resampler = polyphase_resampler_create(
+            inRate, outRate, channels, AUDIO_FORMAT_PCM_FLOAT, RESAMPLER_QUALITY_DEFAULT);
+    ASSERT_NE(nullptr, resampler);
+    const std::vector<float> expected = resampleAll(resampler, channels, in, outCapacity);
+
+    // from input, pseudo random input and output sizes.
+    polyphase_resampler_reset(resampler);
+    std::vector<float> out(outCapacity * channels);
+    std::minstd_rand gen(42);
+    std::uniform_int_distribution<size_t> dis(0, 200);
+    size_t inPosition = 0, outPosition = 0;
+    while (inPosition < inFrames) {
+        size_t inCount = std::min(dis(gen), inFrames - inPosition);
+        size_t outCount = std::min(dis(gen), outCapacity - outPosition);
+        ASSERT_EQ(0, polyphase_resampler_resample_from_input(resampler,
+                &in[inPosition * channels], &inCount, &out[outPosition * channels], &outCount));
+        inPosition += inCount;
+        outPosition += outCount;
+    }
+    ASSERT_EQ(expected.size(), outPosition * channels);
+    EXPECT_EQ(0, memcmp(expected.data(), out.data(), expected.size() * sizeof(float)));
+
+    // from provider.
+    polyphase_resampler_reset(resampler);
+    TestProvider provider(in, channels);
+    outPosition = 0;
+    for (;;) {
+        size_t outCount = std::min(dis(gen) + 1, outCapacity - outPosition);
+        ASSERT_EQ(0, polyphase_resampler_resample_from_provider(resampler,
+                &provider.itfe, &out[outPosition * channels], &outCount));
+        if (outCount == 0) break;
+        outPosition += outCount;
+    }
+    ASSERT_EQ(expected.size(), outPosition * channels);
+    EXPECT_EQ(0, memcmp(expected.data(), out.data(), expected.size() * sizeof(float)));
+    polyphase_resampler_destroy(resampler);
+}
+
+// Q8.23 must match float to within rounding.
+TEST_P(PolyphaseResamplerTest, q8_23) {
+    const auto [inRate, outRate, channels] = GetParam();
+    const size_t inFrames = inRate / 10;
+    const std::vector<float> in = makeSine(inFrames, channels, 440., inRate);
+    std::vector<int32_t> inQ(in.size());
+    memcpy_to_q8_23_from_float_with_clamp(inQ.data(), in.data(), in.size());
+
+    polyphase_resampler_t *resamplerF = polyphase_resampler_create(
+            inRate, outRate, channels, AUDIO_FORMAT_PCM_FLOAT, RESAMPLER_QUALITY_DEFAULT);
+    polyphase_resampler_t *resamplerQ = polyphase_resampler_create(
+            inRate, outRate, channels, AUDIO_FORMAT_PCM_8_24_BIT, RESAMPLER_QUALITY_DEFAULT);
+    ASSERT_NE(nullptr, resamplerF);
+    ASSERT_NE(nullptr, resamplerQ);
+    const std::vector<float> outF = resampleAll(resamplerF, channels, in, outRate);
+    const std::vector<int32_t> outQ = resampleAll(resamplerQ, channels, inQ, outRate);
+    ASSERT_EQ(outF.size(), outQ.size());
+    for (size_t i = 0; i < outF.size(); ++i) {
+        ASSERT_NEAR(outF[i], float_from_q8_23(outQ[i]), 4.f / (1 << 23)) << i;
+    }
+    polyphase_resampler_destroy(resamplerF);
+    polyphase_resampler_destroy(resamplerQ);
+}
+
+INSTANTIATE_TEST_CASE_P(PolyphaseResamplerVariations, PolyphaseResamplerTest, ::testing::Values(
+        std::make_tuple(48000, 44100, 1),
+        std::make_tuple(44100, 48000, 2),
+        std::make_tuple(16000, 48000, 1),
+        std::make_tuple(48000, 16000, 2),
+        std::make_tuple(48000, 48000, 1),
+        std::make_tuple(8000, 44100, 6),
+        std::make_tuple(96000, 44100, 4)));
@@ -19,6 +19,8 @@
 
 #include <cmath>
 #include <math.h>
+#include <random>
+#include <vector>
 
 #include <audio_utils/power.h>
 #include <gtest/gtest.h>
@@ -171,3 +173,81 @@ TEST(audio_utils_power, power_from) {
     EXPECT_EQ(-INFINITY, audio_utils_power_from_energy(0.f));
     EXPECT_TRUE(std::isnan(audio_utils_power_from_energy(-1.f)));
 }
+
+// Compares the statistics of interleaved channels with those computed per channel.
+void testChannelStats(size_t frames, size_t channelCount) {
+    const size_t samples = frames * channelCount;
+    std::vector<float> f_ary(samples);
+    std::vector<uint8_t> u8_ary(samples);
+    std::vector<int16_t> i16_ary(samples);
+    std::vector<int32_t> i32_ary(samples);
+    std::vector<int32_t> q8_23_ary(samples);
+    std::vector<uint8x3_t> p24_ary(samples);
+
+    // must be expressed cleanly in uint8_t, and include zero.
+    std::minstd_rand gen(samples);
+    std::uniform_int_distribution<> dis(-128, 127);
+    for (size_t i = 0; i < samples; ++i) {
+        const int value = dis(gen) / 8 * 8 + (i % channelCount);  // add a DC offset
+        const float f_value = std::min(value, 127) / 128.f;
+        f_ary[i] = f_value;
+        u8_ary[i] = uint8_t(f_value * 128 + 128);
+        i16_ary[i] = int16_t(f_value * -INT16_MIN);
+        i32_ary[i] = int32_t(f_value * -(double)INT32_MIN);
+        q8_23_ary[i] = int32_t(f_value * (1 << 23));
+        // PCM_24_BIT_PACKED is native endian.
+#if HAVE_BIG_ENDIAN
+        p24_ary[i] = {{uint8_t(q8_23_ary[i] >> 16), uint8_t(q8_23_ary[i] >> 8),
+                uint8_t(q8_23_ary[i])}};
+#else
+        p24_ary[i] = {{uint8_t(q8_23_ary[i]), uint8_t(q8_23_ary[i] >> 8),
+                uint8_t(q8_23_ary[i] >> 16)}};
+#endif
+    }
+
+    std::vector<audio_utils_channel_stats> expected(channelCount);
+    std::vector<float> channel(frames);
+    for (size_t j = 0; j < channelCount; ++j) {
+        double sum = 0.;
+        for (size_t i = 0; i < frames; ++i) {
+            channel[i] = f_ary[i * channelCount + j];
+            expected[j].peak = std::max(expected[j].peak, fabsf(channel[i]));
+            sum += channel[i];
+            if (i > 0 && (channel[i] < 0.f) != (channel[i - 1] < 0.f)) {
+                ++expected[j].zero_crossings;
+            }
+        }
+        expected[j].energy =
+                audio_utils_compute_energy_mono(channel.data(), AUDIO_FORMAT_PCM_FLOAT, frames);
+        expected[j].dc = frames > 0 ? sum / frames : 0.;
+    }
+
+    const std::pair<audio_format_t, const void *> buffers[] = {
+        {AUDIO_FORMAT_PCM_FLOAT, f_ary.data()},
+        {AUDIO_FORMAT_PCM_8_BIT, u8_ary.data()},
+        {AUDIO_FORMAT_PCM_16_BIT, i16_ary.data()},
+        {AUDIO_FORMAT_PCM_32_BIT, i32_ary.data()},
+        {AUDIO_FORMAT_PCM_8_24_BIT, q8_23_ary.data()},
+        {AUDIO_FORMAT_PCM_24_BIT_PACKED, p24_ary.data()},
+    };
+    for (const auto& [format, buffer] : buffers) {
+        std::vector<audio_utils_channel_stats> stats(channelCount);
+        audio_utils_compute_channel_stats(buffer, format, frames, channelCount, stats.data());
+        for (size_t j = 0; j < channelCount; ++j) {
+            SCOPED_TRACE(testing::Message() << "format: " << format << " frames: " << frames
+                    << " channelCount: " << channelCount << " channel: " << j);
+            EXPECT_NEAR(expected[j].energy, stats[j].energy, expected[j].energy * 1e-5f);
+            EXPECT_EQ(expected[j].peak, stats[j].peak);
+            EXPECT_NEAR(expected[j].dc, stats[j].dc, 1e-5f);
+            EXPECT_EQ(expected[j].zero_crossings, stats[j].zero_crossings);
+        }
+    }
+}
+
+TEST(audio_utils_power, channel_stats) {
+    for (size_t channelCount : { 1, 2, 3, 4, 5, 6, 8, 11, 24 }) {
+        for (size_t frames : { 0, 1, 2, 3, 5, 16, 37, 300 }) {
+            testChannelStats(frames, channelCount);
+        }
+    }
+}
@@ -17,6 +17,10 @@
 //#define LOG_NDEBUG 0
 #define LOG_TAG "audio_utils_powerlog_tests"
 
+#include <atomic>
+#include <chrono>
+#include <thread>
+
 #include <audio_utils/PowerLog.h>
 #include <gtest/gtest.h>
 #include <iostream>
@@ -128,3 +132,67 @@ TEST(audio_utils_powerlog, c) {
    12-31 16:00:00.000: [  -12.0 ] sum(-12.0)
      */
 }
+
+// Lock-free mode dumps the same as the default mode, including after the log wraps.
+TEST(audio_utils_powerlog, lock_free) {
+    auto plog = std::make_unique<PowerLog>(
+            48000 /* sampleRate */, 1 /* channelCount */, AUDIO_FORMAT_PCM_16_BIT,
+            10 /* entries */, 1 /* framesPerEntry */);
+    auto lockFreeLog = std::make_unique<PowerLog>(
+            48000 /* sampleRate */, 1 /* channelCount */, AUDIO_FORMAT_PCM_16_BIT,
+            10 /* entries */, 1 /* framesPerEntry */, true /* lockFree */);
+
+    for (int64_t i = 0; i < 37; ++i) {
+        const int16_t sample = i % 7 < 2 ? 0 : 0x1000 * (i % 5);
+        plog->log(&sample, 1 /* frame */, i /* nowNs */);
+        lockFreeLog->log(&sample, 1 /* frame */, i /* nowNs */);
+        EXPECT_EQ(plog->dumpToString(), lockFreeLog->dumpToString());
+    }
+}
+
+// A dump in lock-free mode does not block log(), so a real-time writer cannot be
+// delayed by a lower priority thread dumping the log.
+TEST(audio_utils_powerlog, lock_free_concurrent_dump) {
+    constexpr size_t kEntries = 20000;
+    auto plog = std::make_unique<PowerLog>(
+            48000 /* sampleRate */, 1 /* channelCount */, AUDIO_FORMAT_PCM_16_BIT,
+            kEntries, 1 /* framesPerEntry */, true /* lockFree */);
+    const int16_t half = 0x4000;
+    int64_t nowNs = 0;
+    for (size_t i = 0; i < kEntries; ++i) {
+        plog->log(&half, 1 /* frame */, nowNs++);
+    }
+
+    std::atomic<bool> dumping{true};
+    std::atomic<int64_t> minDumpNs{INT64_MAX};
+    std::thread dumper([&] {
+        for (int i = 0; i < 10; ++i) {
+            const auto start = std::chrono::steady_clock::now();
+            const std::string dump = plog->dumpToString(
+                    "" /* prefix */, 0 /* lines */, 0 /* limitNs */, false /* logPlot */);
+            const int64_t durationNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start).count();
+            minDumpNs = std::min(minDumpNs.load(), durationNs);
+            // The snapshot is consistent: every entry is at -6 dB, the oldest entries
+            // overwritten during the dump are dropped, and the rest is a single signal.
+            EXPECT_EQ(std::string::npos, dump.find("-inf"));
+            EXPECT_LE(countNewLines(dump), kEntries / 10 + 2);
+        }
+        dumping = false;
+    });
+
+    // The writer keeps logging while the dumps are in progress, each log() taking
+    // much less time than a dump.
+    int64_t maxLogNs = 0;
+    size_t logs = 0;
+    while (dumping) {
+        const auto start = std::chrono::steady_clock::now();
+        plog->log(&half, 1 /* frame */, nowNs++);
+        maxLogNs = std::max(maxLogNs, (int64_t)std::chrono::duration_cast<
+                std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        ++logs;
+    }
+    dumper.join();
+    EXPECT_GT(logs, (size_t)0);
+    EXPECT_LT(maxLogNs, minDumpNs.load());
+}
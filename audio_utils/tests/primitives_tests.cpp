@@ -14,7 +14,10 @@
  * limitations under the License.
  */
 
+#include <float.h>
 #include <math.h>
+#include <algorithm>
+#include <random>
 #include <vector>
 
 #include <gtest/gtest.h>
@@ -23,6 +26,8 @@
 #include <audio_utils/format.h>
 #include <audio_utils/channels.h>
 
+#include "../private/primitives_simd.h"
+
 #define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
 
 static const int32_t lim8pos = 255;
@@ -859,3 +864,237 @@ TEST(audio_utils_primitives, MemcpyToFloatFromFloatWithClamping) {
 
     ASSERT_EQ(dst, expected) << "src=" << testing::PrintToString(src);
 }
+
+// Float values which exercise the clamping and rounding of the float to integer
+// conversions: the limits, values near the limits, ties, infinities and signed zeros.
+static std::vector<float> makeFloatTestValues(size_t randomCount) {
+    std::vector<float> values = {
+            -INFINITY, -2.f, -1.f, -0.f, 0.f, 1.f, 2.f, INFINITY,
+            nextafterf(-1.f, 0.f), nextafterf(1.f, 0.f), nextafterf(-1.f, -2.f),
+            nextafterf(1.f, 2.f), FLT_MIN, -FLT_MIN, FLT_MAX, -FLT_MAX};
+    for (int shift : {7, 15, 23, 31}) {
+        const float scale = 1.f / (1UL << shift);
+        for (float tie = -8.5f; tie <= 8.5f; tie += 1.f) {
+            values.push_back(tie * scale);
+            values.push_back(nextafterf(tie, 0.f) * scale);
+            values.push_back(nextafterf(tie, tie * 2) * scale);
+        }
+        values.push_back(((1UL << shift) - 0.5f) * scale);
+        values.push_back(-((1UL << shift) + 0.5f) * scale);
+    }
+    std::minstd_rand gen(42);
+    std::uniform_real_distribution<float> dis(-1.5f, 1.5f);
+    while (values.size() < randomCount) {
+        values.push_back(dis(gen));
+    }
+    return values;
+}
+
+static std::vector<int32_t> makeI32TestValues(size_t randomCount) {
+    std::vector<int32_t> values = {INT32_MIN, INT32_MIN + 1, -1, 0, 1, INT32_MAX - 1, INT32_MAX,
+            -0x800000, 0x7fffff, -0x800001, 0x800000, 0x7fff00, -0x8000, 0x7fff};
+    std::minstd_rand gen(42);
+    std::uniform_int_distribution<int32_t> dis(INT32_MIN, INT32_MAX);
+    while (values.size() < randomCount) {
+        values.push_back(dis(gen));
+    }
+    return values;
+}
+
+static std::vector<int16_t> makeI16TestValues(size_t randomCount) {
+    std::vector<int16_t> values = {INT16_MIN, INT16_MIN + 1, -1, 0, 1, INT16_MAX - 1, INT16_MAX};
+    std::minstd_rand gen(42);
+    std::uniform_int_distribution<int16_t> dis(INT16_MIN, INT16_MAX);
+    while (values.size() < randomCount) {
+        values.push_back(dis(gen));
+    }
+    return values;
+}
+
+// Compares a memcpy_to_* conversion against the per-sample inline conversion
+// for every count (to cover the vector remainder) and also in-place.
+template <typename D, typename S, typename F, typename R>
+static void testBitExact(const std::vector<S>& src, F convert, R reference) {
+    const size_t maxCount = src.size();
+    std::vector<D> expected(maxCount);
+    for (size_t i = 0; i < maxCount; ++i) {
+        expected[i] = reference(src[i]);
+    }
+    for (size_t count : {(size_t)0, (size_t)1, (size_t)3, (size_t)7, (size_t)8, (size_t)9,
+            (size_t)15, (size_t)17, (size_t)31, (size_t)33, maxCount - 1, maxCount}) {
+        std::vector<D> dst(count + 1, (D)0x5a);  // guard element at the end.
+        convert(dst.data(), src.data(), count);
+        for (size_t i = 0; i < count; ++i) {
+            ASSERT_EQ(0, memcmp(&expected[i], &dst[i], sizeof(D)))
+                    << "count:" << count << " index:" << i << " src:" << +src[i]
+                    << " expected:" << +expected[i] << " actual:" << +dst[i];
+        }
+        ASSERT_EQ((D)0x5a, dst[count]) << "count:" << count << " wrote past the end";
+
+        // in-place, the buffer is sized for the larger of the two sample types,
+        // and is never empty so that its data() is not NULL for count 0.
+        constexpr size_t kBufferSize = std::max(sizeof(D), sizeof(S));
+        std::vector<uint8_t> inplace(std::max(count, (size_t)1) * kBufferSize);
+        memcpy(inplace.data(), src.data(), count * sizeof(S));
+        convert((D *)inplace.data(), (const S *)inplace.data(), count);
+        ASSERT_EQ(0, memcmp(expected.data(), inplace.data(), count * sizeof(D)))
+                << "count:" << count << " in-place";
+    }
+}
+
+// Returns the kernels of each instruction set supported by this processor, so that they are
+// all tested and not only the one selected, followed by the public functions.
+static std::vector<primitives_simd_t> getSimdTables() {
+    const primitives_simd_t *tables[PRIMITIVES_SIMD_MAX_TABLES];
+    const size_t count = primitives_simd_get_tables(tables);
+    std::vector<primitives_simd_t> result;
+    for (size_t i = 0; i < count; ++i) {
+        result.push_back(*tables[i]);
+    }
+    result.push_back(primitives_simd_t{
+            .name = "public",
+            .memcpy_to_i16_from_float = memcpy_to_i16_from_float,
+            .memcpy_to_i16_from_i32 = memcpy_to_i16_from_i32,
+            .memcpy_to_i16_from_q8_23 = memcpy_to_i16_from_q8_23,
+            .memcpy_to_float_from_i16 = memcpy_to_float_from_i16,
+            .memcpy_to_float_from_i32 = memcpy_to_float_from_i32,
+            .memcpy_to_float_from_q8_23 = memcpy_to_float_from_q8_23,
+            .memcpy_to_i32_from_i16 = memcpy_to_i32_from_i16,
+            .memcpy_to_i32_from_float = memcpy_to_i32_from_float,
+            .memcpy_to_q8_23_from_i16 = memcpy_to_q8_23_from_i16,
+            .memcpy_to_q8_23_from_float_with_clamp = memcpy_to_q8_23_from_float_with_clamp,
+            .memcpy_to_float_from_p24 = memcpy_to_float_from_p24,
+            .memcpy_to_i32_from_p24 = memcpy_to_i32_from_p24,
+            .memcpy_to_p24_from_float = memcpy_to_p24_from_float,
+            .memcpy_to_p24_from_i32 = memcpy_to_p24_from_i32,
+            .accumulate_p24 = accumulate_p24,
+    });
+    return result;
+}
+
+TEST(audio_utils_primitives, memcpy_bit_exact) {
+    constexpr size_t kCount = 4096;
+    const std::vector<float> fary = makeFloatTestValues(kCount);
+    const std::vector<int32_t> i32ary = makeI32TestValues(kCount);
+    const std::vector<int16_t> i16ary = makeI16TestValues(kCount);
+
+    for (const primitives_simd_t& simd : getSimdTables()) {
+        SCOPED_TRACE(simd.name);
+        testBitExact<int16_t>(fary, simd.memcpy_to_i16_from_float, clamp16_from_float);
+        testBitExact<int16_t>(i32ary, simd.memcpy_to_i16_from_i32,
+                [](int32_t v) { return (int16_t)(v >> 16); });
+        testBitExact<int16_t>(i32ary, simd.memcpy_to_i16_from_q8_23,
+                [](int32_t v) { return clamp16(v >> 8); });
+        testBitExact<float>(i16ary, simd.memcpy_to_float_from_i16, float_from_i16);
+        testBitExact<float>(i32ary, simd.memcpy_to_float_from_i32, float_from_i32);
+        testBitExact<float>(i32ary, simd.memcpy_to_float_from_q8_23, float_from_q8_23);
+        testBitExact<int32_t>(i16ary, simd.memcpy_to_i32_from_i16,
+                [](int16_t v) { return (int32_t)v << 16; });
+        testBitExact<int32_t>(fary, simd.memcpy_to_i32_from_float, clamp32_from_float);
+        testBitExact<int32_t>(i16ary, simd.memcpy_to_q8_23_from_i16,
+                [](int16_t v) { return (int32_t)v << 8; });
+        testBitExact<int32_t>(fary, simd.memcpy_to_q8_23_from_float_with_clamp,
+                clamp24_from_float);
+    }
+}
+
+// Byte oriented variant of testBitExact() for the packed 24 bit formats,
+// srcSize and dstSize are the sample sizes in bytes.
+template <typename F>
+static void testBitExactP24(const std::vector<uint8_t>& src, size_t srcSize,
+        const std::vector<uint8_t>& expected, size_t dstSize, F convert) {
+    const size_t maxCount = src.size() / srcSize;
+    for (size_t count : {(size_t)0, (size_t)1, (size_t)15, (size_t)16, (size_t)17,
+            (size_t)31, (size_t)33, (size_t)47, (size_t)48, (size_t)49,
+            maxCount - 1, maxCount}) {
+        std::vector<uint8_t> dst((count + 1) * dstSize, 0x5a);  // guard sample at the end.
+        convert(dst.data(), src.data(), count);
+        ASSERT_EQ(0, memcmp(expected.data(), dst.data(), count * dstSize))
+                << "count:" << count;
+        for (size_t i = count * dstSize; i < dst.size(); ++i) {
+            ASSERT_EQ(0x5a, dst[i]) << "count:" << count << " wrote past the end";
+        }
+
+        // never empty, so that data() is not NULL for count 0.
+        std::vector<uint8_t> inplace(std::max(count, (size_t)1) * std::max(srcSize, dstSize));
+        memcpy(inplace.data(), src.data(), count * srcSize);
+        convert(inplace.data(), inplace.data(), count);
+        ASSERT_EQ(0, memcmp(expected.data(), inplace.data(), count * dstSize))
+                << "count:" << count << " in-place";
+    }
+}
+
+static void appendP24(std::vector<uint8_t> *p24, int32_t q8_23) {
+    p24->push_back(q8_23 & 0xff);
+    p24->push_back((q8_23 >> 8) & 0xff);
+    p24->push_back((q8_23 >> 16) & 0xff);
+}
+
+template <typename T>
+static void appendBytes(std::vector<uint8_t> *bytes, T value) {
+    const uint8_t *p = (const uint8_t *)&value;
+    bytes->insert(bytes->end(), p, p + sizeof(value));
+}
+
+TEST(audio_utils_primitives, memcpy_p24_bit_exact) {
+    constexpr size_t kCount = 4096;
+    const std::vector<float> fary = makeFloatTestValues(kCount);
+    const std::vector<int32_t> i32ary = makeI32TestValues(kCount);
+
+    std::vector<uint8_t> p24, i32bytes, fbytes;
+    std::vector<uint8_t> expectedI32FromP24, expectedFloatFromP24;
+    std::vector<uint8_t> expectedP24FromI32, expectedP24FromFloat;
+    for (size_t i = 0; i < kCount; ++i) {
+        appendP24(&p24, i32ary[i] >> 8);
+        appendBytes(&i32bytes, i32ary[i]);
+        appendBytes(&fbytes, fary[i]);
+        appendP24(&expectedP24FromI32, i32ary[i] >> 8);
+        appendP24(&expectedP24FromFloat, clamp24_from_float(fary[i]));
+    }
+    for (size_t i = 0; i < kCount; ++i) {
+        appendBytes(&expectedI32FromP24, i32_from_p24(&p24[i * 3]));
+        appendBytes(&expectedFloatFromP24, float_from_p24(&p24[i * 3]));
+    }
+
+    const std::vector<primitives_simd_t> tables = getSimdTables();
+    for (const primitives_simd_t& simd : tables) {
+        SCOPED_TRACE(simd.name);
+        testBitExactP24(p24, 3, expectedI32FromP24, sizeof(int32_t),
+                [&](uint8_t *dst, const uint8_t *src, size_t count) {
+                    simd.memcpy_to_i32_from_p24((int32_t *)dst, src, count); });
+        testBitExactP24(p24, 3, expectedFloatFromP24, sizeof(float),
+                [&](uint8_t *dst, const uint8_t *src, size_t count) {
+                    simd.memcpy_to_float_from_p24((float *)dst, src, count); });
+        testBitExactP24(i32bytes, sizeof(int32_t), expectedP24FromI32, 3,
+                [&](uint8_t *dst, const uint8_t *src, size_t count) {
+                    simd.memcpy_to_p24_from_i32(dst, (const int32_t *)src, count); });
+        testBitExactP24(fbytes, sizeof(float), expectedP24FromFloat, 3,
+                [&](uint8_t *dst, const uint8_t *src, size_t count) {
+                    simd.memcpy_to_p24_from_float(dst, (const float *)src, count); });
+    }
+
+    // accumulate_p24 saturates, use the reversed source as the addend.
+    std::vector<uint8_t> addend(p24.size());
+    for (size_t i = 0; i < kCount; ++i) {
+        memcpy(&addend[i * 3], &p24[(kCount - 1 - i) * 3], 3);
+    }
+    std::vector<uint8_t> expectedSum;
+    for (size_t i = 0; i < kCount; ++i) {
+        appendP24(&expectedSum, clamp24_from_q8_23(
+                (i32_from_p24(&p24[i * 3]) >> 8) + (i32_from_p24(&addend[i * 3]) >> 8)));
+    }
+    for (const primitives_simd_t& simd : tables) {
+        SCOPED_TRACE(simd.name);
+        for (size_t count : {(size_t)0, (size_t)1, (size_t)15, (size_t)16, (size_t)17,
+                (size_t)47, (size_t)49, kCount - 1, kCount}) {
+            std::vector<uint8_t> sum((count + 1) * 3, 0x5a);  // guard sample at the end.
+            memcpy(sum.data(), p24.data(), count * 3);
+            simd.accumulate_p24(sum.data(), addend.data(), count);
+            ASSERT_EQ(0, memcmp(expectedSum.data(), sum.data(), count * 3))
+                    << "count:" << count;
+            for (size_t i = count * 3; i < sum.size(); ++i) {
+                ASSERT_EQ(0x5a, sum[i]) << "count:" << count << " wrote past the end";
+            }
+        }
+    }
+}
@@ -167,6 +167,41 @@ ANDROID_API
 camera_metadata_t *allocate_camera_metadata(size_t entry_capacity,
         size_t data_capacity);
 
+/**
+ * Allocate a new camera_metadata structure as allocate_camera_metadata(), which
+ * also holds a hash index of the entry tags, so that
+ * find_camera_metadata_entry() is O(1) whether or not the entries are sorted.
+ * The index is maintained by the functions adding, appending, deleting and
+ * sorting entries.
+ *
+ * The index takes between 8 and 16 more bytes per entry of capacity. It is not
+ * kept by copy_camera_metadata(), clone_camera_metadata() or
+ * allocate_copy_camera_metadata_checked().
+ */
+ANDROID_API
+camera_metadata_t *allocate_camera_metadata_with_tag_index(size_t entry_capacity,
+        size_t data_capacity);
+
+/**
+ * Allocate a new mutable camera_metadata structure, with a tag index as
+ * allocate_camera_metadata_with_tag_index(), for packets which are updated
+ * many times before being sent, such as capture results.
+ *
+ * The entry data are allocated in slots of a few size classes, and the slots of
+ * deleted entries, or of updated entries whose data changes size class, are
+ * reused. So delete_camera_metadata_entry() and update_camera_metadata_entry()
+ * do not move the data of the other entries. The slots round the data size up
+ * to a multiple of 8 bytes up to 128 bytes, then to a power of 2, so
+ * data_capacity should allow for this rounding and for the free slots.
+ *
+ * compact_camera_metadata() packs the data, and makes the packet no longer
+ * mutable. copy_camera_metadata() and clone_camera_metadata() pack the data of
+ * the copy, and get_camera_metadata_compact_size() gives the packed size.
+ */
+ANDROID_API
+camera_metadata_t *allocate_camera_metadata_mutable(size_t entry_capacity,
+        size_t data_capacity);
+
 /**
  * Get the required alignment of a packet of camera metadata, which is the
  * maximal alignment of the embedded camera_metadata, camera_metadata_buffer_entry,
@@ -202,6 +237,27 @@ camera_metadata_t *place_camera_metadata(void *dst, size_t dst_size,
         size_t entry_capacity,
         size_t data_capacity);
 
+/**
+ * Place a camera metadata structure with a tag index into an existing buffer,
+ * as place_camera_metadata(). See allocate_camera_metadata_with_tag_index().
+ * The buffer size needed is given by
+ * calculate_camera_metadata_size_with_tag_index().
+ */
+ANDROID_API
+camera_metadata_t *place_camera_metadata_with_tag_index(void *dst, size_t dst_size,
+        size_t entry_capacity,
+        size_t data_capacity);
+
+/**
+ * Place a mutable camera metadata structure into an existing buffer, as
+ * place_camera_metadata(). See allocate_camera_metadata_mutable(). The buffer
+ * size needed is given by calculate_camera_metadata_size_mutable().
+ */
+ANDROID_API
+camera_metadata_t *place_camera_metadata_mutable(void *dst, size_t dst_size,
+        size_t entry_capacity,
+        size_t data_capacity);
+
 /**
  * Free a camera_metadata structure. Should only be used with structures
  * allocated with allocate_camera_metadata().
@@ -217,6 +273,22 @@ ANDROID_API
 size_t calculate_camera_metadata_size(size_t entry_count,
         size_t data_count);
 
+/**
+ * Calculate the buffer size needed for a metadata structure with a tag index,
+ * see place_camera_metadata_with_tag_index().
+ */
+ANDROID_API
+size_t calculate_camera_metadata_size_with_tag_index(size_t entry_count,
+        size_t data_count);
+
+/**
+ * Calculate the buffer size needed for a mutable metadata structure, see
+ * place_camera_metadata_mutable().
+ */
+ANDROID_API
+size_t calculate_camera_metadata_size_mutable(size_t entry_count,
+        size_t data_count);
+
 /**
  * Get current size of entire metadata structure in bytes, including reserved
  * but unused space.
@@ -315,6 +387,67 @@ int validate_camera_metadata_structure(const camera_metadata_t *metadata,
 ANDROID_API
 int append_camera_metadata(camera_metadata_t *dst, const camera_metadata_t *src);
 
+/**
+ * Which entry is kept when entries with the same tag are merged, see
+ * merge_camera_metadata() and add_camera_metadata_entry_sorted().
+ */
+typedef enum camera_metadata_duplicate_policy {
+    // Keep the entry already in the destination, or from the earlier source
+    CAMERA_METADATA_DUPLICATE_FIRST_WINS = 0,
+    // Keep the entry from the latest source, or the new entry
+    CAMERA_METADATA_DUPLICATE_LAST_WINS = 1,
+} camera_metadata_duplicate_policy_t;
+
+/**
+ * Merge the camera metadata of the src_count packets in srcs into dst, which
+ * stays sorted. Each source must be sorted, and dst is sorted first if needed.
+ * The sources are merged in turn, each in O(N) with no full sort, and only one
+ * entry is kept for each tag of the result, according to policy. Entries with
+ * the same tag within one packet are merged in their order in the packet.
+ *
+ * This does not resize the destination structure, which must have room for all
+ * the entries and data of the sources, as for append_camera_metadata(), even if
+ * some of them are dropped as duplicates. In that case, a non-zero value is
+ * returned and dst is unchanged. This invalidates any existing
+ * camera_metadata_entry.data pointers to dst.
+ */
+ANDROID_API
+int merge_camera_metadata(camera_metadata_t *dst,
+        const camera_metadata_t *const *srcs,
+        size_t src_count,
+        camera_metadata_duplicate_policy_t policy);
+
+/**
+ * Compute the delta from camera metadata prev to cur, for packets which differ
+ * in a few entries, such as the capture results of consecutive frames. The delta
+ * is a new sorted and compact packet, which holds the entries of cur whose tag
+ * is not in prev or whose type, count or data changed, and an entry marking each
+ * tag of prev which is not in cur as deleted. The packets are compared by the
+ * first entry of each tag. This is O(N) if both packets are sorted, and
+ * O(N log N) otherwise.
+ *
+ * The delta is a packet in the same format, which can be sent as any packet and
+ * read with the functions above. It stays a delta through
+ * copy_camera_metadata() and clone_camera_metadata(), but not when appended to
+ * a non-empty packet.
+ *
+ * Returns NULL on error. The delta can be freed with free_camera_metadata().
+ */
+ANDROID_API
+camera_metadata_t *diff_camera_metadata(const camera_metadata_t *prev,
+        const camera_metadata_t *cur);
+
+/**
+ * Apply a delta from diff_camera_metadata() to base, a copy of the packet prev
+ * of the delta, so that base has the entries of cur. This is a merge of the
+ * delta with CAMERA_METADATA_DUPLICATE_LAST_WINS, see merge_camera_metadata(),
+ * where the tags marked as deleted are removed: base is sorted and has a single
+ * entry per tag, and must have room for all the entries and data of the delta.
+ */
+ANDROID_API
+int apply_camera_metadata_delta(camera_metadata_t *base,
+        const camera_metadata_t *delta);
+
 /**
  * Clone an existing metadata buffer, compacting along the way. This is
  * equivalent to allocating a new buffer of the minimum needed size, then
@@ -352,6 +485,26 @@ int add_camera_metadata_entry(camera_metadata_t *dst,
         const void *data,
         size_t data_count);
 
+/**
+ * Add a metadata entry to a metadata structure at its sorted position, so that
+ * the structure stays sorted. dst is sorted first if needed. This is O(N) as the
+ * following entries are moved, instead of O(N log N) for a later
+ * sort_camera_metadata().
+ *
+ * If an entry with the tag already exists, it is kept as is with
+ * CAMERA_METADATA_DUPLICATE_FIRST_WINS, or updated with the new data with
+ * CAMERA_METADATA_DUPLICATE_LAST_WINS, as by update_camera_metadata_entry().
+ *
+ * Returns 0 on success. A non-0 value is returned on error, or if there is no
+ * room for the entry.
+ */
+ANDROID_API
+int add_camera_metadata_entry_sorted(camera_metadata_t *dst,
+        uint32_t tag,
+        const void *data,
+        size_t data_count,
+        camera_metadata_duplicate_policy_t policy);
+
 /**
  * Sort the metadata buffer for fast searching. If already marked as sorted,
  * does nothing. Adding or appending entries to the buffer will place the buffer
@@ -392,7 +545,8 @@ int get_camera_metadata_ro_entry(const camera_metadata_t *src,
  *
  * If multiple entries with the same tag exist, does not have any guarantees on
  * which is returned. To speed up searching for tags, sort the metadata
- * structure first by calling sort_camera_metadata().
+ * structure first by calling sort_camera_metadata(), or allocate it with
+ * allocate_camera_metadata_with_tag_index().
  */
 ANDROID_API
 int find_camera_metadata_entry(camera_metadata_t *src,
@@ -407,11 +561,75 @@ int find_camera_metadata_ro_entry(const camera_metadata_t *src,
         uint32_t tag,
         camera_metadata_ro_entry_t *entry);
 
+/**
+ * A read-only view of a camera metadata packet in a buffer which is neither
+ * owned nor copied, such as a mmap'd or ashmem region, for packets read many
+ * times such as the static characteristics.
+ *
+ * The packet is validated once when the view is allocated, and the view keeps
+ * what it needs of the validated header. Each entry read through the view is
+ * checked again against it in O(1), so that reads stay within the buffer even
+ * if it is changed after validation, e.g. by another process; the entries then
+ * read are however unspecified. Lookups are O(log N) whether or not the packet
+ * is sorted.
+ *
+ * The buffer must outlive the view, and must not be changed by this process
+ * while the view is in use.
+ */
+struct camera_metadata_view;
+typedef struct camera_metadata_view camera_metadata_view_t;
+
+/**
+ * Allocate a view of the packet in buffer, of buffer_size bytes. Returns NULL if
+ * the packet is not valid, as by validate_camera_metadata_structure(), or if
+ * the buffer is not aligned to get_camera_metadata_alignment(), in which case
+ * the packet must be copied, e.g. by allocate_copy_camera_metadata_checked().
+ *
+ * The view is O(1) in size if the packet entries are sorted, and O(N) otherwise.
+ */
+ANDROID_API
+camera_metadata_view_t *allocate_camera_metadata_view(const void *buffer,
+        size_t buffer_size);
+
+/**
+ * Free a view allocated with allocate_camera_metadata_view(). The buffer is not
+ * freed.
+ */
+ANDROID_API
+void free_camera_metadata_view(camera_metadata_view_t *view);
+
+/**
+ * Get the number of entries in the packet of the view, when validated.
+ */
+ANDROID_API
+size_t get_camera_metadata_view_entry_count(const camera_metadata_view_t *view);
+
+/**
+ * Get the metadata entry at position index of the packet of a view, as
+ * get_camera_metadata_ro_entry(). Returns a non-zero value if the index is out
+ * of range, or if the entry was changed to be invalid since the validation.
+ */
+ANDROID_API
+int get_camera_metadata_view_ro_entry(const camera_metadata_view_t *view,
+        size_t index,
+        camera_metadata_ro_entry_t *entry);
+
+/**
+ * Find an entry with given tag value in the packet of a view, as
+ * find_camera_metadata_ro_entry(). If not found, returns -ENOENT. If multiple
+ * entries with the same tag exist, the first one is returned.
+ */
+ANDROID_API
+int find_camera_metadata_view_ro_entry(const camera_metadata_view_t *view,
+        uint32_t tag,
+        camera_metadata_ro_entry_t *entry);
+
 /**
  * Delete an entry at given index. This is an expensive operation, since it
  * requires repacking entries and possibly entry data. This also invalidates any
  * existing camera_metadata_entry.data pointers to this buffer. Sorting is
- * maintained.
+ * maintained. The entry data is not repacked in a mutable packet, see
+ * allocate_camera_metadata_mutable().
  */
 ANDROID_API
 int delete_camera_metadata_entry(camera_metadata_t *dst,
@@ -424,7 +642,8 @@ int delete_camera_metadata_entry(camera_metadata_t *dst,
  * sorting, but invalidates camera_metadata_entry instances that point to the
  * updated entry. If a non-NULL value is passed in to entry, the entry structure
  * is updated to match the new buffer state.  Returns a non-zero value if there
- * is no room for the new data in the buffer.
+ * is no room for the new data in the buffer. In a mutable packet, see
+ * allocate_camera_metadata_mutable(), this is O(1) whatever the data size.
  */
 ANDROID_API
 int update_camera_metadata_entry(camera_metadata_t *dst,
@@ -433,6 +652,17 @@ int update_camera_metadata_entry(camera_metadata_t *dst,
         size_t data_count,
         camera_metadata_entry_t *updated_entry);
 
+/**
+ * Packs the entry data of a mutable packet, so that they are contiguous as in a
+ * packet which is not mutable, before it is sent to another process. The packet
+ * is no longer mutable, and its capacities are unchanged. This is O(N), and
+ * invalidates any existing camera_metadata_entry.data pointers to this buffer.
+ * Returns a non-zero value if the temporary copy of the data cannot be
+ * allocated.
+ */
+ANDROID_API
+int compact_camera_metadata(camera_metadata_t *dst);
+
 /**
  * Retrieve human-readable name of section the tag is in. Returns NULL if
  * no such tag is defined. Returns NULL for tags in the vendor section, unless
@@ -22,6 +22,7 @@
 #include <assert.h>
 #include <errno.h>
 #include <inttypes.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -40,8 +41,12 @@
  * array is no larger than 4 bytes in size, it is stored in the data.value[]
  * array; otherwise, it can found in the parent's data array at index
  * data.offset.
+ *
+ * In a delta packet (FLAG_DELTA), an entry with ENTRY_FLAG_DELETED in flags
+ * has no data, and removes its tag when the delta is applied.
  */
 #define ENTRY_ALIGNMENT ((size_t) 4)
+#define ENTRY_FLAG_DELETED 0x01
 typedef struct camera_metadata_buffer_entry {
     uint32_t tag;
     uint32_t count;
@@ -50,7 +55,8 @@ typedef struct camera_metadata_buffer_entry {
         uint8_t  value[4];
     } data;
     uint8_t  type;
-    uint8_t  reserved[3];
+    uint8_t  flags;
+    uint8_t  reserved[2];
 } camera_metadata_buffer_entry_t;
 
 typedef uint32_t metadata_uptrdiff_t;
@@ -67,7 +73,10 @@ typedef uint32_t metadata_size_t;
  *   | camera_metadata_t                             |
  *   |                                               |
  *   |-----------------------------------------------|
- *   | reserved for future expansion                 |
+ *   | reserved for future expansion, or the         |
+ *   | camera_metadata_tag_index_t if FLAG_TAG_INDEX |
+ *   | then camera_metadata_mutable_state_t if       |
+ *   | FLAG_MUTABLE                                  |
  *   |-----------------------------------------------|
  *   | camera_metadata_buffer_entry_t #0             |
  *   |-----------------------------------------------|
@@ -178,6 +187,44 @@ _Static_assert(sizeof(camera_metadata_t) == 48,
 
 /** Flag definitions */
 #define FLAG_SORTED 0x00000001
+#define FLAG_TAG_INDEX 0x00000002
+#define FLAG_MUTABLE 0x00000004
+#define FLAG_DELTA 0x00000008
+
+/**
+ * An open addressing hash table of the entry tags, with linear probing, placed
+ * between the header and the entries. Each of the slot_count slots holds an
+ * entry index + 1, or 0 if empty. There are more slots than the entry capacity,
+ * so a probe always ends at an empty slot.
+ *
+ * The index is only maintained by this library, and is ignored if its
+ * entry_count does not match the packet, so the flag is cleared in copies of
+ * packets from other processes.
+ */
+typedef struct camera_metadata_tag_index {
+    uint32_t slot_count;  // power of 2, at least twice the entry capacity
+    uint32_t entry_count; // entry count of the packet when last maintained
+    uint32_t slots[];
+} camera_metadata_tag_index_t;
+
+/**
+ * The state of a mutable packet, placed just before the entries. The data of the
+ * entries are allocated in slots of DATA_SLOT_CLASS_COUNT size classes, and the
+ * slot of a deleted or resized entry goes to the free list of its class, so that
+ * no change moves the data of the other entries. The first 4 bytes of a free slot
+ * hold the offset + 1 of the next free slot of its class, or 0.
+ *
+ * data_count is then the end of the slots allocated so far, and data_used the sum
+ * of the data sizes of the entries, as if compacted. As for the tag index, the
+ * state is ignored if its counts do not match the packet.
+ */
+#define DATA_SLOT_CLASS_COUNT 41
+typedef struct camera_metadata_mutable_state {
+    uint32_t entry_count; // entry count of the packet when last maintained
+    uint32_t data_count;  // data count of the packet when last maintained
+    uint32_t data_used;
+    uint32_t free_slots[DATA_SLOT_CLASS_COUNT];
+} camera_metadata_mutable_state_t;
 
 /** Tag information */
 
@@ -216,6 +263,265 @@ static uint8_t *get_data(const camera_metadata_t *metadata) {
     return (uint8_t*)metadata + metadata->data_start;
 }
 
+static size_t calculate_tag_index_slot_count(size_t entry_capacity) {
+    size_t slot_count = 1;
+    while (slot_count < 2 * entry_capacity) slot_count <<= 1;
+    return slot_count;
+}
+
+static size_t calculate_tag_index_size(size_t entry_capacity) {
+    return sizeof(camera_metadata_tag_index_t) +
+            sizeof(uint32_t[calculate_tag_index_slot_count(entry_capacity)]);
+}
+
+// Returns the tag index if present and up to date, otherwise NULL.
+static camera_metadata_tag_index_t *get_tag_index(const camera_metadata_t *metadata) {
+    if ((metadata->flags & FLAG_TAG_INDEX) == 0) return NULL;
+    camera_metadata_tag_index_t *index = (camera_metadata_tag_index_t*)
+            ((uint8_t*)metadata + sizeof(camera_metadata_t));
+    if (index->entry_count != metadata->entry_count) return NULL;
+    return index;
+}
+
+// Returns the tag index to be maintained by a change to the packet. A stale index
+// is dropped, as it was changed by someone else.
+static camera_metadata_tag_index_t *get_tag_index_for_update(camera_metadata_t *metadata) {
+    camera_metadata_tag_index_t *index = get_tag_index(metadata);
+    if (index == NULL) metadata->flags &= ~FLAG_TAG_INDEX;
+    return index;
+}
+
+static uint32_t tag_index_hash(const camera_metadata_tag_index_t *index, uint32_t tag) {
+    uint32_t hash = tag * 0x9E3779B1u;
+    hash ^= hash >> 16;
+    return hash & (index->slot_count - 1);
+}
+
+// Returns ERROR if the index has no empty slot, in which case it is corrupt and
+// must be dropped.
+static int tag_index_insert(camera_metadata_tag_index_t *index, uint32_t tag,
+        uint32_t entry_index) {
+    const uint32_t mask = index->slot_count - 1;
+    uint32_t slot = tag_index_hash(index, tag);
+    for (uint32_t probes = 0; probes < index->slot_count; ++probes) {
+        if (index->slots[slot] == 0) {
+            index->slots[slot] = entry_index + 1;
+            return OK;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return ERROR;
+}
+
+// Renumbers the index after the last entry was moved to entry_index, ahead of
+// the following entries.
+static void tag_index_move_last(camera_metadata_tag_index_t *index, uint32_t entry_index) {
+    const uint32_t last = index->entry_count - 1;
+    for (uint32_t slot = 0; slot < index->slot_count; ++slot) {
+        if (index->slots[slot] == last + 1) {
+            index->slots[slot] = entry_index + 1;
+        } else if (index->slots[slot] > entry_index) {
+            ++index->slots[slot];
+        }
+    }
+}
+
+// Rebuilds the index of a packet with FLAG_TAG_INDEX from its entries.
+static void tag_index_rebuild(camera_metadata_t *metadata) {
+    camera_metadata_tag_index_t *index = (camera_metadata_tag_index_t*)
+            ((uint8_t*)metadata + sizeof(camera_metadata_t));
+    memset(index->slots, 0, sizeof(uint32_t[index->slot_count]));
+    const camera_metadata_buffer_entry_t *entries = get_entries(metadata);
+    for (uint32_t i = 0; i < metadata->entry_count; ++i) {
+        if (tag_index_insert(index, entries[i].tag, i) != OK) {
+            metadata->flags &= ~FLAG_TAG_INDEX;
+            return;
+        }
+    }
+    index->entry_count = metadata->entry_count;
+}
+
+// Removes an entry from the index, before it is removed from the entries,
+// and renumbers the following entries. Returns ERROR if the entry is not found
+// in its probe sequence or a slot is out of range, in which case the index is
+// corrupt and must be dropped.
+static int tag_index_remove(camera_metadata_t *metadata,
+        camera_metadata_tag_index_t *index, uint32_t entry_index) {
+    const camera_metadata_buffer_entry_t *entries = get_entries(metadata);
+    const uint32_t mask = index->slot_count - 1;
+    uint32_t hole = tag_index_hash(index, entries[entry_index].tag);
+    uint32_t probes = 0;
+    while (index->slots[hole] != entry_index + 1) {
+        if (++probes == index->slot_count) return ERROR;
+        hole = (hole + 1) & mask;
+    }
+
+    // Shift back the following slots of the probe sequence which may fill the hole,
+    // so that no probe stops early at the hole.
+    for (uint32_t slot = (hole + 1) & mask; index->slots[slot] != 0; slot = (slot + 1) & mask) {
+        if (++probes == index->slot_count ||
+                index->slots[slot] > metadata->entry_count) return ERROR;
+        const uint32_t home = tag_index_hash(index, entries[index->slots[slot] - 1].tag);
+        const int stays = hole <= slot ? hole < home && home <= slot
+                : hole < home || home <= slot;
+        if (!stays) {
+            index->slots[hole] = index->slots[slot];
+            hole = slot;
+        }
+    }
+    index->slots[hole] = 0;
+
+    for (uint32_t slot = 0; slot < index->slot_count; ++slot) {
+        if (index->slots[slot] > entry_index + 1) --index->slots[slot];
+    }
+    --index->entry_count;
+    return OK;
+}
+
+static size_t calculate_reserved_size(size_t entry_capacity, uint32_t flags) {
+    size_t reserved_size = 0;
+    if (flags & FLAG_TAG_INDEX) reserved_size += calculate_tag_index_size(entry_capacity);
+    if (flags & FLAG_MUTABLE) reserved_size += sizeof(camera_metadata_mutable_state_t);
+    return reserved_size;
+}
+
+// Returns the mutable state if present and up to date, otherwise NULL.
+static camera_metadata_mutable_state_t *get_mutable_state(const camera_metadata_t *metadata) {
+    if ((metadata->flags & FLAG_MUTABLE) == 0) return NULL;
+    camera_metadata_mutable_state_t *state = (camera_metadata_mutable_state_t*)
+            ((uint8_t*)metadata + metadata->entries_start - sizeof(*state));
+    if (state->entry_count != metadata->entry_count ||
+            state->data_count != metadata->data_count) return NULL;
+    return state;
+}
+
+// Returns the mutable state to be maintained by a change to the packet. A stale
+// state is dropped, the packet data then keeps the free slots as unused gaps.
+static camera_metadata_mutable_state_t *get_mutable_state_for_update(
+        camera_metadata_t *metadata) {
+    camera_metadata_mutable_state_t *state = get_mutable_state(metadata);
+    if (state == NULL) metadata->flags &= ~FLAG_MUTABLE;
+    return state;
+}
+
+static void mutable_state_sync(const camera_metadata_t *metadata,
+        camera_metadata_mutable_state_t *state) {
+    state->entry_count = metadata->entry_count;
+    state->data_count = metadata->data_count;
+}
+
+// Returns the slot size class of entry data of data_bytes > 0, a multiple of
+// DATA_ALIGNMENT: each multiple up to 128 bytes, then each power of 2.
+static uint32_t data_slot_class(size_t data_bytes) {
+    if (data_bytes <= 128) return data_bytes / DATA_ALIGNMENT - 1;
+    uint32_t slot_class = 16;
+    for (size_t slot_size = 256; slot_size < data_bytes; slot_size <<= 1) ++slot_class;
+    return slot_class;
+}
+
+static size_t data_slot_size(uint32_t slot_class) {
+    return slot_class < 16 ? (slot_class + 1) * DATA_ALIGNMENT : (size_t)256 << (slot_class - 16);
+}
+
+// Returns whether a data slot of slot_size at offset is aligned and within the
+// data count, so that it may be in a free list.
+static int is_data_slot_valid(const camera_metadata_t *metadata, uint32_t offset,
+        size_t slot_size) {
+    return offset % DATA_ALIGNMENT == 0 && offset <= metadata->data_count &&
+            slot_size <= metadata->data_count - offset;
+}
+
+// Empties a free list which links to an invalid slot, as it is corrupt. The rest of
+// its slots are left as unused gaps.
+static void drop_invalid_free_slot(const camera_metadata_t *metadata, uint32_t *free_slot,
+        size_t slot_size) {
+    if (*free_slot != 0 && !is_data_slot_valid(metadata, *free_slot - 1, slot_size)) {
+        ALOGE("%s: Free slot offset %" PRIu32 " of size %zu is outside the data (%" PRIu32 ")",
+                __FUNCTION__, *free_slot - 1, slot_size, metadata->data_count);
+        *free_slot = 0;
+    }
+}
+
+// Allocates data_bytes of entry data, from a free slot or at the end of the data
+// if the packet is mutable, otherwise at the end of the data.
+static int allocate_entry_data(camera_metadata_t *dst, camera_metadata_mutable_state_t *state,
+        size_t data_bytes, uint32_t *offset) {
+    if (state == NULL) {
+        if (data_bytes + dst->data_count > dst->data_capacity) return ERROR;
+        *offset = dst->data_count;
+        dst->data_count += data_bytes;
+        return OK;
+    }
+    const uint32_t slot_class = data_slot_class(data_bytes);
+    const size_t slot_size = data_slot_size(slot_class);
+    uint32_t *free_slot = &state->free_slots[slot_class];
+    drop_invalid_free_slot(dst, free_slot, slot_size);
+    if (*free_slot != 0) {
+        *offset = *free_slot - 1;
+        memcpy(free_slot, get_data(dst) + *offset, sizeof(uint32_t));
+        drop_invalid_free_slot(dst, free_slot, slot_size);
+    } else {
+        if (slot_size + dst->data_count > dst->data_capacity) return ERROR;
+        *offset = dst->data_count;
+        dst->data_count += slot_size;
+    }
+    state->data_used += data_bytes;
+    return OK;
+}
+
+// Returns the slot of entry data of data_bytes > 0 to its free list.
+static void free_entry_data(camera_metadata_t *dst, camera_metadata_mutable_state_t *state,
+        uint32_t offset, size_t data_bytes) {
+    const uint32_t slot_class = data_slot_class(data_bytes);
+    if (!is_data_slot_valid(dst, offset, data_slot_size(slot_class))) {
+        // Not allocated from a slot, left as an unused gap
+        state->data_used -= data_bytes;
+        return;
+    }
+    memcpy(get_data(dst) + offset, &state->free_slots[slot_class], sizeof(uint32_t));
+    state->free_slots[slot_class] = offset + 1;
+    state->data_used -= data_bytes;
+}
+
+// Returns the entry data size of a packet once compacted.
+static size_t get_data_used(const camera_metadata_t *metadata) {
+    const camera_metadata_mutable_state_t *state = get_mutable_state(metadata);
+    return state != NULL ? state->data_used : metadata->data_count;
+}
+
+// Copies the entry data from src_data to be contiguous in entry order at dst_data,
+// updates the entry offsets, and returns the data count.
+static size_t pack_entry_data(uint8_t *dst_data, camera_metadata_buffer_entry_t *entries,
+        size_t entry_count, const uint8_t *src_data) {
+    size_t data_count = 0;
+    for (size_t i = 0; i < entry_count; ++i) {
+        const size_t data_bytes = calculate_camera_metadata_entry_data_size(
+                entries[i].type, entries[i].count);
+        if (data_bytes == 0) continue;
+        memcpy(dst_data + data_count, src_data + entries[i].data.offset, data_bytes);
+        entries[i].data.offset = data_count;
+        data_count += data_bytes;
+    }
+    return data_count;
+}
+
+// Packs the entry data of a packet in place, through a temporary copy.
+static int pack_data_in_place(camera_metadata_t *dst) {
+    uint8_t *data = NULL;
+    if (dst->data_count != 0) {
+        data = malloc(dst->data_count);
+        if (data == NULL) {
+            ALOGE("%s: Failed to allocate %" PRIu32 " bytes to compact the data",
+                    __FUNCTION__, dst->data_count);
+            return ERROR;
+        }
+        memcpy(data, get_data(dst), dst->data_count);
+    }
+    dst->data_count = pack_entry_data(get_data(dst), get_entries(dst), dst->entry_count, data);
+    free(data);
+    return OK;
+}
+
 size_t get_camera_metadata_alignment() {
     return METADATA_PACKET_ALIGNMENT;
 }
@@ -242,18 +548,26 @@ camera_metadata_t *allocate_copy_camera_metadata_checked(
         free(buffer);
         return NULL;
     }
+    // The tag index and free slots of an untrusted source may not match the entries.
+    metadata->flags &= ~(FLAG_TAG_INDEX | FLAG_MUTABLE);
 
     return metadata;
 }
 
-camera_metadata_t *allocate_camera_metadata(size_t entry_capacity,
-                                            size_t data_capacity) {
+static size_t calculate_camera_metadata_size_internal(size_t entry_count,
+        size_t data_count, size_t reserved_size);
+static camera_metadata_t *place_camera_metadata_internal(void *dst,
+        size_t dst_size, size_t entry_capacity, size_t data_capacity,
+        uint32_t flags);
+
+static camera_metadata_t *allocate_camera_metadata_internal(size_t entry_capacity,
+        size_t data_capacity, uint32_t flags) {
 
-    size_t memory_needed = calculate_camera_metadata_size(entry_capacity,
-                                                          data_capacity);
+    size_t memory_needed = calculate_camera_metadata_size_internal(entry_capacity,
+            data_capacity, calculate_reserved_size(entry_capacity, flags));
     void *buffer = calloc(1, memory_needed);
-    camera_metadata_t *metadata = place_camera_metadata(
-        buffer, memory_needed, entry_capacity, data_capacity);
+    camera_metadata_t *metadata = place_camera_metadata_internal(
+        buffer, memory_needed, entry_capacity, data_capacity, flags);
     if (!metadata) {
         /* This should not happen when memory_needed is the same
          * calculated in this function and in place_camera_metadata.
@@ -263,14 +577,57 @@ camera_metadata_t *allocate_camera_metadata(size_t entry_capacity,
     return metadata;
 }
 
+camera_metadata_t *allocate_camera_metadata(size_t entry_capacity,
+                                            size_t data_capacity) {
+    return allocate_camera_metadata_internal(entry_capacity, data_capacity, 0 /* flags */);
+}
+
+camera_metadata_t *allocate_camera_metadata_with_tag_index(size_t entry_capacity,
+                                                           size_t data_capacity) {
+    return allocate_camera_metadata_internal(entry_capacity, data_capacity, FLAG_TAG_INDEX);
+}
+
+camera_metadata_t *allocate_camera_metadata_mutable(size_t entry_capacity,
+                                                    size_t data_capacity) {
+    return allocate_camera_metadata_internal(entry_capacity, data_capacity,
+            FLAG_TAG_INDEX | FLAG_MUTABLE);
+}
+
 camera_metadata_t *place_camera_metadata(void *dst,
                                          size_t dst_size,
                                          size_t entry_capacity,
                                          size_t data_capacity) {
+    return place_camera_metadata_internal(dst, dst_size, entry_capacity,
+            data_capacity, 0 /* flags */);
+}
+
+camera_metadata_t *place_camera_metadata_with_tag_index(void *dst,
+                                                        size_t dst_size,
+                                                        size_t entry_capacity,
+                                                        size_t data_capacity) {
+    return place_camera_metadata_internal(dst, dst_size, entry_capacity,
+            data_capacity, FLAG_TAG_INDEX);
+}
+
+camera_metadata_t *place_camera_metadata_mutable(void *dst,
+                                                 size_t dst_size,
+                                                 size_t entry_capacity,
+                                                 size_t data_capacity) {
+    return place_camera_metadata_internal(dst, dst_size, entry_capacity,
+            data_capacity, FLAG_TAG_INDEX | FLAG_MUTABLE);
+}
+
+static camera_metadata_t *place_camera_metadata_internal(void *dst,
+                                                         size_t dst_size,
+                                                         size_t entry_capacity,
+                                                         size_t data_capacity,
+                                                         uint32_t flags) {
     if (dst == NULL) return NULL;
 
-    size_t memory_needed = calculate_camera_metadata_size(entry_capacity,
-                                                          data_capacity);
+    const size_t reserved_size = calculate_reserved_size(entry_capacity, flags);
+    size_t memory_needed = calculate_camera_metadata_size_internal(entry_capacity,
+                                                                   data_capacity,
+                                                                   reserved_size);
     if (memory_needed > dst_size) {
       ALOGE("%s: Memory needed to place camera metadata (%zu) > dst size (%zu)", __FUNCTION__,
               memory_needed, dst_size);
@@ -283,7 +640,7 @@ camera_metadata_t *place_camera_metadata(void *dst,
     metadata->entry_count = 0;
     metadata->entry_capacity = entry_capacity;
     metadata->entries_start =
-            ALIGN_TO(sizeof(camera_metadata_t), ENTRY_ALIGNMENT);
+            ALIGN_TO(sizeof(camera_metadata_t) + reserved_size, ENTRY_ALIGNMENT);
     metadata->data_count = 0;
     metadata->data_capacity = data_capacity;
     metadata->size = memory_needed;
@@ -291,6 +648,19 @@ camera_metadata_t *place_camera_metadata(void *dst,
             metadata->entry_capacity) - (uint8_t*)metadata;
     metadata->data_start = ALIGN_TO(data_unaligned, DATA_ALIGNMENT);
     metadata->vendor_id = CAMERA_METADATA_INVALID_VENDOR_ID;
+    if (flags & FLAG_TAG_INDEX) {
+        camera_metadata_tag_index_t *index = (camera_metadata_tag_index_t*)
+                ((uint8_t*)metadata + sizeof(camera_metadata_t));
+        index->slot_count = calculate_tag_index_slot_count(entry_capacity);
+        metadata->flags |= FLAG_TAG_INDEX;
+        tag_index_rebuild(metadata);
+    }
+    if (flags & FLAG_MUTABLE) {
+        camera_metadata_mutable_state_t *state = (camera_metadata_mutable_state_t*)
+                ((uint8_t*)metadata + metadata->entries_start - sizeof(*state));
+        memset(state, 0, sizeof(*state));
+        metadata->flags |= FLAG_MUTABLE;
+    }
 
     assert(validate_camera_metadata_structure(metadata, NULL) == OK);
     return metadata;
@@ -301,7 +671,26 @@ void free_camera_metadata(camera_metadata_t *metadata) {
 
 size_t calculate_camera_metadata_size(size_t entry_count,
                                       size_t data_count) {
-    size_t memory_needed = sizeof(camera_metadata_t);
+    return calculate_camera_metadata_size_internal(entry_count, data_count,
+            0 /* reserved_size */);
+}
+
+size_t calculate_camera_metadata_size_with_tag_index(size_t entry_count,
+                                                     size_t data_count) {
+    return calculate_camera_metadata_size_internal(entry_count, data_count,
+            calculate_reserved_size(entry_count, FLAG_TAG_INDEX));
+}
+
+size_t calculate_camera_metadata_size_mutable(size_t entry_count,
+                                              size_t data_count) {
+    return calculate_camera_metadata_size_internal(entry_count, data_count,
+            calculate_reserved_size(entry_count, FLAG_TAG_INDEX | FLAG_MUTABLE));
+}
+
+static size_t calculate_camera_metadata_size_internal(size_t entry_count,
+                                                      size_t data_count,
+                                                      size_t reserved_size) {
+    size_t memory_needed = sizeof(camera_metadata_t) + reserved_size;
     // Start entry list at aligned boundary
     memory_needed = ALIGN_TO(memory_needed, ENTRY_ALIGNMENT);
     memory_needed += sizeof(camera_metadata_buffer_entry_t[entry_count]);
@@ -323,7 +712,7 @@ size_t get_camera_metadata_compact_size(const camera_metadata_t *metadata) {
     if (metadata == NULL) return ERROR;
 
     return calculate_camera_metadata_size(metadata->entry_count,
-                                          metadata->data_count);
+                                          get_data_used(metadata));
 }
 
 size_t get_camera_metadata_entry_count(const camera_metadata_t *metadata) {
@@ -354,17 +743,23 @@ camera_metadata_t* copy_camera_metadata(void *dst, size_t dst_size,
     }
 
     camera_metadata_t *metadata =
-        place_camera_metadata(dst, dst_size, src->entry_count, src->data_count);
+        place_camera_metadata(dst, dst_size, src->entry_count, get_data_used(src));
 
-    metadata->flags = src->flags;
+    // The compacted copy has no room for the tag index or the mutable state.
+    metadata->flags = src->flags & ~(FLAG_TAG_INDEX | FLAG_MUTABLE);
     metadata->entry_count = src->entry_count;
-    metadata->data_count = src->data_count;
     metadata->vendor_id = src->vendor_id;
 
     memcpy(get_entries(metadata), get_entries(src),
             sizeof(camera_metadata_buffer_entry_t[metadata->entry_count]));
-    memcpy(get_data(metadata), get_data(src),
-            sizeof(uint8_t[metadata->data_count]));
+    if (get_mutable_state(src) != NULL) {
+        metadata->data_count = pack_entry_data(get_data(metadata), get_entries(metadata),
+                metadata->entry_count, get_data(src));
+    } else {
+        metadata->data_count = src->data_count;
+        memcpy(get_data(metadata), get_data(src),
+                sizeof(uint8_t[metadata->data_count]));
+    }
 
     assert(validate_camera_metadata_structure(metadata, NULL) == OK);
     return metadata;
@@ -487,6 +882,59 @@ int validate_camera_metadata_structure(const camera_metadata_t *metadata,
         return CAMERA_METADATA_VALIDATION_ERROR;
     }
 
+    const size_t mutable_state_size =
+            header->flags & FLAG_MUTABLE ? sizeof(camera_metadata_mutable_state_t) : 0;
+    if (mutable_state_size != 0 &&
+            header->entries_start < sizeof(camera_metadata_t) + mutable_state_size) {
+        ALOGE("%s: Entry start (%" PRIu32 ") leaves no room for the mutable state",
+              __FUNCTION__, header->entries_start);
+        return CAMERA_METADATA_VALIDATION_ERROR;
+    }
+
+    if (header->flags & FLAG_TAG_INDEX) {
+        camera_metadata_tag_index_t index;
+        if (header->entries_start <
+                sizeof(camera_metadata_t) + sizeof(index) + mutable_state_size) {
+            ALOGE("%s: Entry start (%" PRIu32 ") leaves no room for the tag index",
+                  __FUNCTION__, header->entries_start);
+            return CAMERA_METADATA_VALIDATION_ERROR;
+        }
+        memcpy(&index, (const uint8_t*)metadata + sizeof(camera_metadata_t), sizeof(index));
+        if (index.slot_count == 0 || (index.slot_count & (index.slot_count - 1)) != 0 ||
+                index.slot_count <= header->entry_capacity ||
+                index.slot_count > (header->entries_start - sizeof(camera_metadata_t) -
+                        sizeof(index) - mutable_state_size) / sizeof(uint32_t)) {
+            ALOGE("%s: Tag index slot count (%" PRIu32 ") is invalid for entry capacity "
+                  "(%" PRIu32 ") and entry start (%" PRIu32 ")",
+                  __FUNCTION__, index.slot_count, header->entry_capacity,
+                  header->entries_start);
+            return CAMERA_METADATA_VALIDATION_ERROR;
+        }
+        // A stale index is dropped before use, an up to date one must hold each
+        // entry once, which leaves empty slots to end the probes.
+        if (index.entry_count == header->entry_count) {
+            const uint8_t *slots = (const uint8_t*)metadata + sizeof(camera_metadata_t) +
+                    sizeof(index);
+            uint32_t used_slots = 0;
+            for (uint32_t i = 0; i < index.slot_count; ++i) {
+                uint32_t slot;
+                memcpy(&slot, slots + i * sizeof(uint32_t), sizeof(slot));
+                if (slot > header->entry_count) {
+                    ALOGE("%s: Tag index slot %" PRIu32 " holds entry %" PRIu32 " beyond "
+                          "the entry count (%" PRIu32 ")",
+                          __FUNCTION__, i, slot, header->entry_count);
+                    return CAMERA_METADATA_VALIDATION_ERROR;
+                }
+                if (slot != 0) ++used_slots;
+            }
+            if (used_slots != header->entry_count) {
+                ALOGE("%s: Tag index holds %" PRIu32 " entries, expected %" PRIu32,
+                      __FUNCTION__, used_slots, header->entry_count);
+                return CAMERA_METADATA_VALIDATION_ERROR;
+            }
+        }
+    }
+
     const metadata_uptrdiff_t entries_end =
         header->entries_start + header->entry_capacity;
     if (entries_end < header->entries_start || // overflow check
@@ -513,6 +961,32 @@ int validate_camera_metadata_structure(const camera_metadata_t *metadata,
         return CAMERA_METADATA_VALIDATION_ERROR;
     }
 
+    // A stale mutable state is dropped before use, the free lists of an up to date
+    // one are followed by later changes, so must only hold slots within the data.
+    if (mutable_state_size != 0) {
+        camera_metadata_mutable_state_t state;
+        memcpy(&state, (const uint8_t*)metadata + header->entries_start - sizeof(state),
+                sizeof(state));
+        if (state.entry_count == header->entry_count &&
+                state.data_count == header->data_count) {
+            const uint8_t *data = (const uint8_t*)metadata + header->data_start;
+            for (uint32_t slot_class = 0; slot_class < DATA_SLOT_CLASS_COUNT; ++slot_class) {
+                const size_t slot_size = data_slot_size(slot_class);
+                // Each slot of the list is distinct, which bounds a list with a cycle.
+                size_t slot_count = header->data_count / slot_size;
+                for (uint32_t slot = state.free_slots[slot_class]; slot != 0; ) {
+                    if (slot_count-- == 0 || !is_data_slot_valid(header, slot - 1, slot_size)) {
+                        ALOGE("%s: Free slot offset %" PRIu32 " of size %zu is invalid for "
+                              "data count (%" PRIu32 ")",
+                              __FUNCTION__, slot - 1, slot_size, header->data_count);
+                        return CAMERA_METADATA_VALIDATION_ERROR;
+                    }
+                    memcpy(&slot, data + slot - 1, sizeof(slot));
+                }
+            }
+        }
+    }
+
     // Validate each entry
     const metadata_size_t entry_count = header->entry_count;
     camera_metadata_buffer_entry_t *entries = get_entries(metadata);
@@ -608,7 +1082,24 @@ int append_camera_metadata(camera_metadata_t *dst,
     if (src->data_count + dst->data_count < src->data_count) return ERROR;
     // Check for space
     if (dst->entry_capacity < src->entry_count + dst->entry_count) return ERROR;
-    if (dst->data_capacity < src->data_count + dst->data_count) return ERROR;
+    camera_metadata_mutable_state_t *state = get_mutable_state(dst);
+    // The data of each entry is allocated in turn, if either packet may have gaps
+    const int per_entry_data = state != NULL || get_mutable_state(src) != NULL;
+    if (per_entry_data) {
+        size_t data_needed = 0;
+        const camera_metadata_buffer_entry_t *entry = get_entries(src);
+        for (size_t i = 0; i < src->entry_count; i++, entry++) {
+            size_t data_bytes = calculate_camera_metadata_entry_data_size(entry->type,
+                    entry->count);
+            if (data_bytes > 0) {
+                data_needed += state != NULL ?
+                        data_slot_size(data_slot_class(data_bytes)) : data_bytes;
+            }
+        }
+        if (dst->data_capacity < data_needed + dst->data_count) return ERROR;
+    } else if (dst->data_capacity < src->data_count + dst->data_count) {
+        return ERROR;
+    }
 
     if ((dst->vendor_id != CAMERA_METADATA_INVALID_VENDOR_ID) &&
             (src->vendor_id != CAMERA_METADATA_INVALID_VENDOR_ID)) {
@@ -619,11 +1110,28 @@ int append_camera_metadata(camera_metadata_t *dst,
         }
     }
 
+    camera_metadata_tag_index_t *tag_index = get_tag_index_for_update(dst);
+    state = get_mutable_state_for_update(dst);
     memcpy(get_entries(dst) + dst->entry_count, get_entries(src),
             sizeof(camera_metadata_buffer_entry_t[src->entry_count]));
-    memcpy(get_data(dst) + dst->data_count, get_data(src),
-            sizeof(uint8_t[src->data_count]));
-    if (dst->data_count != 0) {
+    if (per_entry_data) {
+        camera_metadata_buffer_entry_t *entry = get_entries(dst) + dst->entry_count;
+        for (size_t i = 0; i < src->entry_count; i++, entry++) {
+            size_t data_bytes = calculate_camera_metadata_entry_data_size(entry->type,
+                    entry->count);
+            if (data_bytes > 0) {
+                const uint32_t src_offset = entry->data.offset;
+                // Cannot fail, the space was checked above
+                allocate_entry_data(dst, state, data_bytes, &entry->data.offset);
+                memcpy(get_data(dst) + entry->data.offset, get_data(src) + src_offset,
+                        data_bytes);
+            }
+        }
+    } else {
+        memcpy(get_data(dst) + dst->data_count, get_data(src),
+                sizeof(uint8_t[src->data_count]));
+    }
+    if (!per_entry_data && dst->data_count != 0) {
         camera_metadata_buffer_entry_t *entry = get_entries(dst) + dst->entry_count;
         for (size_t i = 0; i < src->entry_count; i++, entry++) {
             if ( calculate_camera_metadata_entry_data_size(entry->type,
@@ -633,16 +1141,31 @@ int append_camera_metadata(camera_metadata_t *dst,
         }
     }
     if (dst->entry_count == 0) {
-        // Appending onto empty buffer, keep sorted state
-        dst->flags |= src->flags & FLAG_SORTED;
+        // Appending onto empty buffer, keep sorted and delta state
+        dst->flags |= src->flags & (FLAG_SORTED | FLAG_DELTA);
     } else if (src->entry_count != 0) {
         // Both src, dst are nonempty, cannot assume sort remains
         dst->flags &= ~FLAG_SORTED;
     } else {
         // Src is empty, keep dst sorted state
     }
+    if (tag_index != NULL) {
+        const camera_metadata_buffer_entry_t *entry = get_entries(dst) + dst->entry_count;
+        for (size_t i = 0; i < src->entry_count; i++, entry++) {
+            if (tag_index_insert(tag_index, entry->tag, dst->entry_count + i) != OK) {
+                dst->flags &= ~FLAG_TAG_INDEX;
+                break;
+            }
+        }
+        tag_index->entry_count += src->entry_count;
+    }
     dst->entry_count += src->entry_count;
-    dst->data_count += src->data_count;
+    if (!per_entry_data) {
+        dst->data_count += src->data_count;
+    }
+    if (state != NULL) {
+        mutable_state_sync(dst, state);
+    }
 
     if (dst->vendor_id == CAMERA_METADATA_INVALID_VENDOR_ID) {
         dst->vendor_id = src->vendor_id;
@@ -652,12 +1175,161 @@ int append_camera_metadata(camera_metadata_t *dst,
     return OK;
 }
 
+// Merges the sorted entries of src into the sorted entries of dst, which has room
+// for all of them. The entries of dst are moved to the end of its capacity, and
+// merged from there to the start, which never overtakes them. A deleted entry of
+// a delta src which is chosen drops the tag. Returns whether the data of a
+// dropped entry of dst was left as a gap.
+static int merge_sorted_entries(camera_metadata_t *dst, camera_metadata_mutable_state_t *state,
+        const camera_metadata_t *src, camera_metadata_duplicate_policy_t policy) {
+    camera_metadata_buffer_entry_t *entries = get_entries(dst);
+    const camera_metadata_buffer_entry_t *src_entries = get_entries(src);
+    const size_t dst_end = dst->entry_capacity;
+    size_t dst_index = dst_end - dst->entry_count;
+    size_t src_index = 0;
+    size_t merged_count = 0;
+    int data_gap = 0;
+    memmove(entries + dst_index, entries,
+            sizeof(camera_metadata_buffer_entry_t[dst->entry_count]));
+
+    while (dst_index < dst_end || src_index < src->entry_count) {
+        uint32_t tag;
+        if (src_index == src->entry_count ||
+                (dst_index < dst_end && entries[dst_index].tag <= src_entries[src_index].tag)) {
+            tag = entries[dst_index].tag;
+        } else {
+            tag = src_entries[src_index].tag;
+        }
+
+        // Choose one of the entries of the tag, the entries of dst coming first
+        const camera_metadata_buffer_entry_t *chosen = NULL;
+        int chosen_from_dst = 0;
+        for (; dst_index < dst_end && entries[dst_index].tag == tag; ++dst_index) {
+            const camera_metadata_buffer_entry_t *dropped = entries + dst_index;
+            if (chosen == NULL || policy == CAMERA_METADATA_DUPLICATE_LAST_WINS) {
+                dropped = chosen;
+                chosen = entries + dst_index;
+                chosen_from_dst = 1;
+            }
+            if (dropped != NULL) {
+                size_t data_bytes = calculate_camera_metadata_entry_data_size(dropped->type,
+                        dropped->count);
+                if (data_bytes > 0 && state != NULL) {
+                    free_entry_data(dst, state, dropped->data.offset, data_bytes);
+                } else if (data_bytes > 0) {
+                    data_gap = 1;
+                }
+            }
+        }
+        for (; src_index < src->entry_count && src_entries[src_index].tag == tag; ++src_index) {
+            if (chosen == NULL || policy == CAMERA_METADATA_DUPLICATE_LAST_WINS) {
+                if (chosen_from_dst) {
+                    size_t data_bytes = calculate_camera_metadata_entry_data_size(
+                            chosen->type, chosen->count);
+                    if (data_bytes > 0 && state != NULL) {
+                        free_entry_data(dst, state, chosen->data.offset, data_bytes);
+                    } else if (data_bytes > 0) {
+                        data_gap = 1;
+                    }
+                }
+                chosen = src_entries + src_index;
+                chosen_from_dst = 0;
+            }
+        }
+
+        if (!chosen_from_dst && (src->flags & FLAG_DELTA) &&
+                (chosen->flags & ENTRY_FLAG_DELETED)) {
+            // The tag is removed by the delta
+            continue;
+        }
+        camera_metadata_buffer_entry_t *merged = entries + merged_count++;
+        *merged = *chosen;
+        if (!chosen_from_dst) {
+            size_t data_bytes = calculate_camera_metadata_entry_data_size(chosen->type,
+                    chosen->count);
+            if (data_bytes > 0) {
+                // Cannot fail, the space was checked by the caller
+                allocate_entry_data(dst, state, data_bytes, &merged->data.offset);
+                memcpy(get_data(dst) + merged->data.offset,
+                        get_data(src) + chosen->data.offset, data_bytes);
+            }
+        }
+    }
+    dst->entry_count = merged_count;
+    return data_gap;
+}
+
+int merge_camera_metadata(camera_metadata_t *dst,
+        const camera_metadata_t *const *srcs,
+        size_t src_count,
+        camera_metadata_duplicate_policy_t policy) {
+    if (dst == NULL || (srcs == NULL && src_count != 0)) return ERROR;
+    if (policy != CAMERA_METADATA_DUPLICATE_FIRST_WINS &&
+            policy != CAMERA_METADATA_DUPLICATE_LAST_WINS) return ERROR;
+
+    // Check for space for all the source entries, as for appending them
+    camera_metadata_mutable_state_t *state = get_mutable_state(dst);
+    metadata_vendor_id_t vendor_id = dst->vendor_id;
+    size_t entries_needed = dst->entry_count;
+    size_t data_needed = dst->data_count;
+    for (size_t i = 0; i < src_count; ++i) {
+        const camera_metadata_t *src = srcs[i];
+        if (src == NULL || src == dst) return ERROR;
+        if ((src->flags & FLAG_SORTED) == 0 && src->entry_count > 1) {
+            ALOGE("%s: Source %zu is not sorted", __FUNCTION__, i);
+            return ERROR;
+        }
+        if (vendor_id == CAMERA_METADATA_INVALID_VENDOR_ID) {
+            vendor_id = src->vendor_id;
+        } else if (src->vendor_id != CAMERA_METADATA_INVALID_VENDOR_ID &&
+                src->vendor_id != vendor_id) {
+            ALOGE("%s: Merge for metadata from different vendors is"
+                    "not supported!", __func__);
+            return ERROR;
+        }
+        entries_needed += src->entry_count;
+        const camera_metadata_buffer_entry_t *entry = get_entries(src);
+        for (size_t j = 0; j < src->entry_count; j++, entry++) {
+            size_t data_bytes = calculate_camera_metadata_entry_data_size(entry->type,
+                    entry->count);
+            if (data_bytes > 0) {
+                data_needed += state != NULL ?
+                        data_slot_size(data_slot_class(data_bytes)) : data_bytes;
+            }
+        }
+    }
+    if (dst->entry_capacity < entries_needed) return ERROR;
+    if (dst->data_capacity < data_needed) return ERROR;
+
+    sort_camera_metadata(dst);
+    const int tag_index = get_tag_index_for_update(dst) != NULL;
+    state = get_mutable_state_for_update(dst);
+    int data_gap = 0;
+    for (size_t i = 0; i < src_count; ++i) {
+        data_gap |= merge_sorted_entries(dst, state, srcs[i], policy);
+    }
+    // If the temporary copy cannot be allocated, the gaps are left as unused data
+    if (data_gap) {
+        pack_data_in_place(dst);
+    }
+    if (tag_index) {
+        tag_index_rebuild(dst);
+    }
+    if (state != NULL) {
+        mutable_state_sync(dst, state);
+    }
+    dst->vendor_id = vendor_id;
+
+    assert(validate_camera_metadata_structure(dst, NULL) == OK);
+    return OK;
+}
+
 camera_metadata_t *clone_camera_metadata(const camera_metadata_t *src) {
     int res;
     if (src == NULL) return NULL;
     camera_metadata_t *clone = allocate_camera_metadata(
         get_camera_metadata_entry_count(src),
-        get_camera_metadata_data_count(src));
+        get_data_used(src));
     if (clone != NULL) {
         res = append_camera_metadata(clone, src);
         if (res != OK) {
@@ -681,10 +1353,14 @@ static int add_camera_metadata_entry_raw(camera_metadata_t *dst,
 
     size_t data_bytes =
             calculate_camera_metadata_entry_data_size(type, data_count);
-    if (data_bytes + dst->data_count > dst->data_capacity) return ERROR;
+    camera_metadata_mutable_state_t *state = get_mutable_state_for_update(dst);
+    uint32_t data_offset = 0;
+    if (data_bytes != 0 &&
+            allocate_entry_data(dst, state, data_bytes, &data_offset) != OK) return ERROR;
 
     size_t data_payload_bytes =
             data_count * camera_metadata_type_size[type];
+    camera_metadata_tag_index_t *tag_index = get_tag_index_for_update(dst);
     camera_metadata_buffer_entry_t *entry = get_entries(dst) + dst->entry_count;
     memset(entry, 0, sizeof(camera_metadata_buffer_entry_t));
     entry->tag = tag;
@@ -695,13 +1371,21 @@ static int add_camera_metadata_entry_raw(camera_metadata_t *dst,
         memcpy(entry->data.value, data,
                 data_payload_bytes);
     } else {
-        entry->data.offset = dst->data_count;
+        entry->data.offset = data_offset;
         memcpy(get_data(dst) + entry->data.offset, data,
                 data_payload_bytes);
-        dst->data_count += data_bytes;
+    }
+    if (tag_index != NULL) {
+        if (tag_index_insert(tag_index, tag, dst->entry_count) != OK) {
+            dst->flags &= ~FLAG_TAG_INDEX;
+        }
+        tag_index->entry_count++;
     }
     dst->entry_count++;
     dst->flags &= ~FLAG_SORTED;
+    if (state != NULL) {
+        mutable_state_sync(dst, state);
+    }
     assert(validate_camera_metadata_structure(dst, NULL) == OK);
     return OK;
 }
@@ -724,6 +1408,56 @@ int add_camera_metadata_entry(camera_metadata_t *dst,
             data_count);
 }
 
+int add_camera_metadata_entry_sorted(camera_metadata_t *dst,
+        uint32_t tag,
+        const void *data,
+        size_t data_count,
+        camera_metadata_duplicate_policy_t policy) {
+    if (dst == NULL) return ERROR;
+    if (policy != CAMERA_METADATA_DUPLICATE_FIRST_WINS &&
+            policy != CAMERA_METADATA_DUPLICATE_LAST_WINS) return ERROR;
+
+    int type = get_local_camera_metadata_tag_type(tag, dst);
+    if (type == -1) {
+        ALOGE("%s: Unknown tag %04x.", __FUNCTION__, tag);
+        return ERROR;
+    }
+
+    sort_camera_metadata(dst);
+    camera_metadata_buffer_entry_t *entries = get_entries(dst);
+    size_t index = 0;
+    for (size_t end = dst->entry_count; index < end;) {
+        size_t middle = index + (end - index) / 2;
+        if (entries[middle].tag < tag) {
+            index = middle + 1;
+        } else {
+            end = middle;
+        }
+    }
+    if (index < dst->entry_count && entries[index].tag == tag) {
+        if (policy == CAMERA_METADATA_DUPLICATE_FIRST_WINS) return OK;
+        return update_camera_metadata_entry(dst, index, data, data_count, NULL);
+    }
+
+    int res = add_camera_metadata_entry_raw(dst, tag, type, data, data_count);
+    if (res != OK) return res;
+
+    // Move the added entry from the end to its sorted position
+    const size_t last = dst->entry_count - 1;
+    camera_metadata_buffer_entry_t entry = entries[last];
+    memmove(entries + index + 1, entries + index,
+            sizeof(camera_metadata_buffer_entry_t[last - index]));
+    entries[index] = entry;
+    camera_metadata_tag_index_t *tag_index = get_tag_index(dst);
+    if (tag_index != NULL) {
+        tag_index_move_last(tag_index, index);
+    }
+    dst->flags |= FLAG_SORTED;
+
+    assert(validate_camera_metadata_structure(dst, NULL) == OK);
+    return OK;
+}
+
 static int compare_entry_tags(const void *p1, const void *p2) {
     uint32_t tag1 = ((camera_metadata_buffer_entry_t*)p1)->tag;
     uint32_t tag2 = ((camera_metadata_buffer_entry_t*)p2)->tag;
@@ -740,6 +1474,9 @@ int sort_camera_metadata(camera_metadata_t *dst) {
             sizeof(camera_metadata_buffer_entry_t),
             compare_entry_tags);
     dst->flags |= FLAG_SORTED;
+    if (get_tag_index_for_update(dst) != NULL) {
+        tag_index_rebuild(dst);
+    }
 
     assert(validate_camera_metadata_structure(dst, NULL) == OK);
     return OK;
@@ -779,7 +1516,22 @@ int find_camera_metadata_entry(camera_metadata_t *src,
     if (src == NULL) return ERROR;
 
     uint32_t index;
-    if (src->flags & FLAG_SORTED) {
+    const camera_metadata_tag_index_t *tag_index = get_tag_index(src);
+    if (tag_index != NULL) {
+        // Indexed entries, probe from the hash of the tag until an empty slot
+        const camera_metadata_buffer_entry_t *entries = get_entries(src);
+        const uint32_t mask = tag_index->slot_count - 1;
+        uint32_t slot = tag_index_hash(tag_index, tag);
+        for (uint32_t probes = 0; probes < tag_index->slot_count; ++probes) {
+            index = tag_index->slots[slot];
+            if (index == 0) return NOT_FOUND;
+            if (--index < src->entry_count && entries[index].tag == tag) {
+                return get_camera_metadata_entry(src, index, entry);
+            }
+            slot = (slot + 1) & mask;
+        }
+        return NOT_FOUND;
+    } else if (src->flags & FLAG_SORTED) {
         // Sorted entries, do a binary search
         camera_metadata_buffer_entry_t *search_entry = NULL;
         camera_metadata_buffer_entry_t key;
@@ -813,6 +1565,323 @@ int find_camera_metadata_ro_entry(const camera_metadata_t *src,
             (camera_metadata_entry_t*)entry);
 }
 
+/**
+ * A validated view of a packet in a buffer which is not owned. The header is
+ * copied when validated, and each entry is checked against it when read, so
+ * that a buffer changed afterwards cannot cause reads outside of it.
+ *
+ * If the entries are not sorted, the view holds their tags and indices sorted
+ * by tag, for binary search.
+ */
+typedef struct camera_metadata_view_tag {
+    uint32_t tag;
+    uint32_t index;
+} camera_metadata_view_tag_t;
+
+struct camera_metadata_view {
+    const camera_metadata_buffer_entry_t *entries;
+    const uint8_t *data;
+    uint32_t entry_count;
+    uint32_t data_capacity;
+    uint32_t sorted;
+    camera_metadata_view_tag_t tags[];  // entry_count if not sorted
+};
+
+static int compare_view_tags(const void *p1, const void *p2) {
+    const camera_metadata_view_tag_t *tag1 = (const camera_metadata_view_tag_t*)p1;
+    const camera_metadata_view_tag_t *tag2 = (const camera_metadata_view_tag_t*)p2;
+    return  tag1->tag < tag2->tag ? -1 :
+            tag1->tag > tag2->tag ? 1 :
+            tag1->index < tag2->index ? -1 :
+            tag1->index > tag2->index;
+}
+
+static int are_entries_sorted(const camera_metadata_buffer_entry_t *entries,
+        size_t entry_count) {
+    for (size_t i = 1; i < entry_count; ++i) {
+        if (entries[i - 1].tag > entries[i].tag) return 0;
+    }
+    return 1;
+}
+
+// Fills tags with the tags and indices of the entries, sorted by tag then index.
+static void sort_entry_tags(const camera_metadata_buffer_entry_t *entries,
+        size_t entry_count, camera_metadata_view_tag_t *tags) {
+    for (size_t i = 0; i < entry_count; ++i) {
+        tags[i].tag = entries[i].tag;
+        tags[i].index = i;
+    }
+    qsort(tags, entry_count, sizeof(camera_metadata_view_tag_t), compare_view_tags);
+}
+
+camera_metadata_view_t *allocate_camera_metadata_view(const void *buffer,
+        size_t buffer_size) {
+    if (buffer == NULL) return NULL;
+    if (ALIGN_TO(buffer, METADATA_PACKET_ALIGNMENT) != (uintptr_t)buffer) {
+        ALOGE("%s: Buffer %p is not aligned for a view, it must be copied",
+                __FUNCTION__, buffer);
+        return NULL;
+    }
+
+    // The view only uses this copy of the header, which must be the one validated
+    const camera_metadata_t *metadata = (const camera_metadata_t*)buffer;
+    camera_metadata_t header;
+    if (buffer_size < sizeof(camera_metadata_t)) {
+        ALOGE("%s: Buffer size (%zu) is too small for the header", __FUNCTION__, buffer_size);
+        return NULL;
+    }
+    memcpy(&header, metadata, sizeof(header));
+    if (header.entries_start > buffer_size ||
+            sizeof(camera_metadata_buffer_entry_t[header.entry_count]) >
+                    buffer_size - header.entries_start) {
+        ALOGE("%s: Buffer size (%zu) is too small for the entries", __FUNCTION__, buffer_size);
+        return NULL;
+    }
+    if (validate_camera_metadata_structure(metadata, &buffer_size) != OK) {
+        return NULL;
+    }
+    if (memcmp(&header, metadata, sizeof(header)) != 0) {
+        ALOGE("%s: Header changed during validation", __FUNCTION__);
+        return NULL;
+    }
+
+    const uint32_t entry_count = header.entry_count;
+    const camera_metadata_buffer_entry_t *entries = (const camera_metadata_buffer_entry_t*)
+            ((const uint8_t*)buffer + header.entries_start);
+    const int sorted = are_entries_sorted(entries, entry_count);
+
+    camera_metadata_view_t *view = calloc(1, sizeof(camera_metadata_view_t) +
+            (sorted ? 0 : sizeof(camera_metadata_view_tag_t[entry_count])));
+    if (view == NULL) {
+        ALOGE("%s: Failed to allocate the view", __FUNCTION__);
+        return NULL;
+    }
+    view->entries = entries;
+    view->data = (const uint8_t*)buffer + header.data_start;
+    view->entry_count = entry_count;
+    view->data_capacity = header.data_capacity;
+    view->sorted = sorted;
+    if (!sorted) {
+        sort_entry_tags(entries, entry_count, view->tags);
+    }
+    return view;
+}
+
+void free_camera_metadata_view(camera_metadata_view_t *view) {
+    free(view);
+}
+
+size_t get_camera_metadata_view_entry_count(const camera_metadata_view_t *view) {
+    return view->entry_count;
+}
+
+int get_camera_metadata_view_ro_entry(const camera_metadata_view_t *view,
+        size_t index,
+        camera_metadata_ro_entry_t *entry) {
+    if (view == NULL || entry == NULL) return ERROR;
+    if (index >= view->entry_count) return ERROR;
+
+    // Read the entry once, and check it again in case the buffer was changed
+    camera_metadata_buffer_entry_t buffer_entry;
+    memcpy(&buffer_entry, view->entries + index, sizeof(buffer_entry));
+    size_t data_size;
+    if (validate_and_calculate_camera_metadata_entry_data_size(&data_size, buffer_entry.type,
+            buffer_entry.count) != OK) {
+        ALOGE("%s: Entry index %zu changed to an invalid type or count", __FUNCTION__, index);
+        return ERROR;
+    }
+    if (data_size != 0 && (buffer_entry.data.offset % DATA_ALIGNMENT != 0 ||
+            buffer_entry.data.offset > view->data_capacity ||
+            data_size > view->data_capacity - buffer_entry.data.offset)) {
+        ALOGE("%s: Entry index %zu changed to data beyond the capacity", __FUNCTION__, index);
+        return ERROR;
+    }
+
+    entry->index = index;
+    entry->tag = buffer_entry.tag;
+    entry->type = buffer_entry.type;
+    entry->count = buffer_entry.count;
+    if (data_size != 0) {
+        entry->data.u8 = view->data + buffer_entry.data.offset;
+    } else {
+        entry->data.u8 = view->entries[index].data.value;
+    }
+    return OK;
+}
+
+int find_camera_metadata_view_ro_entry(const camera_metadata_view_t *view,
+        uint32_t tag,
+        camera_metadata_ro_entry_t *entry) {
+    if (view == NULL) return ERROR;
+
+    // Binary search for the first entry of the tag
+    const camera_metadata_buffer_entry_t *entries = view->entries;
+    size_t begin = 0;
+    for (size_t end = view->entry_count; begin < end;) {
+        size_t middle = begin + (end - begin) / 2;
+        uint32_t middle_tag = view->sorted ? entries[middle].tag : view->tags[middle].tag;
+        if (middle_tag < tag) {
+            begin = middle + 1;
+        } else {
+            end = middle;
+        }
+    }
+    if (begin == view->entry_count) return NOT_FOUND;
+    size_t index = view->sorted ? begin : view->tags[begin].index;
+
+    camera_metadata_ro_entry_t found;
+    int res = get_camera_metadata_view_ro_entry(view, index, &found);
+    if (res != OK) return res;
+    if (found.tag != tag) return NOT_FOUND;
+    if (entry != NULL) *entry = found;
+    return OK;
+}
+
+// The entries of a packet in tag order, through a sorted table if not sorted.
+typedef struct camera_metadata_tag_order {
+    const camera_metadata_t *metadata;
+    camera_metadata_view_tag_t *tags;  // NULL if the entries are sorted
+} camera_metadata_tag_order_t;
+
+static int get_tag_order(const camera_metadata_t *metadata,
+        camera_metadata_tag_order_t *order) {
+    order->metadata = metadata;
+    order->tags = NULL;
+    const camera_metadata_buffer_entry_t *entries = get_entries(metadata);
+    if ((metadata->flags & FLAG_SORTED) || are_entries_sorted(entries, metadata->entry_count)) {
+        return OK;
+    }
+    order->tags = malloc(sizeof(camera_metadata_view_tag_t[metadata->entry_count]));
+    if (order->tags == NULL) {
+        ALOGE("%s: Failed to allocate the tag order", __FUNCTION__);
+        return ERROR;
+    }
+    sort_entry_tags(entries, metadata->entry_count, order->tags);
+    return OK;
+}
+
+static const camera_metadata_buffer_entry_t *get_tag_order_entry(
+        const camera_metadata_tag_order_t *order, size_t position) {
+    return get_entries(order->metadata) +
+            (order->tags != NULL ? order->tags[position].index : position);
+}
+
+// Returns the position after the entries of the tag at position.
+static size_t skip_tag_order_entries(const camera_metadata_tag_order_t *order,
+        size_t position) {
+    const uint32_t tag = get_tag_order_entry(order, position)->tag;
+    while (++position < order->metadata->entry_count &&
+            get_tag_order_entry(order, position)->tag == tag) {}
+    return position;
+}
+
+// Compares the first entries of each tag of prev and cur in tag order. The changed
+// entries of cur, and deleted entries for the tags only in prev, are added to the
+// delta if not NULL, and counted otherwise.
+static int diff_entries(const camera_metadata_tag_order_t *prev,
+        const camera_metadata_tag_order_t *cur, camera_metadata_t *delta,
+        size_t *entry_count, size_t *data_count) {
+    size_t prev_position = 0;
+    size_t cur_position = 0;
+    const size_t prev_end = prev->metadata->entry_count;
+    const size_t cur_end = cur->metadata->entry_count;
+    while (prev_position < prev_end || cur_position < cur_end) {
+        const camera_metadata_buffer_entry_t *prev_entry = prev_position < prev_end ?
+                get_tag_order_entry(prev, prev_position) : NULL;
+        const camera_metadata_buffer_entry_t *cur_entry = cur_position < cur_end ?
+                get_tag_order_entry(cur, cur_position) : NULL;
+        const camera_metadata_buffer_entry_t *deleted = NULL;
+        const camera_metadata_buffer_entry_t *changed = NULL;
+        if (cur_entry == NULL || (prev_entry != NULL && prev_entry->tag < cur_entry->tag)) {
+            deleted = prev_entry;
+            prev_position = skip_tag_order_entries(prev, prev_position);
+        } else if (prev_entry == NULL || cur_entry->tag < prev_entry->tag) {
+            changed = cur_entry;
+            cur_position = skip_tag_order_entries(cur, cur_position);
+        } else {
+            camera_metadata_ro_entry_t prev_data, cur_data;
+            if (get_camera_metadata_ro_entry(prev->metadata,
+                    prev_entry - get_entries(prev->metadata), &prev_data) != OK ||
+                    get_camera_metadata_ro_entry(cur->metadata,
+                    cur_entry - get_entries(cur->metadata), &cur_data) != OK) {
+                return ERROR;
+            }
+            if (prev_data.type != cur_data.type || prev_data.count != cur_data.count ||
+                    memcmp(prev_data.data.u8, cur_data.data.u8,
+                            cur_data.count * camera_metadata_type_size[cur_data.type]) != 0) {
+                changed = cur_entry;
+            }
+            prev_position = skip_tag_order_entries(prev, prev_position);
+            cur_position = skip_tag_order_entries(cur, cur_position);
+        }
+
+        if (deleted != NULL) {
+            if (delta != NULL) {
+                if (add_camera_metadata_entry_raw(delta, deleted->tag, deleted->type,
+                        deleted->data.value, 0) != OK) return ERROR;
+                get_entries(delta)[delta->entry_count - 1].flags = ENTRY_FLAG_DELETED;
+            }
+            ++*entry_count;
+        } else if (changed != NULL) {
+            if (delta != NULL) {
+                camera_metadata_ro_entry_t entry;
+                if (get_camera_metadata_ro_entry(cur->metadata,
+                        changed - get_entries(cur->metadata), &entry) != OK) return ERROR;
+                if (add_camera_metadata_entry_raw(delta, entry.tag, entry.type,
+                        entry.data.u8, entry.count) != OK) return ERROR;
+            }
+            ++*entry_count;
+            *data_count += calculate_camera_metadata_entry_data_size(changed->type,
+                    changed->count);
+        }
+    }
+    return OK;
+}
+
+camera_metadata_t *diff_camera_metadata(const camera_metadata_t *prev,
+        const camera_metadata_t *cur) {
+    if (prev == NULL || cur == NULL) return NULL;
+    if (prev->vendor_id != CAMERA_METADATA_INVALID_VENDOR_ID &&
+            cur->vendor_id != CAMERA_METADATA_INVALID_VENDOR_ID &&
+            prev->vendor_id != cur->vendor_id) {
+        ALOGE("%s: Diff for metadata from different vendors is"
+                "not supported!", __func__);
+        return NULL;
+    }
+
+    camera_metadata_tag_order_t prev_order = {prev, NULL};
+    camera_metadata_tag_order_t cur_order = {cur, NULL};
+    camera_metadata_t *delta = NULL;
+    size_t entry_count = 0;
+    size_t data_count = 0;
+    // Count the delta entries and data, then add them
+    if (get_tag_order(prev, &prev_order) == OK && get_tag_order(cur, &cur_order) == OK &&
+            diff_entries(&prev_order, &cur_order, NULL, &entry_count, &data_count) == OK) {
+        delta = allocate_camera_metadata(entry_count, data_count);
+    }
+    if (delta != NULL) {
+        delta->vendor_id = cur->vendor_id;
+        if (diff_entries(&prev_order, &cur_order, delta, &entry_count, &data_count) == OK) {
+            // The entries were added in tag order
+            delta->flags |= FLAG_SORTED | FLAG_DELTA;
+            assert(validate_camera_metadata_structure(delta, NULL) == OK);
+        } else {
+            free_camera_metadata(delta);
+            delta = NULL;
+        }
+    }
+    free(prev_order.tags);
+    free(cur_order.tags);
+    return delta;
+}
+
+int apply_camera_metadata_delta(camera_metadata_t *base,
+        const camera_metadata_t *delta) {
+    if (base == NULL || delta == NULL) return ERROR;
+
+    return merge_camera_metadata(base, &delta, 1, CAMERA_METADATA_DUPLICATE_LAST_WINS);
+}
+
 
 int delete_camera_metadata_entry(camera_metadata_t *dst,
         size_t index) {
@@ -823,7 +1892,16 @@ int delete_camera_metadata_entry(camera_metadata_t *dst,
     size_t data_bytes = calculate_camera_metadata_entry_data_size(entry->type,
             entry->count);
 
-    if (data_bytes > 0) {
+    camera_metadata_tag_index_t *tag_index = get_tag_index_for_update(dst);
+    if (tag_index != NULL && tag_index_remove(dst, tag_index, index) != OK) {
+        dst->flags &= ~FLAG_TAG_INDEX;
+    }
+    camera_metadata_mutable_state_t *state = get_mutable_state_for_update(dst);
+
+    if (data_bytes > 0 && state != NULL) {
+        // Free the data slot, the data of the other entries stay in place
+        free_entry_data(dst, state, entry->data.offset, data_bytes);
+    } else if (data_bytes > 0) {
         // Shift data buffer to overwrite deleted data
         uint8_t *start = get_data(dst) + entry->data.offset;
         uint8_t *end = start + data_bytes;
@@ -848,6 +1926,9 @@ int delete_camera_metadata_entry(camera_metadata_t *dst,
             sizeof(camera_metadata_buffer_entry_t) *
             (dst->entry_count - index - 1) );
     dst->entry_count -= 1;
+    if (state != NULL) {
+        mutable_state_sync(dst, state);
+    }
 
     assert(validate_camera_metadata_structure(dst, NULL) == OK);
     return OK;
@@ -872,7 +1953,29 @@ int update_camera_metadata_entry(camera_metadata_t *dst,
     size_t entry_bytes =
             calculate_camera_metadata_entry_data_size(entry->type,
                     entry->count);
-    if (data_bytes != entry_bytes) {
+    camera_metadata_mutable_state_t *state = get_mutable_state_for_update(dst);
+    if (state != NULL) {
+        if (data_bytes != 0 && entry_bytes != 0 &&
+                data_slot_class(data_bytes) == data_slot_class(entry_bytes)) {
+            // The new data fits in the same slot
+            state->data_used = state->data_used - entry_bytes + data_bytes;
+        } else if (data_bytes != entry_bytes) {
+            uint32_t data_offset = 0;
+            if (data_bytes != 0 &&
+                    allocate_entry_data(dst, state, data_bytes, &data_offset) != OK) {
+                // No room
+                return ERROR;
+            }
+            if (entry_bytes != 0) {
+                free_entry_data(dst, state, entry->data.offset, entry_bytes);
+            }
+            entry->data.offset = data_offset;
+        }
+        if (data_bytes != 0) {
+            memcpy(get_data(dst) + entry->data.offset, data, data_payload_bytes);
+        }
+        mutable_state_sync(dst, state);
+    } else if (data_bytes != entry_bytes) {
         // May need to shift/add to data array
         if (dst->data_capacity < dst->data_count + data_bytes - entry_bytes) {
             // No room
@@ -929,13 +2032,369 @@ int update_camera_metadata_entry(camera_metadata_t *dst,
     return OK;
 }
 
+int compact_camera_metadata(camera_metadata_t *dst) {
+    if (dst == NULL) return ERROR;
+
+    if (pack_data_in_place(dst) != OK) return ERROR;
+    dst->flags &= ~FLAG_MUTABLE;
+
+    assert(validate_camera_metadata_structure(dst, NULL) == OK);
+    return OK;
+}
+
 static const vendor_tag_ops_t *vendor_tag_ops = NULL;
 static const struct vendor_tag_cache_ops *vendor_cache_ops = NULL;
 
+/**
+ * A table of the vendor tags of vendor_tag_ops (for CAMERA_METADATA_INVALID_VENDOR_ID)
+ * or of vendor_cache_ops for a vendor id, so that the vendor tag queries are
+ * array loads as for the Android tags, rather than calls to the ops.
+ *
+ * The tables are built on first use from the tags listed by the ops. The sections
+ * from the lowest listed are indexed directly, up to VENDOR_TAG_CACHE_MAX_SECTIONS.
+ * A section holds its tags from the lowest to the highest listed, unless they are
+ * sparse, in which case it holds only the listed tags, which are binary searched.
+ * Entries of tags not listed have type -1. The tags without an entry with a type
+ * are queried from the ops. The names are copied into the table, so they stay valid
+ * after the ops are changed.
+ */
+typedef struct vendor_tag_cache_entry {
+    const char *section_name;
+    const char *tag_name;
+    int         tag_type;
+} vendor_tag_cache_entry_t;
+
+typedef struct vendor_tag_cache_section {
+    uint32_t start;        // lowest tag & 0xFFFF
+    uint32_t end;          // highest tag & 0xFFFF + 1, or start if no tags
+    uint32_t first_entry;  // entry of start
+    uint32_t sparse_count; // number of entries if sparse, otherwise 0
+} vendor_tag_cache_section_t;
+
+typedef struct vendor_tag_cache_table {
+    struct vendor_tag_cache_table *next_retired;
+    metadata_vendor_id_t id;
+    uint32_t generation;     // vendor_tag_cache_generation when built
+    uint32_t first_section;  // tag >> 16 of sections[0]
+    uint32_t section_count;
+    vendor_tag_cache_section_t *sections;
+    vendor_tag_cache_entry_t *entries;
+    uint16_t *sparse_tags;   // tag & 0xFFFF of each entry of the sparse sections
+    char *names;             // the section and tag names of the entries
+} vendor_tag_cache_table_t;
+
+#define VENDOR_TAG_CACHE_MAX_SECTIONS 64
+
+/**
+ * The tables are looked up without locks, in a hash table of slots by vendor id.
+ * A table is published in an empty slot, or one of a previous generation, by
+ * compare and exchange. Setting the ops starts a new generation, which ignores
+ * the tables built before. If the slots probed all hold current tables of other
+ * vendor ids, the queries are made to the ops as before, without building a table.
+ *
+ * Replaced tables may still be read by a lookup in progress, and the names returned
+ * from them by its caller, so they are retired rather than freed, and kept until the
+ * process exits. The lookups make no writes to shared state once the table of their
+ * vendor id is built. As a table is only replaced when the ops are set, at most
+ * VENDOR_TAG_CACHE_SLOT_COUNT tables are retired each time.
+ */
+#define VENDOR_TAG_CACHE_SLOT_BITS 3
+#define VENDOR_TAG_CACHE_SLOT_COUNT (1 << VENDOR_TAG_CACHE_SLOT_BITS)
+static _Atomic(vendor_tag_cache_table_t *) vendor_tag_cache_slots[VENDOR_TAG_CACHE_SLOT_COUNT];
+static _Atomic(vendor_tag_cache_table_t *) vendor_tag_cache_retired;
+static atomic_uint vendor_tag_cache_generation;
+
+static uint32_t vendor_tag_cache_home_slot(metadata_vendor_id_t id) {
+    return (uint32_t)((id * 0x9E3779B97F4A7C15ull) >> (64 - VENDOR_TAG_CACHE_SLOT_BITS));
+}
+
+// Returns whether a table was built before the ops of generation were set.
+static int is_vendor_tag_cache_table_stale(const vendor_tag_cache_table_t *table,
+        uint32_t generation) {
+    return (int32_t)(table->generation - generation) < 0;
+}
+
+static void retire_vendor_tag_cache_table(vendor_tag_cache_table_t *table) {
+    table->next_retired = atomic_load(&vendor_tag_cache_retired);
+    while (!atomic_compare_exchange_weak(&vendor_tag_cache_retired, &table->next_retired,
+            table)) {}
+}
+
+// Frees a table which was never published.
+static void free_vendor_tag_cache_table(vendor_tag_cache_table_t *table) {
+    free(table->names);
+    free(table);
+}
+
+// Drops all the tables, after the ops changed.
+static void invalidate_vendor_tag_cache(void) {
+    atomic_fetch_add(&vendor_tag_cache_generation, 1);
+    for (size_t i = 0; i < VENDOR_TAG_CACHE_SLOT_COUNT; ++i) {
+        vendor_tag_cache_table_t *table = atomic_exchange(&vendor_tag_cache_slots[i], NULL);
+        if (table != NULL) retire_vendor_tag_cache_table(table);
+    }
+}
+
+static int compare_tags(const void *p1, const void *p2) {
+    uint32_t tag1 = *(const uint32_t*)p1;
+    uint32_t tag2 = *(const uint32_t*)p2;
+    return  tag1 < tag2 ? -1 :
+            tag1 == tag2 ? 0 :
+            1;
+}
+
+// Returns the number of entries of a section of count > 0 sorted distinct tags,
+// and whether they are too sparse to hold every tag from the lowest to the highest.
+static size_t calculate_vendor_tag_cache_section_size(const uint32_t *tags, size_t count,
+        int *sparse) {
+    const size_t span = (tags[count - 1] & 0xFFFF) - (tags[0] & 0xFFFF) + 1;
+    *sparse = span > 2 * count + 8;
+    return *sparse ? count : span;
+}
+
+// Builds the table of the vendor tags of the ops for id. Returns NULL on allocation
+// failure, or an empty table if the ops list no tags.
+static vendor_tag_cache_table_t *build_vendor_tag_cache_table(metadata_vendor_id_t id,
+        uint32_t generation) {
+    const int use_cache_ops = id != CAMERA_METADATA_INVALID_VENDOR_ID;
+    int tag_count = use_cache_ops ? vendor_cache_ops->get_tag_count(id) :
+            vendor_tag_ops->get_tag_count(vendor_tag_ops);
+    uint32_t *tags = NULL;
+    if (tag_count > 0) {
+        tags = malloc(sizeof(uint32_t[tag_count]));
+        if (tags == NULL) return NULL;
+        if (use_cache_ops) {
+            vendor_cache_ops->get_all_tags(tags, id);
+        } else {
+            vendor_tag_ops->get_all_tags(vendor_tag_ops, tags);
+        }
+        qsort(tags, tag_count, sizeof(uint32_t), compare_tags);
+    } else {
+        tag_count = 0;
+    }
+
+    // Keep each vendor tag once, in the sections indexed
+    size_t count = 0;
+    for (int i = 0; i < tag_count; ++i) {
+        if (tags[i] >> 16 < VENDOR_SECTION) continue;
+        if (count > 0 &&
+                (tags[i] >> 16) - (tags[0] >> 16) >= VENDOR_TAG_CACHE_MAX_SECTIONS) break;
+        if (count == 0 || tags[i] != tags[count - 1]) tags[count++] = tags[i];
+    }
+    const uint32_t first_section = count > 0 ? tags[0] >> 16 : 0;
+    const size_t section_count = count > 0 ? (tags[count - 1] >> 16) - first_section + 1 : 0;
+
+    size_t entry_count = 0;
+    for (size_t i = 0, end; i < count; i = end) {
+        for (end = i + 1; end < count && tags[end] >> 16 == tags[i] >> 16; ++end) {}
+        int sparse;
+        entry_count += calculate_vendor_tag_cache_section_size(tags + i, end - i, &sparse);
+    }
+
+    vendor_tag_cache_table_t *table = malloc(sizeof(vendor_tag_cache_table_t) +
+            sizeof(vendor_tag_cache_section_t[section_count]) +
+            sizeof(vendor_tag_cache_entry_t[entry_count]) +
+            sizeof(uint16_t[entry_count]));
+    if (table == NULL) {
+        free(tags);
+        return NULL;
+    }
+    table->next_retired = NULL;
+    table->names = NULL;
+    table->id = id;
+    table->generation = generation;
+    table->first_section = first_section;
+    table->section_count = section_count;
+    table->sections = (vendor_tag_cache_section_t*)(table + 1);
+    table->entries = (vendor_tag_cache_entry_t*)(table->sections + section_count);
+    table->sparse_tags = (uint16_t*)(table->entries + entry_count);
+    memset(table->sections, 0, sizeof(vendor_tag_cache_section_t[section_count]));
+    for (size_t i = 0; i < entry_count; ++i) {
+        table->entries[i].section_name = NULL;
+        table->entries[i].tag_name = NULL;
+        table->entries[i].tag_type = -1;
+    }
+
+    size_t next_entry = 0;
+    for (size_t i = 0, end; i < count; i = end) {
+        for (end = i + 1; end < count && tags[end] >> 16 == tags[i] >> 16; ++end) {}
+        vendor_tag_cache_section_t *section = table->sections + (tags[i] >> 16) - first_section;
+        int sparse;
+        const size_t size = calculate_vendor_tag_cache_section_size(tags + i, end - i, &sparse);
+        section->start = tags[i] & 0xFFFF;
+        section->end = (tags[end - 1] & 0xFFFF) + 1;
+        section->first_entry = next_entry;
+        section->sparse_count = sparse ? size : 0;
+        for (size_t j = i; j < end; ++j) {
+            const uint32_t tag = tags[j];
+            const size_t entry_index = next_entry +
+                    (sparse ? j - i : (tag & 0xFFFF) - section->start);
+            vendor_tag_cache_entry_t *entry = table->entries + entry_index;
+            table->sparse_tags[entry_index] = tag & 0xFFFF;
+            if (use_cache_ops) {
+                entry->section_name = vendor_cache_ops->get_section_name(tag, id);
+                entry->tag_name = vendor_cache_ops->get_tag_name(tag, id);
+                entry->tag_type = vendor_cache_ops->get_tag_type(tag, id);
+            } else {
+                entry->section_name = vendor_tag_ops->get_section_name(vendor_tag_ops, tag);
+                entry->tag_name = vendor_tag_ops->get_tag_name(vendor_tag_ops, tag);
+                entry->tag_type = vendor_tag_ops->get_tag_type(vendor_tag_ops, tag);
+            }
+        }
+        next_entry += size;
+    }
+    free(tags);
+
+    // Copy the names, once for the consecutive entries of a section name
+    size_t names_size = 0;
+    for (size_t i = 0; i < entry_count; ++i) {
+        const vendor_tag_cache_entry_t *entry = table->entries + i;
+        if (entry->section_name != NULL &&
+                (i == 0 || entry->section_name != entry[-1].section_name)) {
+            names_size += strlen(entry->section_name) + 1;
+        }
+        if (entry->tag_name != NULL) names_size += strlen(entry->tag_name) + 1;
+    }
+    if (names_size > 0) {
+        table->names = malloc(names_size);
+        if (table->names == NULL) {
+            free(table);
+            return NULL;
+        }
+    }
+    char *name = table->names;
+    const char *last_section_name = NULL;
+    const char *last_section_copy = NULL;
+    for (size_t i = 0; i < entry_count; ++i) {
+        vendor_tag_cache_entry_t *entry = table->entries + i;
+        if (entry->section_name != NULL) {
+            if (entry->section_name != last_section_name) {
+                last_section_name = entry->section_name;
+                last_section_copy = name;
+                const size_t size = strlen(entry->section_name) + 1;
+                memcpy(name, entry->section_name, size);
+                name += size;
+            }
+            entry->section_name = last_section_copy;
+        }
+        if (entry->tag_name != NULL) {
+            const size_t size = strlen(entry->tag_name) + 1;
+            memcpy(name, entry->tag_name, size);
+            entry->tag_name = name;
+            name += size;
+        }
+    }
+    return table;
+}
+
+// Builds the table of id, and publishes it in the empty or stale slot, or a later
+// one of its probe sequence. Returns the table of id published, which may be another
+// thread's, or NULL if none could be.
+static vendor_tag_cache_table_t *publish_vendor_tag_cache_table(metadata_vendor_id_t id,
+        uint32_t generation, uint32_t slot, uint32_t probes) {
+    vendor_tag_cache_table_t *table = build_vendor_tag_cache_table(id, generation);
+    if (table == NULL) return NULL;
+    while (probes < VENDOR_TAG_CACHE_SLOT_COUNT) {
+        vendor_tag_cache_table_t *slot_table = atomic_load(&vendor_tag_cache_slots[slot]);
+        if (slot_table == NULL || is_vendor_tag_cache_table_stale(slot_table, generation)) {
+            if (atomic_compare_exchange_strong(&vendor_tag_cache_slots[slot], &slot_table,
+                    table)) {
+                if (slot_table != NULL) retire_vendor_tag_cache_table(slot_table);
+                return table;
+            }
+            // another thread changed the slot first, look at it again
+            continue;
+        }
+        if (slot_table->id == id) {
+            free_vendor_tag_cache_table(table);
+            return slot_table;
+        }
+        slot = (slot + 1) & (VENDOR_TAG_CACHE_SLOT_COUNT - 1);
+        ++probes;
+    }
+    free_vendor_tag_cache_table(table);
+    return NULL;
+}
+
+static const vendor_tag_cache_entry_t *find_vendor_tag_cache_entry(
+        const vendor_tag_cache_table_t *table, uint32_t tag) {
+    // below the first section wraps around to beyond the last
+    const uint32_t section_index = (tag >> 16) - table->first_section;
+    if (section_index >= table->section_count) return NULL;
+    const vendor_tag_cache_section_t *section = table->sections + section_index;
+    const uint32_t index = tag & 0xFFFF;
+    if (index < section->start || index >= section->end) return NULL;
+
+    uint32_t entry_index = index - section->start;
+    if (section->sparse_count != 0) {
+        const uint16_t *sparse_tags = table->sparse_tags + section->first_entry;
+        uint32_t low = 0;
+        uint32_t high = section->sparse_count;
+        while (low < high) {
+            const uint32_t middle = low + (high - low) / 2;
+            if (sparse_tags[middle] < index) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        if (low == section->sparse_count || sparse_tags[low] != index) return NULL;
+        entry_index = low;
+    }
+    const vendor_tag_cache_entry_t *entry = table->entries + section->first_entry + entry_index;
+    return entry->tag_type != -1 ? entry : NULL;
+}
+
+// Copies the cached vendor tag to cached. Returns NOT_FOUND if it must be queried
+// from the ops.
+static int get_vendor_tag_cache_entry(uint32_t tag, metadata_vendor_id_t id,
+        vendor_tag_cache_entry_t *cached) {
+    if (vendor_cache_ops == NULL || id == CAMERA_METADATA_INVALID_VENDOR_ID) {
+        if (vendor_tag_ops == NULL) return NOT_FOUND;
+        id = CAMERA_METADATA_INVALID_VENDOR_ID;
+    }
+
+    const uint32_t generation = atomic_load(&vendor_tag_cache_generation);
+    vendor_tag_cache_table_t *table = NULL;
+    uint32_t slot = vendor_tag_cache_home_slot(id);
+    uint32_t probes = 0;
+    int free_slot = -1;
+    uint32_t free_probes = 0;
+    for (; probes < VENDOR_TAG_CACHE_SLOT_COUNT; ++probes) {
+        vendor_tag_cache_table_t *slot_table = atomic_load(&vendor_tag_cache_slots[slot]);
+        if (slot_table == NULL || is_vendor_tag_cache_table_stale(slot_table, generation)) {
+            if (free_slot < 0) {
+                free_slot = slot;
+                free_probes = probes;
+            }
+            // the slots are only emptied all at once, so the probe ends at an empty slot
+            if (slot_table == NULL) break;
+        } else if (slot_table->id == id) {
+            table = slot_table;
+            break;
+        }
+        slot = (slot + 1) & (VENDOR_TAG_CACHE_SLOT_COUNT - 1);
+    }
+    if (table == NULL && free_slot >= 0) {
+        // First use in this generation
+        table = publish_vendor_tag_cache_table(id, generation, free_slot, free_probes);
+    }
+
+    const vendor_tag_cache_entry_t *entry =
+            table != NULL ? find_vendor_tag_cache_entry(table, tag) : NULL;
+    if (entry == NULL) return NOT_FOUND;
+    *cached = *entry;
+    return OK;
+}
+
 // Declared in system/media/private/camera/include/camera_metadata_hidden.h
 const char *get_local_camera_metadata_section_name_vendor_id(uint32_t tag,
         metadata_vendor_id_t id) {
     uint32_t tag_section = tag >> 16;
+    if (tag_section >= VENDOR_SECTION) {
+        vendor_tag_cache_entry_t cached;
+        if (get_vendor_tag_cache_entry(tag, id, &cached) == OK) return cached.section_name;
+    }
     if (tag_section >= VENDOR_SECTION && vendor_cache_ops != NULL &&
                id != CAMERA_METADATA_INVALID_VENDOR_ID) {
            return vendor_cache_ops->get_section_name(tag, id);
@@ -954,6 +2413,10 @@ const char *get_local_camera_metadata_section_name_vendor_id(uint32_t tag,
 const char *get_local_camera_metadata_tag_name_vendor_id(uint32_t tag,
         metadata_vendor_id_t id) {
     uint32_t tag_section = tag >> 16;
+    if (tag_section >= VENDOR_SECTION) {
+        vendor_tag_cache_entry_t cached;
+        if (get_vendor_tag_cache_entry(tag, id, &cached) == OK) return cached.tag_name;
+    }
     if (tag_section >= VENDOR_SECTION && vendor_cache_ops != NULL &&
                 id != CAMERA_METADATA_INVALID_VENDOR_ID) {
             return vendor_cache_ops->get_tag_name(tag, id);
@@ -974,6 +2437,10 @@ const char *get_local_camera_metadata_tag_name_vendor_id(uint32_t tag,
 int get_local_camera_metadata_tag_type_vendor_id(uint32_t tag,
         metadata_vendor_id_t id) {
     uint32_t tag_section = tag >> 16;
+    if (tag_section >= VENDOR_SECTION) {
+        vendor_tag_cache_entry_t cached;
+        if (get_vendor_tag_cache_entry(tag, id, &cached) == OK) return cached.tag_type;
+    }
     if (tag_section >= VENDOR_SECTION && vendor_cache_ops != NULL &&
                 id != CAMERA_METADATA_INVALID_VENDOR_ID) {
             return vendor_cache_ops->get_tag_type(tag, id);
@@ -1045,6 +2512,7 @@ int set_camera_metadata_vendor_tag_ops(const vendor_tag_query_ops_t* ops) {
 // Declared in system/media/private/camera/include/camera_metadata_hidden.h
 int set_camera_metadata_vendor_ops(const vendor_tag_ops_t* ops) {
     vendor_tag_ops = ops;
+    invalidate_vendor_tag_cache();
     return OK;
 }
 
@@ -1052,6 +2520,7 @@ int set_camera_metadata_vendor_ops(const vendor_tag_ops_t* ops) {
 int set_camera_metadata_vendor_cache_ops(
         const struct vendor_tag_cache_ops *query_cache_ops) {
     vendor_cache_ops = query_cache_ops;
+    invalidate_vendor_tag_cache();
     return OK;
 }
 
@@ -19,6 +19,7 @@
 
 #include <errno.h>
 
+#include <map>
 #include <vector>
 #include <algorithm>
 
@@ -873,6 +874,168 @@ TEST(camera_metadata, vendor_tags) {
     FINISH_USING_CAMERA_METADATA(m);
 }
 
+static int counting_vendor_tag_count_calls = 0;
+static int counting_vendor_tag_type_calls = 0;
+
+static int get_counting_vendor_tag_count(const vendor_tag_ops_t *) {
+    counting_vendor_tag_count_calls++;
+    return get_fakevendor_tag_count(&fakevendor_ops);
+}
+
+static void get_counting_vendor_tags(const vendor_tag_ops_t *, uint32_t *tag_array) {
+    get_fakevendor_tags(&fakevendor_ops, tag_array);
+}
+
+static const char *get_counting_vendor_section_name(const vendor_tag_ops_t *, uint32_t tag) {
+    return get_fakevendor_section_name(&fakevendor_ops, tag);
+}
+
+static const char *get_counting_vendor_tag_name(const vendor_tag_ops_t *, uint32_t tag) {
+    return get_fakevendor_tag_name(&fakevendor_ops, tag);
+}
+
+static int get_counting_vendor_tag_type(const vendor_tag_ops_t *, uint32_t tag) {
+    counting_vendor_tag_type_calls++;
+    return get_fakevendor_tag_type(&fakevendor_ops, tag);
+}
+
+static const vendor_tag_ops_t counting_vendor_ops = {
+    get_counting_vendor_tag_count,
+    get_counting_vendor_tags,
+    get_counting_vendor_section_name,
+    get_counting_vendor_tag_name,
+    get_counting_vendor_tag_type,
+    {NULL}
+};
+
+TEST(camera_metadata, vendor_tag_cache) {
+    set_camera_metadata_vendor_ops(&counting_vendor_ops);
+    counting_vendor_tag_count_calls = 0;
+    counting_vendor_tag_type_calls = 0;
+
+    // The first lookup caches all the tags listed by the ops
+    EXPECT_EQ(TYPE_BYTE, get_camera_metadata_tag_type(FAKEVENDOR_SENSOR_SUPERMODE));
+    EXPECT_EQ(1, counting_vendor_tag_count_calls);
+    const int tag_type_calls = counting_vendor_tag_type_calls;
+    EXPECT_EQ(get_fakevendor_tag_count(&fakevendor_ops), tag_type_calls);
+
+    for (int i = 0; i < 3; i++) {
+        EXPECT_EQ(TYPE_BYTE, get_camera_metadata_tag_type(FAKEVENDOR_SENSOR_SUPERMODE));
+        EXPECT_EQ(TYPE_FLOAT, get_camera_metadata_tag_type(FAKEVENDOR_SCALER_DOWNSCALE_COEFF));
+        EXPECT_STREQ("com.fakevendor.sensor",
+                get_camera_metadata_section_name(FAKEVENDOR_SENSOR_SUPERMODE));
+        EXPECT_STREQ("superMode",
+                get_camera_metadata_tag_name(FAKEVENDOR_SENSOR_SUPERMODE));
+    }
+    EXPECT_EQ(1, counting_vendor_tag_count_calls);
+    EXPECT_EQ(tag_type_calls, counting_vendor_tag_type_calls);
+
+    // Tags not listed by the ops are still queried from them
+    EXPECT_STREQ("com.fakevendor.scaler",
+            get_camera_metadata_section_name(FAKEVENDOR_SCALER_END));
+    EXPECT_EQ(-1, get_camera_metadata_tag_type(FAKEVENDOR_SCALER_END));
+    EXPECT_EQ(tag_type_calls + 1, counting_vendor_tag_type_calls);
+
+    // Setting the ops drops the cache
+    set_camera_metadata_vendor_ops(&counting_vendor_ops);
+    EXPECT_EQ(TYPE_BYTE, get_camera_metadata_tag_type(FAKEVENDOR_SENSOR_SUPERMODE));
+    EXPECT_EQ(2, counting_vendor_tag_count_calls);
+
+    // The cached names are copies, which outlive the ops
+    const char *tag_name = get_camera_metadata_tag_name(FAKEVENDOR_SENSOR_SUPERMODE);
+    EXPECT_NE(get_fakevendor_tag_name(&fakevendor_ops, FAKEVENDOR_SENSOR_SUPERMODE), tag_name);
+    set_camera_metadata_vendor_ops(NULL);
+    EXPECT_STREQ("superMode", tag_name);
+    EXPECT_EQ(-1, get_camera_metadata_tag_type(FAKEVENDOR_SENSOR_SUPERMODE));
+    EXPECT_NULL(get_camera_metadata_tag_name(FAKEVENDOR_SENSOR_SUPERMODE));
+
+    set_camera_metadata_vendor_ops(&fakevendor_ops);
+    EXPECT_EQ(TYPE_BYTE, get_camera_metadata_tag_type(FAKEVENDOR_SENSOR_SUPERMODE));
+    EXPECT_EQ(2, counting_vendor_tag_count_calls);
+    set_camera_metadata_vendor_ops(NULL);
+}
+
+// Each vendor id defines a dense section and a sparse one, with types by id.
+static const uint32_t cache_vendor_tags[] = {
+    0x80000000, 0x80000001, 0x80000002,
+    0x80010000, 0x80017000, 0x8001FFFF,
+};
+static int cache_vendor_tag_count_calls = 0;
+static int cache_vendor_tag_type_calls = 0;
+
+static int get_cache_vendor_tag_count(metadata_vendor_id_t) {
+    cache_vendor_tag_count_calls++;
+    return ARRAY_SIZE(cache_vendor_tags);
+}
+
+static void get_cache_vendor_tags(uint32_t *tag_array, metadata_vendor_id_t) {
+    // in reverse, as the tags need not be listed in order
+    for (size_t i = 0; i < ARRAY_SIZE(cache_vendor_tags); i++) {
+        tag_array[i] = cache_vendor_tags[ARRAY_SIZE(cache_vendor_tags) - 1 - i];
+    }
+}
+
+static const char *get_cache_vendor_section_name(uint32_t tag, metadata_vendor_id_t) {
+    return tag >> 16 == 0x8000 ? "com.cachevendor.dense" : "com.cachevendor.sparse";
+}
+
+static const char *get_cache_vendor_tag_name(uint32_t, metadata_vendor_id_t) {
+    return "cacheVendorTag";
+}
+
+static int get_cache_vendor_tag_type(uint32_t tag, metadata_vendor_id_t id) {
+    cache_vendor_tag_type_calls++;
+    for (uint32_t vendor_tag : cache_vendor_tags) {
+        if (vendor_tag == tag) return (tag + id) % NUM_TYPES;
+    }
+    return -1;
+}
+
+static const struct vendor_tag_cache_ops cache_vendor_ops = {
+    get_cache_vendor_tag_count,
+    get_cache_vendor_tags,
+    get_cache_vendor_section_name,
+    get_cache_vendor_tag_name,
+    get_cache_vendor_tag_type,
+    {NULL}
+};
+
+TEST(camera_metadata, vendor_tag_cache_ids) {
+    set_camera_metadata_vendor_cache_ops(&cache_vendor_ops);
+    // more vendor ids than the cache holds
+    const metadata_vendor_id_t id_count = 9;
+    auto expect_tags = [&]() {
+        for (metadata_vendor_id_t id = 1; id <= id_count; id++) {
+            for (uint32_t tag : cache_vendor_tags) {
+                EXPECT_EQ((int)((tag + id) % NUM_TYPES),
+                        get_local_camera_metadata_tag_type_vendor_id(tag, id));
+                EXPECT_STREQ(tag >> 16 == 0x8000 ? "com.cachevendor.dense" :
+                        "com.cachevendor.sparse",
+                        get_local_camera_metadata_section_name_vendor_id(tag, id));
+            }
+            EXPECT_EQ(-1, get_local_camera_metadata_tag_type_vendor_id(0x80000003, id));
+            EXPECT_EQ(-1, get_local_camera_metadata_tag_type_vendor_id(0x80017001, id));
+        }
+    };
+    expect_tags();
+    EXPECT_LT(cache_vendor_tag_count_calls, (int)id_count);
+
+    // The ids which are not cached are queried from the ops, rather than rebuilt.
+    cache_vendor_tag_count_calls = 0;
+    cache_vendor_tag_type_calls = 0;
+    const int rounds = 10;
+    for (int i = 0; i < rounds; i++) {
+        expect_tags();
+    }
+    EXPECT_EQ(0, cache_vendor_tag_count_calls);
+    // the 2 tags not listed of each id, and the tags of one id not cached.
+    const int uncached_lookups = 2 * id_count + ARRAY_SIZE(cache_vendor_tags);
+    EXPECT_EQ(rounds * uncached_lookups, cache_vendor_tag_type_calls);
+
+    set_camera_metadata_vendor_cache_ops(NULL);
+    EXPECT_EQ(-1, get_local_camera_metadata_tag_type_vendor_id(cache_vendor_tags[0], 1));
+}
+
 TEST(camera_metadata, add_all_tags) {
     int total_tag_count = 0;
     for (int i = 0; i < ANDROID_SECTION_COUNT; i++) {
@@ -1072,6 +1235,629 @@ TEST(camera_metadata, sort_metadata) {
     FINISH_USING_CAMERA_METADATA(m);
 }
 
+// Checks that find_camera_metadata_entry() finds each tag, as a linear search does.
+static void expect_find_matches_linear_search(camera_metadata_t *m,
+        const std::vector<uint32_t> &tags) {
+    for (uint32_t tag : tags) {
+        size_t linear_index = get_camera_metadata_entry_count(m);
+        for (size_t i = 0; i < get_camera_metadata_entry_count(m); ++i) {
+            camera_metadata_entry_t entry;
+            ASSERT_EQ(OK, get_camera_metadata_entry(m, i, &entry));
+            if (entry.tag == tag) {
+                linear_index = i;
+                break;
+            }
+        }
+        camera_metadata_ro_entry_t entry;
+        int result = find_camera_metadata_ro_entry(m, tag, &entry);
+        if (linear_index == get_camera_metadata_entry_count(m)) {
+            EXPECT_EQ(NOT_FOUND, result) << "tag " << tag;
+        } else {
+            ASSERT_EQ(OK, result) << "tag " << tag;
+            EXPECT_EQ(tag, entry.tag);
+            EXPECT_EQ(linear_index, entry.index);
+            EXPECT_EQ((uint8_t)tag, entry.data.u8[0]);
+        }
+    }
+}
+
+TEST(camera_metadata, tag_index) {
+    std::vector<uint32_t> tags;
+    for (int i = 0; i < ANDROID_SECTION_COUNT; i++) {
+        for (uint32_t tag = camera_metadata_section_bounds[i][0];
+                tag < camera_metadata_section_bounds[i][1]; tag++) {
+            tags.push_back(tag);
+        }
+    }
+    // a deterministic shuffle, so the entries are not sorted.
+    for (size_t i = 0; i < tags.size(); i++) {
+        std::swap(tags[i], tags[(i * 7919) % tags.size()]);
+    }
+    const size_t entry_capacity = tags.size() + 1;
+    const size_t data_capacity = tags.size() * 8;
+    EXPECT_GT(calculate_camera_metadata_size_with_tag_index(entry_capacity, data_capacity),
+            calculate_camera_metadata_size(entry_capacity, data_capacity));
+
+    camera_metadata_t *m = allocate_camera_metadata_with_tag_index(entry_capacity,
+            data_capacity);
+    ASSERT_TRUE(NULL != m);
+    expect_find_matches_linear_search(m, tags);
+
+    // all values are the low byte of the tag, in the smallest type of the tag.
+    uint8_t data[8] = {};
+    for (uint32_t tag : tags) {
+        data[0] = tag;
+        ASSERT_EQ(OK, add_camera_metadata_entry(m, tag, data, 1));
+    }
+    EXPECT_EQ(OK, validate_camera_metadata_structure(m, NULL));
+    expect_find_matches_linear_search(m, tags);
+    // a duplicate tag is found, either entry may be returned.
+    data[0] = tags[0];
+    ASSERT_EQ(OK, add_camera_metadata_entry(m, tags[0], data, 1));
+    camera_metadata_entry_t entry;
+    ASSERT_EQ(OK, find_camera_metadata_entry(m, tags[0], &entry));
+    EXPECT_EQ(tags[0], entry.tag);
+    ASSERT_EQ(OK, delete_camera_metadata_entry(m, tags.size()));
+
+    // deleting renumbers the entries, which must still be found.
+    for (size_t i = 0; i < tags.size(); i += 3) {
+        ASSERT_EQ(OK, find_camera_metadata_entry(m, tags[i], &entry));
+        ASSERT_EQ(OK, delete_camera_metadata_entry(m, entry.index));
+    }
+    EXPECT_EQ(OK, validate_camera_metadata_structure(m, NULL));
+    expect_find_matches_linear_search(m, tags);
+
+    // appending indexes the appended entries.
+    camera_metadata_t *src = allocate_camera_metadata(tags.size(), data_capacity);
+    ASSERT_TRUE(NULL != src);
+    for (size_t i = 0; i < tags.size(); i += 3) {
+        data[0] = tags[i];
+        ASSERT_EQ(OK, add_camera_metadata_entry(src, tags[i], data, 1));
+    }
+    ASSERT_EQ(OK, append_camera_metadata(m, src));
+    EXPECT_EQ(tags.size(), get_camera_metadata_entry_count(m));
+    expect_find_matches_linear_search(m, tags);
+    FINISH_USING_CAMERA_METADATA(src);
+
+    // sorting reorders the entries, and rebuilds the index.
+    ASSERT_EQ(OK, sort_camera_metadata(m));
+    expect_find_matches_linear_search(m, tags);
+
+    // a compacted copy has no index, but still finds the same entries.
+    std::vector<uint8_t> buffer(get_camera_metadata_compact_size(m));
+    camera_metadata_t *copy = copy_camera_metadata(buffer.data(), buffer.size(), m);
+    ASSERT_TRUE(NULL != copy);
+    EXPECT_EQ(OK, validate_camera_metadata_structure(copy, NULL));
+    expect_find_matches_linear_search(copy, tags);
+
+    FINISH_USING_CAMERA_METADATA(m);
+
+    // placing with an index in a buffer.
+    buffer.resize(calculate_camera_metadata_size_with_tag_index(2, 0));
+    EXPECT_NULL(place_camera_metadata_with_tag_index(buffer.data(), buffer.size() - 1, 2, 0));
+    m = place_camera_metadata_with_tag_index(buffer.data(), buffer.size(), 2, 0);
+    ASSERT_TRUE(NULL != m);
+    data[0] = (uint8_t)ANDROID_CONTROL_AE_MODE;
+    ASSERT_EQ(OK, add_camera_metadata_entry(m, ANDROID_CONTROL_AE_MODE, data, 1));
+    data[0] = (uint8_t)ANDROID_CONTROL_AF_MODE;
+    ASSERT_EQ(OK, add_camera_metadata_entry(m, ANDROID_CONTROL_AF_MODE, data, 1));
+    size_t buffer_size = buffer.size();
+    EXPECT_EQ(OK, validate_camera_metadata_structure(m, &buffer_size));
+    expect_find_matches_linear_search(m, tags);
+}
+
+TEST(camera_metadata, tag_index_forged) {
+    const uint32_t tags[] = {
+        ANDROID_CONTROL_AE_MODE,
+        ANDROID_CONTROL_AF_MODE,
+    };
+    uint8_t data[1] = {1};
+    auto make_indexed = [&]() {
+        camera_metadata_t *m = allocate_camera_metadata_with_tag_index(4, 0);
+        for (uint32_t tag : tags) {
+            EXPECT_EQ(OK, add_camera_metadata_entry(m, tag, data, 1));
+        }
+        return m;
+    };
+    // The index follows the header: slot_count, entry_count, then the slots.
+    auto get_index = [](camera_metadata_t *m) {
+        return (uint32_t*)((uint8_t*)m + calculate_camera_metadata_size(0, 0));
+    };
+    camera_metadata_entry_t entry;
+
+    // Full slots fail validation, and are dropped rather than probed forever.
+    camera_metadata_t *m = make_indexed();
+    ASSERT_TRUE(NULL != m);
+    uint32_t *index = get_index(m);
+    for (uint32_t i = 0; i < index[0]; i++) index[2 + i] = 1;
+    EXPECT_NE(OK, validate_camera_metadata_structure(m, NULL));
+    EXPECT_EQ(OK, add_camera_metadata_entry(m, ANDROID_CONTROL_AWB_MODE, data, 1));
+    EXPECT_EQ(OK, validate_camera_metadata_structure(m, NULL));
+    EXPECT_EQ(OK, find_camera_metadata_entry(m, ANDROID_CONTROL_AWB_MODE, &entry));
+    EXPECT_EQ(2u, entry.index);
+    FINISH_USING_CAMERA_METADATA(m);
+
+    // Slots beyond the entries fail validation, and are not followed on deletion.
+    m = make_indexed();
+    ASSERT_TRUE(NULL != m);
+    index = get_index(m);
+    for (uint32_t i = 0; i < index[0]; i++) {
+        if (index[2 + i] == 0) index[2 + i] = 100;
+    }
+    EXPECT_NE(OK, validate_camera_metadata_structure(m, NULL));
+    EXPECT_EQ(OK, delete_camera_metadata_entry(m, 0));
+    EXPECT_EQ(OK, validate_camera_metadata_structure(m, NULL));
+    EXPECT_EQ(OK, find_camera_metadata_entry(m, tags[1], &entry));
+    EXPECT_EQ(0u, entry.index);
+    FINISH_USING_CAMERA_METADATA(m);
+}
+
+TEST(camera_metadata, mutable_metadata) {
+    const uint32_t tags[] = {
+        ANDROID_TONEMAP_CURVE_RED,          // float
+        ANDROID_SENSOR_EXPOSURE_TIME,       // int64
+        ANDROID_CONTROL_AE_REGIONS,         // int32
+        ANDROID_STATISTICS_FACE_RECTANGLES, // int32
+        ANDROID_LENS_FOCUS_DISTANCE,        // float
+        ANDROID_JPEG_GPS_PROCESSING_METHOD, // byte
+        ANDROID_SENSOR_NEUTRAL_COLOR_POINT, // rational
+        ANDROID_JPEG_GPS_COORDINATES,       // double
+    };
+    const size_t entry_capacity = ARRAY_SIZE(tags);
+    const size_t data_capacity = 8 * 1024;
+    const size_t max_count = 40;
+
+    camera_metadata_t *m = allocate_camera_metadata_mutable(entry_capacity, data_capacity);
+    ASSERT_TRUE(NULL != m);
+    EXPECT_EQ(calculate_camera_metadata_size_mutable(entry_capacity, data_capacity),
+            get_camera_metadata_size(m));
+
+    // The data of the entries present, by tag.
+    std::map<uint32_t, std::vector<uint8_t>> values;
+    auto expect_values = [&](const camera_metadata_t *m) {
+        ASSERT_EQ(values.size(), get_camera_metadata_entry_count(m));
+        size_t data_size = 0;
+        for (const auto &[tag, value] : values) {
+            camera_metadata_ro_entry_t entry;
+            ASSERT_EQ(OK, find_camera_metadata_ro_entry(m, tag, &entry));
+            ASSERT_EQ(value.size(), entry.count * camera_metadata_type_size[entry.type]);
+            EXPECT_EQ(0, memcmp(value.data(), entry.data.u8, value.size()));
+            data_size += calculate_camera_metadata_entry_data_size(entry.type, entry.count);
+        }
+        EXPECT_EQ(calculate_camera_metadata_size(values.size(), data_size),
+                get_camera_metadata_compact_size(m));
+    };
+
+    uint32_t seed = 1;
+    auto random = [&seed](uint32_t n) {
+        seed = seed * 1103515245 + 12345;
+        return (seed >> 16) % n;
+    };
+    // Far more data than the capacity is added, so the free slots must be reused.
+    for (size_t i = 0; i < 2000; ++i) {
+        const uint32_t tag = tags[random(ARRAY_SIZE(tags))];
+        const size_t type_size = camera_metadata_type_size[get_camera_metadata_tag_type(tag)];
+        std::vector<uint8_t> value(type_size * (1 + random(max_count)));
+        for (uint8_t &byte : value) byte = random(256);
+
+        // The data of the other entries must not move.
+        std::map<uint32_t, const uint8_t *> pointers;
+        for (const auto &item : values) {
+            camera_metadata_ro_entry_t entry;
+            ASSERT_EQ(OK, find_camera_metadata_ro_entry(m, item.first, &entry));
+            pointers[item.first] = entry.data.u8;
+        }
+
+        camera_metadata_entry_t entry;
+        if (find_camera_metadata_entry(m, tag, &entry) == NOT_FOUND) {
+            ASSERT_EQ(OK, add_camera_metadata_entry(m, tag, value.data(),
+                    value.size() / type_size));
+            values[tag] = value;
+        } else if (random(3) == 0) {
+            ASSERT_EQ(OK, delete_camera_metadata_entry(m, entry.index));
+            values.erase(tag);
+        } else {
+            ASSERT_EQ(OK, update_camera_metadata_entry(m, entry.index, value.data(),
+                    value.size() / type_size, NULL));
+            values[tag] = value;
+        }
+        pointers.erase(tag);
+        for (const auto &[other_tag, pointer] : pointers) {
+            camera_metadata_ro_entry_t other_entry;
+            ASSERT_EQ(OK, find_camera_metadata_ro_entry(m, other_tag, &other_entry));
+            if (other_entry.count * camera_metadata_type_size[other_entry.type] > 4) {
+                EXPECT_EQ(pointer, other_entry.data.u8);
+            }
+        }
+        ASSERT_NO_FATAL_FAILURE(expect_values(m));
+        ASSERT_EQ(OK, validate_camera_metadata_structure(m, NULL));
+    }
+    // Copies are packed, and are not mutable.
+    std::vector<uint8_t> buffer(get_camera_metadata_compact_size(m));
+    camera_metadata_t *copy = copy_camera_metadata(buffer.data(), buffer.size(), m);
+    ASSERT_TRUE(NULL != copy);
+    size_t buffer_size = buffer.size();
+    EXPECT_EQ(OK, validate_camera_metadata_structure(copy, &buffer_size));
+    ASSERT_NO_FATAL_FAILURE(expect_values(copy));
+
+    camera_metadata_t *clone = clone_camera_metadata(m);
+    ASSERT_TRUE(NULL != clone);
+    EXPECT_EQ(get_camera_metadata_compact_size(m), get_camera_metadata_size(clone));
+    ASSERT_NO_FATAL_FAILURE(expect_values(clone));
+
+    // Appending into a mutable packet allocates slots.
+    camera_metadata_t *appended = allocate_camera_metadata_mutable(entry_capacity,
+            data_capacity);
+    ASSERT_TRUE(NULL != appended);
+    ASSERT_EQ(OK, append_camera_metadata(appended, clone));
+    ASSERT_NO_FATAL_FAILURE(expect_values(appended));
+    camera_metadata_entry_t entry;
+    ASSERT_EQ(OK, find_camera_metadata_entry(appended, values.begin()->first, &entry));
+    ASSERT_EQ(OK, delete_camera_metadata_entry(appended, entry.index));
+    EXPECT_EQ(OK, validate_camera_metadata_structure(appended, NULL));
+    FINISH_USING_CAMERA_METADATA(appended);
+    FINISH_USING_CAMERA_METADATA(clone);
+
+    // Compacting packs the data in place.
+    const size_t data_used = get_camera_metadata_compact_size(m);
+    ASSERT_EQ(OK, compact_camera_metadata(m));
+    EXPECT_EQ(data_used, get_camera_metadata_compact_size(m));
+    EXPECT_EQ(data_used, calculate_camera_metadata_size(get_camera_metadata_entry_count(m),
+            get_camera_metadata_data_count(m)));
+    ASSERT_NO_FATAL_FAILURE(expect_values(m));
+
+    // It is then updated as any packet.
+    ASSERT_EQ(OK, find_camera_metadata_entry(m, values.begin()->first, &entry));
+    ASSERT_EQ(OK, delete_camera_metadata_entry(m, entry.index));
+    values.erase(values.begin());
+    ASSERT_NO_FATAL_FAILURE(expect_values(m));
+
+    FINISH_USING_CAMERA_METADATA(m);
+}
+
+// Returns the first count tags of the Android sections.
+static std::vector<uint32_t> get_tags(size_t count) {
+    std::vector<uint32_t> tags;
+    for (int i = 0; i < ANDROID_SECTION_COUNT && tags.size() < count; i++) {
+        for (uint32_t tag = camera_metadata_section_bounds[i][0];
+                tag < camera_metadata_section_bounds[i][1] && tags.size() < count; tag++) {
+            tags.push_back(tag);
+        }
+    }
+    return tags;
+}
+
+// Adds an entry of count values all set to value, and returns their bytes.
+static std::vector<uint8_t> add_filled_entry(camera_metadata_t *m, uint32_t tag,
+        size_t count, uint8_t value, bool sorted = false,
+        camera_metadata_duplicate_policy_t policy = CAMERA_METADATA_DUPLICATE_LAST_WINS) {
+    std::vector<uint8_t> bytes(
+            count * camera_metadata_type_size[get_camera_metadata_tag_type(tag)], value);
+    if (sorted) {
+        EXPECT_EQ(OK, add_camera_metadata_entry_sorted(m, tag, bytes.data(), count, policy));
+    } else {
+        EXPECT_EQ(OK, add_camera_metadata_entry(m, tag, bytes.data(), count));
+    }
+    return bytes;
+}
+
+// Checks that m is sorted, with one entry of each tag of values.
+static void expect_sorted_values(const camera_metadata_t *m,
+        const std::map<uint32_t, std::vector<uint8_t>> &values) {
+    ASSERT_EQ(values.size(), get_camera_metadata_entry_count(m));
+    size_t i = 0;
+    for (const auto &[tag, value] : values) {
+        camera_metadata_ro_entry_t entry;
+        ASSERT_EQ(OK, get_camera_metadata_ro_entry(m, i++, &entry));
+        ASSERT_EQ(tag, entry.tag);
+        ASSERT_EQ(value.size(), entry.count * camera_metadata_type_size[entry.type]);
+        EXPECT_EQ(0, memcmp(value.data(), entry.data.u8, value.size()));
+        ASSERT_EQ(OK, find_camera_metadata_ro_entry(m, tag, &entry));
+        EXPECT_EQ(i - 1, entry.index);
+    }
+    EXPECT_EQ(OK, validate_camera_metadata_structure(m, NULL));
+}
+
+TEST(camera_metadata, mutable_metadata_forged) {
+    const int32_t value[4] = {1, 2, 3, 4};
+    camera_metadata_t *m = allocate_camera_metadata_mutable(4, 256);
+    ASSERT_TRUE(NULL != m);
+    ASSERT_EQ(OK, add_camera_metadata_entry(m, ANDROID_CONTROL_AE_REGIONS, value, 4));
+    ASSERT_EQ(OK, add_camera_metadata_entry(m, ANDROID_CONTROL_AF_REGIONS, value, 4));
+    camera_metadata_entry_t entry;
+    ASSERT_EQ(OK, find_camera_metadata_entry(m, ANDROID_CONTROL_AE_REGIONS, &entry));
+    uint8_t *freed = entry.data.u8;
+    ASSERT_EQ(OK, delete_camera_metadata_entry(m, entry.index));
+    EXPECT_EQ(OK, validate_camera_metadata_structure(m, NULL));
+
+    // The first bytes of a free slot link to the next free slot of its size.
+    const uint32_t link = 0x7FFFFFF0;
+    memcpy(freed, &link, sizeof(link));
+    EXPECT_NE(OK, validate_camera_metadata_structure(m, NULL));
+
+    // The forged link is dropped rather than followed.
+    ASSERT_EQ(OK, add_camera_metadata_entry(m, ANDROID_CONTROL_AE_REGIONS, value, 4));
+    ASSERT_EQ(OK, add_camera_metadata_entry(m, ANDROID_CONTROL_AWB_REGIONS, value, 4));
+    EXPECT_EQ(OK, validate_camera_metadata_structure(m, NULL));
+    for (uint32_t tag : {ANDROID_CONTROL_AE_REGIONS, ANDROID_CONTROL_AF_REGIONS,
+            ANDROID_CONTROL_AWB_REGIONS}) {
+        ASSERT_EQ(OK, find_camera_metadata_entry(m, tag, &entry));
+        EXPECT_EQ(0, memcmp(value, entry.data.i32, sizeof(value)));
+    }
+    FINISH_USING_CAMERA_METADATA(m);
+}
+
+TEST(camera_metadata, merge_metadata) {
+    const std::vector<uint32_t> tags = get_tags(60);
+    const size_t source_count = 3;
+
+    for (auto policy : {CAMERA_METADATA_DUPLICATE_FIRST_WINS,
+            CAMERA_METADATA_DUPLICATE_LAST_WINS}) {
+        for (auto allocate : {allocate_camera_metadata, allocate_camera_metadata_with_tag_index,
+                allocate_camera_metadata_mutable}) {
+            std::map<uint32_t, std::vector<uint8_t>> values;
+            uint32_t seed = 1;
+            auto random = [&seed](uint32_t n) {
+                seed = seed * 1103515245 + 12345;
+                return (seed >> 16) % n;
+            };
+
+            // The destination is not sorted, the sources are.
+            camera_metadata_t *dst = allocate(tags.size() * (source_count + 1),
+                    tags.size() * (source_count + 1) * 512);
+            ASSERT_TRUE(NULL != dst);
+            for (size_t i = tags.size(); i-- > 0;) {
+                if (random(2) == 0) {
+                    values[tags[i]] = add_filled_entry(dst, tags[i], 1 + random(20), 0);
+                }
+            }
+            camera_metadata_t *srcs[source_count];
+            for (size_t s = 0; s < source_count; ++s) {
+                srcs[s] = allocate_camera_metadata(tags.size(), tags.size() * 256);
+                ASSERT_TRUE(NULL != srcs[s]);
+                for (uint32_t tag : tags) {
+                    if (random(3) != 0) continue;
+                    std::vector<uint8_t> bytes =
+                            add_filled_entry(srcs[s], tag, 1 + random(20), s + 1);
+                    if (policy == CAMERA_METADATA_DUPLICATE_LAST_WINS ||
+                            values.count(tag) == 0) {
+                        values[tag] = bytes;
+                    }
+                }
+            }
+            // An unsorted source is not merged.
+            EXPECT_EQ(ERROR, merge_camera_metadata(dst, srcs, source_count, policy));
+            for (camera_metadata_t *src : srcs) {
+                ASSERT_EQ(OK, sort_camera_metadata(src));
+            }
+
+            ASSERT_EQ(OK, merge_camera_metadata(dst, srcs, source_count, policy));
+            ASSERT_NO_FATAL_FAILURE(expect_sorted_values(dst, values));
+            size_t data_size = 0;
+            for (const auto &item : values) {
+                data_size += calculate_camera_metadata_entry_data_size(
+                        get_camera_metadata_tag_type(item.first),
+                        item.second.size() / camera_metadata_type_size[
+                                get_camera_metadata_tag_type(item.first)]);
+            }
+            EXPECT_EQ(calculate_camera_metadata_size(values.size(), data_size),
+                    get_camera_metadata_compact_size(dst));
+
+            // A destination without room for all the source entries is unchanged.
+            size_t source_entry_count = 0;
+            for (camera_metadata_t *src : srcs) {
+                source_entry_count += get_camera_metadata_entry_count(src);
+            }
+            camera_metadata_t *small = allocate(source_entry_count - 1, tags.size() * 512);
+            ASSERT_TRUE(NULL != small);
+            EXPECT_EQ(ERROR, merge_camera_metadata(small, srcs, source_count, policy));
+            EXPECT_EQ(0u, get_camera_metadata_entry_count(small));
+            FINISH_USING_CAMERA_METADATA(small);
+
+            for (camera_metadata_t *src : srcs) {
+                FINISH_USING_CAMERA_METADATA(src);
+            }
+            FINISH_USING_CAMERA_METADATA(dst);
+        }
+    }
+}
+
+TEST(camera_metadata, add_entry_sorted) {
+    const std::vector<uint32_t> tags = get_tags(100);
+
+    for (auto policy : {CAMERA_METADATA_DUPLICATE_FIRST_WINS,
+            CAMERA_METADATA_DUPLICATE_LAST_WINS}) {
+        for (auto allocate : {allocate_camera_metadata, allocate_camera_metadata_with_tag_index,
+                allocate_camera_metadata_mutable}) {
+            std::map<uint32_t, std::vector<uint8_t>> values;
+            uint32_t seed = 1;
+            auto random = [&seed](uint32_t n) {
+                seed = seed * 1103515245 + 12345;
+                return (seed >> 16) % n;
+            };
+
+            camera_metadata_t *m = allocate(tags.size(), tags.size() * 2 * 256);
+            ASSERT_TRUE(NULL != m);
+            // An unsorted packet is sorted first.
+            values[tags[1]] = add_filled_entry(m, tags[1], 1, 0);
+            values[tags[0]] = add_filled_entry(m, tags[0], 1, 0);
+            for (size_t i = 0; i < 2 * tags.size(); ++i) {
+                const uint32_t tag = tags[random(tags.size())];
+                std::vector<uint8_t> bytes =
+                        add_filled_entry(m, tag, 1 + random(20), i, true, policy);
+                if (policy == CAMERA_METADATA_DUPLICATE_LAST_WINS || values.count(tag) == 0) {
+                    values[tag] = bytes;
+                }
+                ASSERT_NO_FATAL_FAILURE(expect_sorted_values(m, values));
+            }
+
+            // Deleting keeps the entries sorted.
+            EXPECT_EQ(OK, delete_camera_metadata_entry(m, 0));
+            values.erase(values.begin());
+            ASSERT_NO_FATAL_FAILURE(expect_sorted_values(m, values));
+
+            FINISH_USING_CAMERA_METADATA(m);
+        }
+    }
+}
+
+TEST(camera_metadata, metadata_view) {
+    const std::vector<uint32_t> tags = get_tags(80);
+    for (bool sorted : {false, true}) {
+        camera_metadata_t *m = allocate_camera_metadata(tags.size() + 1, tags.size() * 160);
+        ASSERT_TRUE(NULL != m);
+        for (size_t i = tags.size(); i-- > 0;) {
+            add_filled_entry(m, tags[i], 1 + i % 20, i);
+        }
+        // A duplicate tag, the first entry is found.
+        add_filled_entry(m, tags[1], 1, 0xff);
+        if (sorted) {
+            ASSERT_EQ(OK, sort_camera_metadata(m));
+        }
+
+        const size_t size = get_camera_metadata_size(m);
+        camera_metadata_view_t *view = allocate_camera_metadata_view(m, size);
+        ASSERT_TRUE(NULL != view);
+        ASSERT_EQ(get_camera_metadata_entry_count(m),
+                get_camera_metadata_view_entry_count(view));
+        for (size_t i = 0; i < get_camera_metadata_entry_count(m); ++i) {
+            camera_metadata_ro_entry_t expected, entry;
+            ASSERT_EQ(OK, get_camera_metadata_ro_entry(m, i, &expected));
+            ASSERT_EQ(OK, get_camera_metadata_view_ro_entry(view, i, &entry));
+            EXPECT_EQ(expected.index, entry.index);
+            EXPECT_EQ(expected.tag, entry.tag);
+            EXPECT_EQ(expected.count, entry.count);
+            EXPECT_EQ(expected.data.u8, entry.data.u8);
+        }
+        for (size_t i = 0; i < tags.size(); ++i) {
+            camera_metadata_ro_entry_t entry;
+            ASSERT_EQ(OK, find_camera_metadata_view_ro_entry(view, tags[i], &entry));
+            EXPECT_EQ(tags[i], entry.tag);
+            EXPECT_EQ(1 + i % 20, entry.count);
+            EXPECT_EQ((uint8_t)i, entry.data.u8[0]);
+        }
+        camera_metadata_ro_entry_t entry;
+        EXPECT_EQ(NOT_FOUND, find_camera_metadata_view_ro_entry(view, tags.back() + 1, &entry));
+        EXPECT_EQ(ERROR, get_camera_metadata_view_ro_entry(view, tags.size() + 1, &entry));
+
+        // An entry changed after the validation is not read outside of the buffer.
+        // The count of an entry precedes its inline data.
+        size_t index = 0;
+        camera_metadata_entry_t changed;
+        do {
+            ASSERT_EQ(OK, get_camera_metadata_entry(m, index++, &changed));
+        } while (changed.count * camera_metadata_type_size[changed.type] > 4);
+        const uint32_t count = 0x10000;
+        memcpy(changed.data.u8 - sizeof(count), &count, sizeof(count));
+        EXPECT_EQ(ERROR, get_camera_metadata_view_ro_entry(view, changed.index, &entry));
+        EXPECT_EQ(ERROR, find_camera_metadata_view_ro_entry(view, changed.tag, &entry));
+        EXPECT_NE(OK, validate_camera_metadata_structure(m, NULL));
+        memcpy(changed.data.u8 - sizeof(count), &changed.count, sizeof(count));
+        free_camera_metadata_view(view);
+
+        // Views need an aligned and valid packet.
+        std::vector<uint8_t> buffer(size + get_camera_metadata_alignment());
+        memcpy(buffer.data() + 1, m, size);
+        EXPECT_TRUE(NULL == allocate_camera_metadata_view(buffer.data() + 1, size));
+        EXPECT_TRUE(NULL == allocate_camera_metadata_view(m, size - 1));
+        EXPECT_TRUE(NULL == allocate_camera_metadata_view(m, 8));
+        EXPECT_TRUE(NULL == allocate_camera_metadata_view(NULL, size));
+
+        FINISH_USING_CAMERA_METADATA(m);
+    }
+}
+
+TEST(camera_metadata, metadata_delta) {
+    const std::vector<uint32_t> tags = get_tags(100);
+    uint32_t seed = 1;
+    auto random = [&seed](uint32_t n) {
+        seed = seed * 1103515245 + 12345;
+        return (seed >> 16) % n;
+    };
+
+    // Consecutive frames, which change, add and remove a few tags.
+    std::map<uint32_t, std::vector<uint8_t>> prev_values, cur_values;
+    camera_metadata_t *prev = allocate_camera_metadata(tags.size(), tags.size() * 160);
+    camera_metadata_t *cur = allocate_camera_metadata(tags.size(), tags.size() * 160);
+    ASSERT_TRUE(NULL != prev);
+    ASSERT_TRUE(NULL != cur);
+    size_t changes = 0;
+    for (size_t i = tags.size(); i-- > 0;) {
+        const uint32_t tag = tags[i];
+        const size_t count = 1 + i % 20;
+        switch (random(10)) {
+        case 0:  // added
+            cur_values[tag] = add_filled_entry(cur, tag, count, i);
+            ++changes;
+            break;
+        case 1:  // removed
+            prev_values[tag] = add_filled_entry(prev, tag, count, i);
+            ++changes;
+            break;
+        case 2:  // changed data
+            prev_values[tag] = add_filled_entry(prev, tag, count, i);
+            cur_values[tag] = add_filled_entry(cur, tag, count, i + 1);
+            ++changes;
+            break;
+        case 3:  // changed count
+            prev_values[tag] = add_filled_entry(prev, tag, count, i);
+            cur_values[tag] = add_filled_entry(cur, tag, count + 1, i);
+            ++changes;
+            break;
+        default:  // unchanged
+            prev_values[tag] = add_filled_entry(prev, tag, count, i);
+            cur_values[tag] = add_filled_entry(cur, tag, count, i);
+            break;
+        }
+    }
+    ASSERT_EQ(OK, sort_camera_metadata(prev));
+
+    camera_metadata_t *delta = diff_camera_metadata(prev, cur);
+    ASSERT_TRUE(NULL != delta);
+    EXPECT_EQ(changes, get_camera_metadata_entry_count(delta));
+    EXPECT_EQ(get_camera_metadata_compact_size(delta), get_camera_metadata_size(delta));
+    EXPECT_LT(get_camera_metadata_size(delta), get_camera_metadata_size(cur));
+
+    // The delta is sent as any packet.
+    std::vector<uint8_t> buffer(get_camera_metadata_size(delta));
+    camera_metadata_t *sent = copy_camera_metadata(buffer.data(), buffer.size(), delta);
+    ASSERT_TRUE(NULL != sent);
+    camera_metadata_t *received = allocate_copy_camera_metadata_checked(sent, buffer.size());
+    ASSERT_TRUE(NULL != received);
+
+    camera_metadata_t *base = allocate_camera_metadata(2 * tags.size(), tags.size() * 320);
+    ASSERT_TRUE(NULL != base);
+    ASSERT_EQ(OK, append_camera_metadata(base, prev));
+    ASSERT_EQ(OK, apply_camera_metadata_delta(base, received));
+    ASSERT_NO_FATAL_FAILURE(expect_sorted_values(base, cur_values));
+
+    // A clone of the delta is still a delta.
+    camera_metadata_t *clone = clone_camera_metadata(delta);
+    ASSERT_TRUE(NULL != clone);
+    camera_metadata_t *mutable_base = allocate_camera_metadata_mutable(2 * tags.size(),
+            tags.size() * 640);
+    ASSERT_TRUE(NULL != mutable_base);
+    ASSERT_EQ(OK, append_camera_metadata(mutable_base, prev));
+    ASSERT_EQ(OK, apply_camera_metadata_delta(mutable_base, clone));
+    ASSERT_NO_FATAL_FAILURE(expect_sorted_values(mutable_base, cur_values));
+    FINISH_USING_CAMERA_METADATA(mutable_base);
+    FINISH_USING_CAMERA_METADATA(clone);
+
+    // The delta of identical packets is empty, and applies as a sort.
+    camera_metadata_t *empty = diff_camera_metadata(cur, cur);
+    ASSERT_TRUE(NULL != empty);
+    EXPECT_EQ(0u, get_camera_metadata_entry_count(empty));
+    ASSERT_EQ(OK, apply_camera_metadata_delta(cur, empty));
+    ASSERT_NO_FATAL_FAILURE(expect_sorted_values(cur, cur_values));
+
+    FINISH_USING_CAMERA_METADATA(empty);
+    FINISH_USING_CAMERA_METADATA(base);
+    free_camera_metadata(received);
+    FINISH_USING_CAMERA_METADATA(delta);
+    FINISH_USING_CAMERA_METADATA(cur);
+    FINISH_USING_CAMERA_METADATA(prev);
+}
+
 TEST(camera_metadata, delete_metadata) {
     camera_metadata_t *m = NULL;
     const size_t entry_capacity = 50;
@@ -38,6 +38,10 @@ extern "C" {
  * Set the global vendor tag operations object used to define vendor tag
  * structure when parsing camera metadata with functions defined in
  * system/media/camera/include/camera_metadata.h.
+ *
+ * The names and types of the tags listed by the ops are cached on first use,
+ * and the cache is dropped by each call, so the ops must not change the tags
+ * they define while set.
  */
 ANDROID_API
 int set_camera_metadata_vendor_ops(const vendor_tag_ops_t *query_ops);
@@ -46,6 +50,9 @@ int set_camera_metadata_vendor_ops(const vendor_tag_ops_t *query_ops);
  * Set the global vendor tag cache operations object used to define vendor tag
  * structure when parsing camera metadata with functions defined in
  * system/media/camera/include/camera_metadata.h.
+ *
+ * As for set_camera_metadata_vendor_ops(), the tags of each vendor id are
+ * cached on first use until the next call.
  */
 ANDROID_API
 int set_camera_metadata_vendor_cache_ops(